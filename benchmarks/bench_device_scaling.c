@@ -0,0 +1,221 @@
+/**
+ * Device Scaling Benchmark
+ *
+ * One engine over a growing number of devices, driven by two client
+ * threads per device storing and then retrieving 4KB values, so the load
+ * grows with the fleet as it would behind a server. [BEFORE] is the range
+ * the engine allowed while KV_MAX_DEVICES was 8: one engine could use at
+ * most eight SSDs, and a larger box needed several engines with the
+ * sharding done by the application. [AFTER] runs one engine over 16 to 128
+ * devices, its per-device tables sized for config.max_devices. Also shown
+ * per row: what a placement costs at that device count (it hashes every
+ * device), and the bytes of per-device tables the engine allocated.
+ *
+ * The emulator serves each device from its own polling threads, so on a
+ * host with fewer cores than devices the rows past the core count measure
+ * those threads competing for the CPU rather than the engine.
+ */
+
+#include "kv_engine.h"
+#include "kv_engine_internal.h"
+#include "util/bench_utils.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define THREADS_PER_DEVICE 2
+#define DEFAULT_KEYS_PER_THREAD 50
+#define KEY_SIZE 16
+/* Keys are KEY_SIZE bytes; make_key's buffer fits any number given */
+#define KEY_BUFFER_SIZE 32
+#define VALUE_SIZE 4096
+#define PLACEMENTS 1000000
+
+/* Keeps the placement loop from being optimized away */
+static volatile uint32_t placement_sink;
+
+typedef struct {
+  kv_engine_t *engine;
+  int thread;
+  int num_keys;
+  uint64_t failures;
+} worker_t;
+
+/* CPU time of the calling thread: placement is pure computation, and the
+ * emulator's polling threads would otherwise be charged to it */
+static double thread_cpu_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void make_key(char *key, int thread, int k) {
+  snprintf(key, KEY_BUFFER_SIZE, "t%04d.key%06d", thread, k);
+}
+
+static void *store_thread(void *arg) {
+  worker_t *w = (worker_t *)arg;
+  char key[KEY_BUFFER_SIZE];
+  void *value = kv_engine_alloc_buffer(w->engine, VALUE_SIZE);
+  if (!value) {
+    w->failures += w->num_keys;
+    return NULL;
+  }
+  memset(value, 'v', VALUE_SIZE);
+  for (int k = 0; k < w->num_keys; k++) {
+    make_key(key, w->thread, k);
+    w->failures += kv_engine_store(w->engine, key, KEY_SIZE, value,
+                                   VALUE_SIZE, true) != KV_SUCCESS;
+  }
+  kv_engine_free_buffer(w->engine, value);
+  return NULL;
+}
+
+static void *retrieve_thread(void *arg) {
+  worker_t *w = (worker_t *)arg;
+  char key[KEY_BUFFER_SIZE];
+  for (int k = 0; k < w->num_keys; k++) {
+    make_key(key, w->thread, k);
+    void *value = NULL;
+    size_t value_len = 0;
+    if (kv_engine_retrieve(w->engine, key, KEY_SIZE, &value, &value_len,
+                           false) != KV_SUCCESS) {
+      w->failures++;
+      continue;
+    }
+    w->failures += value_len != VALUE_SIZE;
+    kv_engine_free_buffer(w->engine, value);
+  }
+  return NULL;
+}
+
+/* Runs one phase on every worker; returns ops/sec */
+static double run_phase(worker_t *workers, pthread_t *threads,
+                        int num_threads, void *(*phase)(void *)) {
+  double start = get_time_seconds();
+  for (int t = 0; t < num_threads; t++) {
+    pthread_create(&threads[t], NULL, phase, &workers[t]);
+  }
+  for (int t = 0; t < num_threads; t++) {
+    pthread_join(threads[t], NULL);
+  }
+  return (double)num_threads * workers[0].num_keys /
+         (get_time_seconds() - start);
+}
+
+static void run(const char *prefix, uint32_t num_devices, int keys_per_thread) {
+  kv_engine_config_t config = {
+      .emul_config_file = "/kvssd/PDK/core/kvssd_emul.conf",
+      .memory_pool_size = 64 * 1024 * 1024,
+      .queue_depth = 128,
+      .enable_stats = 1,
+      .dma_pool_count = 16,
+      .num_devices = num_devices,
+      .max_devices = num_devices,
+  };
+  char(*paths)[256] = malloc(num_devices * sizeof(*paths));
+  int num_threads = (int)num_devices * THREADS_PER_DEVICE;
+  worker_t *workers = calloc(num_threads, sizeof(worker_t));
+  pthread_t *threads = calloc(num_threads, sizeof(pthread_t));
+  if (!paths || !workers || !threads) {
+    fprintf(stderr, "Failed to allocate %u-device run\n", num_devices);
+    goto out;
+  }
+  for (uint32_t i = 0; i < num_devices; i++) {
+    snprintf(paths[i], sizeof(paths[i]), "%s%u", prefix, i);
+    config.device_paths[i] = paths[i];
+  }
+
+  kv_engine_t *engine;
+  if (init_engine(&engine, paths[0], &config) != KV_SUCCESS) {
+    goto out;
+  }
+
+  kv_placement_t placement;
+  double start = thread_cpu_seconds();
+  for (uint32_t k = 0; k < PLACEMENTS; k++) {
+    kv_engine_place(engine, k * 2654435761u, &placement);
+    placement_sink = placement.dev[0];
+  }
+  double place_ns = (thread_cpu_seconds() - start) * 1e9 / PLACEMENTS;
+
+  for (int t = 0; t < num_threads; t++) {
+    workers[t] = (worker_t){
+        .engine = engine, .thread = t, .num_keys = keys_per_thread};
+  }
+  double store_rate = run_phase(workers, threads, num_threads, store_thread);
+  double retrieve_rate =
+      run_phase(workers, threads, num_threads, retrieve_thread);
+  uint64_t failures = 0;
+  for (int t = 0; t < num_threads; t++) {
+    failures += workers[t].failures;
+  }
+
+  /* device contexts and their latency histograms */
+  size_t table_bytes =
+      engine->device_slots *
+      (sizeof(kv_device_ctx_t) + sizeof(engine->latency->device[0]));
+  printf("  %7u %7d %12.0f %12.0f %10.1f %10.1f%s\n", num_devices,
+         num_threads, store_rate, retrieve_rate, place_ns,
+         table_bytes / 1024.0, failures ? "  (with failures)" : "");
+
+  /* the emulator keeps values in memory: free them for the next run */
+  char key[KEY_BUFFER_SIZE];
+  for (int t = 0; t < num_threads; t++) {
+    for (int k = 0; k < keys_per_thread; k++) {
+      make_key(key, t, k);
+      kv_engine_delete(engine, key, KEY_SIZE);
+    }
+  }
+  kv_engine_cleanup(engine);
+out:
+  free(threads);
+  free(workers);
+  free(paths);
+}
+
+static void print_header(void) {
+  printf("  %7s %7s %12s %12s %10s %10s\n", "devices", "threads",
+         "stores/s", "retrieves/s", "place ns", "tables KB");
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr,
+            "Usage: %s <device_path_prefix> [keys_per_thread]\n"
+            "  devices are <prefix>0 .. <prefix>%d\n",
+            argv[0], KV_MAX_DEVICES - 1);
+    return 1;
+  }
+
+  int keys_per_thread = argc >= 3 ? atoi(argv[2]) : DEFAULT_KEYS_PER_THREAD;
+  if (keys_per_thread <= 0) {
+    fprintf(stderr, "Invalid keys_per_thread: %s\n", argv[2]);
+    return 1;
+  }
+
+  printf("=== Device Scaling Benchmark ===\n");
+  printf("Threads: %d per device | Keys: %d per thread | Values: %dB | "
+         "Host cores: %ld\n",
+         THREADS_PER_DEVICE, keys_per_thread, VALUE_SIZE,
+         sysconf(_SC_NPROCESSORS_ONLN));
+
+  printf("\n[BEFORE] KV_MAX_DEVICES = 8: one engine, at most 8 devices\n");
+  print_header();
+  for (uint32_t n = 1; n <= 8; n *= 2) {
+    run(argv[1], n, keys_per_thread);
+  }
+
+  printf("\n[AFTER] KV_MAX_DEVICES = %d, tables sized by max_devices\n",
+         KV_MAX_DEVICES);
+  print_header();
+  for (uint32_t n = 16; n <= KV_MAX_DEVICES; n *= 2) {
+    run(argv[1], n, keys_per_thread);
+  }
+
+  printf("\nDone.\n");
+  return 0;
+}
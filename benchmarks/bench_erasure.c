@@ -0,0 +1,197 @@
+/**
+ * Erasure Coding Benchmark
+ *
+ * Four devices holding 2MB objects. Each configuration stores them, reads
+ * them back from several threads, and then reads them all again after one
+ * device has been marked unhealthy (as the engine does after repeated
+ * device errors). [BEFORE] keeps each object whole on the one device its
+ * key hashes to: a read moves 2MB through one SSD, and a quarter of the
+ * objects are lost with the device. [AFTER] stripes objects of 64KB and
+ * up over k data plus m parity chunks on k + m devices: a read fetches
+ * the chunks in parallel, and any m devices may be down. Parity costs m/k
+ * extra bytes on every store, and on every read, since the parity is read
+ * alongside the data to ride out a slow device. The emulator copies values
+ * in memory without any per-device bandwidth limit, so it shows the cost
+ * of chunking and coding but not the bandwidth of k devices at once.
+ */
+
+#include "kv_engine.h"
+#include "kv_engine_internal.h"
+#include "util/bench_utils.h"
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_DEVICES 4
+#define DEFAULT_NUM_OBJECTS 64
+#define READ_THREADS 4
+#define READ_PASSES 4
+#define KEY_SIZE 16
+#define OBJECT_SIZE (2 * 1024 * 1024)
+#define STRIPE_THRESHOLD (64 * 1024)
+
+typedef struct {
+  kv_engine_t *engine;
+  int num_objects;
+  int first;
+  uint64_t failures;
+} reader_t;
+
+static void make_key(char *key, int k) {
+  snprintf(key, KEY_SIZE, "obj%012d", k);
+}
+
+/* READ_PASSES sweeps over all objects, each thread starting elsewhere */
+static void *reader_thread(void *arg) {
+  reader_t *reader = (reader_t *)arg;
+  char key[KEY_SIZE];
+  for (int i = 0; i < READ_PASSES * reader->num_objects; i++) {
+    make_key(key, (reader->first + i) % reader->num_objects);
+    void *out = NULL;
+    size_t out_len = 0;
+    if (kv_engine_retrieve(reader->engine, key, KEY_SIZE, &out, &out_len,
+                           false) != KV_SUCCESS) {
+      reader->failures++;
+      continue;
+    }
+    kv_engine_free_buffer(reader->engine, out);
+  }
+  return NULL;
+}
+
+static void run(const char *label, char paths[][256], int num_objects,
+                uint32_t data_chunks, uint32_t parity_chunks) {
+  kv_engine_config_t config = {
+      .emul_config_file = "/kvssd/PDK/core/kvssd_emul.conf",
+      .memory_pool_size = 64 * 1024 * 1024,
+      .queue_depth = 128,
+      .enable_stats = 1,
+      .dma_pool_count = 16,
+      .num_devices = NUM_DEVICES,
+      .erasure_min_value_size = data_chunks ? STRIPE_THRESHOLD : 0,
+      .erasure_data_chunks = data_chunks,
+      .erasure_parity_chunks = parity_chunks,
+  };
+  for (int i = 0; i < NUM_DEVICES; i++) {
+    config.device_paths[i] = paths[i];
+  }
+
+  kv_engine_t *engine;
+  if (init_engine(&engine, paths[0], &config) != KV_SUCCESS) {
+    return;
+  }
+
+  char key[KEY_SIZE];
+  void *value = kv_engine_alloc_buffer(engine, OBJECT_SIZE);
+  if (!value) {
+    fprintf(stderr, "Failed to allocate value buffer\n");
+    kv_engine_cleanup(engine);
+    return;
+  }
+  memset(value, 'v', OBJECT_SIZE);
+
+  double start = get_time_seconds();
+  for (int k = 0; k < num_objects; k++) {
+    make_key(key, k);
+    if (kv_engine_store(engine, key, KEY_SIZE, value, OBJECT_SIZE, true) !=
+        KV_SUCCESS) {
+      fprintf(stderr, "Preload failed at object %d\n", k);
+      kv_engine_free_buffer(engine, value);
+      kv_engine_cleanup(engine);
+      return;
+    }
+  }
+  double mb = (double)num_objects * OBJECT_SIZE / (1024 * 1024);
+  double store_bw = mb / (get_time_seconds() - start);
+
+  reader_t readers[READ_THREADS];
+  pthread_t threads[READ_THREADS];
+  start = get_time_seconds();
+  for (int t = 0; t < READ_THREADS; t++) {
+    readers[t] = (reader_t){.engine = engine,
+                            .num_objects = num_objects,
+                            .first = t * num_objects / READ_THREADS};
+    pthread_create(&threads[t], NULL, reader_thread, &readers[t]);
+  }
+  uint64_t failures = 0;
+  for (int t = 0; t < READ_THREADS; t++) {
+    pthread_join(threads[t], NULL);
+    failures += readers[t].failures;
+  }
+  double read_bw =
+      READ_THREADS * READ_PASSES * mb / (get_time_seconds() - start);
+
+  /* full read sweep with device 0 out of service */
+  atomic_store(&engine->devices[0].healthy, false);
+  int readable = 0;
+  start = get_time_seconds();
+  for (int k = 0; k < num_objects; k++) {
+    void *out = NULL;
+    size_t out_len = 0;
+    make_key(key, k);
+    if (kv_engine_retrieve(engine, key, KEY_SIZE, &out, &out_len, false) ==
+        KV_SUCCESS) {
+      readable++;
+      kv_engine_free_buffer(engine, out);
+    }
+  }
+  double degraded_bw = readable * ((double)OBJECT_SIZE / (1024 * 1024)) /
+                       (get_time_seconds() - start);
+  atomic_store(&engine->devices[0].healthy, true);
+
+  kv_engine_stats_t stats;
+  kv_engine_get_stats(engine, &stats);
+
+  if (data_chunks) {
+    printf("\n%s k = %u data + m = %u parity chunks\n", label, data_chunks,
+           parity_chunks);
+  } else {
+    printf("\n%s whole objects, one device each\n", label);
+  }
+  printf("  stores:                %8.1f MB/s\n", store_bw);
+  printf("  reads, %d threads:      %8.1f MB/s%s\n", READ_THREADS, read_bw,
+         failures ? " (with failures)" : "");
+  printf("  reads, 1 device down:  %8.1f MB/s, %d of %d objects readable "
+         "(%.1f%%), %" PRIu64 " rebuilt from parity\n",
+         degraded_bw, readable, num_objects, 100.0 * readable / num_objects,
+         stats.reconstructed_retrieves);
+
+  kv_engine_free_buffer(engine, value);
+  kv_engine_cleanup(engine);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr,
+            "Usage: %s <device_path_prefix> [num_objects]\n"
+            "  devices are <prefix>0 .. <prefix>%d\n",
+            argv[0], NUM_DEVICES - 1);
+    return 1;
+  }
+
+  int num_objects = argc >= 3 ? atoi(argv[2]) : DEFAULT_NUM_OBJECTS;
+  if (num_objects <= 0) {
+    fprintf(stderr, "Invalid num_objects: %s\n", argv[2]);
+    return 1;
+  }
+
+  char paths[NUM_DEVICES][256];
+  for (int i = 0; i < NUM_DEVICES; i++) {
+    snprintf(paths[i], sizeof(paths[i]), "%s%d", argv[1], i);
+  }
+
+  printf("=== Erasure Coding Benchmark ===\n");
+  printf("Objects: %d x %dMB | Devices: %d | Readers: %d threads x %d "
+         "passes\n",
+         num_objects, OBJECT_SIZE / (1024 * 1024), NUM_DEVICES, READ_THREADS,
+         READ_PASSES);
+
+  run("[BEFORE]", paths, num_objects, 0, 0);
+  run("[AFTER]", paths, num_objects, 3, 1);
+  run("[AFTER]", paths, num_objects, 2, 2);
+
+  printf("\nDone.\n");
+  return 0;
+}
@@ -0,0 +1,109 @@
+/**
+ * Existence Check Benchmark
+ *
+ * Measures kv_engine_exists() latency over a mix of stored and absent keys.
+ * The [BEFORE] run checks every key against the device; the [AFTER] run
+ * makes the recovered key index authoritative so checks are answered from
+ * DRAM, optionally verifying a sample against the device.
+ */
+
+#include "kv_engine.h"
+#include "util/bench_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_NUM_OPS 100000
+#define NUM_KEYS 10000
+#define KEY_SIZE 16
+#define VALUE_SIZE 4096
+#define VERIFY_INTERVAL 1000
+
+static void run(const char *label, const char *device_path, int num_ops,
+                uint32_t authoritative, uint32_t verify_interval) {
+  kv_engine_config_t config = {
+      .device_path = device_path,
+      .emul_config_file = "/kvssd/PDK/core/kvssd_emul.conf",
+      .memory_pool_size = 64 * 1024 * 1024,
+      .queue_depth = 128,
+      .enable_stats = 1,
+      .dma_pool_count = 16,
+      .recover_index = 1,
+      .index_authoritative = authoritative,
+      .exists_verify_interval = verify_interval,
+  };
+
+  kv_engine_t *engine;
+  if (init_engine(&engine, device_path, &config) != KV_SUCCESS) {
+    return;
+  }
+
+  char key[KEY_SIZE];
+  void *value = kv_engine_alloc_buffer(engine, VALUE_SIZE);
+  if (!value) {
+    fprintf(stderr, "Failed to allocate value buffer\n");
+    kv_engine_cleanup(engine);
+    return;
+  }
+  memset(value, 'X', VALUE_SIZE);
+
+  for (int i = 0; i < NUM_KEYS; i++) {
+    snprintf(key, KEY_SIZE, "key%012d", i);
+    kv_engine_store(engine, key, KEY_SIZE, value, VALUE_SIZE, true);
+  }
+  kv_engine_reset_stats(engine);
+
+  /* keys in [0, 2 * NUM_KEYS): half were stored, half never were */
+  unsigned int seed = 42;
+  int found = 0;
+  double start = get_time_seconds();
+  for (int i = 0; i < num_ops; i++) {
+    snprintf(key, KEY_SIZE, "key%012d", rand_r(&seed) % (2 * NUM_KEYS));
+    int exists = 0;
+    kv_engine_exists(engine, key, KEY_SIZE, &exists);
+    found += exists;
+  }
+  double elapsed = get_time_seconds() - start;
+
+  kv_engine_stats_t stats;
+  kv_engine_get_stats(engine, &stats);
+
+  printf("\n%s\n", label);
+  printf("  ops/sec: %10.0f   latency: %.3f us   found: %.1f%%\n",
+         num_ops / elapsed, (elapsed * 1e6) / num_ops, found * 100.0 / num_ops);
+  printf("  from index: %lu   verified on device: %lu   mismatches: %lu\n",
+         (unsigned long)stats.exists_from_index,
+         (unsigned long)stats.exists_verified,
+         (unsigned long)stats.index_mismatches);
+
+  kv_engine_free_buffer(engine, value);
+  kv_engine_cleanup(engine);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <device_path> [num_ops]\n", argv[0]);
+    return 1;
+  }
+
+  int num_ops = DEFAULT_NUM_OPS;
+  if (argc >= 3) {
+    num_ops = atoi(argv[2]);
+    if (num_ops <= 0) {
+      fprintf(stderr, "Invalid num_ops: %s\n", argv[2]);
+      return 1;
+    }
+  }
+
+  printf("=== Existence Check Benchmark ===\n");
+  printf("Keys: %d | Ops: %d | Half of the probed keys are absent\n", NUM_KEYS,
+         num_ops);
+
+  run("[BEFORE] index + device check", argv[1], num_ops, 0, 0);
+  run("[AFTER] authoritative index", argv[1], num_ops, 1, 0);
+  run("[AFTER] authoritative index, 1 in 1000 verified", argv[1], num_ops, 1,
+      VERIFY_INTERVAL);
+
+  printf("\nDone.\n");
+  return 0;
+}
@@ -0,0 +1,189 @@
+/**
+ * Flight Recorder Benchmark
+ *
+ * Store/retrieve loop over mixed value sizes. The [BEFORE] run has the
+ * flight recorder off; the [AFTER] run keeps the last 1024 ops per thread
+ * and a slow-op log, so the throughput difference is the recording cost.
+ * The [AFTER] run then reads both logs back, summarizes which ops and
+ * sizes were slow, and triggers a dump through the configured signal.
+ */
+
+#include "kv_engine.h"
+#include "util/bench_utils.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DEFAULT_NUM_OPS 20000
+#define NUM_KEYS 5000
+#define KEY_SIZE 16
+#define MAX_VALUE_SIZE (64 * 1024)
+#define RECORDER_SIZE 1024
+#define SLOW_OP_US 200
+#define RECENT_TO_PRINT 5
+#define DUMP_PATH "/tmp/kv_engine_flight_recorder.txt"
+
+static const char *op_names[KV_OP_TYPES] = {"store", "retrieve", "delete",
+                                            "exists"};
+
+static void print_logs(kv_engine_t *engine) {
+  kv_op_record_t *recent = malloc(sizeof(kv_op_record_t) * RECENT_TO_PRINT);
+  kv_op_record_t *slow = malloc(sizeof(kv_op_record_t) * KV_SLOW_OP_LOG_SIZE);
+  if (!recent || !slow) {
+    free(recent);
+    free(slow);
+    return;
+  }
+
+  uint32_t count = 0;
+  if (kv_engine_get_recent_ops(engine, recent, RECENT_TO_PRINT, &count) ==
+      KV_SUCCESS) {
+    printf("  last %u ops:\n", count);
+    for (uint32_t i = 0; i < count; i++) {
+      printf("    %-8s dev %u  size %6lu  %8.1f us (device %8.1f us)\n",
+             op_names[recent[i].op], recent[i].device_index,
+             (unsigned long)recent[i].value_size, recent[i].latency_ns / 1e3,
+             recent[i].device_ns / 1e3);
+    }
+  }
+
+  if (kv_engine_get_slow_ops(engine, slow, KV_SLOW_OP_LOG_SIZE, &count) ==
+      KV_SUCCESS) {
+    /* which ops and sizes were slow: bucket by op and power-of-two size */
+    uint32_t by_size[KV_OP_TYPES][8] = {{0}};
+    for (uint32_t i = 0; i < count; i++) {
+      uint32_t bucket = 0;
+      for (uint64_t size = slow[i].value_size; size > 1024 && bucket < 7;
+           size >>= 1) {
+        bucket++;
+      }
+      by_size[slow[i].op][bucket]++;
+    }
+    printf("  slow ops (>= %d us) kept: %u\n", SLOW_OP_US, count);
+    for (int op = 0; op < KV_OP_TYPES; op++) {
+      for (int b = 0; b < 8; b++) {
+        if (by_size[op][b]) {
+          printf("    %-8s <= %3uKB: %u\n", op_names[op], 1u << b,
+                 by_size[op][b]);
+        }
+      }
+    }
+  }
+
+  free(recent);
+  free(slow);
+}
+
+/* Raises the dump signal and waits for the dump thread to write the file */
+static void dump_via_signal(void) {
+  unlink(DUMP_PATH);
+  raise(SIGUSR2);
+  for (int i = 0; i < 100; i++) {
+    usleep(10000);
+    FILE *f = fopen(DUMP_PATH, "r");
+    if (!f) {
+      continue;
+    }
+    int lines = 0;
+    for (int c; (c = fgetc(f)) != EOF;) {
+      lines += c == '\n';
+    }
+    fclose(f);
+    if (lines > 0) {
+      printf("  SIGUSR2 dump: %d lines in %s\n", lines, DUMP_PATH);
+      return;
+    }
+  }
+  printf("  SIGUSR2 dump: no output\n");
+}
+
+static void run(const char *label, const char *device_path, int num_ops,
+                uint32_t recorder_size) {
+  kv_engine_config_t config = {
+      .device_path = device_path,
+      .emul_config_file = "/kvssd/PDK/core/kvssd_emul.conf",
+      .memory_pool_size = 64 * 1024 * 1024,
+      .queue_depth = 128,
+      .enable_stats = 1,
+      .dma_pool_count = 16,
+      .flight_recorder_size = recorder_size,
+      .slow_op_threshold_us = recorder_size ? SLOW_OP_US : 0,
+      .dump_signal = recorder_size ? SIGUSR2 : 0,
+      .dump_path = DUMP_PATH,
+  };
+
+  kv_engine_t *engine;
+  if (init_engine(&engine, device_path, &config) != KV_SUCCESS) {
+    return;
+  }
+
+  char key[KEY_SIZE];
+  void *value = kv_engine_alloc_buffer(engine, MAX_VALUE_SIZE);
+  if (!value) {
+    fprintf(stderr, "Failed to allocate value buffer\n");
+    kv_engine_cleanup(engine);
+    return;
+  }
+  memset(value, 'X', MAX_VALUE_SIZE);
+
+  unsigned int seed = 42;
+  double start = get_time_seconds();
+  for (int i = 0; i < num_ops; i++) {
+    int k = rand_r(&seed) % NUM_KEYS;
+    snprintf(key, KEY_SIZE, "key%012d", k);
+    if (i % 2 == 0) {
+      /* 512B..64KB, fixed per key */
+      size_t value_len = (size_t)512 << (k % 8);
+      kv_engine_store(engine, key, KEY_SIZE, value, value_len, true);
+    } else {
+      void *out = NULL;
+      size_t out_len = 0;
+      if (kv_engine_retrieve(engine, key, KEY_SIZE, &out, &out_len, false) ==
+          KV_SUCCESS) {
+        kv_engine_free_buffer(engine, out);
+      }
+    }
+  }
+  double elapsed = get_time_seconds() - start;
+
+  printf("\n%s\n", label);
+  printf("  ops/sec: %10.0f   latency: %.2f us\n", num_ops / elapsed,
+         (elapsed * 1e6) / num_ops);
+
+  if (recorder_size) {
+    print_logs(engine);
+    dump_via_signal();
+  }
+
+  kv_engine_free_buffer(engine, value);
+  kv_engine_cleanup(engine);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <device_path> [num_ops]\n", argv[0]);
+    return 1;
+  }
+
+  int num_ops = DEFAULT_NUM_OPS;
+  if (argc >= 3) {
+    num_ops = atoi(argv[2]);
+    if (num_ops <= 0) {
+      fprintf(stderr, "Invalid num_ops: %s\n", argv[2]);
+      return 1;
+    }
+  }
+
+  printf("=== Flight Recorder Benchmark ===\n");
+  printf("Keys: %d | Ops: %d (50%% store, 512B-64KB values)\n", NUM_KEYS,
+         num_ops);
+
+  run("[BEFORE] flight recorder off", argv[1], num_ops, 0);
+  run("[AFTER] flight recorder on (1024 ops/thread, slow-op log)", argv[1],
+      num_ops, RECORDER_SIZE);
+
+  printf("\nDone.\n");
+  return 0;
+}
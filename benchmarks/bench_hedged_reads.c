@@ -0,0 +1,198 @@
+/**
+ * Hedged Reads Benchmark
+ *
+ * Two devices holding two copies of every key. A background thread makes
+ * device 0 intermittently slow, the way garbage collection or a noisy
+ * neighbour would: bursts of large writes issued straight to its keyspace,
+ * outside the engine, separated by idle gaps. A reader then retrieves
+ * random keys and the engine's retrieve latency is reported. [BEFORE] has
+ * hedging off, so every read the placement sends to device 0 during a
+ * burst waits it out; [AFTER] sets hedge_percentile, so a read still
+ * waiting after the device's recent p95 is also sent to device 1 and the
+ * first answer wins.
+ */
+
+#include "kv_engine.h"
+#include "kv_engine_internal.h"
+#include "util/bench_utils.h"
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define NUM_DEVICES 2
+#define DEFAULT_NUM_KEYS 4000
+#define DEFAULT_NUM_READS 40000
+#define KEY_SIZE 16
+#define VALUE_SIZE 4096
+#define NOISE_VALUE_SIZE (1024 * 1024)
+#define NOISE_BURST 8       /* writes per burst */
+#define NOISE_GAP_US 20000  /* idle time between bursts */
+#define NOISE_KEYS 64
+
+typedef struct {
+  kv_engine_t *engine;
+  kv_device_ctx_t *device;
+  volatile int stop;
+  uint64_t writes;
+} noise_t;
+
+static void make_key(char *key, int k) {
+  snprintf(key, KEY_SIZE, "key%012d", k);
+}
+
+/* Bursts of large overwrites on internal keys, so the engine never sees
+ * them as user data */
+static void *noise_thread(void *arg) {
+  noise_t *noise = (noise_t *)arg;
+  void *value = kv_engine_alloc_buffer(noise->engine, NOISE_VALUE_SIZE);
+  if (!value) {
+    return NULL;
+  }
+  memset(value, 'n', NOISE_VALUE_SIZE);
+
+  char key[KEY_SIZE];
+  memcpy(key, KV_INTERNAL_KEY_PREFIX, KV_INTERNAL_KEY_PREFIX_LEN);
+  kvs_key kv_key = {.key = key, .length = KEY_SIZE};
+  kvs_value kv_value = {.value = value,
+                        .length = NOISE_VALUE_SIZE,
+                        .actual_value_size = NOISE_VALUE_SIZE,
+                        .offset = 0};
+  kvs_option_store option = {.st_type = KVS_STORE_POST};
+
+  uint64_t n = 0;
+  while (!noise->stop) {
+    for (int i = 0; i < NOISE_BURST && !noise->stop; i++, n++) {
+      snprintf(key + KV_INTERNAL_KEY_PREFIX_LEN,
+               KEY_SIZE - KV_INTERNAL_KEY_PREFIX_LEN, "noise%06" PRIu64,
+               n % NOISE_KEYS);
+      kvs_store_kvp(noise->device->keyspace, &kv_key, &kv_value, &option);
+    }
+    usleep(NOISE_GAP_US);
+  }
+  noise->writes = n;
+  kv_engine_free_buffer(noise->engine, value);
+  return NULL;
+}
+
+static void run(const char *label, char paths[][256], int num_keys,
+                int num_reads, uint32_t hedge_percentile) {
+  kv_engine_config_t config = {
+      .emul_config_file = "/kvssd/PDK/core/kvssd_emul.conf",
+      .memory_pool_size = 64 * 1024 * 1024,
+      .queue_depth = 128,
+      .enable_stats = 1,
+      .dma_pool_count = 16,
+      .num_devices = NUM_DEVICES,
+      .replication_factor = NUM_DEVICES,
+      .hedge_percentile = hedge_percentile,
+  };
+  for (int i = 0; i < NUM_DEVICES; i++) {
+    config.device_paths[i] = paths[i];
+  }
+
+  kv_engine_t *engine;
+  if (init_engine(&engine, paths[0], &config) != KV_SUCCESS) {
+    return;
+  }
+
+  char key[KEY_SIZE];
+  void *value = kv_engine_alloc_buffer(engine, VALUE_SIZE);
+  if (!value) {
+    fprintf(stderr, "Failed to allocate value buffer\n");
+    kv_engine_cleanup(engine);
+    return;
+  }
+  memset(value, 'v', VALUE_SIZE);
+  for (int k = 0; k < num_keys; k++) {
+    make_key(key, k);
+    if (kv_engine_store(engine, key, KEY_SIZE, value, VALUE_SIZE, true) !=
+        KV_SUCCESS) {
+      fprintf(stderr, "Preload failed at key %d\n", k);
+      kv_engine_free_buffer(engine, value);
+      kv_engine_cleanup(engine);
+      return;
+    }
+  }
+
+  noise_t noise = {.engine = engine, .device = &engine->devices[0]};
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, noise_thread, &noise) != 0) {
+    fprintf(stderr, "Failed to start noise thread\n");
+    kv_engine_free_buffer(engine, value);
+    kv_engine_cleanup(engine);
+    return;
+  }
+
+  kv_engine_reset_stats(engine);
+  unsigned int seed = 42;
+  uint64_t failures = 0;
+  double start = get_time_seconds();
+  for (int i = 0; i < num_reads; i++) {
+    void *out = NULL;
+    size_t out_len = 0;
+    make_key(key, rand_r(&seed) % num_keys);
+    if (kv_engine_retrieve(engine, key, KEY_SIZE, &out, &out_len, false) !=
+        KV_SUCCESS) {
+      failures++;
+      continue;
+    }
+    kv_engine_free_buffer(engine, out);
+  }
+  double elapsed = get_time_seconds() - start;
+
+  noise.stop = 1;
+  pthread_join(thread, NULL);
+
+  kv_engine_stats_t stats;
+  kv_engine_get_stats(engine, &stats);
+
+  printf("\n%s hedge_percentile = %u\n", label, hedge_percentile);
+  printf("  reads: %.0f ops/sec, %" PRIu64 " failed, %" PRIu64
+         " background writes on device 0\n",
+         num_reads / elapsed, failures, noise.writes);
+  print_latency_percentiles(engine, KV_OP_RETRIEVE);
+  printf("  hedged: %" PRIu64 " reads (%.1f%%), second copy answered "
+         "first %" PRIu64 " times\n",
+         stats.hedged_reads, 100.0 * (double)stats.hedged_reads / num_reads,
+         stats.hedge_wins);
+
+  kv_engine_free_buffer(engine, value);
+  kv_engine_cleanup(engine);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr,
+            "Usage: %s <device_path_prefix> [num_keys] [num_reads]\n"
+            "  devices are <prefix>0 .. <prefix>%d\n",
+            argv[0], NUM_DEVICES - 1);
+    return 1;
+  }
+
+  int num_keys = argc >= 3 ? atoi(argv[2]) : DEFAULT_NUM_KEYS;
+  int num_reads = argc >= 4 ? atoi(argv[3]) : DEFAULT_NUM_READS;
+  if (num_keys <= 0 || num_reads <= 0) {
+    fprintf(stderr, "Invalid num_keys or num_reads\n");
+    return 1;
+  }
+
+  char paths[NUM_DEVICES][256];
+  for (int i = 0; i < NUM_DEVICES; i++) {
+    snprintf(paths[i], sizeof(paths[i]), "%s%d", argv[1], i);
+  }
+
+  printf("=== Hedged Reads Benchmark ===\n");
+  printf("Keys: %d x %dB on %d devices, 2 copies each | Reads: %d\n",
+         num_keys, VALUE_SIZE, NUM_DEVICES, num_reads);
+  printf("Device 0 noise: bursts of %d x %dKB writes every %d ms\n",
+         NOISE_BURST, NOISE_VALUE_SIZE / 1024, NOISE_GAP_US / 1000);
+
+  run("[BEFORE]", paths, num_keys, num_reads, 0);
+  run("[AFTER]", paths, num_keys, num_reads, 95);
+
+  printf("\nDone.\n");
+  return 0;
+}
@@ -0,0 +1,135 @@
+/**
+ * Hot-Key Detection Benchmark
+ *
+ * Skewed read/write mix across several devices: a handful of keys take a
+ * large share of the traffic and the rest is uniform. The [BEFORE] run has
+ * hot-key sampling off; the [AFTER] run samples 1 in 16 ops and prints the
+ * detected top keys and the device load skew, so the throughput difference
+ * is the cost of detection.
+ */
+
+#include "kv_engine.h"
+#include "util/bench_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_NUM_OPS 40000
+#define NUM_KEYS 10000
+#define NUM_HOT_KEYS 4
+#define HOT_PERCENT 30
+#define KEY_SIZE 16
+#define VALUE_SIZE 1024
+#define SAMPLE_INTERVAL 16
+#define TOP_TO_PRINT 6
+
+static void run(const char *label, const char **device_paths,
+                uint32_t num_devices, int num_ops, uint32_t sample_interval) {
+  kv_engine_config_t config = {
+      .emul_config_file = "/kvssd/PDK/core/kvssd_emul.conf",
+      .memory_pool_size = 64 * 1024 * 1024,
+      .queue_depth = 128,
+      .enable_stats = 1,
+      .dma_pool_count = 16,
+      .num_devices = num_devices,
+      .hot_key_sample_interval = sample_interval,
+  };
+  for (uint32_t i = 0; i < num_devices; i++) {
+    config.device_paths[i] = device_paths[i];
+  }
+
+  kv_engine_t *engine;
+  if (init_engine(&engine, device_paths[0], &config) != KV_SUCCESS) {
+    return;
+  }
+
+  char key[KEY_SIZE];
+  void *value = kv_engine_alloc_buffer(engine, VALUE_SIZE);
+  if (!value) {
+    fprintf(stderr, "Failed to allocate value buffer\n");
+    kv_engine_cleanup(engine);
+    return;
+  }
+  memset(value, 'X', VALUE_SIZE);
+
+  unsigned int seed = 42;
+  double start = get_time_seconds();
+  for (int i = 0; i < num_ops; i++) {
+    if ((rand_r(&seed) % 100) < HOT_PERCENT) {
+      snprintf(key, KEY_SIZE, "hot%012d", rand_r(&seed) % NUM_HOT_KEYS);
+    } else {
+      snprintf(key, KEY_SIZE, "key%012d", rand_r(&seed) % NUM_KEYS);
+    }
+
+    if (i % 4 == 0) {
+      kv_engine_store(engine, key, KEY_SIZE, value, VALUE_SIZE, true);
+    } else {
+      void *out = NULL;
+      size_t out_len = 0;
+      if (kv_engine_retrieve(engine, key, KEY_SIZE, &out, &out_len, false) ==
+          KV_SUCCESS) {
+        kv_engine_free_buffer(engine, out);
+      }
+    }
+  }
+  double elapsed = get_time_seconds() - start;
+
+  printf("\n%s\n", label);
+  printf("  ops/sec: %10.0f   latency: %.2f us\n", num_ops / elapsed,
+         (elapsed * 1e6) / num_ops);
+
+  kv_hot_key_report_t report;
+  if (kv_engine_get_hot_keys(engine, &report) == KV_SUCCESS) {
+    printf("  device load (cmds/sec):");
+    for (uint32_t i = 0; i < report.num_devices; i++) {
+      printf(" %.0f", report.device_ops_per_sec[i]);
+    }
+    printf("   skew: %.2f\n", report.load_skew);
+
+    uint32_t shown =
+        report.num_keys < TOP_TO_PRINT ? report.num_keys : TOP_TO_PRINT;
+    for (uint32_t i = 0; i < shown; i++) {
+      const kv_hot_key_t *hot = &report.keys[i];
+      printf("  #%u %.*s  device %u  ~%.0f ops/sec\n", i + 1,
+             (int)strnlen((const char *)hot->key, hot->key_len),
+             (const char *)hot->key, hot->device_index, hot->ops_per_sec);
+    }
+  }
+
+  kv_engine_free_buffer(engine, value);
+  kv_engine_cleanup(engine);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <device_path> [device_path...] [-n num_ops]\n",
+            argv[0]);
+    return 1;
+  }
+
+  const char *device_paths[KV_MAX_DEVICES];
+  uint32_t num_devices = 0;
+  int num_ops = DEFAULT_NUM_OPS;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      num_ops = atoi(argv[++i]);
+    } else if (num_devices < KV_MAX_DEVICES) {
+      device_paths[num_devices++] = argv[i];
+    }
+  }
+  if (num_ops <= 0 || num_devices == 0) {
+    fprintf(stderr, "Invalid arguments\n");
+    return 1;
+  }
+
+  printf("=== Hot-Key Detection Benchmark ===\n");
+  printf("Devices: %u | Ops: %d | %d%% of ops on %d hot keys\n", num_devices,
+         num_ops, HOT_PERCENT, NUM_HOT_KEYS);
+
+  run("[BEFORE] hot-key sampling off", device_paths, num_devices, num_ops, 0);
+  run("[AFTER] sampling 1 in 16 ops", device_paths, num_devices, num_ops,
+      SAMPLE_INTERVAL);
+
+  printf("\nDone.\n");
+  return 0;
+}
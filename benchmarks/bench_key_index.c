@@ -0,0 +1,151 @@
+/**
+ * Key Index Scaling Benchmark
+ *
+ * Measures exists/store throughput on the in-memory key index as the number
+ * of threads grows from 1 to 64. The [BEFORE] run wraps every index call in
+ * one global mutex, which is how the engine serialized index access prior to
+ * striping; the [AFTER] run uses the striped reader-writer locks directly.
+ */
+
+#include "hashTable.h"
+#include "util/bench_utils.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEFAULT_OPS_PER_THREAD 200000
+#define KEY_SPACE 65536
+#define KEY_SIZE 16
+#define STORE_PERCENT 10 /* remaining ops are exists checks */
+
+/* keys and hashes are generated up front so the timed loop measures only
+ * the index, not snprintf */
+static char keys[KEY_SPACE][KEY_SIZE];
+static uint32_t key_hashes[KEY_SPACE];
+
+typedef struct {
+  hash_table_t *table;
+  pthread_mutex_t *global_lock; /* NULL = striped locking only */
+  int thread_id;
+  int num_ops;
+} worker_args_t;
+
+static uint32_t fnv1a(const void *key, size_t key_len) {
+  const uint8_t *data = (const uint8_t *)key;
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < key_len; i++) {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static void *worker(void *arg) {
+  worker_args_t *args = (worker_args_t *)arg;
+  unsigned int seed = (unsigned int)args->thread_id * 7919u + 1;
+
+  for (int i = 0; i < args->num_ops; i++) {
+    int k = rand_r(&seed) % KEY_SPACE;
+    const char *key = keys[k];
+    uint32_t hash = key_hashes[k];
+    int is_store = (rand_r(&seed) % 100) < STORE_PERCENT;
+
+    if (args->global_lock) {
+      pthread_mutex_lock(args->global_lock);
+    }
+    if (is_store) {
+      add_key(args->table, key, KEY_SIZE, hash);
+    } else {
+      (void)key_in_table(args->table, key, KEY_SIZE, hash);
+    }
+    if (args->global_lock) {
+      pthread_mutex_unlock(args->global_lock);
+    }
+  }
+  return NULL;
+}
+
+static double run(int num_threads, int ops_per_thread, int use_global_lock) {
+  hash_table_t *table = aligned_alloc(64, sizeof(hash_table_t));
+  pthread_mutex_t global_lock = PTHREAD_MUTEX_INITIALIZER;
+  pthread_t threads[64];
+  worker_args_t args[64];
+
+  if (!table || create_table(table) != 0) {
+    fprintf(stderr, "Failed to create key index\n");
+    free(table);
+    return 0.0;
+  }
+
+  /* pre-populate half the key space so exists checks see a mix of hits */
+  for (int k = 0; k < KEY_SPACE; k += 2) {
+    add_key(table, keys[k], KEY_SIZE, key_hashes[k]);
+  }
+
+  double start = get_time_seconds();
+  for (int t = 0; t < num_threads; t++) {
+    args[t].table = table;
+    args[t].global_lock = use_global_lock ? &global_lock : NULL;
+    args[t].thread_id = t;
+    args[t].num_ops = ops_per_thread;
+    pthread_create(&threads[t], NULL, worker, &args[t]);
+  }
+  for (int t = 0; t < num_threads; t++) {
+    pthread_join(threads[t], NULL);
+  }
+  double elapsed = get_time_seconds() - start;
+
+  free_table(table);
+  free(table);
+  return ((double)num_threads * ops_per_thread) / elapsed;
+}
+
+int main(int argc, char **argv) {
+  int ops_per_thread = DEFAULT_OPS_PER_THREAD;
+  if (argc >= 2) {
+    ops_per_thread = atoi(argv[1]);
+    if (ops_per_thread <= 0) {
+      fprintf(stderr, "Invalid ops_per_thread: %s\n", argv[1]);
+      return 1;
+    }
+  }
+
+  for (int k = 0; k < KEY_SPACE; k++) {
+    snprintf(keys[k], KEY_SIZE, "key%012d", k);
+    key_hashes[k] = fnv1a(keys[k], KEY_SIZE);
+  }
+
+  int thread_counts[] = {1, 2, 4, 8, 16, 32, 64};
+  int num_counts = sizeof(thread_counts) / sizeof(thread_counts[0]);
+
+  printf("=== Key Index Scaling Benchmark ===\n");
+  printf("Ops/thread: %d | Key space: %d | Mix: %d%% store, %d%% exists\n",
+         ops_per_thread, KEY_SPACE, STORE_PERCENT, 100 - STORE_PERCENT);
+  printf("\n  %8s  %18s  %18s  %8s\n", "threads", "[BEFORE] global",
+         "[AFTER] striped", "speedup");
+
+  for (int i = 0; i < num_counts; i++) {
+    int n = thread_counts[i];
+    double before = run(n, ops_per_thread, 1);
+    double after = run(n, ops_per_thread, 0);
+    printf("  %8d  %12.0f ops/s  %12.0f ops/s  %7.2fx\n", n, before, after,
+           before > 0 ? after / before : 0.0);
+  }
+
+  /* index footprint with the whole key space loaded */
+  hash_table_t *table = aligned_alloc(64, sizeof(hash_table_t));
+  if (table && create_table(table) == 0) {
+    for (int k = 0; k < KEY_SPACE; k++) {
+      add_key(table, keys[k], KEY_SIZE, key_hashes[k]);
+    }
+    printf("\nIndex footprint: %lu keys, %lu bytes, %.1f bytes/key\n",
+           (unsigned long)table_key_count(table),
+           (unsigned long)table_memory_bytes(table),
+           (double)table_memory_bytes(table) / table_key_count(table));
+    free_table(table);
+  }
+  free(table);
+
+  printf("\nDone.\n");
+  return 0;
+}
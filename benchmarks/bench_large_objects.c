@@ -0,0 +1,232 @@
+/**
+ * Large Object Benchmark
+ *
+ * Four devices holding 64MB objects, more than the 2MB one device value
+ * can hold. [BEFORE] does what an application had to: cut each object into
+ * 2MB pieces under keys of its own, store and fetch them one after another,
+ * one device command at a time, and reassemble the object. [AFTER] hands
+ * the whole object to the engine, which chunks it into 256KB stripe units
+ * under a manifest and keeps several rows of them in flight on all
+ * devices: first through kv_engine_store and kv_engine_retrieve, then
+ * through the streaming calls, which move the object through a few rows'
+ * worth of engine buffers instead of a copy of the whole object. The
+ * emulator has no per-device bandwidth limit, so the gain shown is that of
+ * overlapping commands on several device threads.
+ */
+
+#include "kv_engine.h"
+#include "util/bench_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_DEVICES 4
+#define DEFAULT_NUM_OBJECTS 8
+#define KEY_SIZE 16
+/* Keys are KEY_SIZE bytes; make_key's buffer fits any int it is given */
+#define KEY_BUFFER_SIZE 32
+#define OBJECT_SIZE (64 * 1024 * 1024)
+#define PIECE_SIZE (2 * 1024 * 1024)
+#define PIECES (OBJECT_SIZE / PIECE_SIZE)
+
+/* How an object reaches the engine */
+typedef enum { MODE_PIECES, MODE_WHOLE, MODE_STREAM } transfer_mode_t;
+
+/* Position in the source object for a streamed store or retrieve */
+typedef struct {
+  const char *object;
+  size_t pos;
+  int mismatches;
+} cursor_t;
+
+static int fill_next(void *buffer, size_t len, void *user_data) {
+  cursor_t *cursor = (cursor_t *)user_data;
+  memcpy(buffer, cursor->object + cursor->pos, len);
+  cursor->pos += len;
+  return 0;
+}
+
+static int check_next(const void *data, size_t len, void *user_data) {
+  cursor_t *cursor = (cursor_t *)user_data;
+  cursor->mismatches += memcmp(data, cursor->object + cursor->pos, len) != 0;
+  cursor->pos += len;
+  return 0;
+}
+
+static void make_key(char *key, int object, int piece) {
+  if (piece < 0) {
+    snprintf(key, KEY_BUFFER_SIZE, "obj%012d", object);
+  } else {
+    snprintf(key, KEY_BUFFER_SIZE, "obj%05d.%06d", object, piece);
+  }
+}
+
+static kv_result_t store_object(kv_engine_t *engine, transfer_mode_t mode,
+                                int k, const char *object) {
+  char key[KEY_BUFFER_SIZE];
+  if (mode == MODE_PIECES) {
+    for (int p = 0; p < PIECES; p++) {
+      make_key(key, k, p);
+      kv_result_t res = kv_engine_store(engine, key, KEY_SIZE,
+                                        object + (size_t)p * PIECE_SIZE,
+                                        PIECE_SIZE, true);
+      if (res != KV_SUCCESS) {
+        return res;
+      }
+    }
+    return KV_SUCCESS;
+  }
+  make_key(key, k, -1);
+  if (mode == MODE_WHOLE) {
+    return kv_engine_store(engine, key, KEY_SIZE, object, OBJECT_SIZE, true);
+  }
+  cursor_t cursor = {.object = object};
+  return kv_engine_store_stream(engine, key, KEY_SIZE, OBJECT_SIZE, fill_next,
+                                &cursor, true);
+}
+
+/* Reads an object back and compares it; returns false on any failure */
+static bool read_object(kv_engine_t *engine, transfer_mode_t mode, int k,
+                        const char *object) {
+  char key[KEY_BUFFER_SIZE];
+  void *value = NULL;
+  size_t value_len = 0;
+  if (mode == MODE_PIECES) {
+    char *whole = malloc(OBJECT_SIZE);
+    bool same = whole != NULL;
+    for (int p = 0; same && p < PIECES; p++) {
+      make_key(key, k, p);
+      if (kv_engine_retrieve(engine, key, KEY_SIZE, &value, &value_len,
+                             false) != KV_SUCCESS) {
+        same = false;
+        break;
+      }
+      same = value_len == PIECE_SIZE;
+      if (same) {
+        memcpy(whole + (size_t)p * PIECE_SIZE, value, PIECE_SIZE);
+      }
+      kv_engine_free_buffer(engine, value);
+    }
+    same = same && memcmp(whole, object, OBJECT_SIZE) == 0;
+    free(whole);
+    return same;
+  }
+  make_key(key, k, -1);
+  if (mode == MODE_WHOLE) {
+    if (kv_engine_retrieve(engine, key, KEY_SIZE, &value, &value_len,
+                           false) != KV_SUCCESS) {
+      return false;
+    }
+    bool same = value_len == OBJECT_SIZE &&
+                memcmp(value, object, OBJECT_SIZE) == 0;
+    kv_engine_free_buffer(engine, value);
+    return same;
+  }
+  cursor_t cursor = {.object = object};
+  return kv_engine_retrieve_stream(engine, key, KEY_SIZE, check_next, &cursor,
+                                   &value_len) == KV_SUCCESS &&
+         value_len == OBJECT_SIZE && cursor.mismatches == 0;
+}
+
+static void run(const char *label, const char *what, char paths[][256],
+                int num_objects, transfer_mode_t mode, const char *object) {
+  kv_engine_config_t config = {
+      .emul_config_file = "/kvssd/PDK/core/kvssd_emul.conf",
+      .memory_pool_size = 64 * 1024 * 1024,
+      .queue_depth = 128,
+      .enable_stats = 1,
+      .dma_pool_count = 16,
+      .num_devices = NUM_DEVICES,
+  };
+  for (int i = 0; i < NUM_DEVICES; i++) {
+    config.device_paths[i] = paths[i];
+  }
+
+  kv_engine_t *engine;
+  if (init_engine(&engine, paths[0], &config) != KV_SUCCESS) {
+    return;
+  }
+
+  double start = get_time_seconds();
+  for (int k = 0; k < num_objects; k++) {
+    if (store_object(engine, mode, k, object) != KV_SUCCESS) {
+      fprintf(stderr, "Store failed at object %d\n", k);
+      kv_engine_cleanup(engine);
+      return;
+    }
+  }
+  double mb = (double)num_objects * (OBJECT_SIZE / (1024 * 1024));
+  double store_bw = mb / (get_time_seconds() - start);
+
+  int failures = 0;
+  start = get_time_seconds();
+  for (int k = 0; k < num_objects; k++) {
+    failures += !read_object(engine, mode, k, object);
+  }
+  double read_bw = mb / (get_time_seconds() - start);
+
+  printf("\n%s %s\n", label, what);
+  printf("  stores:                %8.1f MB/s\n", store_bw);
+  printf("  reads:                 %8.1f MB/s%s\n", read_bw,
+         failures ? " (with failures)" : "");
+
+  /* the emulator keeps values in memory: free them for the next run */
+  char key[KEY_BUFFER_SIZE];
+  for (int k = 0; k < num_objects; k++) {
+    if (mode == MODE_PIECES) {
+      for (int p = 0; p < PIECES; p++) {
+        make_key(key, k, p);
+        kv_engine_delete(engine, key, KEY_SIZE);
+      }
+    } else {
+      make_key(key, k, -1);
+      kv_engine_delete(engine, key, KEY_SIZE);
+    }
+  }
+  kv_engine_cleanup(engine);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr,
+            "Usage: %s <device_path_prefix> [num_objects]\n"
+            "  devices are <prefix>0 .. <prefix>%d\n",
+            argv[0], NUM_DEVICES - 1);
+    return 1;
+  }
+
+  int num_objects = argc >= 3 ? atoi(argv[2]) : DEFAULT_NUM_OBJECTS;
+  if (num_objects <= 0) {
+    fprintf(stderr, "Invalid num_objects: %s\n", argv[2]);
+    return 1;
+  }
+
+  char paths[NUM_DEVICES][256];
+  for (int i = 0; i < NUM_DEVICES; i++) {
+    snprintf(paths[i], sizeof(paths[i]), "%s%d", argv[1], i);
+  }
+
+  char *object = malloc(OBJECT_SIZE);
+  if (!object) {
+    fprintf(stderr, "Failed to allocate object\n");
+    return 1;
+  }
+  for (size_t i = 0; i < OBJECT_SIZE; i++) {
+    object[i] = (char)(i * 7 + (i >> 12));
+  }
+
+  printf("=== Large Object Benchmark ===\n");
+  printf("Objects: %d x %dMB | Devices: %d\n", num_objects,
+         OBJECT_SIZE / (1024 * 1024), NUM_DEVICES);
+
+  run("[BEFORE]", "app-side 2MB pieces, stored and read serially", paths,
+      num_objects, MODE_PIECES, object);
+  run("[AFTER]", "engine-chunked, kv_engine_store/kv_engine_retrieve", paths,
+      num_objects, MODE_WHOLE, object);
+  run("[AFTER]", "engine-chunked, kv_engine_store_stream/retrieve_stream",
+      paths, num_objects, MODE_STREAM, object);
+
+  free(object);
+  printf("\nDone.\n");
+  return 0;
+}
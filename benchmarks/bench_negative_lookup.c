@@ -0,0 +1,114 @@
+/**
+ * Negative Lookup Benchmark
+ *
+ * Cache-style read mix where a share of lookups ask for keys that were never
+ * stored. The [BEFORE] run sends every miss to the device; the [AFTER] run
+ * enables the per-device Bloom filter so most misses return without a device
+ * command or a retrieve buffer.
+ */
+
+#include "kv_engine.h"
+#include "util/bench_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_NUM_OPS 20000
+#define NUM_KEYS 10000
+#define KEY_SIZE 16
+#define VALUE_SIZE 4096
+#define MISS_PERCENT 40
+#define BLOOM_BITS_PER_KEY 10
+
+static void run(const char *label, const char *device_path, int num_ops,
+                uint32_t bloom_bits_per_key) {
+  kv_engine_config_t config = {
+      .device_path = device_path,
+      .emul_config_file = "/kvssd/PDK/core/kvssd_emul.conf",
+      .memory_pool_size = 64 * 1024 * 1024,
+      .queue_depth = 128,
+      .enable_stats = 1,
+      .dma_pool_count = 16,
+      /* the filter must start from a complete index */
+      .recover_index = 1,
+      .bloom_bits_per_key = bloom_bits_per_key,
+  };
+
+  kv_engine_t *engine;
+  if (init_engine(&engine, device_path, &config) != KV_SUCCESS) {
+    return;
+  }
+
+  char key[KEY_SIZE];
+  void *value = kv_engine_alloc_buffer(engine, VALUE_SIZE);
+  if (!value) {
+    fprintf(stderr, "Failed to allocate value buffer\n");
+    kv_engine_cleanup(engine);
+    return;
+  }
+  memset(value, 'X', VALUE_SIZE);
+
+  for (int i = 0; i < NUM_KEYS; i++) {
+    snprintf(key, KEY_SIZE, "key%012d", i);
+    kv_engine_store(engine, key, KEY_SIZE, value, VALUE_SIZE, true);
+  }
+  kv_engine_reset_stats(engine);
+
+  unsigned int seed = 42;
+  int hits = 0;
+  double start = get_time_seconds();
+  for (int i = 0; i < num_ops; i++) {
+    int k = rand_r(&seed) % NUM_KEYS;
+    bool miss = (rand_r(&seed) % 100) < MISS_PERCENT;
+    snprintf(key, KEY_SIZE, miss ? "nokey%010d" : "key%012d", k);
+
+    void *out = NULL;
+    size_t out_len = 0;
+    if (kv_engine_retrieve(engine, key, KEY_SIZE, &out, &out_len, false) ==
+        KV_SUCCESS) {
+      hits++;
+      kv_engine_free_buffer(engine, out);
+    }
+  }
+  double elapsed = get_time_seconds() - start;
+
+  kv_engine_stats_t stats;
+  kv_engine_get_stats(engine, &stats);
+
+  printf("\n%s\n", label);
+  printf("  ops/sec: %10.0f   latency: %.2f us   hit rate: %.1f%%\n",
+         num_ops / elapsed, (elapsed * 1e6) / num_ops, hits * 100.0 / num_ops);
+  printf("  device commands avoided: %lu   filter memory: %lu bytes\n",
+         (unsigned long)stats.filter_negatives,
+         (unsigned long)stats.filter_bytes);
+
+  kv_engine_free_buffer(engine, value);
+  kv_engine_cleanup(engine);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <device_path> [num_ops]\n", argv[0]);
+    return 1;
+  }
+
+  int num_ops = DEFAULT_NUM_OPS;
+  if (argc >= 3) {
+    num_ops = atoi(argv[2]);
+    if (num_ops <= 0) {
+      fprintf(stderr, "Invalid num_ops: %s\n", argv[2]);
+      return 1;
+    }
+  }
+
+  printf("=== Negative Lookup Benchmark ===\n");
+  printf("Keys: %d | Ops: %d | Miss rate: %d%%\n", NUM_KEYS, num_ops,
+         MISS_PERCENT);
+
+  run("[BEFORE] no filter", argv[1], num_ops, 0);
+  run("[AFTER] bloom filter (10 bits/key)", argv[1], num_ops,
+      BLOOM_BITS_PER_KEY);
+
+  printf("\nDone.\n");
+  return 0;
+}
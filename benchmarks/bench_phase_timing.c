@@ -0,0 +1,162 @@
+/**
+ * Hot-Path Phase Breakdown Benchmark
+ *
+ * Runs a store/retrieve loop plus a burst of async stores and prints where
+ * the time in each call goes (argument checks, routing, index, buffers,
+ * device, stats, queue wait). The [BEFORE] run has phase timing off and
+ * the [AFTER] run turns it on, so the throughput difference is the cost of
+ * the instrumentation itself.
+ */
+
+#include "kv_engine.h"
+#include "util/bench_utils.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DEFAULT_NUM_OPS 20000
+#define NUM_KEYS 5000
+#define KEY_SIZE 16
+#define VALUE_SIZE 4096
+#define ASYNC_OPS 2000
+
+static const char *phase_names[KV_PHASES] = {
+    "validate", "route", "index", "buffer", "device", "stats", "queue wait",
+};
+
+static _Atomic int async_done;
+
+static void on_store_done(kv_result_t result, void *user_data) {
+  (void)result;
+  (void)user_data;
+  atomic_fetch_add(&async_done, 1);
+}
+
+static void print_breakdown(const kv_phase_stats_t *stats, kv_op_type_t op,
+                            const char *name) {
+  /* share is of the time inside the call; queue wait comes before it */
+  double total = 0.0;
+  for (int phase = 0; phase < KV_PHASE_QUEUE_WAIT; phase++) {
+    const kv_latency_summary_t *s = &stats->phase[op][phase];
+    total += s->mean_us * (double)s->count;
+  }
+  if (total == 0.0) {
+    return;
+  }
+
+  printf("  %s:\n", name);
+  printf("    %-10s %9s %9s %9s %9s %7s\n", "phase", "samples", "mean us",
+         "p50 us", "p99 us", "share");
+  for (int phase = 0; phase < KV_PHASES; phase++) {
+    const kv_latency_summary_t *s = &stats->phase[op][phase];
+    if (s->count == 0) {
+      continue;
+    }
+    printf("    %-10s %9lu %9.2f %9.2f %9.2f", phase_names[phase],
+           (unsigned long)s->count, s->mean_us, s->p50_us, s->p99_us);
+    if (phase == KV_PHASE_QUEUE_WAIT) {
+      printf("       -\n");
+    } else {
+      printf(" %6.1f%%\n", s->mean_us * (double)s->count * 100.0 / total);
+    }
+  }
+}
+
+static void run(const char *label, const char *device_path, int num_ops,
+                uint32_t phase_timing) {
+  kv_engine_config_t config = {
+      .device_path = device_path,
+      .emul_config_file = "/kvssd/PDK/core/kvssd_emul.conf",
+      .memory_pool_size = 64 * 1024 * 1024,
+      .queue_depth = 128,
+      .num_worker_threads = 2,
+      .enable_stats = 1,
+      .dma_pool_count = 16,
+      .enable_phase_timing = phase_timing,
+  };
+
+  kv_engine_t *engine;
+  if (init_engine(&engine, device_path, &config) != KV_SUCCESS) {
+    return;
+  }
+
+  /* plain heap buffer, so stores go through the DMA staging copy */
+  char key[KEY_SIZE];
+  char *value = malloc(VALUE_SIZE + 1);
+  if (!value) {
+    fprintf(stderr, "Failed to allocate value buffer\n");
+    kv_engine_cleanup(engine);
+    return;
+  }
+  memset(value, 'X', VALUE_SIZE + 1);
+
+  unsigned int seed = 42;
+  double start = get_time_seconds();
+  for (int i = 0; i < num_ops; i++) {
+    snprintf(key, KEY_SIZE, "key%012d", rand_r(&seed) % NUM_KEYS);
+    if (i % 2 == 0) {
+      kv_engine_store(engine, key, KEY_SIZE, value + 1, VALUE_SIZE, true);
+    } else {
+      void *out = NULL;
+      size_t out_len = 0;
+      if (kv_engine_retrieve(engine, key, KEY_SIZE, &out, &out_len, false) ==
+          KV_SUCCESS) {
+        kv_engine_free_buffer(engine, out);
+      }
+    }
+  }
+  double elapsed = get_time_seconds() - start;
+
+  atomic_store(&async_done, 0);
+  for (int i = 0; i < ASYNC_OPS; i++) {
+    snprintf(key, KEY_SIZE, "async%010d", i);
+    while (kv_engine_store_async(engine, key, KEY_SIZE, value, VALUE_SIZE,
+                                 on_store_done, NULL, true) != KV_SUCCESS) {
+      usleep(100);
+    }
+  }
+  while (atomic_load(&async_done) < ASYNC_OPS) {
+    usleep(100);
+  }
+
+  printf("\n%s\n", label);
+  printf("  sync ops/sec: %10.0f   latency: %.2f us\n", num_ops / elapsed,
+         (elapsed * 1e6) / num_ops);
+
+  kv_phase_stats_t stats;
+  if (kv_engine_get_phase_stats(engine, &stats) == KV_SUCCESS) {
+    print_breakdown(&stats, KV_OP_STORE, "store");
+    print_breakdown(&stats, KV_OP_RETRIEVE, "retrieve");
+  }
+
+  free(value);
+  kv_engine_cleanup(engine);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <device_path> [num_ops]\n", argv[0]);
+    return 1;
+  }
+
+  int num_ops = DEFAULT_NUM_OPS;
+  if (argc >= 3) {
+    num_ops = atoi(argv[2]);
+    if (num_ops <= 0) {
+      fprintf(stderr, "Invalid num_ops: %s\n", argv[2]);
+      return 1;
+    }
+  }
+
+  printf("=== Hot-Path Phase Breakdown ===\n");
+  printf("Keys: %d | Ops: %d (50%% store) | Async stores: %d\n", NUM_KEYS,
+         num_ops, ASYNC_OPS);
+
+  run("[BEFORE] phase timing off", argv[1], num_ops, 0);
+  run("[AFTER] phase timing on", argv[1], num_ops, 1);
+
+  printf("\nDone.\n");
+  return 0;
+}
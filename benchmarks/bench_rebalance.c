@@ -0,0 +1,254 @@
+/**
+ * Online Rebalance Benchmark
+ *
+ * Grows a populated engine from 4 to 8 devices, one kv_engine_add_device
+ * at a time, while a client thread keeps reading and overwriting random
+ * keys. [BEFORE] is what hash % N placement would have to relocate for the
+ * same growth (which is why adding a device used to be refused after the
+ * first write); [AFTER] is what the rendezvous placement actually moved,
+ * the client throughput before, during and after the migrations, and
+ * whether any read missed a key along the way. The emulator's per-command
+ * cost grows with the number of open devices, so the migration's own cost
+ * is the gap between the "during" and "after" rates.
+ */
+
+#include "kv_engine.h"
+#include "util/bench_utils.h"
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DEFAULT_NUM_KEYS 20000
+#define START_DEVICES 4
+#define END_DEVICES 8
+#define KEY_SIZE 16
+#define VALUE_SIZE 4096
+#define MEASURE_SECONDS 1.0
+
+typedef struct {
+  kv_engine_t *engine;
+  int num_keys;
+  volatile int stop;
+  uint64_t ops;
+  uint64_t misses;     /* reads that didn't find a stored key */
+  uint64_t mismatches; /* reads that returned the wrong value */
+} client_t;
+
+static void make_key(char *key, int k) {
+  snprintf(key, KEY_SIZE, "key%012d", k);
+}
+
+static void make_value(char *value, int k) {
+  memset(value, 'v', VALUE_SIZE);
+  snprintf(value, 32, "value:%012d", k);
+}
+
+/* FNV-1a, as the engine hashes keys */
+static uint32_t key_hash(const char *key) {
+  uint32_t hash = 2166136261u;
+  for (int i = 0; i < KEY_SIZE; i++) {
+    hash ^= (uint8_t)key[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/* 90% reads checked against the expected value, 10% overwrites */
+static void *client_thread(void *arg) {
+  client_t *client = (client_t *)arg;
+  char key[KEY_SIZE];
+  char value[VALUE_SIZE];
+  unsigned int seed = 7;
+
+  while (!client->stop) {
+    int k = rand_r(&seed) % client->num_keys;
+    make_key(key, k);
+    if (rand_r(&seed) % 10 == 0) {
+      make_value(value, k);
+      kv_engine_store(client->engine, key, KEY_SIZE, value, VALUE_SIZE, true);
+    } else {
+      void *out = NULL;
+      size_t out_len = 0;
+      kv_result_t res = kv_engine_retrieve(client->engine, key, KEY_SIZE, &out,
+                                           &out_len, false);
+      if (res != KV_SUCCESS) {
+        client->misses++;
+      } else {
+        make_value(value, k);
+        if (out_len != VALUE_SIZE || memcmp(out, value, VALUE_SIZE) != 0) {
+          client->mismatches++;
+        }
+        kv_engine_free_buffer(client->engine, out);
+      }
+    }
+    client->ops++;
+  }
+  return NULL;
+}
+
+static void print_before(int num_keys) {
+  /* keys whose hash % N changes at each single-device step */
+  uint64_t relocated = 0;
+  for (int k = 0; k < num_keys; k++) {
+    char key[KEY_SIZE];
+    make_key(key, k);
+    uint32_t hash = key_hash(key);
+    for (uint32_t n = START_DEVICES; n < END_DEVICES; n++) {
+      relocated += hash % n != hash % (n + 1);
+    }
+  }
+  printf("\n[BEFORE] hash %% N placement (add refused after first write)\n");
+  printf("  growing %d -> %d one device at a time would relocate %" PRIu64
+         " keys (%.0f%% of the data set)\n",
+         START_DEVICES, END_DEVICES, relocated,
+         100.0 * (double)relocated / num_keys);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr,
+            "Usage: %s <device_path_prefix> [num_keys] [keys_per_sec]\n"
+            "  devices are <prefix>0 .. <prefix>%d\n",
+            argv[0], END_DEVICES - 1);
+    return 1;
+  }
+
+  int num_keys = argc >= 3 ? atoi(argv[2]) : DEFAULT_NUM_KEYS;
+  if (num_keys <= 0) {
+    fprintf(stderr, "Invalid num_keys: %s\n", argv[2]);
+    return 1;
+  }
+  uint32_t rate = argc >= 4 ? (uint32_t)atoi(argv[3]) : 0;
+
+  char paths[END_DEVICES][256];
+  for (int i = 0; i < END_DEVICES; i++) {
+    snprintf(paths[i], sizeof(paths[i]), "%s%d", argv[1], i);
+  }
+
+  printf("=== Online Rebalance Benchmark ===\n");
+  printf("Keys: %d x %dB | Devices: %d -> %d | Migration rate: %s\n",
+         num_keys, VALUE_SIZE, START_DEVICES, END_DEVICES,
+         rate ? "throttled" : "unthrottled");
+  if (rate) {
+    printf("  (%u keys/sec)\n", rate);
+  }
+
+  kv_engine_config_t config = {
+      .emul_config_file = "/kvssd/PDK/core/kvssd_emul.conf",
+      .memory_pool_size = 64 * 1024 * 1024,
+      .queue_depth = 128,
+      .enable_stats = 1,
+      .dma_pool_count = 16,
+      .num_devices = START_DEVICES,
+      .migration_keys_per_sec = rate,
+  };
+  for (int i = 0; i < START_DEVICES; i++) {
+    config.device_paths[i] = paths[i];
+  }
+
+  kv_engine_t *engine;
+  if (init_engine(&engine, paths[0], &config) != KV_SUCCESS) {
+    return 1;
+  }
+
+  char key[KEY_SIZE];
+  char value[VALUE_SIZE];
+  for (int k = 0; k < num_keys; k++) {
+    make_key(key, k);
+    make_value(value, k);
+    if (kv_engine_store(engine, key, KEY_SIZE, value, VALUE_SIZE, true) !=
+        KV_SUCCESS) {
+      fprintf(stderr, "Preload failed at key %d\n", k);
+      kv_engine_cleanup(engine);
+      return 1;
+    }
+  }
+
+  print_before(num_keys);
+
+  client_t client = {.engine = engine, .num_keys = num_keys};
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, client_thread, &client) != 0) {
+    fprintf(stderr, "Failed to start client thread\n");
+    kv_engine_cleanup(engine);
+    return 1;
+  }
+
+  /* client throughput with no migration running */
+  double start = get_time_seconds();
+  usleep((useconds_t)(MEASURE_SECONDS * 1e6));
+  uint64_t baseline_ops = client.ops;
+  double baseline_rate = baseline_ops / (get_time_seconds() - start);
+
+  printf("\n[AFTER] rendezvous placement, online add + background "
+         "migration\n");
+  uint64_t total_moved = 0;
+  double migrate_start = get_time_seconds();
+  for (int dev = START_DEVICES; dev < END_DEVICES; dev++) {
+    double add_start = get_time_seconds();
+    kv_result_t res = kv_engine_add_device(engine, paths[dev]);
+    if (res != KV_SUCCESS) {
+      fprintf(stderr, "add_device %s failed: %d\n", paths[dev], res);
+      break;
+    }
+
+    kv_migration_status_t status;
+    do {
+      usleep(1000);
+      kv_engine_get_migration_status(engine, &status);
+    } while (status.active);
+
+    total_moved += status.keys_moved;
+    printf("  %u -> %u devices: moved %6" PRIu64 " keys (%4.1f%%) in "
+           "%6.1f ms, %u passes, %" PRIu64 " errors\n",
+           status.from_devices, status.to_devices, status.keys_moved,
+           100.0 * (double)status.keys_moved / num_keys,
+           (get_time_seconds() - add_start) * 1e3, status.passes,
+           status.errors);
+  }
+  double migrate_seconds = get_time_seconds() - migrate_start;
+  uint64_t migrate_ops = client.ops - baseline_ops;
+
+  /* and again on the grown engine */
+  uint64_t after_ops = client.ops;
+  start = get_time_seconds();
+  usleep((useconds_t)(MEASURE_SECONDS * 1e6));
+  double after_rate = (client.ops - after_ops) / (get_time_seconds() - start);
+
+  client.stop = 1;
+  pthread_join(thread, NULL);
+
+  printf("  total moved: %" PRIu64 " keys (%.0f%% of the data set)\n",
+         total_moved, 100.0 * (double)total_moved / num_keys);
+  printf("  client ops/sec: %.0f on %d devices, %.0f during migration, "
+         "%.0f on %d devices\n",
+         baseline_rate, START_DEVICES, migrate_ops / migrate_seconds,
+         after_rate, END_DEVICES);
+  printf("  client reads missing a key: %" PRIu64 ", wrong value: %" PRIu64
+         "\n",
+         client.misses, client.mismatches);
+
+  /* every key readable on the grown engine */
+  uint64_t unreadable = 0;
+  for (int k = 0; k < num_keys; k++) {
+    void *out = NULL;
+    size_t out_len = 0;
+    make_key(key, k);
+    if (kv_engine_retrieve(engine, key, KEY_SIZE, &out, &out_len, false) !=
+        KV_SUCCESS) {
+      unreadable++;
+      continue;
+    }
+    kv_engine_free_buffer(engine, out);
+  }
+  printf("  keys unreadable after growth: %" PRIu64 " of %d\n", unreadable,
+         num_keys);
+
+  kv_engine_cleanup(engine);
+  printf("\nDone.\n");
+  return unreadable == 0 && client.misses == 0 && client.mismatches == 0 ? 0
+                                                                          : 1;
+}
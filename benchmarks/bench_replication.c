@@ -0,0 +1,197 @@
+/**
+ * Replication Benchmark
+ *
+ * Four devices, a populated key set, then two read workloads: several
+ * threads hammering one hot key, and a full read sweep after one device
+ * has been marked unhealthy (as the engine does after repeated device
+ * errors). [BEFORE] is one copy per key: the hot key pins a single device
+ * and a quarter of the key space fails with KV_ERR_DEVICE_DEGRADED.
+ * [AFTER] keeps 2 and 3 copies: reads go to the least busy healthy copy,
+ * at the price of R device writes per store. Reads of keys on the down
+ * device fail without a device command, which flatters [BEFORE]'s sweep
+ * rate.
+ */
+
+#include "kv_engine.h"
+#include "kv_engine_internal.h"
+#include "util/bench_utils.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_DEVICES 4
+#define DEFAULT_NUM_KEYS 8000
+#define NUM_HOT_KEYS 1
+#define HOT_THREADS 8
+#define HOT_READS_PER_THREAD 4000
+#define KEY_SIZE 16
+#define VALUE_SIZE 4096
+
+typedef struct {
+  kv_engine_t *engine;
+  unsigned int seed;
+  uint64_t failures;
+} hot_reader_t;
+
+static void make_key(char *key, int k) {
+  snprintf(key, KEY_SIZE, "key%012d", k);
+}
+
+static void *hot_reader(void *arg) {
+  hot_reader_t *reader = (hot_reader_t *)arg;
+  char key[KEY_SIZE];
+  for (int i = 0; i < HOT_READS_PER_THREAD; i++) {
+    make_key(key, rand_r(&reader->seed) % NUM_HOT_KEYS);
+    void *out = NULL;
+    size_t out_len = 0;
+    if (kv_engine_retrieve(reader->engine, key, KEY_SIZE, &out, &out_len,
+                           false) != KV_SUCCESS) {
+      reader->failures++;
+      continue;
+    }
+    kv_engine_free_buffer(reader->engine, out);
+  }
+  return NULL;
+}
+
+static void device_ops(kv_engine_t *engine, uint64_t *ops) {
+  for (uint32_t i = 0; i < NUM_DEVICES; i++) {
+    kv_device_health_t health;
+    ops[i] = kv_engine_get_device_health(engine, i, &health) == KV_SUCCESS
+                 ? health.total_ops
+                 : 0;
+  }
+}
+
+static void run(const char *label, char paths[][256], int num_keys,
+                uint32_t replication_factor) {
+  kv_engine_config_t config = {
+      .emul_config_file = "/kvssd/PDK/core/kvssd_emul.conf",
+      .memory_pool_size = 64 * 1024 * 1024,
+      .queue_depth = 128,
+      .dma_pool_count = 32,
+      .num_devices = NUM_DEVICES,
+      .replication_factor = replication_factor,
+  };
+  for (int i = 0; i < NUM_DEVICES; i++) {
+    config.device_paths[i] = paths[i];
+  }
+
+  kv_engine_t *engine;
+  if (init_engine(&engine, paths[0], &config) != KV_SUCCESS) {
+    return;
+  }
+
+  char key[KEY_SIZE];
+  void *value = kv_engine_alloc_buffer(engine, VALUE_SIZE);
+  if (!value) {
+    fprintf(stderr, "Failed to allocate value buffer\n");
+    kv_engine_cleanup(engine);
+    return;
+  }
+  memset(value, 'v', VALUE_SIZE);
+
+  double start = get_time_seconds();
+  for (int k = 0; k < num_keys; k++) {
+    make_key(key, k);
+    if (kv_engine_store(engine, key, KEY_SIZE, value, VALUE_SIZE, true) !=
+        KV_SUCCESS) {
+      fprintf(stderr, "Preload failed at key %d\n", k);
+      kv_engine_free_buffer(engine, value);
+      kv_engine_cleanup(engine);
+      return;
+    }
+  }
+  double store_rate = num_keys / (get_time_seconds() - start);
+
+  /* hot keys read from many threads */
+  uint64_t before[NUM_DEVICES], after[NUM_DEVICES];
+  device_ops(engine, before);
+  hot_reader_t readers[HOT_THREADS];
+  pthread_t threads[HOT_THREADS];
+  start = get_time_seconds();
+  for (int t = 0; t < HOT_THREADS; t++) {
+    readers[t] = (hot_reader_t){.engine = engine, .seed = (unsigned)t + 1};
+    pthread_create(&threads[t], NULL, hot_reader, &readers[t]);
+  }
+  uint64_t hot_failures = 0;
+  for (int t = 0; t < HOT_THREADS; t++) {
+    pthread_join(threads[t], NULL);
+    hot_failures += readers[t].failures;
+  }
+  double hot_rate =
+      HOT_THREADS * HOT_READS_PER_THREAD / (get_time_seconds() - start);
+  device_ops(engine, after);
+
+  uint64_t total = 0, busiest = 0;
+  uint32_t devices_used = 0;
+  for (int i = 0; i < NUM_DEVICES; i++) {
+    uint64_t ops = after[i] - before[i];
+    total += ops;
+    busiest = ops > busiest ? ops : busiest;
+    devices_used += ops > 0;
+  }
+
+  /* full read sweep with device 0 out of service */
+  atomic_store(&engine->devices[0].healthy, false);
+  int readable = 0;
+  start = get_time_seconds();
+  for (int k = 0; k < num_keys; k++) {
+    void *out = NULL;
+    size_t out_len = 0;
+    make_key(key, k);
+    if (kv_engine_retrieve(engine, key, KEY_SIZE, &out, &out_len, false) ==
+        KV_SUCCESS) {
+      readable++;
+      kv_engine_free_buffer(engine, out);
+    }
+  }
+  double sweep_rate = num_keys / (get_time_seconds() - start);
+  atomic_store(&engine->devices[0].healthy, true);
+
+  printf("\n%s replication_factor = %u\n", label, replication_factor);
+  printf("  stores:                %8.0f ops/sec\n", store_rate);
+  printf("  hot-key reads:         %8.0f ops/sec on %u device(s), busiest "
+         "serves %.0f%%%s\n",
+         hot_rate, devices_used, total ? 100.0 * busiest / total : 0.0,
+         hot_failures ? " (with failures)" : "");
+  printf("  reads, 1 device down:  %8.0f ops/sec, %d of %d keys readable "
+         "(%.1f%%)\n",
+         sweep_rate, readable, num_keys, 100.0 * readable / num_keys);
+
+  kv_engine_free_buffer(engine, value);
+  kv_engine_cleanup(engine);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr,
+            "Usage: %s <device_path_prefix> [num_keys]\n"
+            "  devices are <prefix>0 .. <prefix>%d\n",
+            argv[0], NUM_DEVICES - 1);
+    return 1;
+  }
+
+  int num_keys = argc >= 3 ? atoi(argv[2]) : DEFAULT_NUM_KEYS;
+  if (num_keys < NUM_HOT_KEYS) {
+    fprintf(stderr, "Invalid num_keys: %s\n", argv[2]);
+    return 1;
+  }
+
+  char paths[NUM_DEVICES][256];
+  for (int i = 0; i < NUM_DEVICES; i++) {
+    snprintf(paths[i], sizeof(paths[i]), "%s%d", argv[1], i);
+  }
+
+  printf("=== Replication Benchmark ===\n");
+  printf("Keys: %d x %dB | Devices: %d | Hot keys: %d, read by %d threads\n",
+         num_keys, VALUE_SIZE, NUM_DEVICES, NUM_HOT_KEYS, HOT_THREADS);
+
+  run("[BEFORE]", paths, num_keys, 1);
+  run("[AFTER]", paths, num_keys, 2);
+  run("[AFTER]", paths, num_keys, 3);
+
+  printf("\nDone.\n");
+  return 0;
+}
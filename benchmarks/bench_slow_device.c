@@ -0,0 +1,265 @@
+/**
+ * Slow Device Ejection Benchmark
+ *
+ * Three devices holding two copies of every key. Background writers keep
+ * device 0 saturated with large writes issued straight to its keyspace,
+ * outside the engine, so it answers slowly without ever failing. A reader
+ * then retrieves random keys for a few seconds. [BEFORE] has no latency
+ * outlier detection: device 0 errs on nothing, so it stays in rotation and
+ * the reads sent there wait behind the writes. [AFTER] sets
+ * slow_device_factor: once the health probe flags device 0 slow, reads go
+ * to the other copy, and the device is re-admitted a few sweeps after the
+ * writers stop. The probe runs every second here instead of every five.
+ */
+
+#include "kv_engine.h"
+#include "kv_engine_internal.h"
+#include "util/bench_utils.h"
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define NUM_DEVICES 3
+#define DEFAULT_NUM_KEYS 3000
+#define KEY_SIZE 16
+#define VALUE_SIZE 4096
+#define NOISE_THREADS 2
+#define NOISE_VALUE_SIZE (1024 * 1024)
+#define NOISE_KEYS 64
+#define READ_SECONDS 3.0
+#define SLOW_FACTOR 4
+#define WAIT_SECONDS 15.0
+
+typedef struct {
+  kv_engine_t *engine;
+  uint32_t id;
+  volatile int *stop;
+} noise_t;
+
+static void make_key(char *key, int k) {
+  snprintf(key, KEY_SIZE, "key%012d", k);
+}
+
+/* Back-to-back large overwrites of internal keys on device 0 */
+static void *noise_thread(void *arg) {
+  noise_t *noise = (noise_t *)arg;
+  void *value = kv_engine_alloc_buffer(noise->engine, NOISE_VALUE_SIZE);
+  if (!value) {
+    return NULL;
+  }
+  memset(value, 'n', NOISE_VALUE_SIZE);
+
+  char key[KEY_SIZE];
+  memcpy(key, KV_INTERNAL_KEY_PREFIX, KV_INTERNAL_KEY_PREFIX_LEN);
+  kvs_key kv_key = {.key = key, .length = KEY_SIZE};
+  kvs_value kv_value = {.value = value,
+                        .length = NOISE_VALUE_SIZE,
+                        .actual_value_size = NOISE_VALUE_SIZE,
+                        .offset = 0};
+  kvs_option_store option = {.st_type = KVS_STORE_POST};
+
+  for (uint64_t n = 0; !*noise->stop; n++) {
+    snprintf(key + KV_INTERNAL_KEY_PREFIX_LEN,
+             KEY_SIZE - KV_INTERNAL_KEY_PREFIX_LEN, "n%u-%04" PRIu64,
+             noise->id, n % NOISE_KEYS);
+    kvs_store_kvp(noise->engine->devices[0].keyspace, &kv_key, &kv_value,
+                  &option);
+  }
+  kv_engine_free_buffer(noise->engine, value);
+  return NULL;
+}
+
+static bool device_slow(kv_engine_t *engine, uint32_t dev) {
+  kv_device_health_t health;
+  return kv_engine_get_device_health(engine, dev, &health) == KV_SUCCESS &&
+         health.slow;
+}
+
+/* Keeps reading, so every device's average stays current, until device
+ * 0's slow flag becomes want; returns the seconds that took, or a
+ * negative value after WAIT_SECONDS */
+static double read_until_slow(kv_engine_t *engine, int num_keys, bool want) {
+  unsigned int seed = 7;
+  char key[KEY_SIZE];
+  double start = get_time_seconds();
+  for (uint64_t i = 0;; i++) {
+    if (i % 256 == 0) {
+      if (device_slow(engine, 0) == want) {
+        return get_time_seconds() - start;
+      }
+      if (get_time_seconds() - start > WAIT_SECONDS) {
+        return -1.0;
+      }
+    }
+    void *out = NULL;
+    size_t out_len = 0;
+    make_key(key, rand_r(&seed) % num_keys);
+    if (kv_engine_retrieve(engine, key, KEY_SIZE, &out, &out_len, false) ==
+        KV_SUCCESS) {
+      kv_engine_free_buffer(engine, out);
+    }
+  }
+}
+
+/* Random reads for READ_SECONDS; returns reads per second and the share
+ * of device read commands that went to device 0 */
+static double read_phase(kv_engine_t *engine, int num_keys,
+                         double *device0_share) {
+  kv_engine_reset_stats(engine);
+
+  unsigned int seed = 42;
+  char key[KEY_SIZE];
+  uint64_t reads = 0;
+  double start = get_time_seconds();
+  double elapsed;
+  while ((elapsed = get_time_seconds() - start) < READ_SECONDS) {
+    void *out = NULL;
+    size_t out_len = 0;
+    make_key(key, rand_r(&seed) % num_keys);
+    if (kv_engine_retrieve(engine, key, KEY_SIZE, &out, &out_len, false) ==
+        KV_SUCCESS) {
+      kv_engine_free_buffer(engine, out);
+    }
+    reads++;
+  }
+
+  kv_latency_stats_t after;
+  kv_engine_get_latency_stats(engine, &after);
+  uint64_t total = 0;
+  for (uint32_t i = 0; i < NUM_DEVICES; i++) {
+    total += after.device[i][KV_OP_RETRIEVE].count;
+  }
+  *device0_share =
+      total ? (double)after.device[0][KV_OP_RETRIEVE].count / total : 0.0;
+  return reads / elapsed;
+}
+
+static void run(const char *label, char paths[][256], int num_keys,
+                uint32_t slow_device_factor) {
+  kv_engine_config_t config = {
+      .emul_config_file = "/kvssd/PDK/core/kvssd_emul.conf",
+      .memory_pool_size = 64 * 1024 * 1024,
+      .queue_depth = 128,
+      .enable_stats = 1,
+      .dma_pool_count = 16,
+      .num_devices = NUM_DEVICES,
+      .replication_factor = 2,
+      .slow_device_factor = slow_device_factor,
+  };
+  for (int i = 0; i < NUM_DEVICES; i++) {
+    config.device_paths[i] = paths[i];
+  }
+
+  kv_engine_t *engine;
+  if (init_engine(&engine, paths[0], &config) != KV_SUCCESS) {
+    return;
+  }
+  if (engine->health_probe) {
+    engine->health_probe->probe_interval_sec = 1;
+    health_probe_wake(engine->health_probe);
+  }
+
+  char key[KEY_SIZE];
+  void *value = kv_engine_alloc_buffer(engine, VALUE_SIZE);
+  if (!value) {
+    fprintf(stderr, "Failed to allocate value buffer\n");
+    kv_engine_cleanup(engine);
+    return;
+  }
+  memset(value, 'v', VALUE_SIZE);
+  for (int k = 0; k < num_keys; k++) {
+    make_key(key, k);
+    if (kv_engine_store(engine, key, KEY_SIZE, value, VALUE_SIZE, true) !=
+        KV_SUCCESS) {
+      fprintf(stderr, "Preload failed at key %d\n", k);
+      kv_engine_free_buffer(engine, value);
+      kv_engine_cleanup(engine);
+      return;
+    }
+  }
+
+  printf("\n%s slow_device_factor = %u\n", label, slow_device_factor);
+
+  double share;
+  double rate = read_phase(engine, num_keys, &share);
+  printf("  quiet:       %8.0f reads/sec, device 0 serves %4.1f%%\n", rate,
+         100.0 * share);
+  print_latency_percentiles(engine, KV_OP_RETRIEVE);
+
+  volatile int stop = 0;
+  noise_t noise[NOISE_THREADS];
+  pthread_t threads[NOISE_THREADS];
+  for (uint32_t t = 0; t < NOISE_THREADS; t++) {
+    noise[t] = (noise_t){.engine = engine, .id = t, .stop = &stop};
+    pthread_create(&threads[t], NULL, noise_thread, &noise[t]);
+  }
+
+  if (slow_device_factor) {
+    double waited = read_until_slow(engine, num_keys, true);
+    if (waited >= 0) {
+      printf("  device 0 flagged slow after %.1f s\n", waited);
+    } else {
+      printf("  device 0 not flagged within %.0f s\n", WAIT_SECONDS);
+    }
+  }
+
+  rate = read_phase(engine, num_keys, &share);
+  printf("  device 0 busy: %6.0f reads/sec, device 0 serves %4.1f%%\n", rate,
+         100.0 * share);
+  print_latency_percentiles(engine, KV_OP_RETRIEVE);
+
+  stop = 1;
+  for (uint32_t t = 0; t < NOISE_THREADS; t++) {
+    pthread_join(threads[t], NULL);
+  }
+
+  if (slow_device_factor && device_slow(engine, 0)) {
+    double waited = read_until_slow(engine, num_keys, false);
+    if (waited >= 0) {
+      printf("  device 0 re-admitted %.1f s after the writes stopped\n",
+             waited);
+    } else {
+      printf("  device 0 still flagged %.0f s after the writes stopped\n",
+             WAIT_SECONDS);
+    }
+  }
+
+  kv_engine_free_buffer(engine, value);
+  kv_engine_cleanup(engine);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr,
+            "Usage: %s <device_path_prefix> [num_keys]\n"
+            "  devices are <prefix>0 .. <prefix>%d\n",
+            argv[0], NUM_DEVICES - 1);
+    return 1;
+  }
+
+  int num_keys = argc >= 3 ? atoi(argv[2]) : DEFAULT_NUM_KEYS;
+  if (num_keys <= 0) {
+    fprintf(stderr, "Invalid num_keys: %s\n", argv[2]);
+    return 1;
+  }
+
+  char paths[NUM_DEVICES][256];
+  for (int i = 0; i < NUM_DEVICES; i++) {
+    snprintf(paths[i], sizeof(paths[i]), "%s%d", argv[1], i);
+  }
+
+  printf("=== Slow Device Ejection Benchmark ===\n");
+  printf("Keys: %d x %dB on %d devices, 2 copies each\n", num_keys,
+         VALUE_SIZE, NUM_DEVICES);
+  printf("Device 0 load: %d threads of back-to-back %dKB writes\n",
+         NOISE_THREADS, NOISE_VALUE_SIZE / 1024);
+
+  run("[BEFORE]", paths, num_keys, 0);
+  run("[AFTER]", paths, num_keys, SLOW_FACTOR);
+
+  printf("\nDone.\n");
+  return 0;
+}
@@ -0,0 +1,129 @@
+/**
+ * Startup Benchmark
+ *
+ * Time for kv_engine_init over 8 to 64 devices with a 64-buffer DMA pool
+ * and a 64-segment stream pool, as a rolling restart would see it, and
+ * where that time went (kv_engine_get_init_timing). [BEFORE] opens the
+ * devices one after another and allocates every pool buffer up front, as
+ * init did before: device_open_threads = 1. [AFTER] opens them all at once
+ * and leaves pool buffers to first use: device_open_threads = 0 and
+ * lazy_pools = 1. Both walk the devices for chunk keys concurrently, so
+ * [BEFORE]'s "other" column is lower than an engine without it would show.
+ *
+ * The emulator opens devices under one global lock and spends no time
+ * waiting on hardware, so only the keyspace, telemetry and weight steps of
+ * an open overlap here; on SSDs each open mostly waits on its own
+ * controller and the device phase approaches the slowest single open.
+ */
+
+#include "kv_engine.h"
+#include "util/bench_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_BENCH_DEVICES 64
+#define DEFAULT_RESTARTS 5
+#define POOL_BUFFERS 64
+
+typedef struct {
+  double total_ms;
+  double devices_ms;
+  double slowest_ms;
+  double pools_ms;
+  double rest_ms;
+} startup_t;
+
+/* Mean init timing over several init/cleanup cycles; false on failure */
+static bool measure(char paths[][256], uint32_t num_devices, int restarts,
+                    bool fast, startup_t *out) {
+  kv_engine_config_t config = {
+      .emul_config_file = "/kvssd/PDK/core/kvssd_emul.conf",
+      .memory_pool_size = 64 * 1024 * 1024,
+      .queue_depth = 128,
+      .enable_stats = 1,
+      .num_worker_threads = 4,
+      .dma_pool_count = POOL_BUFFERS,
+      .stream_pool_count = POOL_BUFFERS,
+      .num_devices = num_devices,
+      .device_open_threads = fast ? 0 : 1,
+      .lazy_pools = fast ? 1 : 0,
+  };
+  for (uint32_t i = 0; i < num_devices; i++) {
+    config.device_paths[i] = paths[i];
+  }
+
+  memset(out, 0, sizeof(*out));
+  for (int r = 0; r < restarts; r++) {
+    kv_engine_t *engine;
+    if (kv_engine_init(&engine, &config) != KV_SUCCESS) {
+      fprintf(stderr, "Failed to initialize %u devices\n", num_devices);
+      return false;
+    }
+    kv_init_timing_t timing;
+    kv_engine_get_init_timing(engine, &timing);
+    out->total_ms += timing.total_us / 1000.0;
+    out->devices_ms += timing.devices_us / 1000.0;
+    out->slowest_ms += timing.slowest_device_us / 1000.0;
+    out->pools_ms += timing.pools_us / 1000.0;
+    out->rest_ms += (timing.state_us + timing.recovery_us +
+                     timing.filters_us + timing.background_us) /
+                    1000.0;
+    kv_engine_cleanup(engine);
+  }
+  out->total_ms /= restarts;
+  out->devices_ms /= restarts;
+  out->slowest_ms /= restarts;
+  out->pools_ms /= restarts;
+  out->rest_ms /= restarts;
+  return true;
+}
+
+static void run(const char *label, const char *what, char paths[][256],
+                int restarts, bool fast) {
+  printf("\n%s %s\n", label, what);
+  printf("  %7s %10s %10s %12s %10s %10s\n", "devices", "init ms",
+         "open ms", "slowest ms", "pools ms", "other ms");
+  for (uint32_t n = 8; n <= MAX_BENCH_DEVICES; n *= 2) {
+    startup_t startup;
+    if (!measure(paths, n, restarts, fast, &startup)) {
+      return;
+    }
+    printf("  %7u %10.1f %10.1f %12.1f %10.2f %10.2f\n", n, startup.total_ms,
+           startup.devices_ms, startup.slowest_ms, startup.pools_ms,
+           startup.rest_ms);
+  }
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr,
+            "Usage: %s <device_path_prefix> [restarts]\n"
+            "  devices are <prefix>0 .. <prefix>%d\n",
+            argv[0], MAX_BENCH_DEVICES - 1);
+    return 1;
+  }
+
+  int restarts = argc >= 3 ? atoi(argv[2]) : DEFAULT_RESTARTS;
+  if (restarts <= 0) {
+    fprintf(stderr, "Invalid restarts: %s\n", argv[2]);
+    return 1;
+  }
+
+  char paths[MAX_BENCH_DEVICES][256];
+  for (int i = 0; i < MAX_BENCH_DEVICES; i++) {
+    snprintf(paths[i], sizeof(paths[i]), "%s%d", argv[1], i);
+  }
+
+  printf("=== Startup Benchmark ===\n");
+  printf("Restarts: %d per row | DMA and stream pools: %d buffers each\n",
+         restarts, POOL_BUFFERS);
+
+  run("[BEFORE]", "serial device opens, pools allocated at init", paths,
+      restarts, false);
+  run("[AFTER]", "concurrent device opens, lazy pools", paths, restarts,
+      true);
+
+  printf("\nDone.\n");
+  return 0;
+}
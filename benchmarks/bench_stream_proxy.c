@@ -0,0 +1,290 @@
+/**
+ * Stream Proxy Benchmark
+ *
+ * Four devices behind a proxy whose connections each relay values between
+ * a client and the engine in 64KB socket writes: 1MB values and 16MB ones,
+ * uploaded and then downloaded by several connections at once. [BEFORE]
+ * does what a proxy had to with kv_engine_store and kv_engine_retrieve:
+ * hold the whole value per connection, gathering an upload before storing
+ * it and fetching a download whole before sending its first byte. [AFTER]
+ * relays through write and read streams, which hold a few segment buffers
+ * from a shared pool whatever the value's size, and sends the first bytes
+ * as soon as the first segment arrives. The "socket" is a copy into a
+ * 64KB buffer, so the numbers are the engine side of the proxy only.
+ */
+
+#include "kv_engine.h"
+#include "util/bench_utils.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_DEVICES 4
+#define CONNECTIONS 4
+#define DEFAULT_NUM_VALUES 8
+#define KEY_SIZE 16
+/* Keys are KEY_SIZE bytes; make_key's buffer fits any number given */
+#define KEY_BUFFER_SIZE 32
+#define SOCKET_WRITE (64 * 1024)
+#define SMALL_VALUE (1024 * 1024)
+#define LARGE_VALUE (16 * 1024 * 1024)
+#define SEGMENT_SIZE (256 * 1024)
+
+typedef struct {
+  kv_engine_t *engine;
+  bool streams;
+  int connection;
+  int num_values;
+  const char *source;
+  uint64_t failures;
+  size_t peak_buffer; /* most value bytes this connection held at once */
+  double first_byte;  /* summed download time to first socket write */
+} connection_t;
+
+static size_t value_size(int v) {
+  return v % 2 ? LARGE_VALUE : SMALL_VALUE;
+}
+
+static void make_key(char *key, int connection, int v) {
+  snprintf(key, KEY_BUFFER_SIZE, "con%02d.val%06d", connection, v);
+}
+
+/* The client's bytes arrive one socket read at a time */
+static bool upload(connection_t *conn, const char *key, size_t len) {
+  if (!conn->streams) {
+    char *value = malloc(len);
+    if (!value) {
+      return false;
+    }
+    for (size_t pos = 0; pos < len; pos += SOCKET_WRITE) {
+      size_t n = len - pos < SOCKET_WRITE ? len - pos : SOCKET_WRITE;
+      memcpy(value + pos, conn->source + pos, n);
+    }
+    if (len > conn->peak_buffer) {
+      conn->peak_buffer = len;
+    }
+    kv_result_t res =
+        kv_engine_store(conn->engine, key, KEY_SIZE, value, len, true);
+    free(value);
+    return res == KV_SUCCESS;
+  }
+  kv_write_stream_t *stream;
+  if (kv_engine_open_write_stream(conn->engine, key, KEY_SIZE, len, true,
+                                  &stream) != KV_SUCCESS) {
+    return false;
+  }
+  kv_result_t res = KV_SUCCESS;
+  for (size_t pos = 0; res == KV_SUCCESS && pos < len; pos += SOCKET_WRITE) {
+    size_t n = len - pos < SOCKET_WRITE ? len - pos : SOCKET_WRITE;
+    res = kv_engine_stream_write(stream, conn->source + pos, n);
+  }
+  return kv_engine_close_write_stream(stream, res == KV_SUCCESS) ==
+         KV_SUCCESS;
+}
+
+/* The value leaves one socket write at a time */
+static bool download(connection_t *conn, const char *key, size_t len,
+                     char *socket_buffer) {
+  double start = get_time_seconds();
+  bool first = true;
+  size_t sent = 0;
+  int mismatches = 0;
+  if (!conn->streams) {
+    void *value = NULL;
+    size_t value_len = 0;
+    if (kv_engine_retrieve(conn->engine, key, KEY_SIZE, &value, &value_len,
+                           false) != KV_SUCCESS) {
+      return false;
+    }
+    if (value_len > conn->peak_buffer) {
+      conn->peak_buffer = value_len;
+    }
+    for (; sent < value_len; sent += SOCKET_WRITE) {
+      size_t n = value_len - sent < SOCKET_WRITE ? value_len - sent
+                                                  : SOCKET_WRITE;
+      memcpy(socket_buffer, (char *)value + sent, n);
+      mismatches += memcmp(socket_buffer, conn->source + sent, n) != 0;
+      if (first) {
+        conn->first_byte += get_time_seconds() - start;
+        first = false;
+      }
+    }
+    kv_engine_free_buffer(conn->engine, value);
+    return sent >= len && mismatches == 0;
+  }
+  kv_read_stream_t *stream;
+  size_t value_len = 0;
+  if (kv_engine_open_read_stream(conn->engine, key, KEY_SIZE, &stream,
+                                 &value_len) != KV_SUCCESS) {
+    return false;
+  }
+  size_t n = 0;
+  kv_result_t res;
+  while ((res = kv_engine_stream_read(stream, socket_buffer, SOCKET_WRITE,
+                                      &n)) == KV_SUCCESS &&
+         n > 0) {
+    mismatches += memcmp(socket_buffer, conn->source + sent, n) != 0;
+    sent += n;
+    if (first) {
+      conn->first_byte += get_time_seconds() - start;
+      first = false;
+    }
+  }
+  kv_engine_close_read_stream(stream);
+  return res == KV_SUCCESS && sent == len && value_len == len &&
+         mismatches == 0;
+}
+
+static void *upload_thread(void *arg) {
+  connection_t *conn = (connection_t *)arg;
+  char key[KEY_BUFFER_SIZE];
+  for (int v = 0; v < conn->num_values; v++) {
+    make_key(key, conn->connection, v);
+    conn->failures += !upload(conn, key, value_size(v));
+  }
+  return NULL;
+}
+
+static void *download_thread(void *arg) {
+  connection_t *conn = (connection_t *)arg;
+  char key[KEY_BUFFER_SIZE];
+  char *socket_buffer = malloc(SOCKET_WRITE);
+  if (!socket_buffer) {
+    conn->failures += conn->num_values;
+    return NULL;
+  }
+  for (int v = 0; v < conn->num_values; v++) {
+    make_key(key, conn->connection, v);
+    conn->failures += !download(conn, key, value_size(v), socket_buffer);
+  }
+  free(socket_buffer);
+  return NULL;
+}
+
+/* Runs one phase on all connections; returns MB/s */
+static double run_phase(connection_t *conns, void *(*phase)(void *)) {
+  pthread_t threads[CONNECTIONS];
+  double start = get_time_seconds();
+  for (int c = 0; c < CONNECTIONS; c++) {
+    pthread_create(&threads[c], NULL, phase, &conns[c]);
+  }
+  for (int c = 0; c < CONNECTIONS; c++) {
+    pthread_join(threads[c], NULL);
+  }
+  double bytes = 0;
+  for (int v = 0; v < conns[0].num_values; v++) {
+    bytes += value_size(v);
+  }
+  return CONNECTIONS * bytes / (1024 * 1024) / (get_time_seconds() - start);
+}
+
+static void run(const char *label, const char *what, char paths[][256],
+                int num_values, bool streams, const char *source) {
+  kv_engine_config_t config = {
+      .emul_config_file = "/kvssd/PDK/core/kvssd_emul.conf",
+      .memory_pool_size = 64 * 1024 * 1024,
+      .queue_depth = 128,
+      .enable_stats = 1,
+      .dma_pool_count = 16,
+      .num_devices = NUM_DEVICES,
+      .stream_segment_size = SEGMENT_SIZE,
+      .stream_pool_count = streams ? CONNECTIONS * KV_STREAM_SEGMENTS : 0,
+  };
+  for (int i = 0; i < NUM_DEVICES; i++) {
+    config.device_paths[i] = paths[i];
+  }
+
+  kv_engine_t *engine;
+  if (init_engine(&engine, paths[0], &config) != KV_SUCCESS) {
+    return;
+  }
+
+  connection_t conns[CONNECTIONS];
+  for (int c = 0; c < CONNECTIONS; c++) {
+    conns[c] = (connection_t){.engine = engine,
+                              .streams = streams,
+                              .connection = c,
+                              .num_values = num_values,
+                              .source = source};
+  }
+  double upload_bw = run_phase(conns, upload_thread);
+  double download_bw = run_phase(conns, download_thread);
+
+  uint64_t failures = 0;
+  size_t peak = 0;
+  double first_byte = 0;
+  for (int c = 0; c < CONNECTIONS; c++) {
+    failures += conns[c].failures;
+    peak = conns[c].peak_buffer > peak ? conns[c].peak_buffer : peak;
+    first_byte += conns[c].first_byte;
+  }
+  if (streams) {
+    peak = (size_t)KV_STREAM_SEGMENTS * SEGMENT_SIZE;
+  }
+
+  printf("\n%s %s\n", label, what);
+  printf("  uploads, %d connections:   %8.1f MB/s\n", CONNECTIONS, upload_bw);
+  printf("  downloads, %d connections: %8.1f MB/s%s\n", CONNECTIONS,
+         download_bw, failures ? " (with failures)" : "");
+  printf("  download time to 1st byte: %8.1f ms avg\n",
+         first_byte * 1000 / (CONNECTIONS * num_values));
+  printf("  download buffer per conn:  %8.1f MB%s\n",
+         (double)peak / (1024 * 1024),
+         streams ? " (read-ahead segments)" : " (largest value)");
+
+  /* the emulator keeps values in memory: free them for the next run */
+  char key[KEY_BUFFER_SIZE];
+  for (int c = 0; c < CONNECTIONS; c++) {
+    for (int v = 0; v < num_values; v++) {
+      make_key(key, c, v);
+      kv_engine_delete(engine, key, KEY_SIZE);
+    }
+  }
+  kv_engine_cleanup(engine);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr,
+            "Usage: %s <device_path_prefix> [values_per_connection]\n"
+            "  devices are <prefix>0 .. <prefix>%d\n",
+            argv[0], NUM_DEVICES - 1);
+    return 1;
+  }
+
+  int num_values = argc >= 3 ? atoi(argv[2]) : DEFAULT_NUM_VALUES;
+  if (num_values <= 0) {
+    fprintf(stderr, "Invalid values_per_connection: %s\n", argv[2]);
+    return 1;
+  }
+
+  char paths[NUM_DEVICES][256];
+  for (int i = 0; i < NUM_DEVICES; i++) {
+    snprintf(paths[i], sizeof(paths[i]), "%s%d", argv[1], i);
+  }
+
+  char *source = malloc(LARGE_VALUE);
+  if (!source) {
+    fprintf(stderr, "Failed to allocate source value\n");
+    return 1;
+  }
+  for (size_t i = 0; i < LARGE_VALUE; i++) {
+    source[i] = (char)(i * 13 + (i >> 16));
+  }
+
+  printf("=== Stream Proxy Benchmark ===\n");
+  printf("Connections: %d | Values: %d each, alternating %dMB and %dMB | "
+         "Devices: %d\n",
+         CONNECTIONS, num_values, SMALL_VALUE / (1024 * 1024),
+         LARGE_VALUE / (1024 * 1024), NUM_DEVICES);
+
+  run("[BEFORE]", "whole values, kv_engine_store/kv_engine_retrieve", paths,
+      num_values, false, source);
+  run("[AFTER]", "write and read streams, 256KB pooled segments", paths,
+      num_values, true, source);
+
+  free(source);
+  printf("\nDone.\n");
+  return 0;
+}
@@ -0,0 +1,171 @@
+/**
+ * Striping Benchmark
+ *
+ * Eight devices holding 2MB objects, written and then read back by one
+ * thread and by several. [BEFORE] keeps each object whole on the one
+ * device its key hashes to, so every object moves through a single SSD.
+ * [AFTER] cuts objects into stripe units (256KB, then 128KB) spread over
+ * all devices and moves them with concurrent async commands: on hardware,
+ * one object read draws on the bandwidth of up to eight SSDs. The emulator
+ * has no per-device bandwidth limit; its gain comes from copying the units
+ * on several device threads at once, so it understates the hardware one.
+ */
+
+#include "kv_engine.h"
+#include "util/bench_utils.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_DEVICES 8
+#define DEFAULT_NUM_OBJECTS 64
+#define THREADS 4
+#define READ_PASSES 4
+#define KEY_SIZE 16
+#define OBJECT_SIZE (2 * 1024 * 1024)
+
+typedef struct {
+  kv_engine_t *engine;
+  int num_objects;
+  int first;
+  uint64_t failures;
+} reader_t;
+
+static void make_key(char *key, int k) {
+  snprintf(key, KEY_SIZE, "obj%012d", k);
+}
+
+/* READ_PASSES sweeps over all objects, starting at reader->first */
+static void *reader_thread(void *arg) {
+  reader_t *reader = (reader_t *)arg;
+  char key[KEY_SIZE];
+  for (int i = 0; i < READ_PASSES * reader->num_objects; i++) {
+    make_key(key, (reader->first + i) % reader->num_objects);
+    void *out = NULL;
+    size_t out_len = 0;
+    if (kv_engine_retrieve(reader->engine, key, KEY_SIZE, &out, &out_len,
+                           false) != KV_SUCCESS) {
+      reader->failures++;
+      continue;
+    }
+    kv_engine_free_buffer(reader->engine, out);
+  }
+  return NULL;
+}
+
+/* Reads from num_threads threads; returns MB/s */
+static double read_phase(kv_engine_t *engine, int num_objects,
+                         int num_threads, uint64_t *failures) {
+  reader_t readers[THREADS];
+  pthread_t threads[THREADS];
+  double start = get_time_seconds();
+  for (int t = 0; t < num_threads; t++) {
+    readers[t] = (reader_t){.engine = engine,
+                            .num_objects = num_objects,
+                            .first = t * num_objects / num_threads};
+    pthread_create(&threads[t], NULL, reader_thread, &readers[t]);
+  }
+  for (int t = 0; t < num_threads; t++) {
+    pthread_join(threads[t], NULL);
+    *failures += readers[t].failures;
+  }
+  double mb = (double)num_threads * READ_PASSES * num_objects *
+              (OBJECT_SIZE / (1024 * 1024));
+  return mb / (get_time_seconds() - start);
+}
+
+static void run(const char *label, char paths[][256], int num_objects,
+                uint32_t stripe_unit) {
+  kv_engine_config_t config = {
+      .emul_config_file = "/kvssd/PDK/core/kvssd_emul.conf",
+      .memory_pool_size = 64 * 1024 * 1024,
+      .queue_depth = 128,
+      .enable_stats = 1,
+      .dma_pool_count = 16,
+      .num_devices = NUM_DEVICES,
+      .stripe_min_value_size = stripe_unit ? stripe_unit + 1 : 0,
+      .stripe_unit_size = stripe_unit,
+  };
+  for (int i = 0; i < NUM_DEVICES; i++) {
+    config.device_paths[i] = paths[i];
+  }
+
+  kv_engine_t *engine;
+  if (init_engine(&engine, paths[0], &config) != KV_SUCCESS) {
+    return;
+  }
+
+  char key[KEY_SIZE];
+  void *value = kv_engine_alloc_buffer(engine, OBJECT_SIZE);
+  if (!value) {
+    fprintf(stderr, "Failed to allocate value buffer\n");
+    kv_engine_cleanup(engine);
+    return;
+  }
+  memset(value, 'v', OBJECT_SIZE);
+
+  double start = get_time_seconds();
+  for (int k = 0; k < num_objects; k++) {
+    make_key(key, k);
+    if (kv_engine_store(engine, key, KEY_SIZE, value, OBJECT_SIZE, true) !=
+        KV_SUCCESS) {
+      fprintf(stderr, "Preload failed at object %d\n", k);
+      kv_engine_free_buffer(engine, value);
+      kv_engine_cleanup(engine);
+      return;
+    }
+  }
+  double mb = (double)num_objects * (OBJECT_SIZE / (1024 * 1024));
+  double store_bw = mb / (get_time_seconds() - start);
+
+  uint64_t failures = 0;
+  double read_bw = read_phase(engine, num_objects, 1, &failures);
+  double parallel_bw = read_phase(engine, num_objects, THREADS, &failures);
+
+  if (stripe_unit) {
+    printf("\n%s %uKB stripe units, %u per object\n", label,
+           stripe_unit / 1024, OBJECT_SIZE / stripe_unit);
+  } else {
+    printf("\n%s whole objects, one device each\n", label);
+  }
+  printf("  stores, 1 thread:      %8.1f MB/s\n", store_bw);
+  printf("  reads, 1 thread:       %8.1f MB/s\n", read_bw);
+  printf("  reads, %d threads:      %8.1f MB/s%s\n", THREADS, parallel_bw,
+         failures ? " (with failures)" : "");
+
+  kv_engine_free_buffer(engine, value);
+  kv_engine_cleanup(engine);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr,
+            "Usage: %s <device_path_prefix> [num_objects]\n"
+            "  devices are <prefix>0 .. <prefix>%d\n",
+            argv[0], NUM_DEVICES - 1);
+    return 1;
+  }
+
+  int num_objects = argc >= 3 ? atoi(argv[2]) : DEFAULT_NUM_OBJECTS;
+  if (num_objects <= 0) {
+    fprintf(stderr, "Invalid num_objects: %s\n", argv[2]);
+    return 1;
+  }
+
+  char paths[NUM_DEVICES][256];
+  for (int i = 0; i < NUM_DEVICES; i++) {
+    snprintf(paths[i], sizeof(paths[i]), "%s%d", argv[1], i);
+  }
+
+  printf("=== Striping Benchmark ===\n");
+  printf("Objects: %d x %dMB | Devices: %d\n", num_objects,
+         OBJECT_SIZE / (1024 * 1024), NUM_DEVICES);
+
+  run("[BEFORE]", paths, num_objects, 0);
+  run("[AFTER]", paths, num_objects, 256 * 1024);
+  run("[AFTER]", paths, num_objects, 128 * 1024);
+
+  printf("\nDone.\n");
+  return 0;
+}
@@ -88,6 +88,7 @@ int throughput_testing(kv_engine_t *engine, int num_ops) {
   }
 
   print_results(start_time, write_success, write_fail);
+  print_latency_percentiles(engine, KV_OP_STORE);
 
   /* ========== READ BENCHMARK ========== */
   printf("\nRunning READ benchmark...\n");
@@ -120,6 +121,7 @@ int throughput_testing(kv_engine_t *engine, int num_ops) {
   printf("  Progress: %d/%d\n", num_ops, num_ops);
   fflush(stdout);
   print_results(start_time, read_success, read_fail);
+  print_latency_percentiles(engine, KV_OP_RETRIEVE);
 
   /* Cleanup */
   free(key_buffer);
@@ -0,0 +1,159 @@
+/**
+ * Weighted Placement Benchmark
+ *
+ * Four devices standing in for two 4TB and two 8TB SSDs, filled with 4KB
+ * values until the first store lands on a full device, where the SSD would
+ * return KV_ERR_DEVICE_FULL. The emulator gives every device the same
+ * capacity, so each one's capacity is a budget of keys in proportion to
+ * its size, and a key's device is read from the engine's placement.
+ * [BEFORE] places keys with unweighted rendezvous hashing: every device
+ * takes a quarter of them, and the 4TB ones fill while a third of the
+ * fleet is still free. [AFTER] sets device_weights to the devices' sizes
+ * in GiB, so each takes keys in proportion and they fill together. Also
+ * shown: what the weights cost per placement and per store.
+ */
+
+#include "kv_engine.h"
+#include "kv_engine_internal.h"
+#include "util/bench_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_DEVICES 4
+#define DEFAULT_SMALL_BUDGET 20000
+#define KEY_SIZE 16
+/* Keys are KEY_SIZE bytes; make_key's buffer fits any number given */
+#define KEY_BUFFER_SIZE 32
+#define VALUE_SIZE 4096
+#define PLACEMENTS 4000000
+
+/* Sizes of the SSDs modelled, in GiB */
+static const uint32_t device_gib[NUM_DEVICES] = {3726, 3726, 7452, 7452};
+
+/* Keeps the placement loop from being optimized away */
+static volatile uint32_t placement_sink;
+
+static void make_key(char *key, uint64_t k) {
+  snprintf(key, KEY_BUFFER_SIZE, "key%012llu", (unsigned long long)k);
+}
+
+static void run(const char *label, char paths[][256], uint32_t small_budget,
+                bool weighted) {
+  kv_engine_config_t config = {
+      .emul_config_file = "/kvssd/PDK/core/kvssd_emul.conf",
+      .memory_pool_size = 64 * 1024 * 1024,
+      .queue_depth = 128,
+      .enable_stats = 1,
+      .dma_pool_count = 16,
+      .num_devices = NUM_DEVICES,
+  };
+  uint64_t budget[NUM_DEVICES];
+  uint64_t total_budget = 0;
+  for (int i = 0; i < NUM_DEVICES; i++) {
+    config.device_paths[i] = paths[i];
+    if (weighted) {
+      config.device_weights[i] = device_gib[i];
+    }
+    budget[i] = (uint64_t)small_budget * device_gib[i] / device_gib[0];
+    total_budget += budget[i];
+  }
+
+  kv_engine_t *engine;
+  if (init_engine(&engine, paths[0], &config) != KV_SUCCESS) {
+    return;
+  }
+
+  /* placement alone */
+  kv_placement_t placement;
+  double start = get_time_seconds();
+  for (uint32_t k = 0; k < PLACEMENTS; k++) {
+    kv_engine_place(engine, k * 2654435761u, &placement);
+    placement_sink = placement.dev[0];
+  }
+  double place_ns = (get_time_seconds() - start) * 1e9 / PLACEMENTS;
+
+  char key[KEY_BUFFER_SIZE];
+  void *value = kv_engine_alloc_buffer(engine, VALUE_SIZE);
+  if (!value) {
+    fprintf(stderr, "Failed to allocate value buffer\n");
+    kv_engine_cleanup(engine);
+    return;
+  }
+  memset(value, 'v', VALUE_SIZE);
+
+  uint64_t used[NUM_DEVICES] = {0};
+  uint64_t stored = 0;
+  int full = -1;
+  start = get_time_seconds();
+  while (full < 0) {
+    make_key(key, stored);
+    kv_engine_place(engine, kv_engine_key_hash(key, KEY_SIZE), &placement);
+    if (used[placement.dev[0]] == budget[placement.dev[0]]) {
+      full = (int)placement.dev[0];
+      break;
+    }
+    if (kv_engine_store(engine, key, KEY_SIZE, value, VALUE_SIZE, true) !=
+        KV_SUCCESS) {
+      fprintf(stderr, "Store failed at key %llu\n",
+              (unsigned long long)stored);
+      break;
+    }
+    used[placement.dev[0]]++;
+    stored++;
+  }
+  double store_rate = stored / (get_time_seconds() - start);
+
+  printf("\n%s %s\n", label,
+         weighted ? "weights = device GiB" : "unweighted placement");
+  printf("  placement:                 %8.1f ns/key\n", place_ns);
+  printf("  stores:                    %8.0f ops/sec\n", store_rate);
+  printf("  first full device:         %8d after %llu keys\n", full,
+         (unsigned long long)stored);
+  printf("  fleet fill at that point:  %8.1f%%\n",
+         100.0 * stored / total_budget);
+  for (int i = 0; i < NUM_DEVICES; i++) {
+    printf("    device %d (%uGiB):        %8.1f%% full\n", i, device_gib[i],
+           100.0 * used[i] / budget[i]);
+  }
+
+  /* the emulator keeps values in memory: free them for the next run */
+  for (uint64_t k = 0; k < stored; k++) {
+    make_key(key, k);
+    kv_engine_delete(engine, key, KEY_SIZE);
+  }
+  kv_engine_free_buffer(engine, value);
+  kv_engine_cleanup(engine);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr,
+            "Usage: %s <device_path_prefix> [keys_on_a_4TB_device]\n"
+            "  devices are <prefix>0 .. <prefix>%d\n",
+            argv[0], NUM_DEVICES - 1);
+    return 1;
+  }
+
+  int small_budget = argc >= 3 ? atoi(argv[2]) : DEFAULT_SMALL_BUDGET;
+  if (small_budget <= 0) {
+    fprintf(stderr, "Invalid keys_on_a_4TB_device: %s\n", argv[2]);
+    return 1;
+  }
+
+  char paths[NUM_DEVICES][256];
+  for (int i = 0; i < NUM_DEVICES; i++) {
+    snprintf(paths[i], sizeof(paths[i]), "%s%d", argv[1], i);
+  }
+
+  printf("=== Weighted Placement Benchmark ===\n");
+  printf("Devices: 2 x 4TB + 2 x 8TB (modelled) | 4TB device holds %d keys "
+         "| Values: %dB\n",
+         small_budget, VALUE_SIZE);
+
+  run("[BEFORE]", paths, (uint32_t)small_budget, false);
+  run("[AFTER]", paths, (uint32_t)small_budget, true);
+
+  printf("\nDone.\n");
+  return 0;
+}
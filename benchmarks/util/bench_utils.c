@@ -63,3 +63,16 @@ kv_result_t init_engine(kv_engine_t** engine, const char* device_path, const kv_
   printf("Engine initialized.\n\n");
   return KV_SUCCESS;
 }
+
+void print_latency_percentiles(kv_engine_t *engine, kv_op_type_t op) {
+  kv_latency_stats_t stats;
+  if (kv_engine_get_latency_stats(engine, &stats) != KV_SUCCESS ||
+      stats.op[op].count == 0) {
+    return;
+  }
+
+  const kv_latency_summary_t *s = &stats.op[op];
+  printf("  Latency percentiles (μs): p50 %.1f  p90 %.1f  p99 %.1f  "
+         "p99.9 %.1f  max %.1f\n",
+         s->p50_us, s->p90_us, s->p99_us, s->p999_us, s->max_us);
+}
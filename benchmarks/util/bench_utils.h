@@ -27,4 +27,12 @@ double get_time_seconds(void);
 kv_result_t init_engine(kv_engine_t **engine, const char *device_path,
                         const kv_engine_config_t *config);
 
+/**
+ * Print the engine's latency percentiles for one operation type
+ *
+ * @param engine Engine handle (created with enable_stats = 1)
+ * @param op Operation type to report
+ */
+void print_latency_percentiles(kv_engine_t *engine, kv_op_type_t op);
+
 #endif /* BENCH_UTILS_H */
@@ -80,6 +80,15 @@ int main(int argc, char **argv) {
     }
   }
 
+  /* Peek at the live queue while the stores drain */
+  kv_runtime_info_t info;
+  if (kv_engine_get_runtime_info(engine, &info) == KV_SUCCESS) {
+    printf("Queue: %u/%u waiting, %u/%u workers busy, %u in flight on "
+           "device 0\n",
+           info.queue_depth, info.queue_capacity, info.active_workers,
+           info.worker_threads, info.in_flight[0]);
+  }
+
   /* Wait for all operations to complete */
   printf("Waiting for operations to complete...\n");
   int all_completed = 0;
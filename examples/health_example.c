@@ -2,7 +2,8 @@
  * Health Monitoring Example
  *
  * Demonstrates the device health API: querying per-device health,
- * counting healthy devices, and hot-adding a device before first write.
+ * counting healthy devices, and hot-adding a device both to a populated
+ * engine (its keys migrate in the background) and before first write.
  *
  * Usage:
  *   ./health_example /dev/kvemul0 /dev/kvemul1
@@ -13,6 +14,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 static void print_health(kv_engine_t *engine, uint32_t num_devices) {
   printf("  healthy devices: %u / %u\n", kv_engine_healthy_device_count(engine),
@@ -118,19 +120,50 @@ int main(int argc, char **argv) {
   printf("  PASS: all devices still healthy after misses\n");
 
   /* -------------------------------------------------------------------------
-   * Section 4: hot-add rejected after writes
+   * Section 4: hot-add after writes; the stored keys stay readable while
+   * the new device takes over its share of them
    * ---------------------------------------------------------------------- */
-  printf("\n--- Section 4: hot-add rejected after writes ---\n");
+  printf("\n--- Section 4: hot-add after writes ---\n");
 
-  res = kv_engine_add_device(engine, argv[1]);
-  if (res == KV_ERR_INVALID_PARAM) {
-    printf("  PASS: add_device correctly rejected after writes (err=%d)\n",
-           res);
-  } else {
-    fprintf(stderr, "  FAIL: expected KV_ERR_INVALID_PARAM, got %d\n", res);
+  /* a path not open yet; the emulator creates a device for any path */
+  char added_path[256];
+  snprintf(added_path, sizeof(added_path), "%s_added", argv[num_devices]);
+  res = kv_engine_add_device(engine, added_path);
+  if (res != KV_SUCCESS) {
+    fprintf(stderr, "  FAIL: add_device after writes returned %d\n", res);
     kv_engine_cleanup(engine);
     return 1;
   }
+  num_devices++;
+
+  kv_migration_status_t status;
+  do {
+    usleep(10000);
+    kv_engine_get_migration_status(engine, &status);
+  } while (status.active);
+  printf("  migrated %u -> %u devices: %" PRIu64 " keys moved (%" PRIu64
+         " scanned over %u passes)\n",
+         status.from_devices, status.to_devices, status.keys_moved,
+         status.keys_scanned, status.passes);
+
+  for (int i = 0; i < 5; i++) {
+    char key[32], expected[64];
+    void *val;
+    size_t len;
+    snprintf(key, sizeof(key), "health:key:%04d", i);
+    snprintf(expected, sizeof(expected), "value-%d", i);
+    res = kv_engine_retrieve(engine, key, strlen(key), &val, &len, false);
+    if (res != KV_SUCCESS || len != strlen(expected) ||
+        memcmp(val, expected, len) != 0) {
+      fprintf(stderr, "  FAIL: %s not readable after add (err=%d)\n", key,
+              res);
+      kv_engine_cleanup(engine);
+      return 1;
+    }
+    kv_engine_free_buffer(engine, val);
+  }
+  printf("  PASS: all keys readable after hot-add\n");
+  print_health(engine, num_devices);
 
   /* -------------------------------------------------------------------------
    * Section 5: probe thread shutdown - cleanup must not hang
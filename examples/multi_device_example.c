@@ -2,7 +2,7 @@
  * Multi-Device Example
  *
  * Demonstrates using multiple emulated NVMe KV SSDs with hash-based
- * key sharding.  Each device path creates an independent in-memory
+ * key placement.  Each device path creates an independent in-memory
  * emulated SSD inside the Samsung PDK emulator.
  *
  * Usage:
@@ -18,6 +18,18 @@
 
 #define NUM_KEYS 120
 
+/* Mirrors the engine's placement: FNV-1a key hash, then rendezvous
+ * hashing (highest per-device score wins) */
+static uint64_t device_score(uint32_t hash, uint32_t device) {
+  uint64_t h = ((uint64_t)(device + 1) << 32 | hash) * 0x9e3779b97f4a7c15ULL;
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ULL;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebULL;
+  h ^= h >> 31;
+  return h;
+}
+
 static uint32_t shard_for_key(const void *key, size_t key_len,
                               uint32_t num_devices) {
   const uint8_t *data = (const uint8_t *)key;
@@ -26,7 +38,14 @@ static uint32_t shard_for_key(const void *key, size_t key_len,
     hash ^= data[i];
     hash *= 16777619u;
   }
-  return hash % num_devices;
+
+  uint32_t best = 0;
+  for (uint32_t d = 1; d < num_devices; d++) {
+    if (device_score(hash, d) > device_score(hash, best)) {
+      best = d;
+    }
+  }
+  return best;
 }
 
 static int expected_version_for_key(int key_index) {
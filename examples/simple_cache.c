@@ -25,7 +25,9 @@ int main(int argc, char **argv) {
                                .memory_pool_size = 32 * 1024 * 1024,
                                .queue_depth = 128,
                                .num_worker_threads = 8,
-                               .enable_stats = 1};
+                               .enable_stats = 1,
+                               .recover_index = 1,
+                               .bloom_bits_per_key = 10};
 
   kv_engine_t *engine;
   if (kv_engine_init(&engine, &config) != KV_SUCCESS) {
@@ -107,6 +109,10 @@ int main(int argc, char **argv) {
   printf("Read ops: %lu (%.2f MB)\n", stats.read_ops,
          stats.bytes_read / (1024.0 * 1024.0));
   printf("Failed ops: %lu\n", stats.failed_ops);
+  printf("Key index: %lu keys, %.1f bytes/key\n", stats.index_keys,
+         stats.index_bytes_per_key);
+  printf("Bloom filter: %lu misses answered in memory (%lu bytes)\n",
+         stats.filter_negatives, stats.filter_bytes);
 
   kv_engine_cleanup(engine);
   return 0;
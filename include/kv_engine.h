@@ -20,7 +20,10 @@
  * ============================================================================
  */
 
-#define KV_MAX_DEVICES 8 /**< Maximum number of devices per engine instance */
+#define KV_MAX_DEVICES 128 /**< Maximum number of devices per engine instance */
+#define KV_TELEMETRY_HISTORY 64 /**< Telemetry samples kept per device */
+#define KV_HOT_KEYS_MAX 16      /**< Keys in a hot-key report */
+#define KV_SLOW_OP_LOG_SIZE 256 /**< Entries kept in the slow-op log */
 
 /* ============================================================================
  * Type Definitions
@@ -52,7 +55,9 @@ typedef enum {
   KV_ERR_KEY_LENGTH = -13,
   KV_ERR_VALUE_LENGTH = -14,
   KV_ERR_DEVICE_DEGRADED = -15,
-  KV_ERR_ALL_DEVICES_FAILED = -16
+  KV_ERR_ALL_DEVICES_FAILED = -16,
+  KV_ERR_BUSY = -17,
+  KV_ERR_ABORTED = -18
 } kv_result_t;
 
 /**
@@ -75,6 +80,41 @@ typedef void (*kv_completion_cb)(kv_result_t result, void *user_data);
 typedef void (*kv_retrieve_cb)(kv_result_t result, void *value,
                                size_t value_len, void *user_data);
 
+/**
+ * Source of a streamed store: writes the next len bytes of the value
+ *
+ * @param buffer Where the bytes go
+ * @param len Bytes wanted
+ * @param user_data User-provided context pointer
+ * @return 0 to continue, nonzero to abort the store (KV_ERR_ABORTED)
+ */
+typedef int (*kv_stream_fill_cb)(void *buffer, size_t len, void *user_data);
+
+/**
+ * Sink of a streamed retrieve: receives the next len bytes of the value
+ *
+ * @param data The bytes, valid only during the call
+ * @param len Byte count
+ * @param user_data User-provided context pointer
+ * @return 0 to continue, nonzero to abort the retrieve (KV_ERR_ABORTED)
+ */
+typedef int (*kv_stream_data_cb)(const void *data, size_t len,
+                                 void *user_data);
+
+/**
+ * A value being read in pieces (see kv_engine_open_read_stream)
+ */
+typedef struct kv_read_stream kv_read_stream_t;
+
+/**
+ * A value being written in pieces (see kv_engine_open_write_stream)
+ */
+typedef struct kv_write_stream kv_write_stream_t;
+
+/* Ranged reads a read stream keeps ahead of its reader, each into a buffer
+ * of config.stream_segment_size bytes */
+#define KV_STREAM_SEGMENTS 4
+
 /**
  * Configuration options for engine initialization
  */
@@ -92,9 +132,160 @@ typedef struct {
   const char *device_paths[KV_MAX_DEVICES]; /**< Array of device paths */
   uint32_t num_devices; /**< Number of devices (0 = single-device mode) */
 
+  /* Device table size: per-device state (device contexts, latency
+   * histograms, hot-key sketches) is allocated at init for max_devices
+   * devices, the ones opened then plus those kv_engine_add_device may add
+   * later, rather than for KV_MAX_DEVICES. */
+  uint32_t max_devices; /**< Device slots, at most KV_MAX_DEVICES (0 = the
+                             larger of the initial device count and 8) */
+
+  /* Weighted placement: each device takes a share of the keys (and of
+   * every key's replicas and chunks) proportional to its weight, so a
+   * larger or emptier device fills at the pace of the others. A device's
+   * weight is device_weights[i] when set; else the weight recorded on the
+   * device when it first joined; else, with weight_by_capacity = 1, its
+   * free space in GiB (capacity less utilization) as it joins, which is
+   * then recorded; else 1. Recorded weights keep a restarted engine
+   * placing keys where it put them; explicit ones must likewise stay as
+   * they are once keys are stored, and should be in GiB when mixed with
+   * derived ones. Equal weights place keys as if unweighted. */
+  uint32_t device_weights[KV_MAX_DEVICES]; /**< Relative weights (0 = unset) */
+  uint32_t weight_by_capacity; /**< Derive unset weights (0 or 1) */
+
   /* DMA buffer pool: set dma_pool_count > 0 to enable pooling.
    * Each buffer is KV_ENGINE_RETRIEVE_SIZE (2MB). 0 = disabled. */
   uint32_t dma_pool_count;
+
+  /* Key index recovery: when recover_index is 1, kv_engine_init rebuilds the
+   * in-memory key index from the devices (one iterator thread per device)
+   * so keys stored by a previous run are visible to kv_engine_exists.
+   * If index_snapshot_path is also set, kv_engine_cleanup saves the index
+   * there and the next init loads it instead of walking the devices, as long
+   * as every device still carries the snapshot's epoch marker. Every init
+   * removes the markers, so a run that doesn't save a snapshot (no path,
+   * or an incomplete index) leaves none to be trusted. */
+  uint32_t recover_index;          /**< Rebuild key index at init (0 or 1) */
+  const char *index_snapshot_path; /**< Optional index snapshot file */
+
+  /* Negative lookup filter: bloom_bits_per_key > 0 keeps a Bloom filter per
+   * device so retrieve/exists on absent keys return KV_ERR_KEY_NOT_FOUND
+   * without a device command. 10 bits/key gives about 1% false positives.
+   * Requires recover_index = 1 (the filter must see every stored key). */
+  uint32_t bloom_bits_per_key; /**< Filter bits per key (0 = disabled) */
+
+  /* Index-authoritative exists: with index_authoritative = 1 and a complete
+   * index (recover_index = 1), kv_engine_exists answers from the in-memory
+   * index without a device command. exists_verify_interval > 0 checks one
+   * in every N such answers against the device and repairs the index on a
+   * mismatch; kv_engine_exists_verified always checks the device. */
+  uint32_t index_authoritative;    /**< Answer exists from DRAM (0 or 1) */
+  uint32_t exists_verify_interval; /**< Sample 1 in N (0 = never) */
+
+  /* Per-phase timing: enable_phase_timing = 1 splits every store and
+   * retrieve into the phases of kv_phase_t and keeps a histogram per phase
+   * (see kv_engine_get_phase_stats). Costs a clock read per phase, so leave
+   * it off outside of tuning runs; when 0 the hot path only tests a
+   * pointer. Independent of enable_stats. */
+  uint32_t enable_phase_timing; /**< Per-phase histograms (0 or 1) */
+
+  /* Metrics endpoint: metrics_port > 0 serves kv_engine_export_metrics
+   * output at http://127.0.0.1:<port>/metrics from a background thread.
+   * Scrapes read in-memory counters only and never reach the devices. */
+  uint32_t metrics_port; /**< Loopback HTTP port (0 = disabled) */
+
+  /* Hot-key detection: hot_key_sample_interval > 0 feeds one in every N
+   * stores and retrieves into a per-device Count-Min sketch with a
+   * heavy-hitter table. kv_engine_get_hot_keys reports the busiest keys and
+   * how unevenly load is spread across devices. */
+  uint32_t hot_key_sample_interval; /**< Sample 1 in N ops (0 = disabled) */
+
+  /* Flight recorder: flight_recorder_size > 0 keeps the last N store,
+   * retrieve, delete and exists calls of every thread in a lock-free ring
+   * (key hash, device, size, timings, result). slow_op_threshold_us > 0
+   * also copies calls at least that slow into a shared slow-op log of
+   * KV_SLOW_OP_LOG_SIZE entries. Setting dump_signal (e.g. SIGUSR2) makes
+   * that signal write both to dump_path, or to stderr when it is NULL. */
+  uint32_t flight_recorder_size; /**< Ops kept per thread (0 = disabled) */
+  uint32_t slow_op_threshold_us; /**< Slow-op log threshold (0 = disabled) */
+  int dump_signal;               /**< Signal that dumps both (0 = none) */
+  const char *dump_path;         /**< Dump file, appended to (NULL = stderr) */
+
+  /* Online device add: kv_engine_add_device moves the keys the new device
+   * takes over in the background, at most migration_keys_per_sec of them
+   * per second so the move doesn't crowd out foreground I/O. */
+  uint32_t migration_keys_per_sec; /**< Migration rate (0 = unthrottled) */
+
+  /* Replication: replication_factor > 1 writes every key to that many
+   * distinct devices (capped at the device count), chosen by the same
+   * rendezvous hash as placement. Reads go to the healthy copy with the
+   * fewest commands in flight and fall back to the others on an error, so
+   * one degraded device no longer fails its keys' reads. Stores write the
+   * copies concurrently, and stores and deletes need every copy's device
+   * healthy. When some copies of a store fail, a no-overwrite store deletes
+   * the ones it wrote and an overwrite marks the failed copies' devices
+   * unhealthy, so reads never see both versions. */
+  uint32_t replication_factor; /**< Copies per key (0 or 1 = one copy) */
+
+  /* Hedged reads: with replication_factor > 1 and hedge_percentile set, a
+   * retrieve still waiting on its device after that percentile of the
+   * device's recent read latency (re-measured every 1024 reads) sends the
+   * same read to the next copy and returns whichever answers first. The
+   * slower answer is discarded. Bounds the tail a busy or garbage
+   * collecting device adds, for about (100 - hedge_percentile)% extra
+   * reads. Not applied to retrieve-and-delete. */
+  uint32_t hedge_percentile; /**< Hedge delay percentile, 1-99 (0 = off) */
+
+  /* Slow-device ejection: with slow_device_factor set, the health probe
+   * keeps a moving average of every device's command latency and flags a
+   * device "slow" while its average is at least that multiple of the
+   * median of its peers'. Reads of keys with a copy elsewhere go to the
+   * other copies; stores and deletes still reach every copy. The device is
+   * re-admitted after the probe's recovery threshold of consecutive sweeps
+   * (3, 5 seconds apart) back under the factor. */
+  uint32_t slow_device_factor; /**< Latency multiple of peers (0 = off) */
+
+  /* Erasure coding: values of at least erasure_min_value_size bytes are
+   * split into erasure_data_chunks (k) pieces plus erasure_parity_chunks
+   * (m) Reed-Solomon parity pieces, each stored on a different healthy
+   * device, with a small manifest under the key itself, kept on
+   * max(m + 1, replication_factor) devices. A retrieve reads all k + m pieces in parallel and rebuilds
+   * from parity whatever a failed or straggling device hasn't delivered,
+   * so the value survives m lost devices and is read at k devices'
+   * bandwidth. k + m must be 2 to 32 and at most the device count; keys
+   * over 245 bytes are stored whole. */
+  uint32_t erasure_min_value_size; /**< Coding threshold, bytes (0 = off) */
+  uint32_t erasure_data_chunks;    /**< k, at least 1 */
+  uint32_t erasure_parity_chunks;  /**< m */
+
+  /* Striping: values of at least stripe_min_value_size bytes (and over one
+   * stripe unit) that erasure coding doesn't take are cut into
+   * stripe_unit_size pieces spread over all devices, written and read in
+   * parallel for the bandwidth of several devices, with the same manifest
+   * under the key. Stripes carry no parity and are not replicated, so a
+   * device down makes the values with a stripe on it unreadable. Values
+   * that reach erasure_min_value_size are erasure coded instead. */
+  uint32_t stripe_min_value_size; /**< Striping threshold, bytes (0 = off) */
+  uint32_t stripe_unit_size;      /**< Bytes per stripe, rounded up to 4KB,
+                                       at most 2MB (0 = 256KB) */
+
+  /* Streams: a read stream (kv_engine_open_read_stream) fetches its value
+   * by ranged reads of stream_segment_size bytes into KV_STREAM_SEGMENTS
+   * buffers, and a write stream of a chunked value holds four chunks plus
+   * two rows' parity, whatever the value's size. stream_pool_count > 0
+   * keeps that many segment buffers in a pool so streams, and write
+   * streams' chunks of up to a segment, don't allocate; past that they
+   * fall back to allocating. */
+  uint32_t stream_segment_size; /**< Bytes per ranged read, rounded up to
+                                     4KB, at most 2MB (0 = 256KB) */
+  uint32_t stream_pool_count;   /**< Pooled segment buffers (0 = none) */
+
+  /* Startup: kv_engine_init opens device_open_threads devices at a time
+   * (0 = all at once; 1 = one after another, for drivers that can't open
+   * devices concurrently). lazy_pools = 1 allocates the DMA and stream
+   * pool buffers as ops first need them instead of all of them at init.
+   * kv_engine_get_init_timing reports where init spent its time. */
+  uint32_t device_open_threads; /**< Concurrent device opens (0 = all) */
+  uint32_t lazy_pools; /**< Allocate pool buffers on first use (0 or 1) */
 } kv_engine_config_t;
 
 /**
@@ -106,16 +297,105 @@ typedef struct {
   uint64_t write_ops;     /**< Write operations */
   uint64_t delete_ops;    /**< Delete operations */
   uint64_t failed_ops;    /**< Failed operations */
-  double avg_latency_us;  /**< Average latency in microseconds */
+  double avg_latency_us;  /**< Mean engine call latency across all ops */
   uint64_t bytes_written; /**< Total bytes written */
   uint64_t bytes_read;    /**< Total bytes read */
+
+  /* In-memory key index footprint, sampled when the stats are read */
+  uint64_t index_keys;        /**< Keys currently tracked by the index */
+  uint64_t index_bytes;       /**< Heap bytes used by the index */
+  double index_bytes_per_key; /**< index_bytes / index_keys (0 if empty) */
+
+  /* Negative lookup filter (bloom_bits_per_key > 0) */
+  uint64_t filter_negatives; /**< Lookups answered "absent" by the filter */
+  uint64_t filter_bytes;     /**< Heap bytes used by the device filters */
+
+  /* Existence checks (index_authoritative = 1) */
+  uint64_t exists_from_index; /**< Answered from DRAM with no device command */
+  uint64_t exists_verified;   /**< Checked against the device */
+  uint64_t index_mismatches;  /**< Verifications that disagreed (repaired) */
+
+  /* Hedged reads (hedge_percentile > 0) */
+  uint64_t hedged_reads; /**< Reads that sent a second copy request */
+  uint64_t hedge_wins;   /**< Of those, answered by the second request */
+
+  /* Erasure-coded values (erasure_min_value_size > 0) */
+  uint64_t chunked_stores;    /**< Stores written as k + m chunks */
+  uint64_t chunked_retrieves; /**< Retrieves reassembled from chunks */
+  uint64_t reconstructed_retrieves; /**< Of those, rebuilt from parity after
+                                       a failed or slow device */
 } kv_engine_stats_t;
 
+/**
+ * Live queue, device and pool state (see kv_engine_get_runtime_info).
+ * Unlike kv_engine_stats_t these are gauges read at the moment of the
+ * call, and they don't depend on enable_stats.
+ */
+typedef struct {
+  /* Async worker pool (all 0 when num_worker_threads is 0) */
+  uint32_t worker_threads;
+  uint32_t active_workers; /**< Workers executing an op */
+  uint32_t queue_depth;    /**< Ops waiting for a worker */
+  uint32_t queue_capacity; /**< Submitters block beyond this */
+
+  /* Device commands issued and not yet completed, per device */
+  uint32_t in_flight[KV_MAX_DEVICES];
+  uint32_t num_devices;
+
+  /* DMA buffer pool (first four are 0 when dma_pool_count is 0) */
+  uint64_t dma_buffer_size;
+  uint64_t dma_buffers_total;
+  uint64_t dma_buffers_free;
+  uint64_t dma_pool_exhausted;  /**< Acquires that found no free buffer */
+  uint64_t dma_fallback_allocs; /**< Per-op allocations outside the pool:
+                                   pool empty or value larger than a
+                                   pool buffer */
+
+  /* Memory pool */
+  uint64_t memory_pool_used;
+  uint64_t memory_pool_size;
+
+  /* Key index */
+  uint64_t index_keys;
+  uint64_t index_capacity;     /**< Slots across all stripes */
+  uint64_t index_tombstones;   /**< Deleted slots awaiting a rehash */
+  double index_load_factor;    /**< (keys + tombstones) / capacity */
+  double index_max_stripe_load; /**< Fullest stripe; rehashes past 0.875 */
+  uint64_t index_bytes;
+} kv_runtime_info_t;
+
+/**
+ * Progress of the key migration started by kv_engine_add_device (see
+ * kv_engine_get_migration_status). Counters cover the latest migration
+ * and are summed over its passes.
+ */
+typedef struct {
+  uint32_t active;       /**< 1 while keys are still moving */
+  uint32_t from_devices; /**< Device count before the add */
+  uint32_t to_devices;   /**< Device count now */
+  uint32_t passes;       /**< Sweeps over the old devices so far */
+  uint64_t keys_scanned; /**< Keys examined on the old devices */
+  uint64_t keys_to_move; /**< Of those, keys owing the new device a copy */
+  uint64_t keys_moved;   /**< Keys copied to the new device */
+  uint64_t bytes_moved;
+  uint64_t errors; /**< Failed moves or device walks, retried next pass */
+} kv_migration_status_t;
+
+/**
+ * One device telemetry sample, taken by the background health probe
+ */
+typedef struct {
+  uint64_t timestamp_ms;    /**< Wall-clock time of the sample (Unix ms) */
+  uint64_t capacity_bytes;  /**< Total raw capacity reported by device */
+  uint32_t utilization_pct; /**< 0-10000, as in kv_device_health_t */
+} kv_device_sample_t;
+
 /**
  * Per-device health snapshot (for multi-device mode)
  *
- * Populated by kv_engine_get_device_health(). Reflects the state of one
- * physical device at the moment of the call.
+ * Populated by kv_engine_get_device_health(). Counters reflect the moment
+ * of the call; capacity and utilization come from the most recent
+ * telemetry sample of the health probe thread.
  */
 typedef struct {
   uint32_t device_index; /**< Index into the engine's device array */
@@ -124,14 +404,172 @@ typedef struct {
   uint64_t capacity_bytes;  /**< Total raw capacity reported by device */
   uint32_t utilization_pct; /**< 0-10000 (divide by 100 for percent; e.g. 4250
                                = 42.50%) */
+  uint64_t sample_age_ms; /**< Age of capacity/utilization (UINT64_MAX if the
+                             device hasn't been sampled) */
+  double fill_rate_bytes_per_sec; /**< Change in used bytes across the
+                                     sample history (0 with < 2 samples) */
   uint64_t consecutive_errors; /**< Device-level errors since last success;
                                   resets to 0 on success */
   uint64_t total_errors; /**< Cumulative device-level error count since engine
                             init */
   uint64_t total_ops;    /**< Cumulative operations attempted on this device */
+
+  /* Latency outliers (slow_device_factor > 0, else all 0) */
+  bool slow; /**< Latency at slow_device_factor times its peers'; reads
+                prefer other copies until it recovers */
+  double latency_ewma_us; /**< Moving average of command latency, updated
+                             every probe sweep */
+  double latency_p99_us;  /**< p99 command latency of the last sweep */
+  uint32_t weight;        /**< Placement weight (see device_weights) */
   char device_path[256]; /**< Null-terminated path (e.g. "/dev/kvemul0") */
 } kv_device_health_t;
 
+/**
+ * How the key index was populated at init
+ */
+typedef enum {
+  KV_RECOVERY_NONE = 0,        /**< Recovery disabled; index starts empty */
+  KV_RECOVERY_DEVICE_SCAN = 1, /**< Keys read back with device iterators */
+  KV_RECOVERY_SNAPSHOT = 2     /**< Keys loaded from index_snapshot_path */
+} kv_recovery_source_t;
+
+/**
+ * Key index recovery report (see kv_engine_get_recovery_info)
+ */
+typedef struct {
+  kv_recovery_source_t source; /**< Where the index came from */
+  bool complete; /**< true if every device was recovered successfully */
+  uint64_t keys_recovered; /**< Keys loaded into the index */
+  uint64_t duration_us;    /**< Wall-clock recovery time */
+  double keys_per_sec;     /**< keys_recovered / duration */
+} kv_recovery_info_t;
+
+/**
+ * Where kv_engine_init spent its time (see kv_engine_get_init_timing), in
+ * microseconds. The phases run one after another and add up to about
+ * total_us.
+ */
+typedef struct {
+  uint64_t total_us;          /**< The whole kv_engine_init call */
+  uint64_t devices_us;        /**< Opening every device, concurrently */
+  uint64_t slowest_device_us; /**< The longest of those opens */
+  uint64_t pools_us;          /**< Memory, DMA and stream pools, workers */
+  uint64_t state_us; /**< Key index, hot-key, migration, latency state */
+  uint64_t recovery_us; /**< Key index recovery and chunk key scan */
+  uint64_t filters_us;  /**< Negative lookup filters */
+  uint64_t background_us; /**< Health probe, migration resume, metrics */
+} kv_init_timing_t;
+
+/**
+ * Operation types for latency reporting
+ */
+typedef enum {
+  KV_OP_STORE = 0,
+  KV_OP_RETRIEVE = 1,
+  KV_OP_DELETE = 2,
+  KV_OP_EXISTS = 3,
+  KV_OP_TYPES = 4 /**< Number of operation types */
+} kv_op_type_t;
+
+/**
+ * Latency distribution of one operation type (microseconds). Percentiles
+ * are accurate to about 3%.
+ */
+typedef struct {
+  uint64_t count; /**< Samples recorded */
+  double mean_us;
+  double p50_us;
+  double p90_us;
+  double p99_us;
+  double p999_us;
+  double max_us;
+} kv_latency_summary_t;
+
+/**
+ * Latency report (see kv_engine_get_latency_stats). Indexed by kv_op_type_t.
+ */
+typedef struct {
+  /* Time spent inside the engine call, for sync calls and for the worker
+   * executing an async op */
+  kv_latency_summary_t op[KV_OP_TYPES];
+  /* Async ops only: submit until the worker picks the op up */
+  kv_latency_summary_t queue_wait[KV_OP_TYPES];
+  /* Async ops only: submit until the completion callback is invoked */
+  kv_latency_summary_t async_total[KV_OP_TYPES];
+  /* Device command service time, per device */
+  kv_latency_summary_t device[KV_MAX_DEVICES][KV_OP_TYPES];
+  uint32_t num_devices; /**< Valid rows in device[] */
+} kv_latency_stats_t;
+
+/**
+ * Hot-path phases for per-phase timing. Store and retrieve record every
+ * phase they pass through; async ops also record their queue wait.
+ */
+typedef enum {
+  KV_PHASE_VALIDATE = 0,   /**< Argument checks */
+  KV_PHASE_ROUTE = 1,      /**< Shard hash, device pick, health check */
+  KV_PHASE_INDEX = 2,      /**< Key index and filter lookups/updates */
+  KV_PHASE_BUFFER = 3,     /**< DMA staging copy, pool acquire/release */
+  KV_PHASE_DEVICE = 4,     /**< Device command */
+  KV_PHASE_STATS = 5,      /**< Statistics counters */
+  KV_PHASE_QUEUE_WAIT = 6, /**< Async ops: submit until a worker starts */
+  KV_PHASES = 7            /**< Number of phases */
+} kv_phase_t;
+
+/**
+ * Per-phase report (see kv_engine_get_phase_stats), indexed by
+ * kv_op_type_t and kv_phase_t. Each sample is the time one call spent in
+ * that phase; phases a call didn't reach are not sampled.
+ */
+typedef struct {
+  kv_latency_summary_t phase[KV_OP_TYPES][KV_PHASES];
+} kv_phase_stats_t;
+
+/**
+ * One frequently accessed key (see kv_engine_get_hot_keys)
+ */
+typedef struct {
+  unsigned char key[255]; /**< Key bytes (not NUL-terminated) */
+  uint32_t key_len;
+  uint32_t device_index; /**< Device the key is sharded to */
+  double ops_per_sec;    /**< Estimated store + retrieve rate; sampling and
+                            the sketch can only overestimate it */
+} kv_hot_key_t;
+
+/**
+ * Hot-key and load skew report, covering the last 5 to 10 seconds
+ */
+typedef struct {
+  kv_hot_key_t keys[KV_HOT_KEYS_MAX]; /**< Busiest keys, hottest first */
+  uint32_t num_keys;
+  double device_ops_per_sec[KV_MAX_DEVICES]; /**< Device commands per sec */
+  uint32_t num_devices;
+  double load_skew;  /**< Busiest device rate / mean rate (1.0 = even) */
+  double window_sec; /**< Time span the rates are computed over */
+} kv_hot_key_report_t;
+
+/**
+ * One call captured by the flight recorder or the slow-op log
+ */
+typedef struct {
+  uint64_t timestamp_ns; /**< Call start, ns since the Unix epoch */
+  uint64_t latency_ns;   /**< Time inside the engine call */
+  uint64_t device_ns;    /**< Device command time (0 if none was issued) */
+  uint64_t value_size;   /**< Bytes stored or retrieved (0 otherwise) */
+  uint32_t key_hash;     /**< Shard hash of the key (0 if key was invalid) */
+  uint32_t device_index; /**< Device commanded (UINT32_MAX if none) */
+  kv_op_type_t op;
+  kv_result_t result;
+} kv_op_record_t;
+
+/**
+ * Application buffer region for kv_engine_register_buffers()
+ */
+typedef struct {
+  void *base; /**< Start of the buffer */
+  size_t len; /**< Length of the buffer in bytes */
+} kv_buffer_t;
+
 /* ============================================================================
  * Lifecycle Management
  * ============================================================================
@@ -162,11 +600,15 @@ void kv_engine_cleanup(kv_engine_t *engine);
 /**
  * Store a key-value pair (synchronous)
  *
+ * Keys starting with the bytes 0xFF 'K' 'V' 'E' are reserved for engine
+ * metadata and are rejected with KV_ERR_INVALID_PARAM.
+ *
  * @param engine Engine handle
  * @param key Key buffer
  * @param key_len Key length (4-255 bytes)
  * @param value Value buffer
- * @param value_len Value length (up to 2MB)
+ * @param value_len Value length; values over 2MB are chunked (see
+ * kv_engine_store_stream) unless the key is over 245 bytes
  * @param overwrite If true, overwrite existing key; if false, return
  * KV_ERR_KEY_ALREADY_EXISTS
  * @return KV_SUCCESS on success, error code otherwise
@@ -205,6 +647,9 @@ kv_result_t kv_engine_delete(kv_engine_t *engine, const void *key,
 /**
  * Check if a key exists (synchronous)
  *
+ * With index_authoritative enabled (and a complete index) this is answered
+ * from memory; otherwise both the index and the device are consulted.
+ *
  * @param engine Engine handle
  * @param key Key buffer
  * @param key_len Key length
@@ -214,6 +659,186 @@ kv_result_t kv_engine_delete(kv_engine_t *engine, const void *key,
 kv_result_t kv_engine_exists(kv_engine_t *engine, const void *key,
                              size_t key_len, int *exists);
 
+/**
+ * Check if a key exists, always asking the device
+ *
+ * Bypasses the index-authoritative fast path. If the device disagrees with a
+ * complete index, the index is repaired and index_mismatches is incremented.
+ *
+ * @param engine Engine handle
+ * @param key Key buffer
+ * @param key_len Key length
+ * @param exists Pointer to receive existence flag (1=exists, 0=not exists)
+ * @return KV_SUCCESS on success, error code otherwise
+ */
+kv_result_t kv_engine_exists_verified(kv_engine_t *engine, const void *key,
+                                      size_t key_len, int *exists);
+
+/**
+ * Store a value of any size, pulled from a callback
+ *
+ * A value over 2MB (or one the striping and erasure coding settings take)
+ * is cut into device-sized chunks under a manifest and written a few rows
+ * of chunks at a time, each row over several devices in parallel, fill
+ * being called for the next row while the previous ones are written; the
+ * engine holds a bounded number of rows however large the value. A
+ * smaller value is gathered with one fill call and stored as
+ * kv_engine_store would. fill is called on the calling thread, in order,
+ * until value_len bytes have been supplied. An aborted or failed store
+ * leaves no chunks behind and any previous value in place.
+ *
+ * @param engine Engine handle
+ * @param key Key buffer
+ * @param key_len Key length (4-255 bytes; at most 245 for values over 2MB)
+ * @param value_len Total value length
+ * @param fill Supplies the value
+ * @param user_data User context for fill
+ * @param overwrite If true, overwrite existing key; if false, return
+ * KV_ERR_KEY_ALREADY_EXISTS
+ * @return KV_SUCCESS on success, KV_ERR_ABORTED if fill asked to stop,
+ * error code otherwise
+ */
+kv_result_t kv_engine_store_stream(kv_engine_t *engine, const void *key,
+                                   size_t key_len, size_t value_len,
+                                   kv_stream_fill_cb fill, void *user_data,
+                                   bool overwrite);
+
+/**
+ * Retrieve a value of any size, pushed to a callback
+ *
+ * A chunked value is read a few rows of chunks at a time and handed to
+ * deliver row by row, in order, so it never has to fit in memory at once;
+ * a plain value is delivered in one call. deliver runs on the calling
+ * thread while the key's lock stripe is held shared, so it must not store
+ * or delete keys.
+ *
+ * @param engine Engine handle
+ * @param key Key buffer
+ * @param key_len Key length
+ * @param deliver Receives the value
+ * @param user_data User context for deliver
+ * @param value_len Pointer to receive the total value length (may be NULL)
+ * @return KV_SUCCESS on success, KV_ERR_ABORTED if deliver asked to stop,
+ * error code otherwise
+ */
+kv_result_t kv_engine_retrieve_stream(kv_engine_t *engine, const void *key,
+                                      size_t key_len,
+                                      kv_stream_data_cb deliver,
+                                      void *user_data, size_t *value_len);
+
+/**
+ * Open a value for reading in pieces of the caller's choosing
+ *
+ * Meant for serving values to sockets with a fixed memory footprint per
+ * connection: the stream holds KV_STREAM_SEGMENTS buffers of
+ * config.stream_segment_size bytes and fills them with ranged reads
+ * (kvs_value.offset), keeping them in flight ahead of the reader, instead
+ * of reading the value whole. Ranges of a chunked value go to the devices
+ * of their chunks, and a range of a lost data chunk is rebuilt from
+ * parity. The stream holds no lock between calls: if the value is
+ * replaced or deleted meanwhile, reads fail with KV_ERR_KEY_NOT_FOUND once
+ * they notice, though a plain value replaced by one of the same size is
+ * read on from the new one. A stream is used by one thread at a time.
+ *
+ * @param engine Engine handle
+ * @param key Key buffer
+ * @param key_len Key length
+ * @param stream Pointer to receive the stream
+ * @param value_len Pointer to receive the value length (may be NULL)
+ * @return KV_SUCCESS on success, error code otherwise
+ */
+kv_result_t kv_engine_open_read_stream(kv_engine_t *engine, const void *key,
+                                       size_t key_len,
+                                       kv_read_stream_t **stream,
+                                       size_t *value_len);
+
+/**
+ * Read the next bytes of a stream's value
+ *
+ * Copies up to len bytes, waiting only for the segments they come from,
+ * and issues reads for the segments after them.
+ *
+ * @param stream Stream from kv_engine_open_read_stream
+ * @param buffer Where the bytes go (any alignment)
+ * @param len Bytes wanted
+ * @param bytes_read Pointer to receive the count copied; 0 at the end of
+ * the value
+ * @return KV_SUCCESS on success, error code otherwise (the bytes copied
+ * before the error are counted in bytes_read)
+ */
+kv_result_t kv_engine_stream_read(kv_read_stream_t *stream, void *buffer,
+                                  size_t len, size_t *bytes_read);
+
+/**
+ * Move a read stream to another position in its value
+ *
+ * Reads in flight are waited for and dropped. Clears an earlier read
+ * error, so a failed stream can be retried from where it failed.
+ *
+ * @param stream Stream from kv_engine_open_read_stream
+ * @param offset Where the next read starts, at most the value length
+ * @return KV_SUCCESS on success, KV_ERR_INVALID_PARAM past the end
+ */
+kv_result_t kv_engine_stream_seek(kv_read_stream_t *stream, uint64_t offset);
+
+/**
+ * Close a read stream, waiting for its reads in flight
+ *
+ * @param stream Stream from kv_engine_open_read_stream (NULL is safe)
+ */
+void kv_engine_close_read_stream(kv_read_stream_t *stream);
+
+/**
+ * Open a value of known length for writing in pieces
+ *
+ * A chunked value (see kv_engine_store_stream) is stored chunk by chunk as
+ * the pieces fill them, from four chunk buffers plus, when erasure coded,
+ * two rows' parity summed up as the chunks go by. The stream holds no lock
+ * between calls: its chunks go under keys no other store of the key uses
+ * while it is open, and close swaps them in for whatever value the key
+ * holds by then. A smaller value is gathered in one buffer and stored at
+ * close. Nothing is visible to readers until the stream is committed, and
+ * a stream that is not leaves no chunks behind and any previous value in
+ * place.
+ *
+ * @param engine Engine handle
+ * @param key Key buffer
+ * @param key_len Key length (4-255 bytes; at most 245 for values over 2MB)
+ * @param value_len Total value length
+ * @param overwrite If true, overwrite existing key; if false, fail with
+ * KV_ERR_KEY_ALREADY_EXISTS (at open for a chunked value, and at close)
+ * @param stream Pointer to receive the stream
+ * @return KV_SUCCESS on success, error code otherwise
+ */
+kv_result_t kv_engine_open_write_stream(kv_engine_t *engine, const void *key,
+                                        size_t key_len, size_t value_len,
+                                        bool overwrite,
+                                        kv_write_stream_t **stream);
+
+/**
+ * Append bytes to a stream's value
+ *
+ * @param stream Stream from kv_engine_open_write_stream
+ * @param data Bytes to write (any alignment)
+ * @param len Byte count; the stream takes no more than value_len in all
+ * @return KV_SUCCESS on success, error code otherwise; after a failure the
+ * stream can only be closed
+ */
+kv_result_t kv_engine_stream_write(kv_write_stream_t *stream, const void *data,
+                                   size_t len);
+
+/**
+ * Close a write stream, storing the value or discarding it
+ *
+ * @param stream Stream from kv_engine_open_write_stream (NULL is safe)
+ * @param commit If true, store the value, which must have been written
+ * whole; if false, discard it
+ * @return KV_SUCCESS if the value was stored, KV_ERR_ABORTED if it was
+ * discarded (or not written whole), error code otherwise
+ */
+kv_result_t kv_engine_close_write_stream(kv_write_stream_t *stream,
+                                         bool commit);
+
 /* ============================================================================
  * Asynchronous Operations
  * ============================================================================
@@ -274,6 +899,10 @@ kv_result_t kv_engine_delete_async(kv_engine_t *engine, const void *key,
 /**
  * Get current performance statistics
  *
+ * Operation counters are kept per thread and summed here; they stay zero
+ * when the engine was created with enable_stats = 0. Index and filter
+ * footprints are always reported.
+ *
  * @param engine Engine handle
  * @param stats Pointer to receive statistics
  * @return KV_SUCCESS on success, error code otherwise
@@ -287,6 +916,144 @@ kv_result_t kv_engine_get_stats(kv_engine_t *engine, kv_engine_stats_t *stats);
  */
 void kv_engine_reset_stats(kv_engine_t *engine);
 
+/**
+ * Get live queue depths, in-flight commands and pool occupancy
+ *
+ * Reads current state only (a few short locks, no device commands), so it
+ * is cheap enough to poll during an incident.
+ *
+ * @param engine Engine handle
+ * @param info   Pointer to receive the snapshot
+ * @return KV_SUCCESS on success, KV_ERR_INVALID_PARAM on bad arguments
+ */
+kv_result_t kv_engine_get_runtime_info(kv_engine_t *engine,
+                                       kv_runtime_info_t *info);
+
+/**
+ * Get latency percentiles per operation type and per device
+ *
+ * Histograms are recorded only when enable_stats = 1; otherwise the report
+ * is all zero. kv_engine_reset_stats clears them.
+ *
+ * @param engine Engine handle
+ * @param stats  Pointer to receive the report
+ * @return KV_SUCCESS on success, KV_ERR_INVALID_PARAM on bad arguments
+ */
+kv_result_t kv_engine_get_latency_stats(kv_engine_t *engine,
+                                        kv_latency_stats_t *stats);
+
+/**
+ * Get the per-phase breakdown of store and retrieve calls
+ *
+ * Recorded only when enable_phase_timing = 1; otherwise the report is all
+ * zero. kv_engine_reset_stats clears it.
+ *
+ * @param engine Engine handle
+ * @param stats  Pointer to receive the report
+ * @return KV_SUCCESS on success, KV_ERR_INVALID_PARAM on bad arguments
+ */
+kv_result_t kv_engine_get_phase_stats(kv_engine_t *engine,
+                                      kv_phase_stats_t *stats);
+
+/**
+ * Get the hottest keys and per-device load skew
+ *
+ * Requires hot_key_sample_interval > 0 for the key list; device rates and
+ * skew are always reported. A single key that dominates one device shows
+ * up as both a top entry here and a skew well above 1.
+ *
+ * @param engine Engine handle
+ * @param report Pointer to receive the report
+ * @return KV_SUCCESS on success, KV_ERR_INVALID_PARAM on bad arguments
+ */
+kv_result_t kv_engine_get_hot_keys(kv_engine_t *engine,
+                                   kv_hot_key_report_t *report);
+
+/**
+ * Get the most recent calls from the flight recorder
+ *
+ * Merges the per-thread rings and returns the newest max calls, oldest
+ * first. Requires flight_recorder_size > 0; otherwise *count is 0.
+ *
+ * @param engine  Engine handle
+ * @param records Array to receive the calls
+ * @param max     Capacity of records
+ * @param count   Receives the number of calls written
+ * @return KV_SUCCESS on success, KV_ERR_INVALID_PARAM on bad arguments,
+ *         KV_ERR_NO_MEMORY if the merge buffer can't be allocated
+ */
+kv_result_t kv_engine_get_recent_ops(kv_engine_t *engine,
+                                     kv_op_record_t *records, uint32_t max,
+                                     uint32_t *count);
+
+/**
+ * Get the calls that exceeded slow_op_threshold_us
+ *
+ * Returns up to max of the newest KV_SLOW_OP_LOG_SIZE slow calls, oldest
+ * first. Requires slow_op_threshold_us > 0; otherwise *count is 0.
+ *
+ * @param engine  Engine handle
+ * @param records Array to receive the calls
+ * @param max     Capacity of records
+ * @param count   Receives the number of calls written
+ * @return KV_SUCCESS on success, KV_ERR_INVALID_PARAM on bad arguments
+ */
+kv_result_t kv_engine_get_slow_ops(kv_engine_t *engine,
+                                   kv_op_record_t *records, uint32_t max,
+                                   uint32_t *count);
+
+/**
+ * Write the flight recorder and slow-op log as text
+ *
+ * One line per call with its start time, op, device, key hash, size,
+ * latency, device time and result. This is what dump_signal writes.
+ *
+ * @param engine Engine handle
+ * @param fd     File descriptor to write to
+ * @return KV_SUCCESS on success, KV_ERR_INVALID_PARAM on bad arguments,
+ *         KV_ERR_IO if the write fails
+ */
+kv_result_t kv_engine_dump_ops(kv_engine_t *engine, int fd);
+
+/**
+ * Render all engine metrics as OpenMetrics text
+ *
+ * Covers the kv_engine_get_stats counters, latency and phase histograms,
+ * memory/DMA pool occupancy, async queue depth and per-device health
+ * counters, ending with "# EOF". Only in-memory state is read, so this is
+ * safe to call at scrape frequency. The same text is served over HTTP when
+ * metrics_port is set.
+ *
+ * @param engine   Engine handle
+ * @param buf      Destination (may be NULL when buf_size is 0)
+ * @param buf_size Size of buf in bytes
+ * @param out_len  Receives the text length, excluding the terminating NUL
+ * @return KV_SUCCESS, or KV_ERR_NO_MEMORY if buf is too small (*out_len
+ *         then holds the length needed)
+ */
+kv_result_t kv_engine_export_metrics(kv_engine_t *engine, char *buf,
+                                     size_t buf_size, size_t *out_len);
+
+/**
+ * Get the key index recovery report from kv_engine_init
+ *
+ * @param engine Engine handle
+ * @param info   Pointer to receive the report
+ * @return KV_SUCCESS on success, KV_ERR_INVALID_PARAM on bad arguments
+ */
+kv_result_t kv_engine_get_recovery_info(kv_engine_t *engine,
+                                        kv_recovery_info_t *info);
+
+/**
+ * Get the time kv_engine_init spent in each phase of startup
+ *
+ * @param engine Engine handle
+ * @param timing Pointer to receive the breakdown
+ * @return KV_SUCCESS on success, KV_ERR_INVALID_PARAM on bad arguments
+ */
+kv_result_t kv_engine_get_init_timing(kv_engine_t *engine,
+                                      kv_init_timing_t *timing);
+
 /* ============================================================================
  * Health Monitoring
  * ============================================================================
@@ -295,8 +1062,9 @@ void kv_engine_reset_stats(kv_engine_t *engine);
 /**
  * Get a health snapshot for a single device
  *
- * Reads capacity and utilization from the Samsung KVS API and copies the
- * current atomic health counters into @p health.
+ * Copies the current atomic health counters and the latest cached
+ * capacity/utilization sample into @p health. No device command is
+ * issued, so this is cheap enough to poll.
  *
  * @param engine       Engine handle
  * @param device_index Index of the device (0 to num_devices-1)
@@ -307,6 +1075,26 @@ kv_result_t kv_engine_get_device_health(kv_engine_t *engine,
                                         uint32_t device_index,
                                         kv_device_health_t *health);
 
+/**
+ * Get the recent capacity/utilization samples of a device
+ *
+ * The health probe samples every device once per probe interval (5s) and
+ * keeps the last KV_TELEMETRY_HISTORY samples. Reading them never touches
+ * the device.
+ *
+ * @param engine       Engine handle
+ * @param device_index Index of the device (0 to num_devices-1)
+ * @param samples      Receives up to max_samples samples, oldest first
+ * @param max_samples  Capacity of samples
+ * @param count        Receives the number of samples written
+ * @return KV_SUCCESS, KV_ERR_INVALID_PARAM if device_index is out of range
+ */
+kv_result_t kv_engine_get_device_telemetry(kv_engine_t *engine,
+                                           uint32_t device_index,
+                                           kv_device_sample_t *samples,
+                                           uint32_t max_samples,
+                                           uint32_t *count);
+
 /**
  * Return the number of currently healthy devices
  *
@@ -321,32 +1109,39 @@ uint32_t kv_engine_healthy_device_count(kv_engine_t *engine);
 /**
  * Add a device to the engine (hot-add)
  *
- * ONLY valid before any keys have been written (write_ops == 0).
- * Changing the device count after writes corrupts hash-mod-N routing:
- * hash(key) % (N+1) produces a different index for ~80% of existing keys,
- * making that data appear missing.
- *
- * NOTE: if we wanted to support hot-add after writes, we would need to use a
- * different hash sharding scheme (e.g. consistent hashing) that doesn't change
- * existing key mappings when N changes, then migrate existing keys to their
- * new locations.
- *
- * @warning Not thread-safe. Call only from a single setup thread, before any
- *          concurrent kv_engine_store/retrieve/delete calls are issued. The
- *          internal write_ops==0 check is a best-effort misuse guard, not a
- *          synchronization barrier: a writer racing with this call may slip
- *          past the guard, and concurrent shard lookups may observe the
- *          num_devices increment before the new device slot is fully
- *          initialized. Treat this function as init-time configuration.
+ * Safe to call while other threads issue operations. Keys are placed by
+ * rendezvous hashing, so the new device takes over only the keys it now
+ * wins (about R/(N+1) of them with N existing devices of equal weight and R
+ * copies per key); every other key stays where it is. Its weight is
+ * config.device_weights[N] or derived as described there. A background
+ * thread moves the affected copies, throttled
+ * by config.migration_keys_per_sec, and until it finishes operations on a
+ * moving key check both its old and its new device, so no key is ever
+ * missing. Progress is reported by kv_engine_get_migration_status. A
+ * marker on every device lets an engine restarted mid-migration (with the
+ * new device in its device list) resume it at init.
  *
  * @param engine      Engine handle
  * @param device_path Path to the new NVMe KV device (e.g. "/dev/kvemul4")
- * @return KV_SUCCESS on success
- *         KV_ERR_INVALID_PARAM if called after writes have started,
- *           or if num_devices == KV_MAX_DEVICES
+ * @return KV_SUCCESS once the device is serving and the migration started
+ *         KV_ERR_BUSY if the previous migration hasn't finished
+ *         KV_ERR_INVALID_PARAM if every device slot (config.max_devices)
+ *         is in use
+ *         KV_ERR_IO if the migration markers, or a weight derived with
+ *         weight_by_capacity, can't be written
  */
 kv_result_t kv_engine_add_device(kv_engine_t *engine, const char *device_path);
 
+/**
+ * Get the progress of the migration started by kv_engine_add_device
+ *
+ * @param engine Engine handle
+ * @param status Output struct to populate
+ * @return KV_SUCCESS on success, KV_ERR_INVALID_PARAM on bad arguments
+ */
+kv_result_t kv_engine_get_migration_status(kv_engine_t *engine,
+                                           kv_migration_status_t *status);
+
 /* ============================================================================
  * Buffer Management
  * ============================================================================
@@ -369,4 +1164,41 @@ void *kv_engine_alloc_buffer(kv_engine_t *engine, size_t size);
  */
 void kv_engine_free_buffer(kv_engine_t *engine, void *buffer);
 
+/**
+ * Register long-lived application buffers (similar to io_uring fixed buffers)
+ *
+ * Values passed to kv_engine_store() that lie entirely inside a registered
+ * buffer are handed to the device directly, even if they are not DMA-aligned.
+ * Registration is the caller's promise that the memory is suitable for device
+ * I/O (e.g. pinned or hugepage-backed) and stays valid until it is
+ * unregistered. Unregistered, unaligned values are bounced through a pooled
+ * DMA staging buffer.
+ *
+ * May be called more than once; regions accumulate. Overlapping regions are
+ * rejected.
+ *
+ * @param engine  Engine handle
+ * @param buffers Array of buffer regions to register
+ * @param count   Number of entries in @p buffers
+ * @return KV_SUCCESS on success
+ *         KV_ERR_INVALID_PARAM if a region is empty, overlaps an existing
+ *           region, or the registration table is full (regions registered
+ *           before the failing entry stay registered)
+ */
+kv_result_t kv_engine_register_buffers(kv_engine_t *engine,
+                                       const kv_buffer_t *buffers,
+                                       uint32_t count);
+
+/**
+ * Unregister all buffers previously registered with
+ * kv_engine_register_buffers()
+ *
+ * @warning Stores that are in flight using a registered buffer must complete
+ *          before the buffer is freed by the caller.
+ *
+ * @param engine Engine handle
+ * @return KV_SUCCESS on success, KV_ERR_INVALID_PARAM if engine is invalid
+ */
+kv_result_t kv_engine_unregister_buffers(kv_engine_t *engine);
+
 #endif /* KV_ENGINE_H */
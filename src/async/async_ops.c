@@ -37,6 +37,8 @@ async_context_create(kv_engine_t *engine, async_op_type_t op_type,
   ctx->key_len = key_len;
   ctx->value_len = value_len;
   ctx->value_buffer = NULL;
+  ctx->submit_ns =
+      (engine->latency || engine->phase_timing) ? kv_now_ns() : 0;
 
   /* Copy key data — caller's buffer may go out of scope */
   ctx->key_buffer = malloc(key_len);
@@ -46,9 +48,11 @@ async_context_create(kv_engine_t *engine, async_op_type_t op_type,
   }
   memcpy(ctx->key_buffer, key, key_len);
 
-  /* Copy value data for store operations */
+  /* Copy value data for store operations. The copy is DMA-aligned so the
+   * worker's kv_engine_store() hands it to the device without a second
+   * bounce copy. */
   if (value && value_len > 0) {
-    ctx->value_buffer = malloc(value_len);
+    ctx->value_buffer = dma_alloc(value_len);
     if (!ctx->value_buffer) {
       free(ctx->key_buffer);
       free(ctx);
@@ -66,15 +70,40 @@ static void async_context_free(void *arg) {
     return;
   }
   free(ctx->key_buffer);
-  free(ctx->value_buffer);
+  dma_free(ctx->value_buffer);
   free(ctx);
 }
 
 /* Worker function executed on a thread pool thread */
+/* async_op_type_t and kv_op_type_t list store, retrieve, delete in the same
+ * order, so the async op type indexes the latency histograms directly */
+_Static_assert(ASYNC_OP_STORE == (int)KV_OP_STORE &&
+                   ASYNC_OP_RETRIEVE == (int)KV_OP_RETRIEVE &&
+                   ASYNC_OP_DELETE == (int)KV_OP_DELETE,
+               "async op types must match kv_op_type_t");
+static void record_async_latency(async_context_t *ctx,
+                                 latency_histogram_t *hists) {
+  if (ctx->submit_ns) {
+    latency_histogram_record(&hists[ctx->op_type],
+                             kv_now_ns() - ctx->submit_ns);
+  }
+}
+
 static void *async_worker_func(void *arg) {
   async_context_t *ctx = (async_context_t *)arg;
+  kv_latency_hists_t *latency = ctx->engine->latency;
+  kv_phase_hists_t *phase_timing = ctx->engine->phase_timing;
   kv_result_t result;
 
+  if (latency) {
+    record_async_latency(ctx, latency->queue_wait);
+  }
+  if (phase_timing) {
+    latency_histogram_record(
+        &phase_timing->phase[ctx->op_type][KV_PHASE_QUEUE_WAIT],
+        kv_now_ns() - ctx->submit_ns);
+  }
+
   switch (ctx->op_type) {
   case ASYNC_OP_STORE:
     result = kv_engine_store(ctx->engine, ctx->key_buffer, ctx->key_len,
@@ -86,6 +115,9 @@ static void *async_worker_func(void *arg) {
     size_t value_len = 0;
     result = kv_engine_retrieve(ctx->engine, ctx->key_buffer, ctx->key_len,
                                 &value, &value_len, false);
+    if (latency) {
+      record_async_latency(ctx, latency->async_total);
+    }
     if (ctx->retrieve_callback) {
       ctx->retrieve_callback(result, value, value_len, ctx->user_data);
     }
@@ -103,6 +135,10 @@ static void *async_worker_func(void *arg) {
     break;
   }
 
+  if (latency) {
+    record_async_latency(ctx, latency->async_total);
+  }
+
   /* Invoke completion callback */
   if (ctx->callback) {
     ctx->callback(result, ctx->user_data);
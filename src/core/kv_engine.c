@@ -6,6 +6,7 @@
 #include "../utils/dma_alloc.h"
 #include "kv_engine_internal.h"
 #include "kvs_result.h"
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -15,7 +16,7 @@
  * ============================================================================
  */
 
-static kv_result_t map_kvs_result(kvs_result kvs_res) {
+kv_result_t map_kvs_result(kvs_result kvs_res) {
   switch (kvs_res) {
   case KVS_SUCCESS:
     return KV_SUCCESS;
@@ -75,7 +76,7 @@ static kv_result_t map_kvs_result(kvs_result kvs_res) {
 /* Returns true if kvs_res indicates a hardware/device-level fault rather
  * than an application-level error (e.g. key not found, duplicate key).
  * Only device errors count toward the health degradation threshold. */
-static bool is_device_error(kvs_result kvs_res) {
+bool is_device_error(kvs_result kvs_res) {
   switch (kvs_res) {
   case KVS_ERR_SYS_IO:
   case KVS_ERR_DEV_NOT_EXIST:
@@ -102,7 +103,7 @@ static kv_result_t check_device_health(kv_device_ctx_t *ctx) {
  * counters. Device-level errors increment consecutive_errors and may mark
  * the device unhealthy. Application-level errors reset consecutive_errors
  * since a valid response proves the device is alive. */
-static void device_record_result(kv_device_ctx_t *ctx, kvs_result kvs_res) {
+void device_record_result(kv_device_ctx_t *ctx, kvs_result kvs_res) {
   atomic_fetch_add(&ctx->total_ops, 1);
 
   if (is_device_error(kvs_res)) {
@@ -123,23 +124,67 @@ static void device_record_result(kv_device_ctx_t *ctx, kvs_result kvs_res) {
   }
 }
 
+void kv_device_async_cmd_end(kv_engine_t *engine, uint32_t dev_idx,
+                             kv_op_type_t op, uint64_t start_ns,
+                             kvs_result kvs_res) {
+  kv_device_ctx_t *dev = &engine->devices[dev_idx];
+  if (start_ns) {
+    uint64_t elapsed = kv_now_ns() - start_ns;
+    if (engine->latency) {
+      latency_histogram_record(&engine->latency->device[dev_idx][op], elapsed);
+    }
+    if (dev->cmd_latency) {
+      latency_histogram_record(dev->cmd_latency, elapsed);
+    }
+    if (op == KV_OP_RETRIEVE && dev->read_latency) {
+      kv_engine_note_read_latency(engine, dev_idx, elapsed);
+    }
+  }
+  atomic_fetch_sub_explicit(&dev->in_flight, 1, memory_order_relaxed);
+  device_record_result(dev, kvs_res);
+}
+
 /* ============================================================================
  * Lifecycle Management
  * ============================================================================
  */
 
+/* Latency tracking for hedged reads and slow-device detection on the
+ * devices opened at init */
+static kv_result_t track_latency(kv_engine_t *engine) {
+  for (uint32_t i = 0; i < engine->num_devices; i++) {
+    kv_result_t res = kv_engine_track_latency(engine, i);
+    if (res != KV_SUCCESS) {
+      return res;
+    }
+  }
+  return KV_SUCCESS;
+}
+
+/* Microseconds since *mark, which moves on to now: one phase of init */
+static uint64_t phase_us(uint64_t *mark) {
+  uint64_t now = kv_now_ns();
+  uint64_t us = (now - *mark) / 1000;
+  *mark = now;
+  return us;
+}
+
 kv_result_t kv_engine_init(kv_engine_t **engine,
                            const kv_engine_config_t *config) {
-  if (!engine || !config) {
+  if (!engine || !config || config->hedge_percentile > 99) {
     return KV_ERR_INVALID_PARAM;
   }
 
   /* Allocate engine structure */
-  kv_engine_t *eng = (kv_engine_t *)malloc(sizeof(kv_engine_t));
-  if (!eng) {
+  /* Cache-line aligned: the key index stripes are padded to 64 bytes */
+  kv_engine_t *eng = NULL;
+  if (posix_memalign((void **)&eng, 64, sizeof(kv_engine_t)) != 0) {
     return KV_ERR_NO_MEMORY;
   }
   memset(eng, 0, sizeof(kv_engine_t));
+  pthread_mutex_init(&eng->generation_mutex, NULL);
+  uint64_t init_start = kv_now_ns();
+  uint64_t mark = init_start;
 
   /* Copy configuration */
   eng->config = *config;
@@ -149,6 +194,12 @@ kv_result_t kv_engine_init(kv_engine_t **engine,
   if (config->emul_config_file) {
     eng->config.emul_config_file = strdup(config->emul_config_file);
   }
+  if (config->index_snapshot_path) {
+    eng->config.index_snapshot_path = strdup(config->index_snapshot_path);
+  }
+  if (config->dump_path) {
+    eng->config.dump_path = strdup(config->dump_path);
+  }
 
   /* Resolve device paths (single or multi-device) */
   const char *effective_paths[KV_MAX_DEVICES];
@@ -156,22 +207,68 @@ kv_result_t kv_engine_init(kv_engine_t **engine,
   kv_result_t res =
       kv_engine_resolve_device_paths(config, effective_paths, &effective_count);
   if (res != KV_SUCCESS) {
-    free(eng);
-    return res;
+    goto fail;
   }
 
-  /* Open all devices */
-  for (uint32_t i = 0; i < effective_count; i++) {
-    res = kv_engine_open_device(&eng->devices[i], effective_paths[i], i);
-    if (res != KV_SUCCESS) {
-      for (uint32_t j = 0; j < i; j++) {
-        kv_engine_close_device(&eng->devices[j]);
-      }
-      free(eng);
-      return res;
-    }
-    eng->num_devices++;
+  /* Room in the device table for the devices given and later adds */
+  uint32_t slots = config->max_devices;
+  if (slots == 0) {
+    slots = effective_count > KV_DEFAULT_DEVICE_SLOTS ? effective_count
+                                                      : KV_DEFAULT_DEVICE_SLOTS;
+  }
+  if (slots < effective_count || slots > KV_MAX_DEVICES) {
+    res = KV_ERR_INVALID_PARAM;
+    goto fail;
+  }
+
+  /* Erasure coding puts every chunk of a value on a different device */
+  uint32_t chunks = config->erasure_data_chunks + config->erasure_parity_chunks;
+  if (config->erasure_min_value_size &&
+      (config->erasure_data_chunks == 0 || chunks < 2 ||
+       chunks > effective_count || chunks > KV_STRIPE_MAX_CHUNKS)) {
+    res = KV_ERR_INVALID_PARAM;
+    goto fail;
+  }
+
+  /* Stripe units are whole DMA blocks that fit one device value */
+  size_t stripe_unit = config->stripe_unit_size ? config->stripe_unit_size
+                                                : KV_STRIPE_DEFAULT_UNIT;
+  stripe_unit = (stripe_unit + DMA_ALIGNMENT - 1) &
+                ~(size_t)(DMA_ALIGNMENT - 1);
+  if (stripe_unit > KV_ENGINE_RETRIEVE_SIZE) {
+    res = KV_ERR_INVALID_PARAM;
+    goto fail;
+  }
+  eng->config.stripe_unit_size = (uint32_t)stripe_unit;
+
+  /* Stream segments are ranged reads at 512-byte aligned offsets */
+  size_t segment = config->stream_segment_size ? config->stream_segment_size
+                                               : KV_STRIPE_DEFAULT_UNIT;
+  segment = (segment + DMA_ALIGNMENT - 1) & ~(size_t)(DMA_ALIGNMENT - 1);
+  if (segment > KV_ENGINE_RETRIEVE_SIZE) {
+    res = KV_ERR_INVALID_PARAM;
+    goto fail;
+  }
+  eng->config.stream_segment_size = (uint32_t)segment;
+
+  eng->devices = aligned_alloc(64, sizeof(kv_device_ctx_t) * slots);
+  if (!eng->devices) {
+    res = KV_ERR_NO_MEMORY;
+    goto fail;
+  }
+  memset(eng->devices, 0, sizeof(kv_device_ctx_t) * slots);
+  eng->device_slots = slots;
+
+  /* Open all devices at once: startup waits for the slowest open rather
+   * than the sum of them */
+  uint64_t slowest_open_ns = 0;
+  res = kv_engine_open_devices(eng, effective_paths, effective_count,
+                               &slowest_open_ns);
+  if (res != KV_SUCCESS) {
+    goto fail;
   }
+  eng->init_timing.devices_us = phase_us(&mark);
+  eng->init_timing.slowest_device_us = slowest_open_ns / 1000;
 
   /* Initialize memory pool */
   size_t pool_size = config->memory_pool_size > 0
@@ -182,8 +279,8 @@ kv_result_t kv_engine_init(kv_engine_t **engine,
     for (uint32_t i = 0; i < eng->num_devices; i++) {
       kv_engine_close_device(&eng->devices[i]);
     }
-    free(eng);
-    return KV_ERR_NO_MEMORY;
+    res = KV_ERR_NO_MEMORY;
+    goto fail;
   }
 
   /* Initialize thread pool for async ops */
@@ -195,28 +292,66 @@ kv_result_t kv_engine_init(kv_engine_t **engine,
       for (uint32_t i = 0; i < eng->num_devices; i++) {
         kv_engine_close_device(&eng->devices[i]);
       }
-      free(eng);
-      return KV_ERR_NO_MEMORY;
+      res = KV_ERR_NO_MEMORY;
+      goto fail;
     }
   }
 
-  /* Initialize statistics */
-  pthread_mutex_init(&eng->stats_lock, NULL);
-  memset(&eng->stats, 0, sizeof(kv_engine_stats_t));
+  /* Initialize statistics: one cache-line padded counter block per thread
+   * slot plus latency histograms, none at all when stats are disabled */
+  if (config->enable_stats) {
+    eng->stats_slots =
+        aligned_alloc(64, sizeof(kv_stats_slot_t) * KV_STATS_SLOTS);
+    if (eng->stats_slots) {
+      memset(eng->stats_slots, 0, sizeof(kv_stats_slot_t) * KV_STATS_SLOTS);
+    }
+    eng->latency = calloc(1, sizeof(kv_latency_hists_t) +
+                                 slots * sizeof(eng->latency->device[0]));
+  }
+  if (config->enable_phase_timing) {
+    eng->phase_timing = calloc(1, sizeof(kv_phase_hists_t));
+  }
 
-  /* Initialize DMA buffer pool (optional, 0 disables it) */
+  /* Initialize DMA buffer pool (optional, 0 disables it); with lazy_pools
+   * its buffers are allocated as ops first need them */
+  dma_pool_t *(*create_pool)(size_t, size_t) =
+      config->lazy_pools ? dma_pool_create_lazy : dma_pool_create;
   eng->buffer_pool = NULL;
   if (config->dma_pool_count > 0) {
     eng->buffer_pool =
-        dma_pool_create(KV_ENGINE_RETRIEVE_SIZE, config->dma_pool_count);
+        create_pool(KV_ENGINE_RETRIEVE_SIZE, config->dma_pool_count);
     /* Non-fatal: engine continues without pooling if creation fails */
   }
-
-  /* Initialize hash table */
-  if (create_table(&eng->key_table) != 0) {
+  eng->stream_pool = NULL;
+  if (config->stream_pool_count > 0) {
+    eng->stream_pool = create_pool(eng->config.stream_segment_size,
+                                   config->stream_pool_count);
+  }
+  eng->init_timing.pools_us = phase_us(&mark);
+
+  /* Initialize registered buffer table and hash table */
+  eng->registered_buffers = buffer_registry_create();
+  if (!eng->registered_buffers || create_table(&eng->key_table) != 0 ||
+      create_table(&eng->striped_keys) != 0 ||
+      kv_engine_hot_keys_init(eng) != KV_SUCCESS ||
+      kv_engine_recorder_init(eng) != KV_SUCCESS ||
+      kv_engine_migration_init(eng) != KV_SUCCESS ||
+      track_latency(eng) != KV_SUCCESS ||
+      (config->enable_stats && (!eng->stats_slots || !eng->latency)) ||
+      (config->enable_phase_timing && !eng->phase_timing)) {
+    buffer_registry_destroy(eng->registered_buffers);
+    kv_engine_hot_keys_destroy(eng);
+    kv_engine_recorder_destroy(eng);
+    kv_engine_migration_destroy(eng);
+    free(eng->stats_slots);
+    free(eng->latency);
+    free(eng->phase_timing);
     if (eng->buffer_pool) {
       dma_pool_destroy(eng->buffer_pool);
     }
+    if (eng->stream_pool) {
+      dma_pool_destroy(eng->stream_pool);
+    }
     if (eng->workers) {
       thread_pool_destroy(eng->workers);
     }
@@ -224,11 +359,47 @@ kv_result_t kv_engine_init(kv_engine_t **engine,
     for (uint32_t i = 0; i < eng->num_devices; i++) {
       kv_engine_close_device(&eng->devices[i]);
     }
-    free((void *)eng->config.device_path);
-    free((void *)eng->config.emul_config_file);
-    pthread_mutex_destroy(&eng->stats_lock);
-    free(eng);
-    return KV_ERR_NO_MEMORY;
+    res = KV_ERR_NO_MEMORY;
+    goto fail;
+  }
+  eng->init_timing.state_us = phase_us(&mark);
+
+  /* Rebuild the key index from a snapshot or a device scan. Called even
+   * with recover_index = 0, to retire the markers of an earlier snapshot.
+   * Non-fatal: on failure the index only reflects keys written by this
+   * process. */
+  if (kv_engine_recover_index(eng) != KV_SUCCESS) {
+    fprintf(stderr, "[kv_engine] warning: key index recovery incomplete; "
+                    "keys from earlier runs may not be visible\n");
+  }
+
+  /* Find values earlier runs stored in chunks: only these keys' values
+   * are read as manifests, and overwriting or deleting them removes the
+   * chunks. Non-fatal: a striped key that was missed reads back as its
+   * manifest and leaves its chunks behind when replaced. */
+  if (kv_engine_stripe_init(eng) != KV_SUCCESS) {
+    fprintf(stderr, "[kv_engine] warning: chunk key scan incomplete; "
+                    "striped values of earlier runs may read back as "
+                    "their manifests\n");
+  }
+  eng->init_timing.recovery_us = phase_us(&mark);
+
+  /* Build per-device negative lookup filters from the recovered index.
+   * Non-fatal: without them every lookup simply goes to the device. */
+  if (kv_engine_filter_init(eng) != KV_SUCCESS) {
+    fprintf(stderr, "[kv_engine] warning: bloom filter allocation failed; "
+                    "some devices run without a filter\n");
+  }
+  eng->init_timing.filters_us = phase_us(&mark);
+
+  if (config->index_authoritative) {
+    if (eng->index_complete) {
+      eng->index_authoritative = true;
+    } else {
+      fprintf(stderr, "[kv_engine] warning: index_authoritative needs a "
+                      "complete key index (recover_index = 1); exists will "
+                      "query the device\n");
+    }
   }
 
   /* Start background health probe thread. Best-effort: a failure here means
@@ -240,10 +411,52 @@ kv_result_t kv_engine_init(kv_engine_t **engine,
                     "automatic device recovery is disabled\n");
   }
 
+  /* Finish a migration interrupted by the previous shutdown */
+  kv_engine_migration_resume(eng);
+
   eng->initialized = 1;
+
+  /* Serve metrics only once the engine is fully usable. Best-effort like
+   * the probe: without it metrics are still available via the API. */
+  if (config->metrics_port > 0) {
+    eng->metrics_server =
+        config->metrics_port <= 65535
+            ? metrics_server_create(eng, (uint16_t)config->metrics_port)
+            : NULL;
+    if (!eng->metrics_server) {
+      fprintf(stderr,
+              "[kv_engine] warning: metrics listener could not bind "
+              "127.0.0.1:%u; use kv_engine_export_metrics instead\n",
+              config->metrics_port);
+    }
+  }
+  eng->init_timing.background_us = phase_us(&mark);
+  eng->init_timing.total_us = (kv_now_ns() - init_start) / 1000;
+
   *engine = eng;
 
   return KV_SUCCESS;
+
+fail:
+  /* Every failure lands here once what it set up is torn down; the
+   * configuration strings and device table are all that remain */
+  free((void *)eng->config.device_path);
+  free((void *)eng->config.emul_config_file);
+  free((void *)eng->config.index_snapshot_path);
+  free((void *)eng->config.dump_path);
+  pthread_mutex_destroy(&eng->generation_mutex);
+  free(eng->devices);
+  free(eng);
+  return res;
+}
+
+kv_result_t kv_engine_get_init_timing(kv_engine_t *engine,
+                                      kv_init_timing_t *timing) {
+  if (!engine || !engine->initialized || !timing) {
+    return KV_ERR_INVALID_PARAM;
+  }
+  *timing = engine->init_timing;
+  return KV_SUCCESS;
 }
 
 void kv_engine_cleanup(kv_engine_t *engine) {
@@ -251,18 +464,47 @@ void kv_engine_cleanup(kv_engine_t *engine) {
     return;
   }
 
+  /* Stop serving scrapes before tearing anything down */
+  metrics_server_destroy(engine->metrics_server);
+
+  /* Stop moving keys; an unfinished migration resumes at the next init */
+  kv_engine_migration_destroy(engine);
+
   /* Stop health probe thread before closing devices */
   health_probe_destroy(engine->health_probe);
 
+  /* Filters are only rebuilt by the probe thread, so it's safe to free */
+  kv_engine_filter_destroy(engine);
+  kv_engine_hot_keys_destroy(engine);
+
   /* Shutdown thread pool */
   if (engine->workers) {
     thread_pool_destroy(engine->workers);
   }
 
+  /* After the workers: their ops are recorded too */
+  kv_engine_recorder_destroy(engine);
+
+  /* Losing hedge reads release their buffers into the DMA pool, and
+   * abandoned chunk reads free theirs */
+  while (atomic_load_explicit(&engine->async_cmds_outstanding,
+                              memory_order_acquire) > 0) {
+    struct timespec pause = {.tv_sec = 0, .tv_nsec = 100000};
+    nanosleep(&pause, NULL);
+  }
+
   /* Cleanup DMA buffer pool */
   if (engine->buffer_pool) {
     dma_pool_destroy(engine->buffer_pool);
   }
+  if (engine->stream_pool) {
+    dma_pool_destroy(engine->stream_pool);
+  }
+
+  buffer_registry_destroy(engine->registered_buffers);
+
+  /* Persist the key index while the devices are still open */
+  kv_engine_save_index_snapshot(engine);
 
   /* Cleanup memory pool */
   if (engine->mem_pool) {
@@ -275,6 +517,8 @@ void kv_engine_cleanup(kv_engine_t *engine) {
   }
 
   free_table(&engine->key_table);
+  free_table(&engine->striped_keys);
+  pthread_mutex_destroy(&engine->generation_mutex);
 
   /* Free config strings */
   if (engine->config.device_path) {
@@ -283,9 +527,17 @@ void kv_engine_cleanup(kv_engine_t *engine) {
   if (engine->config.emul_config_file) {
     free((void *)engine->config.emul_config_file);
   }
+  if (engine->config.index_snapshot_path) {
+    free((void *)engine->config.index_snapshot_path);
+  }
+  if (engine->config.dump_path) {
+    free((void *)engine->config.dump_path);
+  }
 
-  pthread_mutex_destroy(&engine->stats_lock);
-  pthread_mutex_destroy(&engine->hash_lock);
+  free(engine->stats_slots);
+  free(engine->latency);
+  free(engine->phase_timing);
+  free(engine->devices);
   free(engine);
 }
 
@@ -294,26 +546,276 @@ void kv_engine_cleanup(kv_engine_t *engine) {
  * ============================================================================
  */
 
-kv_result_t kv_engine_store(kv_engine_t *engine, const void *key,
-                            size_t key_len, const void *value, size_t value_len,
-                            bool overwrite) {
+/* Deletes key from one device; absent keys are not an error */
+static kvs_result delete_on_device(kv_engine_t *engine, uint32_t dev_idx,
+                                   const void *key, size_t key_len) {
+  kvs_key kv_key;
+  kv_key.key = (void *)key;
+  kv_key.length = key_len;
 
-  if (!engine || !engine->initialized || !key || !value) {
-    return KV_ERR_INVALID_PARAM;
+  kvs_option_delete option;
+  option.kvs_delete_error = false;
+  uint64_t device_start = kv_device_cmd_begin(engine, dev_idx);
+  kvs_result kvs_res =
+      kvs_delete_kvp(engine->devices[dev_idx].keyspace, &kv_key, &option);
+  kv_device_cmd_end(engine, dev_idx, KV_OP_DELETE, device_start);
+
+  device_record_result(&engine->devices[dev_idx], kvs_res);
+  return kvs_res;
+}
+
+/* Deletes every copy of key, including a moving key's copy on the
+ * dropped device; the first failure, if any copy couldn't be deleted */
+static kvs_result delete_copies(kv_engine_t *engine,
+                                const kv_placement_t *placement,
+                                const void *key, size_t key_len) {
+  kvs_result kvs_res = KVS_SUCCESS;
+  for (uint32_t i = 0; i <= placement->count; i++) {
+    uint32_t dev_idx =
+        i < placement->count ? placement->dev[i] : placement->dropped;
+    if (dev_idx == KV_NO_DEVICE) {
+      continue;
+    }
+    kvs_result dev_res = delete_on_device(engine, dev_idx, key, key_len);
+    if (dev_res == KVS_SUCCESS) {
+      kv_engine_filter_note_delete(engine, dev_idx);
+    } else if (kvs_res == KVS_SUCCESS) {
+      kvs_res = dev_res;
+    }
   }
+  return kvs_res;
+}
 
-  if (key_len < 4 || key_len > 255) {
-    return KV_ERR_INVALID_PARAM;
+/* Asks the device whether key exists */
+static kv_result_t exists_on_device(kv_engine_t *engine, uint32_t dev_idx,
+                                    const void *key, size_t key_len,
+                                    int *exists) {
+  kvs_key kv_key;
+  kv_key.key = (void *)key;
+  kv_key.length = key_len;
+
+  uint8_t result_buffer;
+  kvs_exist_list exist_list;
+  exist_list.num_keys = 1;
+  exist_list.keys = &kv_key;
+  exist_list.length = 1;
+  exist_list.result_buffer = &result_buffer;
+
+  uint64_t device_start = kv_device_cmd_begin(engine, dev_idx);
+  kvs_result kvs_res = kvs_exist_kv_pairs(engine->devices[dev_idx].keyspace,
+                                          1, &kv_key, &exist_list);
+  kv_device_cmd_end(engine, dev_idx, KV_OP_EXISTS, device_start);
+
+  device_record_result(&engine->devices[dev_idx], kvs_res);
+
+  if (kvs_res != KVS_SUCCESS) {
+    return map_kvs_result(kvs_res);
   }
 
-  /* Shard key to a device */
-  uint32_t dev_idx = kv_engine_shard_for_key(key, key_len, engine->num_devices);
-  kvs_key_space_handle keyspace = engine->devices[dev_idx].keyspace;
+  *exists = result_buffer != 0;
+  return KV_SUCCESS;
+}
 
-  /* Refuse operation if device is unhealthy */
-  kv_result_t health = check_device_health(&engine->devices[dev_idx]);
-  if (health != KV_SUCCESS) {
-    return health;
+/* Read order for a key: its healthy replicas, starting with the one with
+ * the fewest device commands in flight, then those on devices flagged
+ * slow, then (for a moving key) the device giving up its copy. Returns how
+ * many; 0 if none of them is healthy. */
+static uint32_t read_order(kv_engine_t *engine,
+                           const kv_placement_t *placement, uint32_t *order) {
+  uint32_t count = 0;
+  uint32_t best = 0;
+  uint32_t best_load = UINT32_MAX;
+  uint32_t slow[KV_MAX_DEVICES];
+  uint32_t slow_count = 0;
+  for (uint32_t i = 0; i < placement->count; i++) {
+    uint32_t dev_idx = placement->dev[i];
+    if (check_device_health(&engine->devices[dev_idx]) != KV_SUCCESS) {
+      continue;
+    }
+    if (atomic_load_explicit(&engine->devices[dev_idx].slow,
+                             memory_order_relaxed)) {
+      slow[slow_count++] = dev_idx;
+      continue;
+    }
+    uint32_t load = atomic_load_explicit(&engine->devices[dev_idx].in_flight,
+                                         memory_order_relaxed);
+    if (load < best_load) {
+      best = count;
+      best_load = load;
+    }
+    order[count++] = dev_idx;
+  }
+  if (count > 1) {
+    uint32_t first = order[0];
+    order[0] = order[best];
+    order[best] = first;
+  }
+  for (uint32_t i = 0; i < slow_count; i++) {
+    order[count++] = slow[i];
+  }
+  if (placement->dropped != KV_NO_DEVICE &&
+      check_device_health(&engine->devices[placement->dropped]) ==
+          KV_SUCCESS) {
+    order[count++] = placement->dropped;
+  }
+  return count;
+}
+
+/* Devices a key may be on, counting a moving key's dropped device */
+static uint32_t placement_devices(const kv_placement_t *placement) {
+  return placement->count + (placement->dropped != KV_NO_DEVICE);
+}
+
+/* Writes and deletes reach every copy, so all of the key's devices must be
+ * healthy; skipping one would leave it a stale copy to serve later */
+static kv_result_t check_placement_health(kv_engine_t *engine,
+                                          const kv_placement_t *placement) {
+  for (uint32_t i = 0; i < placement->count; i++) {
+    kv_result_t res =
+        check_device_health(&engine->devices[placement->dev[i]]);
+    if (res != KV_SUCCESS) {
+      return res;
+    }
+  }
+  if (placement->dropped != KV_NO_DEVICE) {
+    return check_device_health(&engine->devices[placement->dropped]);
+  }
+  return KV_SUCCESS;
+}
+
+/* Existence on the first device of order that answers. A moving key not
+ * found on one device may still be on the next, or on one skipped as
+ * unhealthy. */
+static kv_result_t exists_placed(kv_engine_t *engine,
+                                 const kv_placement_t *placement,
+                                 const uint32_t *order, uint32_t count,
+                                 const void *key, size_t key_len,
+                                 int *exists) {
+  kv_result_t res = KV_ERR_DEVICE_DEGRADED;
+  for (uint32_t i = 0; i < count; i++) {
+    res = exists_on_device(engine, order[i], key, key_len, exists);
+    if (res == KV_SUCCESS && (*exists || !placement->moving)) {
+      return res;
+    }
+  }
+  if (res == KV_SUCCESS && count < placement_devices(placement)) {
+    return KV_ERR_DEVICE_DEGRADED;
+  }
+  return res;
+}
+
+/* The stores of a value's copies issued at once. The caller waits for
+ * every one of them, so this lives on its stack. */
+typedef struct {
+  kv_engine_t *engine;
+  const kv_placement_t *placement;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  uint32_t pending;
+  uint64_t start_ns[KV_MAX_DEVICES];
+  kvs_result *result; /* per replica */
+} copy_stores_t;
+
+/* Completion of a copy's store, on the device's completion thread */
+static void copy_store_done(kvs_postprocess_context *ctx) {
+  copy_stores_t *stores = (copy_stores_t *)ctx->private1;
+  kvs_result *result = (kvs_result *)ctx->private2;
+  kv_engine_t *engine = stores->engine;
+  uint32_t i = (uint32_t)(result - stores->result);
+  kv_device_async_cmd_end(engine, stores->placement->dev[i], KV_OP_STORE,
+                          stores->start_ns[i], ctx->result);
+
+  pthread_mutex_lock(&stores->mutex);
+  *result = ctx->result;
+  stores->pending--;
+  pthread_cond_signal(&stores->cond);
+  pthread_mutex_unlock(&stores->mutex);
+  atomic_fetch_sub_explicit(&engine->async_cmds_outstanding, 1,
+                            memory_order_release);
+}
+
+/* Stores replicas [first, end) of a placement with the async kvs calls,
+ * all at once, and waits for them; result[i] gets replica i's outcome. A
+ * lone replica is stored with the blocking call. */
+static void store_copies(kv_engine_t *engine, const kv_placement_t *placement,
+                         uint32_t first, uint32_t end, kvs_key *kv_key,
+                         kvs_value *kv_value, kvs_option_store *option,
+                         kvs_result *result) {
+  if (end - first == 1) {
+    uint32_t dev_idx = placement->dev[first];
+    uint64_t device_start = kv_device_cmd_begin(engine, dev_idx);
+    result[first] = kvs_store_kvp(engine->devices[dev_idx].keyspace, kv_key,
+                                  kv_value, option);
+    kv_device_cmd_end(engine, dev_idx, KV_OP_STORE, device_start);
+    device_record_result(&engine->devices[dev_idx], result[first]);
+    return;
+  }
+
+  copy_stores_t stores = {.engine = engine, .placement = placement,
+                          .result = result};
+  pthread_mutex_init(&stores.mutex, NULL);
+  pthread_cond_init(&stores.cond, NULL);
+  for (uint32_t i = first; i < end; i++) {
+    uint32_t dev_idx = placement->dev[i];
+    pthread_mutex_lock(&stores.mutex);
+    stores.pending++;
+    pthread_mutex_unlock(&stores.mutex);
+    atomic_fetch_add_explicit(&engine->async_cmds_outstanding, 1,
+                              memory_order_relaxed);
+    stores.start_ns[i] = kv_device_cmd_begin(engine, dev_idx);
+
+    kvs_result res = kvs_store_kvp_async(engine->devices[dev_idx].keyspace,
+                                         kv_key, kv_value, option, &stores,
+                                         &result[i], copy_store_done);
+    if (res == KVS_SUCCESS) {
+      continue;
+    }
+    /* refused: completes here */
+    atomic_fetch_sub_explicit(&engine->devices[dev_idx].in_flight, 1,
+                              memory_order_relaxed);
+    atomic_fetch_sub_explicit(&engine->async_cmds_outstanding, 1,
+                              memory_order_relaxed);
+    device_record_result(&engine->devices[dev_idx], res);
+    pthread_mutex_lock(&stores.mutex);
+    result[i] = res;
+    stores.pending--;
+    pthread_mutex_unlock(&stores.mutex);
+  }
+
+  pthread_mutex_lock(&stores.mutex);
+  while (stores.pending > 0) {
+    pthread_cond_wait(&stores.cond, &stores.mutex);
+  }
+  pthread_mutex_unlock(&stores.mutex);
+  pthread_mutex_destroy(&stores.mutex);
+  pthread_cond_destroy(&stores.cond);
+}
+
+/* Stores every replica at once. A no-overwrite store writes the best one
+ * first, so concurrent no-overwrite stores of a key race on the same
+ * device, then the rest. A copy that fails must not leave reads seeing two
+ * versions: a no-overwrite store deletes the copies it wrote, and an
+ * overwrite marks the devices that kept the old value unhealthy, so reads
+ * skip them until the health probe brings them back. A moving key (stripe
+ * lock held shared) may not be on the added device yet, so a no-overwrite
+ * store checks all its devices first, and the copy on the dropped device
+ * is deleted once the new ones are written. */
+static kv_result_t store_placed(kv_engine_t *engine,
+                                const kv_placement_t *placement,
+                                const void *key, size_t key_len,
+                                uint32_t key_hash, const void *value,
+                                size_t value_len, bool overwrite,
+                                kv_phase_timer_t *phases) {
+  if (placement->moving && !overwrite) {
+    uint32_t order[KV_MAX_DEVICES + 1];
+    uint32_t count = read_order(engine, placement, order);
+    int moving_copy = 0;
+    kv_result_t res = exists_placed(engine, placement, order, count, key,
+                                    key_len, &moving_copy);
+    if (res != KV_SUCCESS || moving_copy) {
+      update_stats(engine, 0, 1, 0, 0, 0);
+      return res != KV_SUCCESS ? res : KV_ERR_KEY_ALREADY_EXISTS;
+    }
   }
 
   /* Prepare Samsung KV structures */
@@ -321,18 +823,31 @@ kv_result_t kv_engine_store(kv_engine_t *engine, const void *key,
   kv_key.key = (void *)key;
   kv_key.length = key_len;
 
-  /* handle alignment for DMA */
+  /* handle alignment for DMA: aligned and registered buffers go straight to
+   * the device, anything else bounces through a pooled staging buffer */
   void *value_ptr = (void *)value;
   void *aligned_buf = NULL;
-
-  if (!IS_DMA_ALIGNED(value)) {
-    aligned_buf = dma_alloc(value_len);
+  bool staging_from_pool = false;
+
+  if (!IS_DMA_ALIGNED(value) &&
+      !buffer_registry_contains(engine->registered_buffers, value,
+                                value_len)) {
+    if (engine->buffer_pool && value_len <= engine->buffer_pool->buffer_size) {
+      aligned_buf = dma_pool_acquire(engine->buffer_pool);
+      staging_from_pool = (aligned_buf != NULL);
+    }
+    if (!aligned_buf) {
+      aligned_buf = dma_alloc(value_len);
+      atomic_fetch_add_explicit(&engine->dma_fallback_allocs, 1,
+                                memory_order_relaxed);
+    }
     if (!aligned_buf) {
       return KV_ERR_NO_MEMORY;
     }
     memcpy(aligned_buf, value, value_len);
     value_ptr = aligned_buf;
   }
+  kv_phase_mark(phases, KV_PHASE_BUFFER);
 
   kvs_value kv_value;
   kv_value.value = value_ptr;
@@ -340,165 +855,1532 @@ kv_result_t kv_engine_store(kv_engine_t *engine, const void *key,
   kv_value.actual_value_size = value_len;
   kv_value.offset = 0;
 
-  pthread_mutex_lock(&engine->hash_lock);
-  if (!key_in_table(&engine->key_table, key, key_len)) {
-    add_key(&engine->key_table, key, key_len);
+  /* Index before filter: a concurrent filter rebuild relies on it */
+  int inserted = add_key(&engine->key_table, key, key_len, key_hash);
+  for (uint32_t i = 0; i < placement->count; i++) {
+    kv_engine_filter_add(engine, placement->dev[i], key_hash);
   }
-  pthread_mutex_unlock(&engine->hash_lock);
+  kv_phase_mark(phases, KV_PHASE_INDEX);
 
   /* Perform store operation */
   kvs_option_store option;
   option.st_type = overwrite ? KVS_STORE_POST : KVS_STORE_NOOVERWRITE;
-  kvs_result kvs_res = kvs_store_kvp(keyspace, &kv_key, &kv_value, &option);
-  device_record_result(&engine->devices[dev_idx], kvs_res);
-
-  if (aligned_buf) {
-    dma_free(aligned_buf);
+  kvs_result result[KV_MAX_DEVICES];
+  uint32_t issued = placement->count;
+  if (!overwrite && issued > 1) {
+    store_copies(engine, placement, 0, 1, &kv_key, &kv_value, &option,
+                 result);
+    if (result[0] == KVS_SUCCESS) {
+      store_copies(engine, placement, 1, issued, &kv_key, &kv_value,
+                   &option, result);
+    } else {
+      issued = 1;
+    }
+  } else {
+    store_copies(engine, placement, 0, issued, &kv_key, &kv_value, &option,
+                 result);
   }
 
-  update_stats(engine, 0, 1, 0, kvs_res == KVS_SUCCESS, value_len);
-  return map_kvs_result(kvs_res);
-}
-
-kv_result_t kv_engine_retrieve(kv_engine_t *engine, const void *key,
-                               size_t key_len, void **value, size_t *value_len,
-                               bool delete_value) {
-  if (!engine || !engine->initialized || !key || !key_len || !value ||
-      !value_len) {
-    return KV_ERR_INVALID_PARAM;
+  kvs_result kvs_res = KVS_SUCCESS;
+  uint32_t written = 0;
+  for (uint32_t i = 0; i < issued; i++) {
+    if (result[i] == KVS_SUCCESS) {
+      written++;
+    } else if (kvs_res == KVS_SUCCESS) {
+      kvs_res = result[i];
+    }
   }
 
-  if (key_len < 4 || key_len > 255) {
-    return KV_ERR_INVALID_PARAM;
+  /* some copies hold the new value and others don't */
+  if (kvs_res != KVS_SUCCESS && written > 0) {
+    for (uint32_t i = 0; i < issued; i++) {
+      uint32_t dev_idx = placement->dev[i];
+      if (overwrite) {
+        if (result[i] != KVS_SUCCESS) {
+          atomic_store(&engine->devices[dev_idx].healthy, false);
+        }
+      } else if (result[i] == KVS_SUCCESS) {
+        if (delete_on_device(engine, dev_idx, key, key_len) == KVS_SUCCESS) {
+          kv_engine_filter_note_delete(engine, dev_idx);
+          written--;
+        } else {
+          atomic_store(&engine->devices[dev_idx].healthy, false);
+        }
+      }
+    }
   }
 
-  /* Shard key to a device */
-  uint32_t dev_idx = kv_engine_shard_for_key(key, key_len, engine->num_devices);
-  kvs_key_space_handle keyspace = engine->devices[dev_idx].keyspace;
+  /* the new copies supersede the one still waiting to be moved */
+  if (placement->dropped != KV_NO_DEVICE && kvs_res == KVS_SUCCESS &&
+      delete_on_device(engine, placement->dropped, key, key_len) ==
+          KVS_SUCCESS) {
+    kv_engine_filter_note_delete(engine, placement->dropped);
+  }
+  kv_phase_mark(phases, KV_PHASE_DEVICE);
 
-  /* Refuse operation if device is unhealthy */
-  kv_result_t health = check_device_health(&engine->devices[dev_idx]);
-  if (health != KV_SUCCESS) {
-    return health;
+  /* keep the index exact: drop a key this call added if nothing was
+   * written */
+  if (kvs_res != KVS_SUCCESS && written == 0 && inserted == 1) {
+    delete_key(&engine->key_table, key, key_len, key_hash);
+    kv_phase_mark(phases, KV_PHASE_INDEX);
   }
 
-  /* Prepare key */
-  kvs_key kv_key;
-  kv_key.key = (void *)key;
-  kv_key.length = key_len;
+  if (staging_from_pool) {
+    dma_pool_release(engine->buffer_pool, aligned_buf);
+  } else if (aligned_buf) {
+    dma_free(aligned_buf);
+  }
+  kv_phase_mark(phases, KV_PHASE_BUFFER);
 
-  /* Initial key retrieve buffer */
-  bool from_pool = false;
-  void *buffer = NULL;
+  update_stats(engine, 0, 1, 0, kvs_res == KVS_SUCCESS, value_len);
+  kv_phase_mark(phases, KV_PHASE_STATS);
+  return map_kvs_result(kvs_res);
+}
 
-  if (engine->buffer_pool) {
-    buffer = dma_pool_acquire(engine->buffer_pool);
-    from_pool = (buffer != NULL);
-  }
-  if (!buffer) {
-    buffer = dma_alloc(KV_ENGINE_RETRIEVE_SIZE);
-  }
+/* ============================================================================
+ * Striped Values
+ * ============================================================================
+ */
 
+/* The manifest a striped key holds, from the first of its devices that
+ * answers; false if the key is absent or holds an ordinary value (which
+ * doesn't fit the one-block buffer) */
+static bool load_manifest(kv_engine_t *engine,
+                          const kv_placement_t *placement, const void *key,
+                          size_t key_len, kv_stripe_manifest_t *manifest) {
+  uint32_t order[KV_MAX_DEVICES + 1];
+  uint32_t count = read_order(engine, placement, order);
+  void *buffer = dma_alloc(DMA_ALIGNMENT);
   if (!buffer) {
-    return KV_ERR_NO_MEMORY;
+    return false;
   }
 
-  kvs_value kv_value;
-  kv_value.value = buffer;
-  kv_value.length = KV_ENGINE_RETRIEVE_SIZE;
-  kv_value.actual_value_size = 0;
-  kv_value.offset = 0;
-
+  kvs_key kv_key;
+  kv_key.key = (void *)key;
+  kv_key.length = key_len;
   kvs_option_retrieve option;
-  option.kvs_retrieve_delete = delete_value;
-  kvs_result kvs_res = kvs_retrieve_kvp(keyspace, &kv_key, &option, &kv_value);
-
-  if (kvs_res == KVS_ERR_BUFFER_SMALL) {
-    if (from_pool) {
-      dma_pool_release(engine->buffer_pool, buffer);
-      from_pool = false;
-    } else {
-      dma_free(buffer);
+  option.kvs_retrieve_delete = false;
+
+  bool found = false;
+  for (uint32_t i = 0; i < count; i++) {
+    kvs_value kv_value = {buffer, DMA_ALIGNMENT, 0, 0};
+    uint64_t device_start = kv_device_cmd_begin(engine, order[i]);
+    kvs_result kvs_res = kvs_retrieve_kvp(engine->devices[order[i]].keyspace,
+                                          &kv_key, &option, &kv_value);
+    kv_device_cmd_end(engine, order[i], KV_OP_RETRIEVE, device_start);
+    device_record_result(&engine->devices[order[i]], kvs_res);
+    if (kvs_res == KVS_SUCCESS) {
+      found = kv_stripe_parse_manifest(buffer, kv_value.length, manifest);
+      break;
     }
-    buffer = dma_alloc(kv_value.actual_value_size);
-
-    if (!buffer) {
-      return KV_ERR_NO_MEMORY;
+    if (kvs_res == KVS_ERR_KEY_NOT_EXIST ? !placement->moving
+                                         : !is_device_error(kvs_res)) {
+      break;
     }
-
-    kv_value.value = buffer;
-    kv_value.length = kv_value.actual_value_size;
-    kv_value.offset = 0;
-    kvs_res = kvs_retrieve_kvp(keyspace, &kv_key, &option, &kv_value);
   }
+  dma_free(buffer);
+  return found;
+}
 
-  device_record_result(&engine->devices[dev_idx], kvs_res);
-
-  if (delete_value && kvs_res == KVS_SUCCESS) {
-    pthread_mutex_lock(&engine->hash_lock);
-    delete_key(&engine->key_table, key, key_len);
-    pthread_mutex_unlock(&engine->hash_lock);
+static bool placement_has(const kv_placement_t *placement, uint32_t dev_idx) {
+  for (uint32_t i = 0; i < placement->count; i++) {
+    if (placement->dev[i] == dev_idx) {
+      return true;
+    }
   }
+  return false;
+}
 
-  if (kvs_res != KVS_SUCCESS) {
-    if (from_pool) {
-      dma_pool_release(engine->buffer_pool, buffer);
-    } else {
-      dma_free(buffer);
+/* A store that stripes its value or replaces a striped one, made with the
+ * key's lock stripe held exclusively so its manifest and chunks change
+ * together. New chunks go first and the manifest (or plain value) after
+ * them; the previous value's chunks, and the manifest copies beyond the
+ * key's ordinary placement if it is no longer striped, are deleted last. */
+typedef struct {
+  kv_placement_t wide; /* the manifest's devices */
+  pthread_rwlock_t *lock;
+  bool striped; /* the new value is */
+  bool replaces;
+  kv_stripe_manifest_t old; /* if it replaces a striped value */
+} striped_store_t;
+
+/* Takes the lock and looks up the value being replaced */
+static kv_result_t striped_store_begin(kv_engine_t *engine, const void *key,
+                                       size_t key_len, uint32_t key_hash,
+                                       size_t value_len, bool overwrite,
+                                       striped_store_t *op) {
+  kv_engine_place_copies(engine, key_hash, kv_engine_manifest_replicas(engine),
+                         &op->wide);
+  op->striped = kv_engine_stripes_value(engine, key_len, value_len);
+  if (op->striped) {
+    kv_result_t health = check_placement_health(engine, &op->wide);
+    if (health != KV_SUCCESS) {
+      return health;
     }
-    update_stats(engine, 1, 0, 0, 0, 0);
-    return map_kvs_result(kvs_res);
   }
 
-  *value = kv_value.value;
-  *value_len = kv_value.length;
-
-  update_stats(engine, 1, 0, 0, 1, kv_value.actual_value_size);
+  op->lock = kv_key_lock(engine, key_hash, true);
+  if (!op->lock) {
+    return KV_ERR_BUSY;
+  }
+  op->replaces = kv_engine_is_striped_key(engine, key, key_len, key_hash) &&
+                 load_manifest(engine, &op->wide, key, key_len, &op->old);
+  if (op->replaces && !overwrite) {
+    kv_key_unlock(op->lock);
+    update_stats(engine, 0, 1, 0, 0, 0);
+    return KV_ERR_KEY_ALREADY_EXISTS;
+  }
+  /* Marked before its manifest is written, so a read that finds the
+   * manifest knows to take it for one. A failed store leaves the mark:
+   * it only makes reads and stores of the key check for a manifest. */
+  if (op->striped) {
+    add_key(&engine->striped_keys, key, key_len, key_hash);
+    atomic_store(&engine->striped_keys_present, true);
+  }
   return KV_SUCCESS;
 }
 
-kv_result_t kv_engine_delete(kv_engine_t *engine, const void *key,
-                             size_t key_len) {
-  if (!engine || !engine->initialized || !key) {
-    return KV_ERR_INVALID_PARAM;
+/* A generation an open write stream holds for the key's chunks */
+typedef struct generation_hold {
+  const uint8_t *key;
+  size_t key_len;
+  uint32_t generation;
+  struct generation_hold *next;
+} generation_hold_t;
+
+/* True if generation's chunk keys are the replaced value's or an open
+ * write stream's; chunk keys keep its low byte */
+static bool generation_taken(kv_engine_t *engine, const striped_store_t *op,
+                             const void *key, size_t key_len,
+                             uint32_t generation) {
+  if (op->replaces && (uint8_t)(generation ^ op->old.generation) == 0) {
+    return true;
   }
-
-  if (key_len < 4 || key_len > 255) {
-    return KV_ERR_INVALID_PARAM;
+  for (generation_hold_t *h = engine->generation_holds; h; h = h->next) {
+    if (h->key_len == key_len && (uint8_t)(h->generation ^ generation) == 0 &&
+        memcmp(h->key, key, key_len) == 0) {
+      return true;
+    }
   }
+  return false;
+}
 
-  /* Shard key to a device */
-  uint32_t dev_idx = kv_engine_shard_for_key(key, key_len, engine->num_devices);
-  kvs_key_space_handle keyspace = engine->devices[dev_idx].keyspace;
-
-  /* Refuse operation if device is unhealthy */
-  kv_result_t health = check_device_health(&engine->devices[dev_idx]);
-  if (health != KV_SUCCESS) {
-    return health;
+/* Generation of the new value's chunks: the one after the value it
+ * replaces, skipping any an open write stream of the key holds. Called
+ * with the key's lock stripe held. With hold set, a write stream takes
+ * the generation until release_generation. */
+static uint32_t striped_store_generation(kv_engine_t *engine,
+                                         const striped_store_t *op,
+                                         const void *key, size_t key_len,
+                                         generation_hold_t *hold) {
+  uint32_t generation = op->replaces ? op->old.generation + 1 : 0;
+  pthread_mutex_lock(&engine->generation_mutex);
+  for (uint32_t tries = 0;
+       tries < 256 &&
+       generation_taken(engine, op, key, key_len, generation);
+       tries++) {
+    generation++;
+  }
+  if (hold) {
+    hold->generation = generation;
+    hold->next = engine->generation_holds;
+    engine->generation_holds = hold;
   }
+  pthread_mutex_unlock(&engine->generation_mutex);
+  return generation;
+}
 
-  kvs_key kv_key;
+static void release_generation(kv_engine_t *engine, generation_hold_t *hold) {
+  pthread_mutex_lock(&engine->generation_mutex);
+  for (generation_hold_t **h = &engine->generation_holds; *h;
+       h = &(*h)->next) {
+    if (*h == hold) {
+      *h = hold->next;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&engine->generation_mutex);
+}
+
+/* Stores the manifest of chunks just written, deleting them if that
+ * fails */
+static kv_result_t striped_store_manifest(kv_engine_t *engine,
+                                          striped_store_t *op, const void *key,
+                                          size_t key_len, uint32_t key_hash,
+                                          const kv_stripe_manifest_t *manifest,
+                                          bool overwrite,
+                                          kv_phase_timer_t *phases) {
+  kv_result_t res = store_placed(engine, &op->wide, key, key_len, key_hash,
+                                 manifest, sizeof(*manifest), overwrite,
+                                 phases);
+  if (res != KV_SUCCESS) {
+    kv_stripe_delete(engine, key, key_len, manifest);
+    return res;
+  }
+  KV_STAT_ADD(engine, chunked_stores, 1);
+  /* store_placed counted the manifest */
+  if (manifest->value_size > sizeof(*manifest)) {
+    KV_STAT_ADD(engine, bytes_written,
+                manifest->value_size - sizeof(*manifest));
+  }
+  return KV_SUCCESS;
+}
+
+/* Retires the previous value once the new one is in and drops the lock */
+static void striped_store_end(kv_engine_t *engine, striped_store_t *op,
+                              const void *key, size_t key_len,
+                              uint32_t key_hash, kv_result_t res,
+                              kv_phase_timer_t *phases) {
+  if (res == KV_SUCCESS) {
+    if (op->replaces) {
+      kv_stripe_delete(engine, key, key_len, &op->old);
+    }
+    if (!op->striped) {
+      delete_key(&engine->striped_keys, key, key_len, key_hash);
+    }
+    kv_phase_mark(phases, KV_PHASE_DEVICE);
+  }
+  kv_key_unlock(op->lock);
+}
+
+static kv_result_t store_striped(kv_engine_t *engine,
+                                 const kv_placement_t *placement,
+                                 const void *key, size_t key_len,
+                                 uint32_t key_hash,
+                                 const kv_stripe_source_t *source,
+                                 size_t value_len, bool overwrite,
+                                 kv_phase_timer_t *phases) {
+  striped_store_t op;
+  kv_result_t res = striped_store_begin(engine, key, key_len, key_hash,
+                                        value_len, overwrite, &op);
+  if (res != KV_SUCCESS) {
+    return res;
+  }
+  if (op.striped) {
+    kv_stripe_manifest_t manifest;
+    res = kv_stripe_write(engine, key, key_len, key_hash,
+                          striped_store_generation(engine, &op, key, key_len,
+                                                   NULL),
+                          source, value_len,
+                          &manifest);
+    kv_phase_mark(phases, KV_PHASE_DEVICE);
+    if (res == KV_SUCCESS) {
+      res = striped_store_manifest(engine, &op, key, key_len, key_hash,
+                                   &manifest, overwrite, phases);
+    } else {
+      update_stats(engine, 0, 1, 0, 0, 0);
+    }
+  } else {
+    res = store_placed(engine, placement, key, key_len, key_hash,
+                       source->data, value_len, overwrite, phases);
+    for (uint32_t i = 0; res == KV_SUCCESS && i < op.wide.count; i++) {
+      if (!placement_has(placement, op.wide.dev[i]) &&
+          delete_on_device(engine, op.wide.dev[i], key, key_len) ==
+              KVS_SUCCESS) {
+        kv_engine_filter_note_delete(engine, op.wide.dev[i]);
+      }
+    }
+  }
+  striped_store_end(engine, &op, key, key_len, key_hash, res, phases);
+  return res;
+}
+
+/* Checks the arguments of a store */
+static kv_result_t check_store(kv_engine_t *engine, const void *key,
+                               size_t key_len, size_t value_len) {
+  if (!engine || !engine->initialized || !key) {
+    return KV_ERR_INVALID_PARAM;
+  }
+
+  if (key_len < 4 || key_len > 255) {
+    return KV_ERR_INVALID_PARAM;
+  }
+
+  /* Chunk keys leave no room for keys this long */
+  if (!kv_engine_stripes_value(engine, key_len, value_len) &&
+      value_len > KV_ENGINE_RETRIEVE_SIZE) {
+    return KV_ERR_VALUE_TOO_LARGE;
+  }
+
+  /* Keys under the internal prefix hold engine metadata */
+  if (kv_engine_is_internal_key(key, key_len)) {
+    return KV_ERR_INVALID_PARAM;
+  }
+  return KV_SUCCESS;
+}
+
+/* Stores a value given whole or, if it is striped, possibly by a fill
+ * callback (see kv_stripe_source_t) */
+static kv_result_t engine_store(kv_engine_t *engine, const void *key,
+                                size_t key_len,
+                                const kv_stripe_source_t *source,
+                                size_t value_len, bool overwrite,
+                                kv_phase_timer_t *phases) {
+  if (!source->data && !source->fill) {
+    return KV_ERR_INVALID_PARAM;
+  }
+  kv_result_t valid = check_store(engine, key, key_len, value_len);
+  if (valid != KV_SUCCESS) {
+    return valid;
+  }
+  bool striped = kv_engine_stripes_value(engine, key_len, value_len);
+  kv_phase_mark(phases, KV_PHASE_VALIDATE);
+
+  /* Place key on its devices; the same hash picks the key index stripe */
+  uint32_t key_hash = kv_engine_key_hash(key, key_len);
+  kv_placement_t placement;
+  kv_engine_place(engine, key_hash, &placement);
+
+  /* Refuse operation if a device is unhealthy */
+  kv_result_t health = check_placement_health(engine, &placement);
+  if (health != KV_SUCCESS) {
+    return health;
+  }
+  kv_engine_hot_key_sample(engine, placement.dev[0], key_hash, key, key_len);
+  kv_phase_mark(phases, KV_PHASE_ROUTE);
+
+  if (striped || kv_engine_is_striped_key(engine, key, key_len, key_hash)) {
+    return store_striped(engine, &placement, key, key_len, key_hash, source,
+                         value_len, overwrite, phases);
+  }
+
+  if (!placement.moving) {
+    return store_placed(engine, &placement, key, key_len, key_hash,
+                        source->data, value_len, overwrite, phases);
+  }
+
+  pthread_rwlock_t *move_lock = kv_key_lock(engine, key_hash, false);
+  if (!move_lock) {
+    return KV_ERR_BUSY;
+  }
+  kv_result_t res = store_placed(engine, &placement, key, key_len, key_hash,
+                                 source->data, value_len, overwrite, phases);
+  kv_key_unlock(move_lock);
+  return res;
+}
+
+kv_result_t kv_engine_store(kv_engine_t *engine, const void *key,
+                            size_t key_len, const void *value, size_t value_len,
+                            bool overwrite) {
+  uint64_t start = kv_latency_start(engine);
+  kv_phase_timer_t phases;
+  kv_phase_begin(engine, &phases);
+  kv_stripe_source_t source = {.data = value};
+  kv_result_t res = engine_store(engine, key, key_len, &source, value_len,
+                                 overwrite, &phases);
+  kv_phase_end(engine, &phases, KV_OP_STORE);
+  kv_op_finish(engine, KV_OP_STORE, start, key, key_len, res,
+               res == KV_SUCCESS ? value_len : 0);
+  return res;
+}
+
+/* A value that isn't striped is gathered with one fill call, so only
+ * striped ones reach the devices a row at a time */
+kv_result_t kv_engine_store_stream(kv_engine_t *engine, const void *key,
+                                   size_t key_len, size_t value_len,
+                                   kv_stream_fill_cb fill, void *user_data,
+                                   bool overwrite) {
+  if (!engine || !engine->initialized || !fill) {
+    return KV_ERR_INVALID_PARAM;
+  }
+  uint64_t start = kv_latency_start(engine);
+  kv_phase_timer_t phases;
+  kv_phase_begin(engine, &phases);
+
+  /* Refuse a bad key before the source is drained: fill can't rewind */
+  kv_stripe_source_t source = {.fill = fill, .user_data = user_data};
+  void *gathered = NULL;
+  kv_result_t res = check_store(engine, key, key_len, value_len);
+  if (res == KV_SUCCESS &&
+      !kv_engine_stripes_value(engine, key_len, value_len)) {
+    if (!(gathered = kv_engine_alloc_buffer(
+                     engine, value_len ? value_len : 1))) {
+      res = KV_ERR_NO_MEMORY;
+    } else if (fill(gathered, value_len, user_data) != 0) {
+      res = KV_ERR_ABORTED;
+    }
+    source.data = gathered;
+  }
+  if (res == KV_SUCCESS) {
+    res = engine_store(engine, key, key_len, &source, value_len, overwrite,
+                       &phases);
+  }
+  kv_engine_free_buffer(engine, gathered);
+
+  kv_phase_end(engine, &phases, KV_OP_STORE);
+  kv_op_finish(engine, KV_OP_STORE, start, key, key_len, res,
+               res == KV_SUCCESS ? value_len : 0);
+  return res;
+}
+
+/* Reads key from one device into kv_value, whose buffer holds
+ * buffer_size bytes. A value that doesn't fit replaces the buffer with an
+ * allocation of its size; kv_value->value is NULL if that fails. */
+static kvs_result retrieve_on_device(kv_engine_t *engine, uint32_t dev_idx,
+                                     kvs_key *kv_key, bool delete_value,
+                                     kvs_value *kv_value, size_t *buffer_size,
+                                     bool *from_pool) {
+  kvs_key_space_handle keyspace = engine->devices[dev_idx].keyspace;
+  kv_value->length = *buffer_size;
+  kv_value->actual_value_size = 0;
+  kv_value->offset = 0;
+
+  kvs_option_retrieve option;
+  option.kvs_retrieve_delete = delete_value;
+  uint64_t device_start = kv_device_cmd_begin(engine, dev_idx);
+  kvs_result kvs_res = kvs_retrieve_kvp(keyspace, kv_key, &option, kv_value);
+
+  if (kvs_res == KVS_ERR_BUFFER_SMALL) {
+    if (*from_pool) {
+      dma_pool_release(engine->buffer_pool, kv_value->value);
+      *from_pool = false;
+    } else {
+      dma_free(kv_value->value);
+    }
+    *buffer_size = kv_value->actual_value_size;
+    kv_value->value = dma_alloc(*buffer_size);
+    atomic_fetch_add_explicit(&engine->dma_fallback_allocs, 1,
+                              memory_order_relaxed);
+
+    if (!kv_value->value) {
+      kv_device_cmd_end(engine, dev_idx, KV_OP_RETRIEVE, device_start);
+      return kvs_res;
+    }
+
+    kv_value->length = *buffer_size;
+    kv_value->offset = 0;
+    kvs_res = kvs_retrieve_kvp(keyspace, kv_key, &option, kv_value);
+  }
+  /* includes the buffer reallocation when the value didn't fit */
+  kv_device_cmd_end(engine, dev_idx, KV_OP_RETRIEVE, device_start);
+
+  device_record_result(&engine->devices[dev_idx], kvs_res);
+  return kvs_res;
+}
+
+/* ============================================================================
+ * Hedged Reads
+ * ============================================================================
+ */
+
+/* One device read of a hedged retrieve */
+typedef struct {
+  uint32_t dev_idx;
+  uint64_t start_ns;
+  uint64_t elapsed_ns;
+  kvs_value value;
+  bool from_pool;
+  kvs_result result;
+} hedge_read_t;
+
+/* Shared by the caller and the completions of its reads. The last of them
+ * to finish frees it, so a read the caller stopped waiting for completes
+ * into valid memory and frees its own buffer. */
+typedef struct {
+  kv_engine_t *engine;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  uint32_t refs;      /* caller plus reads not yet completed */
+  uint32_t completed; /* bit per read */
+  bool abandoned;     /* the caller has taken its answer */
+  uint8_t key_bytes[255];
+  kvs_key key;
+  kvs_option_retrieve option;
+  hedge_read_t read[2];
+} hedge_t;
+
+static void release_read_buffer(kv_engine_t *engine, void *buffer,
+                                bool from_pool) {
+  if (from_pool) {
+    dma_pool_release(engine->buffer_pool, buffer);
+  } else {
+    dma_free(buffer);
+  }
+}
+
+static void hedge_free(hedge_t *hedge) {
+  pthread_mutex_destroy(&hedge->mutex);
+  pthread_cond_destroy(&hedge->cond);
+  free(hedge);
+}
+
+/* Completion of a hedged read, on the device's completion thread */
+static void hedge_read_done(kvs_postprocess_context *ctx) {
+  hedge_t *hedge = (hedge_t *)ctx->private1;
+  hedge_read_t *read = (hedge_read_t *)ctx->private2;
+  kv_engine_t *engine = hedge->engine;
+
+  uint64_t elapsed = kv_now_ns() - read->start_ns;
+  kv_device_async_cmd_end(engine, read->dev_idx, KV_OP_RETRIEVE,
+                          read->start_ns, ctx->result);
+
+  pthread_mutex_lock(&hedge->mutex);
+  read->elapsed_ns = elapsed;
+  read->result = ctx->result;
+  hedge->completed |= 1u << (read - hedge->read);
+  bool abandoned = hedge->abandoned;
+  uint32_t refs = --hedge->refs;
+  pthread_cond_signal(&hedge->cond);
+  pthread_mutex_unlock(&hedge->mutex);
+
+  if (abandoned) {
+    release_read_buffer(engine, read->value.value, read->from_pool);
+  }
+  if (refs == 0) {
+    hedge_free(hedge);
+  }
+  atomic_fetch_sub_explicit(&engine->async_cmds_outstanding, 1,
+                            memory_order_release);
+}
+
+/* Issues read i; a command the device refuses completes immediately */
+static void hedge_submit(hedge_t *hedge, uint32_t i) {
+  kv_engine_t *engine = hedge->engine;
+  hedge_read_t *read = &hedge->read[i];
+  read->value.length = KV_ENGINE_RETRIEVE_SIZE;
+  read->value.actual_value_size = 0;
+  read->value.offset = 0;
+
+  pthread_mutex_lock(&hedge->mutex);
+  hedge->refs++;
+  pthread_mutex_unlock(&hedge->mutex);
+  atomic_fetch_add_explicit(&engine->async_cmds_outstanding, 1,
+                            memory_order_relaxed);
+  atomic_fetch_add_explicit(&engine->devices[read->dev_idx].in_flight, 1,
+                            memory_order_relaxed);
+  read->start_ns = kv_now_ns();
+
+  kvs_result res = kvs_retrieve_kvp_async(
+      engine->devices[read->dev_idx].keyspace, &hedge->key, &hedge->option,
+      hedge, read, &read->value, hedge_read_done);
+  if (res == KVS_SUCCESS) {
+    return;
+  }
+
+  atomic_fetch_sub_explicit(&engine->devices[read->dev_idx].in_flight, 1,
+                            memory_order_relaxed);
+  atomic_fetch_sub_explicit(&engine->async_cmds_outstanding, 1,
+                            memory_order_relaxed);
+  device_record_result(&engine->devices[read->dev_idx], res);
+  pthread_mutex_lock(&hedge->mutex);
+  read->result = res;
+  hedge->completed |= 1u << i;
+  hedge->refs--;
+  pthread_mutex_unlock(&hedge->mutex);
+}
+
+/* Reads key from order[0] and, if that hasn't answered within
+ * hedge_after_ns, from order[1] too, taking the first usable answer: the
+ * value, a miss or any error other than a device error. kv_value's buffer
+ * goes to the first read and is replaced by the answering read's buffer;
+ * a read still running frees its own when it completes. Returns the
+ * number of devices tried, 0 if the retrieve couldn't be hedged. */
+static uint32_t retrieve_hedged(kv_engine_t *engine, const uint32_t *order,
+                                const kvs_key *kv_key, uint64_t hedge_after_ns,
+                                kvs_value *kv_value, bool *from_pool,
+                                kvs_result *kvs_res, uint32_t *answered_by) {
+  hedge_t *hedge = calloc(1, sizeof(hedge_t));
+  if (!hedge) {
+    return 0;
+  }
+  hedge->engine = engine;
+  hedge->refs = 1;
+  pthread_mutex_init(&hedge->mutex, NULL);
+  pthread_condattr_t cattr;
+  pthread_condattr_init(&cattr);
+  pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+  pthread_cond_init(&hedge->cond, &cattr);
+  pthread_condattr_destroy(&cattr);
+
+  /* the caller's key may be gone before a losing read completes */
+  memcpy(hedge->key_bytes, kv_key->key, kv_key->length);
+  hedge->key.key = hedge->key_bytes;
+  hedge->key.length = kv_key->length;
+  hedge->option.kvs_retrieve_delete = false;
+
+  hedge->read[0].dev_idx = order[0];
+  hedge->read[0].value.value = kv_value->value;
+  hedge->read[0].from_pool = *from_pool;
+  hedge_submit(hedge, 0);
+
+  uint64_t deadline_ns = hedge->read[0].start_ns + hedge_after_ns;
+  struct timespec deadline = {
+      .tv_sec = (time_t)(deadline_ns / 1000000000ULL),
+      .tv_nsec = (long)(deadline_ns % 1000000000ULL)};
+  pthread_mutex_lock(&hedge->mutex);
+  while (!(hedge->completed & 1) &&
+         pthread_cond_timedwait(&hedge->cond, &hedge->mutex, &deadline) !=
+             ETIMEDOUT) {
+  }
+  bool slow = !(hedge->completed & 1);
+  pthread_mutex_unlock(&hedge->mutex);
+
+  uint32_t issued = 1;
+  if (slow) {
+    void *buffer = NULL;
+    if (engine->buffer_pool) {
+      buffer = dma_pool_acquire(engine->buffer_pool);
+      hedge->read[1].from_pool = (buffer != NULL);
+    }
+    if (!buffer) {
+      buffer = dma_alloc(KV_ENGINE_RETRIEVE_SIZE);
+      atomic_fetch_add_explicit(&engine->dma_fallback_allocs, 1,
+                                memory_order_relaxed);
+    }
+    /* without a buffer, keep waiting on the first read */
+    if (buffer) {
+      hedge->read[1].dev_idx = order[1];
+      hedge->read[1].value.value = buffer;
+      hedge_submit(hedge, 1);
+      issued = 2;
+      KV_STAT_ADD(engine, hedged_reads, 1);
+    }
+  }
+
+  /* first usable answer; if every read hit a device error, the last */
+  uint32_t all = (1u << issued) - 1;
+  uint32_t winner = UINT32_MAX;
+  pthread_mutex_lock(&hedge->mutex);
+  for (;;) {
+    for (uint32_t i = 0; i < issued; i++) {
+      if ((hedge->completed & (1u << i)) &&
+          !is_device_error(hedge->read[i].result)) {
+        winner = i;
+        break;
+      }
+    }
+    if (winner != UINT32_MAX) {
+      break;
+    }
+    if (hedge->completed == all) {
+      winner = issued - 1;
+      break;
+    }
+    pthread_cond_wait(&hedge->cond, &hedge->mutex);
+  }
+  hedge_read_t won = hedge->read[winner];
+  hedge_read_t lost = hedge->read[winner ^ 1];
+  bool lost_done = issued == 2 && (hedge->completed & (1u << (winner ^ 1)));
+  hedge->abandoned = true;
+  uint32_t refs = --hedge->refs;
+  pthread_mutex_unlock(&hedge->mutex);
+
+  if (lost_done) {
+    release_read_buffer(engine, lost.value.value, lost.from_pool);
+  }
+  if (refs == 0) {
+    hedge_free(hedge);
+  }
+
+  if (winner == 1) {
+    KV_STAT_ADD(engine, hedge_wins, 1);
+  }
+  kv_op_trace.device_ns = won.elapsed_ns;
+  kv_op_trace.dev_slot = won.dev_idx + 1;
+  *kv_value = won.value;
+  *from_pool = won.from_pool;
+  *kvs_res = won.result;
+  *answered_by = won.dev_idx;
+  return issued;
+}
+
+/* Retrieves from the first device of order that has the key, moving on
+ * after a device error or, for a moving key (stripe lock held shared), a
+ * miss. Filters are skipped for moving keys since the added device's
+ * filter is rebuilt only once the migration ends. A retrieve-and-delete
+ * deletes the key's other copies too. A plain read of a key with a second
+ * copy is hedged once the first device has a hedge delay. */
+static kv_result_t retrieve_placed(kv_engine_t *engine,
+                                   const kv_placement_t *placement,
+                                   const uint32_t *order, uint32_t count,
+                                   const void *key, size_t key_len,
+                                   uint32_t key_hash, void **value,
+                                   size_t *value_len, bool delete_value,
+                                   kv_phase_timer_t *phases) {
+  /* Definitely absent: skip the device command and the 2MB buffer */
+  bool may_contain = placement->moving ||
+                     kv_engine_filter_may_contain(engine, order[0], key_hash);
+  kv_phase_mark(phases, KV_PHASE_INDEX);
+  if (!may_contain) {
+    update_stats(engine, 1, 0, 0, 0, 0);
+    kv_phase_mark(phases, KV_PHASE_STATS);
+    return KV_ERR_KEY_NOT_FOUND;
+  }
+
+  /* Prepare key */
+  kvs_key kv_key;
   kv_key.key = (void *)key;
   kv_key.length = key_len;
 
-  kvs_option_delete option;
-  option.kvs_delete_error = false;
-  kvs_result kvs_res = kvs_delete_kvp(keyspace, &kv_key, &option);
+  /* Initial key retrieve buffer */
+  bool from_pool = false;
+  void *buffer = NULL;
+  size_t buffer_size = KV_ENGINE_RETRIEVE_SIZE;
+
+  if (engine->buffer_pool) {
+    buffer = dma_pool_acquire(engine->buffer_pool);
+    from_pool = (buffer != NULL);
+  }
+  if (!buffer) {
+    buffer = dma_alloc(KV_ENGINE_RETRIEVE_SIZE);
+    atomic_fetch_add_explicit(&engine->dma_fallback_allocs, 1,
+                              memory_order_relaxed);
+  }
+
+  if (!buffer) {
+    return KV_ERR_NO_MEMORY;
+  }
+  kv_phase_mark(phases, KV_PHASE_BUFFER);
+
+  kvs_value kv_value;
+  kv_value.value = buffer;
+  uint32_t found_idx = KV_NO_DEVICE;
+  kvs_result kvs_res = KVS_ERR_KEY_NOT_EXIST;
+  uint32_t i = 0;
+  if (count > 1 && !placement->moving && !delete_value &&
+      engine->devices[order[0]].read_latency) {
+    uint64_t hedge_after_ns = atomic_load_explicit(
+        &engine->devices[order[0]].hedge_after_ns, memory_order_relaxed);
+    if (hedge_after_ns) {
+      i = retrieve_hedged(engine, order, &kv_key, hedge_after_ns, &kv_value,
+                          &from_pool, &kvs_res, &found_idx);
+      if (i > 0 && !is_device_error(kvs_res)) {
+        i = count; /* answered */
+      }
+    }
+  }
+  for (; i < count && kv_value.value; i++) {
+    kvs_res = retrieve_on_device(engine, order[i], &kv_key, delete_value,
+                                 &kv_value, &buffer_size, &from_pool);
+    if (kvs_res == KVS_SUCCESS) {
+      found_idx = order[i];
+      break;
+    }
+    if (kvs_res == KVS_ERR_KEY_NOT_EXIST ? !placement->moving
+                                         : !is_device_error(kvs_res)) {
+      break;
+    }
+  }
+  if (!kv_value.value) {
+    return KV_ERR_NO_MEMORY;
+  }
+  kv_result_t health = KV_SUCCESS;
+  if (kvs_res == KVS_ERR_KEY_NOT_EXIST && placement->moving &&
+      count < placement_devices(placement)) {
+    /* the copy may be on a device that was skipped */
+    health = KV_ERR_DEVICE_DEGRADED;
+  }
+
+  if (delete_value && kvs_res == KVS_SUCCESS) {
+    /* don't let another copy resurface */
+    for (uint32_t i = 0; i <= placement->count; i++) {
+      uint32_t dev_idx =
+          i < placement->count ? placement->dev[i] : placement->dropped;
+      if (dev_idx != found_idx && dev_idx != KV_NO_DEVICE &&
+          delete_on_device(engine, dev_idx, key, key_len) == KVS_SUCCESS) {
+        kv_engine_filter_note_delete(engine, dev_idx);
+      }
+    }
+  }
+  kv_phase_mark(phases, KV_PHASE_DEVICE);
+
+  if (delete_value && kvs_res == KVS_SUCCESS) {
+    delete_key(&engine->key_table, key, key_len, key_hash);
+    kv_engine_filter_note_delete(engine, found_idx);
+    kv_phase_mark(phases, KV_PHASE_INDEX);
+  }
+
+  if (kvs_res != KVS_SUCCESS) {
+    if (from_pool) {
+      dma_pool_release(engine->buffer_pool, kv_value.value);
+    } else {
+      dma_free(kv_value.value);
+    }
+    kv_phase_mark(phases, KV_PHASE_BUFFER);
+    update_stats(engine, 1, 0, 0, 0, 0);
+    kv_phase_mark(phases, KV_PHASE_STATS);
+    return health != KV_SUCCESS ? health : map_kvs_result(kvs_res);
+  }
+
+  *value = kv_value.value;
+  *value_len = kv_value.length;
+
+  update_stats(engine, 1, 0, 0, 1, kv_value.actual_value_size);
+  kv_phase_mark(phases, KV_PHASE_STATS);
+  return KV_SUCCESS;
+}
+
+static kv_result_t engine_retrieve(kv_engine_t *engine, const void *key,
+                                   size_t key_len, void **value,
+                                   size_t *value_len, bool delete_value,
+                                   kv_phase_timer_t *phases) {
+  if (!engine || !engine->initialized || !key || !key_len || !value ||
+      !value_len) {
+    return KV_ERR_INVALID_PARAM;
+  }
+
+  if (key_len < 4 || key_len > 255) {
+    return KV_ERR_INVALID_PARAM;
+  }
+  kv_phase_mark(phases, KV_PHASE_VALIDATE);
+
+  /* Place key on its devices; the same hash picks the key index stripe */
+  uint32_t key_hash = kv_engine_key_hash(key, key_len);
+  kv_placement_t placement;
+  kv_engine_place_key(engine, key, key_len, key_hash, &placement);
+
+  /* Refuse operation if no copy is readable, or for a delete, if any copy
+   * can't be deleted */
+  uint32_t order[KV_MAX_DEVICES + 1];
+  uint32_t count = read_order(engine, &placement, order);
+  if (count == 0) {
+    return KV_ERR_DEVICE_DEGRADED;
+  }
+  if (delete_value) {
+    kv_result_t health = check_placement_health(engine, &placement);
+    if (health != KV_SUCCESS) {
+      return health;
+    }
+  }
+  kv_engine_hot_key_sample(engine, order[0], key_hash, key, key_len);
+  kv_phase_mark(phases, KV_PHASE_ROUTE);
+
+  /* A striped value's manifest and chunks are read under the key's lock
+   * stripe so an overwrite can't replace them in between; retrieve-and-
+   * delete deletes the chunks too, so like a store it holds it
+   * exclusively, and deletes nothing until the chunks have been read */
+  pthread_rwlock_t *move_lock = NULL;
+  bool striped = kv_engine_is_striped_key(engine, key, key_len, key_hash);
+  if (striped || placement.moving) {
+    move_lock = kv_key_lock(engine, key_hash, striped && delete_value);
+    if (!move_lock) {
+      return KV_ERR_BUSY;
+    }
+  }
+  bool delete_now = delete_value && !striped;
+  kv_result_t res =
+      retrieve_placed(engine, &placement, order, count, key, key_len,
+                      key_hash, value, value_len, delete_now, phases);
+
+  /* A manifest stands in for a striped value; only a striped key's value
+   * is taken for one. Chunks that vanished under an overwrite racing the
+   * key's first store send the read back for the new manifest. */
+  kv_stripe_manifest_t manifest;
+  bool chunked = false;
+  for (int attempt = 0;
+       res == KV_SUCCESS &&
+       kv_engine_is_striped_key(engine, key, key_len, key_hash) &&
+       kv_stripe_parse_manifest(*value, *value_len, &manifest);
+       attempt++) {
+    kv_engine_free_buffer(engine, *value);
+    res = kv_stripe_read(engine, key, key_len, &manifest, value, value_len);
+    kv_phase_mark(phases, KV_PHASE_DEVICE);
+    if (res == KV_SUCCESS) {
+      chunked = true;
+      KV_STAT_ADD(engine, chunked_retrieves, 1);
+      /* retrieve_placed counted the manifest */
+      if (*value_len > sizeof(manifest)) {
+        KV_STAT_ADD(engine, bytes_read, *value_len - sizeof(manifest));
+      }
+      break;
+    }
+    if (res != KV_ERR_KEY_NOT_FOUND || delete_now || attempt == 2) {
+      break;
+    }
+    res = retrieve_placed(engine, &placement, order, count, key, key_len,
+                          key_hash, value, value_len, false, phases);
+  }
+
+  /* The value is in hand: now its copies, index entry and chunks go */
+  if (res == KV_SUCCESS && delete_value && !delete_now) {
+    kvs_result kvs_res = delete_copies(engine, &placement, key, key_len);
+    if (kvs_res != KVS_SUCCESS) {
+      kv_engine_free_buffer(engine, *value);
+      res = map_kvs_result(kvs_res);
+    } else {
+      delete_key(&engine->key_table, key, key_len, key_hash);
+    }
+    kv_phase_mark(phases, KV_PHASE_DEVICE);
+  }
+  if (res == KV_SUCCESS && delete_value && chunked) {
+    kv_stripe_delete(engine, key, key_len, &manifest);
+    delete_key(&engine->striped_keys, key, key_len, key_hash);
+  }
+
+  if (move_lock) {
+    kv_key_unlock(move_lock);
+  }
+  return res;
+}
+
+kv_result_t kv_engine_retrieve(kv_engine_t *engine, const void *key,
+                               size_t key_len, void **value, size_t *value_len,
+                               bool delete_value) {
+  uint64_t start = kv_latency_start(engine);
+  kv_phase_timer_t phases;
+  kv_phase_begin(engine, &phases);
+  kv_result_t res = engine_retrieve(engine, key, key_len, value, value_len,
+                                    delete_value, &phases);
+  kv_phase_end(engine, &phases, KV_OP_RETRIEVE);
+  kv_op_finish(engine, KV_OP_RETRIEVE, start, key, key_len, res,
+               res == KV_SUCCESS ? *value_len : 0);
+  return res;
+}
+
+/* Streams a value to deliver. The key's lock stripe is held shared
+ * throughout, so neither a striped overwrite nor the migrator can change
+ * the value between its rows. */
+static kv_result_t engine_retrieve_stream(kv_engine_t *engine,
+                                          const void *key, size_t key_len,
+                                          kv_stream_data_cb deliver,
+                                          void *user_data, size_t *value_len,
+                                          kv_phase_timer_t *phases) {
+  if (!engine || !engine->initialized || !key || !deliver) {
+    return KV_ERR_INVALID_PARAM;
+  }
+
+  if (key_len < 4 || key_len > 255) {
+    return KV_ERR_INVALID_PARAM;
+  }
+  kv_phase_mark(phases, KV_PHASE_VALIDATE);
+
+  uint32_t key_hash = kv_engine_key_hash(key, key_len);
+  pthread_rwlock_t *move_lock = kv_key_lock(engine, key_hash, false);
+  if (!move_lock) {
+    return KV_ERR_BUSY;
+  }
+
+  kv_placement_t placement;
+  kv_engine_place_key(engine, key, key_len, key_hash, &placement);
+  uint32_t order[KV_MAX_DEVICES + 1];
+  uint32_t count = read_order(engine, &placement, order);
+  if (count == 0) {
+    kv_key_unlock(move_lock);
+    return KV_ERR_DEVICE_DEGRADED;
+  }
+  kv_engine_hot_key_sample(engine, order[0], key_hash, key, key_len);
+  kv_phase_mark(phases, KV_PHASE_ROUTE);
+
+  void *value = NULL;
+  size_t len = 0;
+  kv_result_t res = retrieve_placed(engine, &placement, order, count, key,
+                                    key_len, key_hash, &value, &len, false,
+                                    phases);
+  kv_stripe_manifest_t manifest;
+  if (res == KV_SUCCESS &&
+      kv_engine_is_striped_key(engine, key, key_len, key_hash) &&
+      kv_stripe_parse_manifest(value, len, &manifest)) {
+    res = kv_stripe_read_stream(engine, key, key_len, &manifest, deliver,
+                                user_data);
+    kv_phase_mark(phases, KV_PHASE_DEVICE);
+    len = manifest.value_size;
+    if (res == KV_SUCCESS) {
+      KV_STAT_ADD(engine, chunked_retrieves, 1);
+      /* retrieve_placed counted the manifest */
+      if (len > sizeof(manifest)) {
+        KV_STAT_ADD(engine, bytes_read, len - sizeof(manifest));
+      }
+    }
+  } else if (res == KV_SUCCESS && deliver(value, len, user_data) != 0) {
+    res = KV_ERR_ABORTED;
+  }
+  kv_key_unlock(move_lock);
+
+  if (value) {
+    kv_engine_free_buffer(engine, value);
+  }
+  if (res == KV_SUCCESS && value_len) {
+    *value_len = len;
+  }
+  return res;
+}
+
+kv_result_t kv_engine_retrieve_stream(kv_engine_t *engine, const void *key,
+                                      size_t key_len,
+                                      kv_stream_data_cb deliver,
+                                      void *user_data, size_t *value_len) {
+  uint64_t start = kv_latency_start(engine);
+  kv_phase_timer_t phases;
+  kv_phase_begin(engine, &phases);
+  size_t len = 0;
+  kv_result_t res = engine_retrieve_stream(engine, key, key_len, deliver,
+                                           user_data, &len, &phases);
+  kv_phase_end(engine, &phases, KV_OP_RETRIEVE);
+  kv_op_finish(engine, KV_OP_RETRIEVE, start, key, key_len, res,
+               res == KV_SUCCESS ? len : 0);
+  if (res == KV_SUCCESS && value_len) {
+    *value_len = len;
+  }
+  return res;
+}
+
+/* ============================================================================
+ * Streams
+ * ============================================================================
+ */
+
+/* A ranged read of a read stream's value into one of its buffers */
+typedef struct {
+  kv_stripe_range_t range;
+  bool pending; /* issued, not yet waited for */
+} stream_segment_t;
+
+/* Segments are queued in a ring from head: the one holding pos first, then
+ * reads ahead of it, up to KV_STREAM_SEGMENTS */
+struct kv_read_stream {
+  kv_engine_t *engine;
+  uint8_t key[255];
+  size_t key_len;
+  bool chunked;
+  kv_stripe_manifest_t manifest; /* of a chunked value */
+  uint32_t order[KV_MAX_DEVICES + 1]; /* the key's devices, in read order */
+  uint32_t count;
+  uint32_t device; /* position in order of the one a plain value is on */
+  uint64_t value_len;
+  uint64_t pos;  /* next byte for the reader */
+  uint64_t next; /* where the first segment not queued starts */
+  uint32_t head;
+  uint32_t queued;
+  bool rebuilt;      /* a range came from parity */
+  kv_result_t error; /* the read that failed, until a seek */
+  stream_segment_t segment[KV_STREAM_SEGMENTS];
+};
+
+/* Reads the first segment of the value from the first of the key's
+ * devices that has it. If it is a striped key's manifest the stream reads
+ * the chunks instead. */
+static kv_result_t stream_first_segment(kv_read_stream_t *stream,
+                                        const kv_placement_t *placement,
+                                        uint32_t key_hash) {
+  kv_engine_t *engine = stream->engine;
+  size_t segment_size = engine->config.stream_segment_size;
+  stream_segment_t *seg = &stream->segment[0];
+  seg->range.buffer = kv_engine_stream_buffer(engine, segment_size);
+  if (!seg->range.buffer) {
+    return KV_ERR_NO_MEMORY;
+  }
+
+  kvs_key kv_key;
+  kv_key.key = stream->key;
+  kv_key.length = stream->key_len;
+  kvs_option_retrieve option;
+  option.kvs_retrieve_delete = false;
+  kvs_value kv_value;
+  kvs_result kvs_res = KVS_ERR_KEY_NOT_EXIST;
+  for (; stream->device < stream->count; stream->device++) {
+    uint32_t dev_idx = stream->order[stream->device];
+    kv_value = (kvs_value){seg->range.buffer, (uint32_t)segment_size, 0, 0};
+    uint64_t device_start = kv_device_cmd_begin(engine, dev_idx);
+    kvs_res = kvs_retrieve_kvp(engine->devices[dev_idx].keyspace, &kv_key,
+                               &option, &kv_value);
+    kv_device_cmd_end(engine, dev_idx, KV_OP_RETRIEVE, device_start);
+    device_record_result(&engine->devices[dev_idx], kvs_res);
+    if (kvs_res == KVS_SUCCESS || kvs_res == KVS_ERR_BUFFER_SMALL) {
+      break;
+    }
+    if (kvs_res == KVS_ERR_KEY_NOT_EXIST ? !placement->moving
+                                         : !is_device_error(kvs_res)) {
+      break;
+    }
+  }
+  if (kvs_res != KVS_SUCCESS && kvs_res != KVS_ERR_BUFFER_SMALL) {
+    update_stats(engine, 1, 0, 0, 0, 0);
+    if (kvs_res == KVS_ERR_KEY_NOT_EXIST && placement->moving &&
+        stream->count < placement_devices(placement)) {
+      return KV_ERR_DEVICE_DEGRADED;
+    }
+    return map_kvs_result(kvs_res);
+  }
+
+  update_stats(engine, 1, 0, 0, 1, kv_value.length);
+  if (kvs_res == KVS_SUCCESS &&
+      kv_engine_is_striped_key(engine, stream->key, stream->key_len,
+                               key_hash) &&
+      kv_stripe_parse_manifest(seg->range.buffer, kv_value.length,
+                               &stream->manifest)) {
+    stream->chunked = true;
+    stream->value_len = stream->manifest.value_size;
+    KV_STAT_ADD(engine, chunked_retrieves, 1);
+    return KV_SUCCESS;
+  }
+  /* a value that didn't fit the segment tells its size */
+  stream->value_len = kvs_res == KVS_SUCCESS ? kv_value.length
+                                             : kv_value.actual_value_size;
+  seg->range.key = stream->key;
+  seg->range.key_len = stream->key_len;
+  seg->range.offset = 0;
+  seg->range.len = kv_value.length;
+  stream->queued = 1;
+  stream->next = kv_value.length;
+  return KV_SUCCESS;
+}
+
+/* Issues reads for the segments after the queued ones, up to
+ * KV_STREAM_SEGMENTS. A segment ends at the end of a chunk. */
+static kv_result_t stream_issue(kv_read_stream_t *stream) {
+  kv_engine_t *engine = stream->engine;
+  size_t segment_size = engine->config.stream_segment_size;
+  while (stream->queued < KV_STREAM_SEGMENTS &&
+         stream->next < stream->value_len) {
+    stream_segment_t *seg =
+        &stream->segment[(stream->head + stream->queued) % KV_STREAM_SEGMENTS];
+    if (!seg->range.buffer &&
+        !(seg->range.buffer = kv_engine_stream_buffer(engine, segment_size))) {
+      return KV_ERR_NO_MEMORY;
+    }
+    uint64_t left = stream->value_len - stream->next;
+    size_t len = left < segment_size ? (size_t)left : segment_size;
+    if (stream->chunked) {
+      size_t limit = kv_stripe_range_limit(&stream->manifest, stream->next);
+      len = limit < len ? limit : len;
+    }
+    seg->range.key = stream->key;
+    seg->range.key_len = stream->key_len;
+    seg->range.manifest = stream->chunked ? &stream->manifest : NULL;
+    seg->range.offset = stream->next;
+    seg->range.len = len;
+    kv_result_t res = kv_stripe_range_start(engine, &seg->range,
+                                            stream->order[stream->device]);
+    if (res != KV_SUCCESS) {
+      return res;
+    }
+    seg->pending = true;
+    stream->next += len;
+    stream->queued++;
+  }
+  return KV_SUCCESS;
+}
+
+/* Waits for a segment's read. One of a plain value that fails is tried on
+ * the key's other devices, which the later reads then go to. */
+static kv_result_t stream_settle(kv_read_stream_t *stream,
+                                 stream_segment_t *seg) {
+  if (!seg->pending) {
+    return KV_SUCCESS;
+  }
+  kv_engine_t *engine = stream->engine;
+  seg->pending = false;
+  kv_result_t res = kv_stripe_range_finish(engine, &seg->range);
+  while (res != KV_SUCCESS && res != KV_ERR_NO_MEMORY && !stream->chunked &&
+         stream->device + 1 < stream->count) {
+    stream->device++;
+    res = kv_stripe_range_start(engine, &seg->range,
+                                stream->order[stream->device]);
+    if (res == KV_SUCCESS) {
+      res = kv_stripe_range_finish(engine, &seg->range);
+    }
+  }
+  if (res == KV_SUCCESS) {
+    stream->rebuilt |= seg->range.rebuilt;
+    KV_STAT_ADD(engine, bytes_read, seg->range.len);
+  }
+  return res;
+}
+
+/* Drops the head segment, waiting for its read if still in flight */
+static void stream_drop_head(kv_read_stream_t *stream) {
+  stream_segment_t *seg = &stream->segment[stream->head];
+  if (seg->pending) {
+    seg->pending = false;
+    kv_stripe_range_finish(stream->engine, &seg->range);
+  }
+  stream->head = (stream->head + 1) % KV_STREAM_SEGMENTS;
+  stream->queued--;
+}
 
-  device_record_result(&engine->devices[dev_idx], kvs_res);
+kv_result_t kv_engine_open_read_stream(kv_engine_t *engine, const void *key,
+                                       size_t key_len,
+                                       kv_read_stream_t **stream,
+                                       size_t *value_len) {
+  if (!engine || !engine->initialized || !key || !stream) {
+    return KV_ERR_INVALID_PARAM;
+  }
 
-  pthread_mutex_lock(&engine->hash_lock);
-  delete_key(&engine->key_table, key, key_len);
-  pthread_mutex_unlock(&engine->hash_lock);
+  if (key_len < 4 || key_len > 255) {
+    return KV_ERR_INVALID_PARAM;
+  }
+  uint64_t start = kv_latency_start(engine);
 
-  update_stats(engine, 0, 0, 1, kvs_res == KVS_SUCCESS, 0);
-  return map_kvs_result(kvs_res);
+  uint32_t key_hash = kv_engine_key_hash(key, key_len);
+  kv_placement_t placement;
+  kv_engine_place_key(engine, key, key_len, key_hash, &placement);
+  kv_read_stream_t *opened = calloc(1, sizeof(*opened));
+  if (!opened) {
+    return KV_ERR_NO_MEMORY;
+  }
+  opened->engine = engine;
+  memcpy(opened->key, key, key_len);
+  opened->key_len = key_len;
+  opened->count = read_order(engine, &placement, opened->order);
+
+  /* the manifest of a striped value is read under the key's lock stripe,
+   * as by any retrieve; the chunks it names are read after the lock is
+   * dropped and fail the stream if an overwrite deletes them */
+  kv_result_t res = KV_ERR_DEVICE_DEGRADED;
+  if (opened->count > 0) {
+    kv_engine_hot_key_sample(engine, opened->order[0], key_hash, key,
+                             key_len);
+    pthread_rwlock_t *move_lock = NULL;
+    res = KV_SUCCESS;
+    if (placement.moving ||
+        kv_engine_is_striped_key(engine, key, key_len, key_hash)) {
+      move_lock = kv_key_lock(engine, key_hash, false);
+      res = move_lock ? KV_SUCCESS : KV_ERR_BUSY;
+    }
+    if (res == KV_SUCCESS) {
+      res = stream_first_segment(opened, &placement, key_hash);
+    }
+    if (move_lock) {
+      kv_key_unlock(move_lock);
+    }
+  }
+
+  kv_op_finish(engine, KV_OP_RETRIEVE, start, key, key_len, res,
+               res == KV_SUCCESS ? opened->value_len : 0);
+  if (res != KV_SUCCESS) {
+    kv_engine_close_read_stream(opened);
+    return res;
+  }
+  *stream = opened;
+  if (value_len) {
+    *value_len = opened->value_len;
+  }
+  return KV_SUCCESS;
 }
 
-// TODO: discuss if checking both hash table and device is desired behavior
-kv_result_t kv_engine_exists(kv_engine_t *engine, const void *key,
-                             size_t key_len, int *exists) {
-  if (!engine || !engine->initialized || !key || !exists) {
+kv_result_t kv_engine_stream_read(kv_read_stream_t *stream, void *buffer,
+                                  size_t len, size_t *bytes_read) {
+  if (!stream || (!buffer && len) || !bytes_read) {
+    return KV_ERR_INVALID_PARAM;
+  }
+  uint8_t *out = (uint8_t *)buffer;
+  size_t copied = 0;
+  while (stream->error == KV_SUCCESS && copied < len &&
+         stream->pos < stream->value_len) {
+    stream->error = stream_issue(stream);
+    if (stream->error != KV_SUCCESS) {
+      break;
+    }
+    stream_segment_t *seg = &stream->segment[stream->head];
+    stream->error = stream_settle(stream, seg);
+    if (stream->error != KV_SUCCESS) {
+      break;
+    }
+    size_t at = (size_t)(stream->pos - seg->range.offset);
+    size_t n = seg->range.len - at;
+    n = n < len - copied ? n : len - copied;
+    memcpy(out + copied, seg->range.buffer + at, n);
+    copied += n;
+    stream->pos += n;
+    if (at + n == seg->range.len) {
+      stream->head = (stream->head + 1) % KV_STREAM_SEGMENTS;
+      stream->queued--;
+    }
+  }
+  /* refill the window while the caller deals with what it got */
+  if (stream->error == KV_SUCCESS) {
+    stream->error = stream_issue(stream);
+  }
+  *bytes_read = copied;
+  return stream->error;
+}
+
+kv_result_t kv_engine_stream_seek(kv_read_stream_t *stream, uint64_t offset) {
+  if (!stream || offset > stream->value_len) {
+    return KV_ERR_INVALID_PARAM;
+  }
+  /* keep the segment holding offset and those after it, unless a read
+   * failed */
+  while (stream->queued > 0) {
+    const kv_stripe_range_t *range = &stream->segment[stream->head].range;
+    if (stream->error == KV_SUCCESS && offset >= range->offset &&
+        offset < range->offset + range->len) {
+      break;
+    }
+    stream_drop_head(stream);
+  }
+  if (stream->queued == 0) {
+    stream->next = offset & ~(uint64_t)(DMA_ALIGNMENT - 1);
+  }
+  stream->pos = offset;
+  stream->error = KV_SUCCESS;
+  return KV_SUCCESS;
+}
+
+void kv_engine_close_read_stream(kv_read_stream_t *stream) {
+  if (!stream) {
+    return;
+  }
+  while (stream->queued > 0) {
+    stream_drop_head(stream);
+  }
+  for (uint32_t i = 0; i < KV_STREAM_SEGMENTS; i++) {
+    kv_engine_free_buffer(stream->engine, stream->segment[i].range.buffer);
+  }
+  if (stream->rebuilt) {
+    KV_STAT_ADD(stream->engine, reconstructed_retrieves, 1);
+  }
+  free(stream);
+}
+
+/* A value written in pieces: a chunked one goes to the devices as it
+ * comes, under a generation the stream holds, and is swapped in under the
+ * key's lock stripe at close; any other is gathered and stored at close */
+struct kv_write_stream {
+  kv_engine_t *engine;
+  uint8_t key[255];
+  size_t key_len;
+  uint32_t key_hash;
+  size_t value_len;
+  size_t written;
+  bool overwrite;
+  uint8_t *gathered;
+  kv_stripe_writer_t *writer;
+  generation_hold_t hold;
+  kv_result_t error; /* the write that failed */
+};
+
+kv_result_t kv_engine_open_write_stream(kv_engine_t *engine, const void *key,
+                                        size_t key_len, size_t value_len,
+                                        bool overwrite,
+                                        kv_write_stream_t **stream) {
+  kv_result_t res = check_store(engine, key, key_len, value_len);
+  if (res != KV_SUCCESS || !stream) {
+    return stream ? res : KV_ERR_INVALID_PARAM;
+  }
+  kv_write_stream_t *opened = calloc(1, sizeof(*opened));
+  if (!opened) {
+    return KV_ERR_NO_MEMORY;
+  }
+  opened->engine = engine;
+  memcpy(opened->key, key, key_len);
+  opened->key_len = key_len;
+  opened->key_hash = kv_engine_key_hash(key, key_len);
+  opened->value_len = value_len;
+  opened->overwrite = overwrite;
+
+  if (!kv_engine_stripes_value(engine, key_len, value_len)) {
+    opened->gathered =
+        kv_engine_stream_buffer(engine, value_len ? value_len : 1);
+    if (!opened->gathered) {
+      free(opened);
+      return KV_ERR_NO_MEMORY;
+    }
+    *stream = opened;
+    return KV_SUCCESS;
+  }
+
+  /* the checks engine_store makes, then a generation for the chunks,
+   * picked under the key's lock stripe and held until close */
+  kv_placement_t placement;
+  kv_engine_place(engine, opened->key_hash, &placement);
+  res = check_placement_health(engine, &placement);
+  striped_store_t op;
+  if (res == KV_SUCCESS) {
+    kv_engine_hot_key_sample(engine, placement.dev[0], opened->key_hash, key,
+                             key_len);
+    res = striped_store_begin(engine, key, key_len, opened->key_hash,
+                              value_len, overwrite, &op);
+  }
+  if (res == KV_SUCCESS) {
+    opened->hold.key = opened->key;
+    opened->hold.key_len = key_len;
+    uint32_t generation =
+        striped_store_generation(engine, &op, key, key_len, &opened->hold);
+    kv_key_unlock(op.lock);
+    res = kv_stripe_writer_open(engine, key, key_len, opened->key_hash,
+                                generation, value_len, &opened->writer);
+    if (res != KV_SUCCESS) {
+      update_stats(engine, 0, 1, 0, 0, 0);
+      release_generation(engine, &opened->hold);
+    }
+  }
+  if (res != KV_SUCCESS) {
+    free(opened);
+    return res;
+  }
+  *stream = opened;
+  return KV_SUCCESS;
+}
+
+kv_result_t kv_engine_stream_write(kv_write_stream_t *stream, const void *data,
+                                   size_t len) {
+  if (!stream || (!data && len)) {
+    return KV_ERR_INVALID_PARAM;
+  }
+  if (stream->error != KV_SUCCESS) {
+    return stream->error;
+  }
+  if (len > stream->value_len - stream->written) {
+    return KV_ERR_INVALID_PARAM;
+  }
+  if (stream->writer) {
+    stream->error = kv_stripe_writer_write(stream->writer, data, len);
+  } else {
+    memcpy(stream->gathered + stream->written, data, len);
+  }
+  if (stream->error == KV_SUCCESS) {
+    stream->written += len;
+  }
+  return stream->error;
+}
+
+kv_result_t kv_engine_close_write_stream(kv_write_stream_t *stream,
+                                         bool commit) {
+  if (!stream) {
+    return KV_ERR_INVALID_PARAM;
+  }
+  kv_engine_t *engine = stream->engine;
+  uint64_t start = kv_latency_start(engine);
+  kv_phase_timer_t phases;
+  kv_phase_begin(engine, &phases);
+  bool complete = commit && stream->error == KV_SUCCESS &&
+                  stream->written == stream->value_len;
+
+  kv_result_t res;
+  if (stream->writer) {
+    kv_stripe_manifest_t manifest;
+    res = kv_stripe_writer_close(stream->writer, complete, &manifest);
+    kv_phase_mark(&phases, KV_PHASE_DEVICE);
+    /* Only the swap is locked: it replaces whatever value the key holds
+     * now, which may have changed since open */
+    striped_store_t op;
+    if (res == KV_SUCCESS) {
+      res = striped_store_begin(engine, stream->key, stream->key_len,
+                                stream->key_hash, stream->value_len,
+                                stream->overwrite, &op);
+      if (res == KV_SUCCESS) {
+        res = striped_store_manifest(engine, &op, stream->key,
+                                     stream->key_len, stream->key_hash,
+                                     &manifest, stream->overwrite, &phases);
+        striped_store_end(engine, &op, stream->key, stream->key_len,
+                          stream->key_hash, res, &phases);
+      } else {
+        kv_stripe_delete(engine, stream->key, stream->key_len, &manifest);
+      }
+    } else {
+      update_stats(engine, 0, 1, 0, 0, 0);
+    }
+    release_generation(engine, &stream->hold);
+  } else if (complete) {
+    kv_stripe_source_t source = {.data = stream->gathered};
+    res = engine_store(engine, stream->key, stream->key_len, &source,
+                       stream->value_len, stream->overwrite, &phases);
+  } else {
+    res = stream->error != KV_SUCCESS ? stream->error : KV_ERR_ABORTED;
+  }
+  kv_engine_free_buffer(engine, stream->gathered);
+
+  kv_phase_end(engine, &phases, KV_OP_STORE);
+  kv_op_finish(engine, KV_OP_STORE, start, stream->key, stream->key_len, res,
+               res == KV_SUCCESS ? stream->value_len : 0);
+  free(stream);
+  return res;
+}
+
+static kv_result_t engine_delete(kv_engine_t *engine, const void *key,
+                                 size_t key_len) {
+  if (!engine || !engine->initialized || !key) {
     return KV_ERR_INVALID_PARAM;
   }
 
@@ -506,72 +2388,263 @@ kv_result_t kv_engine_exists(kv_engine_t *engine, const void *key,
     return KV_ERR_INVALID_PARAM;
   }
 
-  /* Shard key to a device */
-  uint32_t dev_idx = kv_engine_shard_for_key(key, key_len, engine->num_devices);
-  kvs_key_space_handle keyspace = engine->devices[dev_idx].keyspace;
+  /* Place key on its devices; the same hash picks the key index stripe */
+  uint32_t key_hash = kv_engine_key_hash(key, key_len);
+  kv_placement_t placement;
+  kv_engine_place_key(engine, key, key_len, key_hash, &placement);
 
-  /* Refuse operation if device is unhealthy */
-  kv_result_t health = check_device_health(&engine->devices[dev_idx]);
+  /* Refuse operation if a device is unhealthy */
+  kv_result_t health = check_placement_health(engine, &placement);
   if (health != KV_SUCCESS) {
     return health;
   }
 
-  pthread_mutex_lock(&engine->hash_lock);
-  uint8_t hash_value_check = key_in_table(&engine->key_table, key, key_len);
-  pthread_mutex_unlock(&engine->hash_lock);
+  /* Every copy goes, including a moving key's copy on the dropped device.
+   * A striped value's chunks go with it, under the lock stripe held
+   * exclusively as its stores do. */
+  pthread_rwlock_t *move_lock = NULL;
+  kv_stripe_manifest_t manifest;
+  bool striped = kv_engine_is_striped_key(engine, key, key_len, key_hash);
+  bool has_chunks = false;
+  if (striped || placement.moving) {
+    move_lock = kv_key_lock(engine, key_hash, striped);
+    if (!move_lock) {
+      return KV_ERR_BUSY;
+    }
+  }
+  if (striped) {
+    has_chunks = load_manifest(engine, &placement, key, key_len, &manifest);
+  }
 
-  kvs_key kv_key;
-  kv_key.key = (void *)key;
-  kv_key.length = key_len;
+  kvs_result kvs_res = delete_copies(engine, &placement, key, key_len);
+  if (striped && kvs_res == KVS_SUCCESS) {
+    if (has_chunks) {
+      kv_stripe_delete(engine, key, key_len, &manifest);
+    }
+    delete_key(&engine->striped_keys, key, key_len, key_hash);
+  }
+  if (move_lock) {
+    kv_key_unlock(move_lock);
+  }
 
-  uint8_t result_buffer;
-  kvs_exist_list exist_list;
-  exist_list.num_keys = 1;
-  exist_list.keys = &kv_key;
-  exist_list.length = 1;
-  exist_list.result_buffer = &result_buffer;
+  if (kvs_res == KVS_SUCCESS) {
+    delete_key(&engine->key_table, key, key_len, key_hash);
+  }
 
-  kvs_result kvs_res = kvs_exist_kv_pairs(keyspace, 1, &kv_key, &exist_list);
+  update_stats(engine, 0, 0, 1, kvs_res == KVS_SUCCESS, 0);
+  return map_kvs_result(kvs_res);
+}
 
-  device_record_result(&engine->devices[dev_idx], kvs_res);
+kv_result_t kv_engine_delete(kv_engine_t *engine, const void *key,
+                             size_t key_len) {
+  uint64_t start = kv_latency_start(engine);
+  kv_result_t res = engine_delete(engine, key, key_len);
+  kv_op_finish(engine, KV_OP_DELETE, start, key, key_len, res, 0);
+  return res;
+}
 
-  if (kvs_res != KVS_SUCCESS) {
-    return map_kvs_result(kvs_res);
+/* Existence per the key's devices (under its stripe lock if moving) */
+static kv_result_t exists_on_devices(kv_engine_t *engine,
+                                     const kv_placement_t *placement,
+                                     const uint32_t *order, uint32_t count,
+                                     const void *key, size_t key_len,
+                                     uint32_t key_hash, int *exists) {
+  if (!placement->moving) {
+    return exists_placed(engine, placement, order, count, key, key_len,
+                         exists);
+  }
+
+  pthread_rwlock_t *move_lock = kv_key_lock(engine, key_hash, false);
+  if (!move_lock) {
+    return KV_ERR_BUSY;
+  }
+  kv_result_t res = exists_placed(engine, placement, order, count, key,
+                                  key_len, exists);
+  kv_key_unlock(move_lock);
+  return res;
+}
+
+/* Checks the devices and, when the index is complete, repairs any
+ * disagreement so later index answers are correct */
+static kv_result_t exists_verify(kv_engine_t *engine,
+                                 const kv_placement_t *placement,
+                                 const uint32_t *order, uint32_t count,
+                                 const void *key, size_t key_len,
+                                 uint32_t key_hash, int *exists) {
+  int on_device = 0;
+  kv_result_t res = exists_on_devices(engine, placement, order, count, key,
+                                      key_len, key_hash, &on_device);
+  if (res != KV_SUCCESS) {
+    return res;
+  }
+
+  KV_STAT_ADD(engine, exists_verified, 1);
+
+  if (engine->index_complete) {
+    int in_index = key_in_table(&engine->key_table, key, key_len, key_hash);
+    if (in_index != on_device) {
+      KV_STAT_ADD(engine, index_mismatches, 1);
+      if (on_device) {
+        add_key(&engine->key_table, key, key_len, key_hash);
+        for (uint32_t i = 0; i < placement->count; i++) {
+          kv_engine_filter_add(engine, placement->dev[i], key_hash);
+        }
+      } else {
+        delete_key(&engine->key_table, key, key_len, key_hash);
+        for (uint32_t i = 0; i < placement->count; i++) {
+          kv_engine_filter_note_delete(engine, placement->dev[i]);
+        }
+      }
+    }
   }
 
-  *exists = (result_buffer != 0) && hash_value_check;
+  *exists = on_device;
   return KV_SUCCESS;
 }
 
+static kv_result_t engine_exists(kv_engine_t *engine, const void *key,
+                                 size_t key_len, int *exists) {
+  if (!engine || !engine->initialized || !key || !exists) {
+    return KV_ERR_INVALID_PARAM;
+  }
+
+  if (key_len < 4 || key_len > 255) {
+    return KV_ERR_INVALID_PARAM;
+  }
+
+  uint32_t key_hash = kv_engine_key_hash(key, key_len);
+
+  /* Authoritative index: answer from DRAM, sampling a share of the answers
+   * against the device. Per-thread counter keeps sampling contention-free. */
+  if (engine->index_authoritative) {
+    static _Thread_local uint32_t sample_counter;
+    uint32_t interval = engine->config.exists_verify_interval;
+    if (interval == 0 || ++sample_counter % interval != 0) {
+      *exists = key_in_table(&engine->key_table, key, key_len, key_hash);
+      KV_STAT_ADD(engine, exists_from_index, 1);
+      return KV_SUCCESS;
+    }
+  }
+
+  /* Place key on its devices and refuse if no copy is readable */
+  kv_placement_t placement;
+  kv_engine_place_key(engine, key, key_len, key_hash, &placement);
+  uint32_t order[KV_MAX_DEVICES + 1];
+  uint32_t count = read_order(engine, &placement, order);
+  if (count == 0) {
+    return KV_ERR_DEVICE_DEGRADED;
+  }
+
+  if (engine->index_authoritative) {
+    return exists_verify(engine, &placement, order, count, key, key_len,
+                         key_hash, exists);
+  }
+
+  /* Definitely absent: answer without a device command. A moving key may
+   * still be on its old device, which the filter doesn't cover. */
+  if (!placement.moving &&
+      !kv_engine_filter_may_contain(engine, order[0], key_hash)) {
+    *exists = 0;
+    return KV_SUCCESS;
+  }
+
+  /* Without a complete index, a key must be both indexed by this process
+   * and present on the device */
+  uint8_t hash_value_check =
+      key_in_table(&engine->key_table, key, key_len, key_hash);
+
+  int on_device = 0;
+  kv_result_t res = exists_on_devices(engine, &placement, order, count, key,
+                                      key_len, key_hash, &on_device);
+  if (res != KV_SUCCESS) {
+    return res;
+  }
+
+  *exists = on_device && hash_value_check;
+  return KV_SUCCESS;
+}
+
+kv_result_t kv_engine_exists(kv_engine_t *engine, const void *key,
+                             size_t key_len, int *exists) {
+  uint64_t start = kv_latency_start(engine);
+  kv_result_t res = engine_exists(engine, key, key_len, exists);
+  kv_op_finish(engine, KV_OP_EXISTS, start, key, key_len, res, 0);
+  return res;
+}
+
+static kv_result_t engine_exists_verified(kv_engine_t *engine,
+                                          const void *key, size_t key_len,
+                                          int *exists) {
+  if (!engine || !engine->initialized || !key || !exists) {
+    return KV_ERR_INVALID_PARAM;
+  }
+
+  if (key_len < 4 || key_len > 255) {
+    return KV_ERR_INVALID_PARAM;
+  }
+
+  uint32_t key_hash = kv_engine_key_hash(key, key_len);
+  kv_placement_t placement;
+  kv_engine_place_key(engine, key, key_len, key_hash, &placement);
+  uint32_t order[KV_MAX_DEVICES + 1];
+  uint32_t count = read_order(engine, &placement, order);
+  if (count == 0) {
+    return KV_ERR_DEVICE_DEGRADED;
+  }
+
+  return exists_verify(engine, &placement, order, count, key, key_len,
+                       key_hash, exists);
+}
+
+kv_result_t kv_engine_exists_verified(kv_engine_t *engine, const void *key,
+                                      size_t key_len, int *exists) {
+  uint64_t start = kv_latency_start(engine);
+  kv_result_t res = engine_exists_verified(engine, key, key_len, exists);
+  kv_op_finish(engine, KV_OP_EXISTS, start, key, key_len, res, 0);
+  return res;
+}
+
 /* ============================================================================
  * Statistics
  * ============================================================================
  */
 
+_Thread_local uint32_t kv_stats_thread_slot;
+static _Atomic uint32_t next_stats_slot;
+
+uint32_t kv_engine_assign_stats_slot(void) {
+  /* slots are 1-based so 0 can mean "unassigned" */
+  kv_stats_thread_slot = atomic_fetch_add(&next_stats_slot, 1) + 1;
+  return kv_stats_thread_slot;
+}
+
 void update_stats(kv_engine_t *engine, int is_read, int is_write, int is_delete,
                   int success, size_t bytes) {
-  pthread_mutex_lock(&engine->stats_lock);
+  if (!engine->stats_slots) {
+    return;
+  }
+
+  kv_stats_slot_t *slot = kv_engine_stats_slot(engine);
 
-  engine->stats.total_ops++;
+  atomic_fetch_add_explicit(&slot->total_ops, 1, memory_order_relaxed);
 
   if (is_read)
-    engine->stats.read_ops++;
+    atomic_fetch_add_explicit(&slot->read_ops, 1, memory_order_relaxed);
   if (is_write)
-    engine->stats.write_ops++;
+    atomic_fetch_add_explicit(&slot->write_ops, 1, memory_order_relaxed);
   if (is_delete)
-    engine->stats.delete_ops++;
+    atomic_fetch_add_explicit(&slot->delete_ops, 1, memory_order_relaxed);
 
   if (!success) {
-    engine->stats.failed_ops++;
+    atomic_fetch_add_explicit(&slot->failed_ops, 1, memory_order_relaxed);
   }
 
   if (is_read && success) {
-    engine->stats.bytes_read += bytes;
+    atomic_fetch_add_explicit(&slot->bytes_read, bytes, memory_order_relaxed);
   } else if (is_write && success) {
-    engine->stats.bytes_written += bytes;
+    atomic_fetch_add_explicit(&slot->bytes_written, bytes,
+                              memory_order_relaxed);
   }
-
-  pthread_mutex_unlock(&engine->stats_lock);
 }
 
 kv_result_t kv_engine_get_stats(kv_engine_t *engine, kv_engine_stats_t *stats) {
@@ -579,9 +2652,68 @@ kv_result_t kv_engine_get_stats(kv_engine_t *engine, kv_engine_stats_t *stats) {
     return KV_ERR_INVALID_PARAM;
   }
 
-  pthread_mutex_lock(&engine->stats_lock);
-  *stats = engine->stats;
-  pthread_mutex_unlock(&engine->stats_lock);
+  memset(stats, 0, sizeof(*stats));
+
+  /* Sum the per-thread slots. Counters are read individually, so a snapshot
+   * taken under load may be off by the operations in flight. */
+  for (uint32_t i = 0; engine->stats_slots && i < KV_STATS_SLOTS; i++) {
+    kv_stats_slot_t *slot = &engine->stats_slots[i];
+    stats->total_ops += atomic_load_explicit(&slot->total_ops,
+                                             memory_order_relaxed);
+    stats->read_ops += atomic_load_explicit(&slot->read_ops,
+                                            memory_order_relaxed);
+    stats->write_ops += atomic_load_explicit(&slot->write_ops,
+                                             memory_order_relaxed);
+    stats->delete_ops += atomic_load_explicit(&slot->delete_ops,
+                                              memory_order_relaxed);
+    stats->failed_ops += atomic_load_explicit(&slot->failed_ops,
+                                              memory_order_relaxed);
+    stats->bytes_written += atomic_load_explicit(&slot->bytes_written,
+                                                 memory_order_relaxed);
+    stats->bytes_read += atomic_load_explicit(&slot->bytes_read,
+                                              memory_order_relaxed);
+    stats->filter_negatives += atomic_load_explicit(&slot->filter_negatives,
+                                                    memory_order_relaxed);
+    stats->exists_from_index += atomic_load_explicit(&slot->exists_from_index,
+                                                     memory_order_relaxed);
+    stats->exists_verified += atomic_load_explicit(&slot->exists_verified,
+                                                   memory_order_relaxed);
+    stats->index_mismatches += atomic_load_explicit(&slot->index_mismatches,
+                                                    memory_order_relaxed);
+    stats->hedged_reads += atomic_load_explicit(&slot->hedged_reads,
+                                                memory_order_relaxed);
+    stats->hedge_wins += atomic_load_explicit(&slot->hedge_wins,
+                                              memory_order_relaxed);
+    stats->chunked_stores += atomic_load_explicit(&slot->chunked_stores,
+                                                  memory_order_relaxed);
+    stats->chunked_retrieves += atomic_load_explicit(
+        &slot->chunked_retrieves, memory_order_relaxed);
+    stats->reconstructed_retrieves += atomic_load_explicit(
+        &slot->reconstructed_retrieves, memory_order_relaxed);
+  }
+
+  stats->index_keys = table_key_count(&engine->key_table);
+  stats->index_bytes = table_memory_bytes(&engine->key_table);
+  stats->index_bytes_per_key =
+      stats->index_keys > 0
+          ? (double)stats->index_bytes / (double)stats->index_keys
+          : 0.0;
+
+  stats->filter_bytes = kv_engine_filter_memory_bytes(engine);
+
+  /* mean engine call latency, weighted across op types */
+  if (engine->latency) {
+    double weighted_ns = 0.0;
+    uint64_t samples = 0;
+    for (int op = 0; op < KV_OP_TYPES; op++) {
+      latency_summary_t summary;
+      latency_histogram_summarize(&engine->latency->op[op], &summary);
+      weighted_ns += summary.mean_ns * (double)summary.count;
+      samples += summary.count;
+    }
+    stats->avg_latency_us =
+        samples > 0 ? weighted_ns / (double)samples / 1000.0 : 0.0;
+  }
 
   return KV_SUCCESS;
 }
@@ -591,9 +2723,148 @@ void kv_engine_reset_stats(kv_engine_t *engine) {
     return;
   }
 
-  pthread_mutex_lock(&engine->stats_lock);
-  memset(&engine->stats, 0, sizeof(kv_engine_stats_t));
-  pthread_mutex_unlock(&engine->stats_lock);
+  for (uint32_t i = 0; engine->stats_slots && i < KV_STATS_SLOTS; i++) {
+    kv_stats_slot_t *slot = &engine->stats_slots[i];
+    atomic_store(&slot->total_ops, 0);
+    atomic_store(&slot->read_ops, 0);
+    atomic_store(&slot->write_ops, 0);
+    atomic_store(&slot->delete_ops, 0);
+    atomic_store(&slot->failed_ops, 0);
+    atomic_store(&slot->bytes_written, 0);
+    atomic_store(&slot->bytes_read, 0);
+    atomic_store(&slot->filter_negatives, 0);
+    atomic_store(&slot->exists_from_index, 0);
+    atomic_store(&slot->exists_verified, 0);
+    atomic_store(&slot->index_mismatches, 0);
+    atomic_store(&slot->hedged_reads, 0);
+    atomic_store(&slot->hedge_wins, 0);
+    atomic_store(&slot->chunked_stores, 0);
+    atomic_store(&slot->chunked_retrieves, 0);
+    atomic_store(&slot->reconstructed_retrieves, 0);
+  }
+
+  if (engine->latency) {
+    latency_histogram_t *hists = (latency_histogram_t *)engine->latency;
+    size_t count = sizeof(kv_latency_hists_t) / sizeof(latency_histogram_t);
+    for (size_t i = 0; i < count; i++) {
+      latency_histogram_reset(&hists[i]);
+    }
+  }
+
+  if (engine->phase_timing) {
+    for (int op = 0; op < KV_OP_TYPES; op++) {
+      for (int phase = 0; phase < KV_PHASES; phase++) {
+        latency_histogram_reset(&engine->phase_timing->phase[op][phase]);
+      }
+    }
+  }
+}
+
+kv_result_t kv_engine_get_runtime_info(kv_engine_t *engine,
+                                       kv_runtime_info_t *info) {
+  if (!engine || !engine->initialized || !info) {
+    return KV_ERR_INVALID_PARAM;
+  }
+
+  memset(info, 0, sizeof(*info));
+
+  if (engine->workers) {
+    info->worker_threads = engine->workers->num_threads;
+    info->active_workers = thread_pool_active(engine->workers);
+    info->queue_depth = thread_pool_queue_size(engine->workers);
+    info->queue_capacity = engine->workers->queue_capacity;
+  }
+
+  uint32_t num_devices = engine->num_devices;
+  info->num_devices = num_devices;
+  for (uint32_t i = 0; i < num_devices; i++) {
+    info->in_flight[i] = atomic_load_explicit(&engine->devices[i].in_flight,
+                                              memory_order_relaxed);
+  }
+
+  if (engine->buffer_pool) {
+    info->dma_buffer_size = engine->buffer_pool->buffer_size;
+    info->dma_buffers_total = engine->buffer_pool->count;
+    info->dma_buffers_free = dma_pool_available(engine->buffer_pool);
+    info->dma_pool_exhausted = dma_pool_exhausted_count(engine->buffer_pool);
+  }
+  info->dma_fallback_allocs = atomic_load_explicit(
+      &engine->dma_fallback_allocs, memory_order_relaxed);
+
+  info->memory_pool_used = memory_pool_used(engine->mem_pool);
+  info->memory_pool_size = engine->mem_pool->size;
+
+  info->index_keys = table_key_count(&engine->key_table);
+  info->index_capacity = table_capacity(&engine->key_table);
+  info->index_tombstones = table_tombstone_count(&engine->key_table);
+  info->index_load_factor =
+      info->index_capacity > 0
+          ? (double)(info->index_keys + info->index_tombstones) /
+                (double)info->index_capacity
+          : 0.0;
+  info->index_max_stripe_load = table_max_stripe_load(&engine->key_table);
+  info->index_bytes = table_memory_bytes(&engine->key_table);
+
+  return KV_SUCCESS;
+}
+
+static void summarize_latency(const latency_histogram_t *hist,
+                              kv_latency_summary_t *out) {
+  latency_summary_t summary;
+  latency_histogram_summarize(hist, &summary);
+  out->count = summary.count;
+  out->mean_us = summary.mean_ns / 1000.0;
+  out->p50_us = summary.p50_ns / 1000.0;
+  out->p90_us = summary.p90_ns / 1000.0;
+  out->p99_us = summary.p99_ns / 1000.0;
+  out->p999_us = summary.p999_ns / 1000.0;
+  out->max_us = summary.max_ns / 1000.0;
+}
+
+kv_result_t kv_engine_get_latency_stats(kv_engine_t *engine,
+                                        kv_latency_stats_t *stats) {
+  if (!engine || !stats) {
+    return KV_ERR_INVALID_PARAM;
+  }
+
+  memset(stats, 0, sizeof(*stats));
+  stats->num_devices = engine->num_devices;
+  if (!engine->latency) {
+    return KV_SUCCESS;
+  }
+
+  for (int op = 0; op < KV_OP_TYPES; op++) {
+    summarize_latency(&engine->latency->op[op], &stats->op[op]);
+    summarize_latency(&engine->latency->queue_wait[op],
+                      &stats->queue_wait[op]);
+    summarize_latency(&engine->latency->async_total[op],
+                      &stats->async_total[op]);
+    for (uint32_t dev = 0; dev < stats->num_devices; dev++) {
+      summarize_latency(&engine->latency->device[dev][op],
+                        &stats->device[dev][op]);
+    }
+  }
+  return KV_SUCCESS;
+}
+
+kv_result_t kv_engine_get_phase_stats(kv_engine_t *engine,
+                                      kv_phase_stats_t *stats) {
+  if (!engine || !stats) {
+    return KV_ERR_INVALID_PARAM;
+  }
+
+  memset(stats, 0, sizeof(*stats));
+  if (!engine->phase_timing) {
+    return KV_SUCCESS;
+  }
+
+  for (int op = 0; op < KV_OP_TYPES; op++) {
+    for (int phase = 0; phase < KV_PHASES; phase++) {
+      summarize_latency(&engine->phase_timing->phase[op][phase],
+                        &stats->phase[op][phase]);
+    }
+  }
+  return KV_SUCCESS;
 }
 
 void *kv_engine_alloc_buffer(kv_engine_t *engine, size_t size) {
@@ -606,10 +2877,49 @@ void *kv_engine_alloc_buffer(kv_engine_t *engine, size_t size) {
   return dma_alloc(size);
 }
 
+void *kv_engine_stream_buffer(kv_engine_t *engine, size_t size) {
+  if (engine->stream_pool && size <= engine->stream_pool->buffer_size) {
+    void *buf = dma_pool_acquire(engine->stream_pool);
+    if (buf) {
+      return buf;
+    }
+  }
+  return kv_engine_alloc_buffer(engine, size);
+}
+
 void kv_engine_free_buffer(kv_engine_t *engine, void *buffer) {
   if (engine->buffer_pool && dma_pool_owns(engine->buffer_pool, buffer)) {
     dma_pool_release(engine->buffer_pool, buffer);
     return;
   }
+  if (engine->stream_pool && dma_pool_owns(engine->stream_pool, buffer)) {
+    dma_pool_release(engine->stream_pool, buffer);
+    return;
+  }
   dma_free(buffer);
 }
+
+kv_result_t kv_engine_register_buffers(kv_engine_t *engine,
+                                       const kv_buffer_t *buffers,
+                                       uint32_t count) {
+  if (!engine || !engine->initialized || (!buffers && count > 0)) {
+    return KV_ERR_INVALID_PARAM;
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    if (buffer_registry_add(engine->registered_buffers, buffers[i].base,
+                            buffers[i].len) != 0) {
+      return KV_ERR_INVALID_PARAM;
+    }
+  }
+  return KV_SUCCESS;
+}
+
+kv_result_t kv_engine_unregister_buffers(kv_engine_t *engine) {
+  if (!engine || !engine->initialized) {
+    return KV_ERR_INVALID_PARAM;
+  }
+
+  buffer_registry_clear(engine->registered_buffers);
+  return KV_SUCCESS;
+}
@@ -0,0 +1,250 @@
+/**
+ * Per-Device Negative Lookup Filters
+ *
+ * Each device gets a Bloom filter of the keys stored on it, so retrieve and
+ * exists can answer "not found" without a device command or a 2MB buffer.
+ * With replication a key is in the filter of every device holding a copy.
+ * A filter is only trustworthy if it has seen every key on its device, so
+ * filters are built from the key index and only when index recovery
+ * completed at init.
+ *
+ * Stores add to the filter before issuing the device command. Deletes can't
+ * clear bits, so the health probe thread rebuilds filters whose delete count
+ * makes them stale at each sweep; a filter that outgrows its sized capacity
+ * wakes the probe thread for an immediate rebuild. A rebuild:
+ *
+ *   1. publish an empty filter as filter_next; stores now add to both
+ *   2. walk the key index and add every key on the device to filter_next
+ *   3. swap filter_next in as the live filter
+ *
+ * After kv_engine_add_device the new device has no filter (every lookup goes
+ * to it) until its migration finishes and asks for a rebuild of all
+ * filters, which also clears the moved keys from the old devices' filters.
+ *
+ * Stores update the index before reading filter_next, so any key missed by
+ * the walk was added to filter_next directly. The replaced filter is kept
+ * until the next rebuild of that device before it is freed; since each
+ * rebuild doubles the sized capacity, that is at least as many stores later
+ * as the device holds keys (or a probe interval), which gives lock-free
+ * readers still holding the old pointer ample time to finish.
+ */
+
+#include "kv_engine_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Filters are sized for twice the keys present at build time, with a floor
+ * so small devices don't rebuild on every probe */
+#define FILTER_MIN_KEYS 4096
+#define FILTER_HEADROOM 2
+
+typedef struct {
+  kv_engine_t *engine;
+  bool rebuilding[KV_MAX_DEVICES];
+} filter_rebuild_t;
+
+uint64_t kv_engine_filter_hash(uint32_t key_hash) {
+  /* murmur3 fmix64: spreads the 32-bit shard hash over 64 bits so the
+   * filter's block and probe bits don't correlate with device placement */
+  uint64_t h = key_hash;
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+static int add_to_next_filter(const void *key, uint32_t key_len, void *arg) {
+  filter_rebuild_t *rebuild = (filter_rebuild_t *)arg;
+  kv_engine_t *engine = rebuild->engine;
+  uint32_t key_hash = kv_engine_key_hash(key, key_len);
+  kv_placement_t placement;
+  kv_engine_place_key(engine, key, key_len, key_hash, &placement);
+
+  for (uint32_t i = 0; i < placement.count; i++) {
+    uint32_t dev_idx = placement.dev[i];
+    if (rebuild->rebuilding[dev_idx]) {
+      bloom_filter_t *next =
+          atomic_load(&engine->devices[dev_idx].filter_next);
+      bloom_filter_add(next, kv_engine_filter_hash(key_hash));
+    }
+  }
+  return 0;
+}
+
+/* Rebuilds the filters of every device flagged in rebuild->rebuilding.
+ * Returns KV_ERR_NO_MEMORY if a filter couldn't be allocated; the affected
+ * devices keep their current filter. */
+static kv_result_t rebuild_filters(filter_rebuild_t *rebuild) {
+  kv_engine_t *engine = rebuild->engine;
+  uint32_t num_devices = engine->num_devices;
+  uint64_t per_device = table_key_count(&engine->key_table) *
+                        kv_engine_replica_count(engine, num_devices) /
+                        num_devices;
+  uint64_t expected = per_device * FILTER_HEADROOM;
+  if (expected < FILTER_MIN_KEYS) {
+    expected = FILTER_MIN_KEYS;
+  }
+
+  kv_result_t result = KV_SUCCESS;
+  bool any = false;
+  for (uint32_t i = 0; i < num_devices; i++) {
+    if (!rebuild->rebuilding[i]) {
+      continue;
+    }
+    bloom_filter_t *next =
+        bloom_filter_create(expected, engine->config.bloom_bits_per_key);
+    if (!next) {
+      rebuild->rebuilding[i] = false;
+      result = KV_ERR_NO_MEMORY;
+      continue;
+    }
+    atomic_store(&engine->devices[i].filter_next, next);
+    any = true;
+  }
+
+  if (!any) {
+    return result;
+  }
+
+  table_for_each(&engine->key_table, add_to_next_filter, rebuild);
+
+  for (uint32_t i = 0; i < num_devices; i++) {
+    if (!rebuild->rebuilding[i]) {
+      continue;
+    }
+    kv_device_ctx_t *dev = &engine->devices[i];
+    bloom_filter_t *next = atomic_load(&dev->filter_next);
+
+    bloom_filter_destroy(dev->filter_retired);
+    dev->filter_retired = atomic_exchange(&dev->filter, next);
+    atomic_store(&dev->filter_next, NULL);
+    atomic_store(&dev->filter_deletes, 0);
+    atomic_store(&dev->filter_rebuild_requested, false);
+  }
+  return result;
+}
+
+kv_result_t kv_engine_filter_init(kv_engine_t *engine) {
+  if (engine->config.bloom_bits_per_key == 0) {
+    return KV_SUCCESS;
+  }
+  if (!engine->index_complete) {
+    fprintf(stderr, "[kv_engine] warning: bloom filter needs a complete key "
+                    "index (recover_index = 1); filter disabled\n");
+    return KV_SUCCESS;
+  }
+
+  filter_rebuild_t rebuild = {.engine = engine};
+  for (uint32_t i = 0; i < engine->num_devices; i++) {
+    rebuild.rebuilding[i] = true;
+  }
+  return rebuild_filters(&rebuild);
+}
+
+void kv_engine_filter_maintain(kv_engine_t *engine) {
+  filter_rebuild_t rebuild = {.engine = engine};
+  bool stale = false;
+
+  bool enabled = engine->config.bloom_bits_per_key > 0 &&
+                 engine->index_complete;
+
+  for (uint32_t i = 0; i < engine->num_devices; i++) {
+    kv_device_ctx_t *dev = &engine->devices[i];
+    bloom_filter_t *filter = atomic_load(&dev->filter);
+    bool requested = atomic_load(&dev->filter_rebuild_requested);
+    if (!filter) {
+      /* a device added at runtime gets its first filter on request */
+      if (enabled && requested) {
+        rebuild.rebuilding[i] = true;
+        stale = true;
+      }
+      continue;
+    }
+    uint64_t inserts = atomic_load_explicit(&filter->count,
+                                            memory_order_relaxed);
+    uint64_t deletes = atomic_load(&dev->filter_deletes);
+
+    /* rebuild once a quarter of the inserted keys are gone, the filter
+     * holds more keys than it was sized for, or a rebuild was requested */
+    if (deletes * 4 > inserts || inserts > filter->capacity || requested) {
+      rebuild.rebuilding[i] = true;
+      stale = true;
+    }
+  }
+
+  if (stale) {
+    rebuild_filters(&rebuild);
+  }
+}
+
+void kv_engine_filter_rebuild_all(kv_engine_t *engine) {
+  for (uint32_t i = 0; i < engine->num_devices; i++) {
+    atomic_store(&engine->devices[i].filter_rebuild_requested, true);
+  }
+  health_probe_wake(engine->health_probe);
+}
+
+void kv_engine_filter_add(kv_engine_t *engine, uint32_t dev_idx,
+                          uint32_t key_hash) {
+  kv_device_ctx_t *dev = &engine->devices[dev_idx];
+  bloom_filter_t *filter = atomic_load(&dev->filter);
+  if (!filter) {
+    return;
+  }
+
+  uint64_t hash = kv_engine_filter_hash(key_hash);
+  bloom_filter_add(filter, hash);
+
+  /* Past its sized capacity the false positive rate climbs quickly, so ask
+   * the probe thread for a rebuild now instead of at its next sweep */
+  if (atomic_load_explicit(&filter->count, memory_order_relaxed) >
+          filter->capacity &&
+      !atomic_exchange(&dev->filter_rebuild_requested, true)) {
+    health_probe_wake(engine->health_probe);
+  }
+
+  bloom_filter_t *next = atomic_load(&dev->filter_next);
+  if (next) {
+    bloom_filter_add(next, hash);
+  }
+}
+
+void kv_engine_filter_note_delete(kv_engine_t *engine, uint32_t dev_idx) {
+  kv_device_ctx_t *dev = &engine->devices[dev_idx];
+  if (atomic_load_explicit(&dev->filter, memory_order_relaxed)) {
+    atomic_fetch_add_explicit(&dev->filter_deletes, 1, memory_order_relaxed);
+  }
+}
+
+bool kv_engine_filter_may_contain(kv_engine_t *engine, uint32_t dev_idx,
+                                  uint32_t key_hash) {
+  bloom_filter_t *filter = atomic_load(&engine->devices[dev_idx].filter);
+  if (!filter) {
+    return true;
+  }
+  if (bloom_filter_may_contain(filter, kv_engine_filter_hash(key_hash))) {
+    return true;
+  }
+  KV_STAT_ADD(engine, filter_negatives, 1);
+  return false;
+}
+
+uint64_t kv_engine_filter_memory_bytes(kv_engine_t *engine) {
+  uint64_t bytes = 0;
+  for (uint32_t i = 0; i < engine->num_devices; i++) {
+    bytes += bloom_filter_memory_bytes(atomic_load(&engine->devices[i].filter));
+  }
+  return bytes;
+}
+
+void kv_engine_filter_destroy(kv_engine_t *engine) {
+  for (uint32_t i = 0; i < engine->num_devices; i++) {
+    kv_device_ctx_t *dev = &engine->devices[i];
+    bloom_filter_destroy(atomic_exchange(&dev->filter, NULL));
+    bloom_filter_destroy(atomic_exchange(&dev->filter_next, NULL));
+    bloom_filter_destroy(dev->filter_retired);
+    dev->filter_retired = NULL;
+  }
+}
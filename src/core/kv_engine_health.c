@@ -5,6 +5,25 @@
  * and the background probe thread that periodically retries unhealthy devices
  * and re-marks them healthy after a configurable number of consecutive
  * successful probes.
+ *
+ * The probe also samples every device's capacity and utilization once per
+ * sweep into a short per-device history, so health reads and metrics
+ * scrapes never issue device queries of their own.
+ *
+ * With hedged reads configured, every read's device latency also goes into
+ * a per-device histogram, and each KV_HEDGE_WINDOW reads the device's hedge
+ * delay is reset to the configured percentile of that window. A device that
+ * slows down (garbage collection, a noisy neighbour) therefore raises its
+ * own delay within a window instead of hedging every read.
+ *
+ * With slow_device_factor set, every device command's latency is recorded
+ * per device too, and each probe sweep folds the sweep's mean into a
+ * moving average. A device whose average reaches slow_device_factor times
+ * the median of its peers' is flagged slow: reads go to its peers' copies
+ * while any are usable, and the probe keeps timing a few commands of its
+ * own against it. The flag clears after recovery_threshold consecutive
+ * sweeps back under the factor, like an unhealthy device's recovery. An
+ * answer that takes 50ms hurts more than an error the caller can retry.
  */
 
 #include "kv_engine_internal.h"
@@ -14,6 +33,230 @@
 #include <string.h>
 #include <time.h>
 
+/* ============================================================================
+ * Device Telemetry
+ * ============================================================================
+ */
+
+static uint64_t wall_clock_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+kvs_result kv_engine_sample_device(kv_device_ctx_t *dev) {
+  kv_device_sample_t sample = {.timestamp_ms = wall_clock_ms()};
+
+  kvs_result res = kvs_get_device_utilization(dev->device,
+                                              &sample.utilization_pct);
+  if (res != KVS_SUCCESS ||
+      kvs_get_device_capacity(dev->device, &sample.capacity_bytes) !=
+          KVS_SUCCESS) {
+    return res;
+  }
+
+  /* seqlock write: odd sequence while the slot is being overwritten */
+  uint64_t seq = atomic_load_explicit(&dev->telemetry_seq,
+                                      memory_order_relaxed);
+  atomic_store_explicit(&dev->telemetry_seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  dev->telemetry[dev->telemetry_count % KV_TELEMETRY_HISTORY] = sample;
+  dev->telemetry_count++;
+  atomic_store_explicit(&dev->telemetry_seq, seq + 2, memory_order_release);
+  return res;
+}
+
+uint32_t kv_engine_read_telemetry(kv_device_ctx_t *dev,
+                                  kv_device_sample_t *samples) {
+  kv_device_sample_t ring[KV_TELEMETRY_HISTORY];
+  uint64_t count;
+
+  for (;;) {
+    uint64_t seq = atomic_load_explicit(&dev->telemetry_seq,
+                                        memory_order_acquire);
+    if (seq & 1) {
+      continue;
+    }
+    count = dev->telemetry_count;
+    memcpy(ring, dev->telemetry, sizeof(ring));
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&dev->telemetry_seq, memory_order_relaxed) ==
+        seq) {
+      break;
+    }
+  }
+
+  /* unroll the ring, oldest first */
+  uint32_t n = count < KV_TELEMETRY_HISTORY ? (uint32_t)count
+                                            : KV_TELEMETRY_HISTORY;
+  uint64_t first = count - n;
+  for (uint32_t i = 0; i < n; i++) {
+    samples[i] = ring[(first + i) % KV_TELEMETRY_HISTORY];
+  }
+  return n;
+}
+
+/* ============================================================================
+ * Read Latency
+ * ============================================================================
+ */
+
+kv_result_t kv_engine_track_latency(kv_engine_t *engine, uint32_t dev_idx) {
+  kv_device_ctx_t *dev = &engine->devices[dev_idx];
+  atomic_store(&dev->read_samples, 0);
+  atomic_store(&dev->hedge_after_ns, 0);
+  atomic_store(&dev->read_window_busy, false);
+  atomic_store(&dev->latency_ewma_ns, 0);
+  atomic_store(&dev->latency_p99_ns, 0);
+  atomic_store(&dev->slow, false);
+
+  if (engine->config.hedge_percentile > 0 &&
+      engine->config.replication_factor > 1) {
+    dev->read_latency = calloc(1, sizeof(latency_histogram_t));
+    dev->read_window = calloc(LATENCY_BUCKETS, sizeof(uint64_t));
+    if (!dev->read_latency || !dev->read_window) {
+      return KV_ERR_NO_MEMORY; /* freed by kv_engine_close_device */
+    }
+  }
+  if (engine->config.slow_device_factor > 0) {
+    dev->cmd_latency = calloc(1, sizeof(latency_histogram_t));
+    dev->cmd_window = calloc(LATENCY_BUCKETS, sizeof(uint64_t));
+    if (!dev->cmd_latency || !dev->cmd_window) {
+      return KV_ERR_NO_MEMORY;
+    }
+  }
+  return KV_SUCCESS;
+}
+
+void kv_engine_note_read_latency(kv_engine_t *engine, uint32_t dev_idx,
+                                 uint64_t elapsed_ns) {
+  kv_device_ctx_t *dev = &engine->devices[dev_idx];
+  latency_histogram_record(dev->read_latency, elapsed_ns);
+
+  uint64_t samples = atomic_fetch_add_explicit(&dev->read_samples, 1,
+                                               memory_order_relaxed) +
+                     1;
+  if (samples % KV_HEDGE_WINDOW != 0) {
+    return;
+  }
+  /* the window's last reader closes it; a reader that closes the next one
+   * while this is still running skips it and the window grows by one */
+  if (atomic_exchange_explicit(&dev->read_window_busy, true,
+                               memory_order_acquire)) {
+    return;
+  }
+  uint64_t delay = latency_histogram_window_percentile(
+      dev->read_latency, dev->read_window,
+      engine->config.hedge_percentile / 100.0);
+  atomic_store_explicit(&dev->hedge_after_ns, delay, memory_order_relaxed);
+  atomic_store_explicit(&dev->read_window_busy, false, memory_order_release);
+}
+
+/* ============================================================================
+ * Slow Devices
+ * ============================================================================
+ */
+
+/* Timed existence checks, so a slow device is still measured while reads
+ * avoid it */
+static void probe_slow_device(kv_engine_t *engine, uint32_t dev_idx) {
+  static const char probe_key[] = KV_INTERNAL_KEY_PREFIX "probe";
+  kvs_key kv_key;
+  kv_key.key = (void *)probe_key;
+  kv_key.length = sizeof(probe_key) - 1;
+
+  uint8_t result_buffer;
+  kvs_exist_list exist_list;
+  exist_list.num_keys = 1;
+  exist_list.keys = &kv_key;
+  exist_list.length = 1;
+  exist_list.result_buffer = &result_buffer;
+
+  for (int i = 0; i < KV_SLOW_MIN_SAMPLES; i++) {
+    uint64_t start = kv_device_cmd_begin(engine, dev_idx);
+    kvs_exist_kv_pairs(engine->devices[dev_idx].keyspace, 1, &kv_key,
+                       &exist_list);
+    kv_device_cmd_end(engine, dev_idx, KV_OP_EXISTS, start);
+  }
+}
+
+/* Median latency average of the devices other than dev_idx that are
+ * healthy, not slow and measured; 0 if there are none */
+static uint64_t peer_latency(kv_engine_t *engine, uint32_t num_devices,
+                             uint32_t dev_idx) {
+  uint64_t peers[KV_MAX_DEVICES];
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < num_devices; i++) {
+    kv_device_ctx_t *dev = &engine->devices[i];
+    uint64_t ewma = atomic_load(&dev->latency_ewma_ns);
+    if (i == dev_idx || ewma == 0 || !atomic_load(&dev->healthy) ||
+        atomic_load(&dev->slow)) {
+      continue;
+    }
+    /* insertion sort; n is at most KV_MAX_DEVICES */
+    uint32_t pos = n++;
+    while (pos > 0 && peers[pos - 1] > ewma) {
+      peers[pos] = peers[pos - 1];
+      pos--;
+    }
+    peers[pos] = ewma;
+  }
+  if (n == 0) {
+    return 0;
+  }
+  return n % 2 ? peers[n / 2] : (peers[n / 2 - 1] + peers[n / 2]) / 2;
+}
+
+/* One sweep: update every device's latency average from the commands since
+ * the last sweep, then flag or re-admit devices against their peers */
+static void detect_slow_devices(kv_engine_t *engine, uint32_t *slow_counts,
+                                uint32_t recovery_threshold) {
+  uint32_t num_devices =
+      atomic_load_explicit(&engine->num_devices, memory_order_acquire);
+  for (uint32_t i = 0; i < num_devices; i++) {
+    kv_device_ctx_t *dev = &engine->devices[i];
+    if (atomic_load(&dev->slow) && atomic_load(&dev->healthy)) {
+      probe_slow_device(engine, i);
+    }
+
+    latency_summary_t window;
+    latency_histogram_window_summarize(dev->cmd_latency, dev->cmd_window,
+                                       &window);
+    if (window.count < KV_SLOW_MIN_SAMPLES) {
+      continue; /* too few to move the average */
+    }
+    /* weight 1/2 per sweep: a device that turns slow is caught within
+     * two or three sweeps */
+    uint64_t mean = (uint64_t)window.mean_ns;
+    uint64_t ewma = atomic_load(&dev->latency_ewma_ns);
+    atomic_store(&dev->latency_ewma_ns, ewma ? ewma / 2 + mean / 2 : mean);
+    atomic_store(&dev->latency_p99_ns, window.p99_ns);
+  }
+
+  uint64_t factor = engine->config.slow_device_factor;
+  for (uint32_t i = 0; i < num_devices; i++) {
+    kv_device_ctx_t *dev = &engine->devices[i];
+    uint64_t ewma = atomic_load(&dev->latency_ewma_ns);
+    uint64_t peers = peer_latency(engine, num_devices, i);
+    if (ewma == 0 || peers == 0) {
+      continue;
+    }
+
+    bool over = ewma >= factor * peers;
+    if (!atomic_load(&dev->slow)) {
+      if (over) {
+        atomic_store(&dev->slow, true);
+        slow_counts[i] = 0;
+      }
+    } else if (over) {
+      slow_counts[i] = 0;
+    } else if (++slow_counts[i] >= recovery_threshold) {
+      atomic_store(&dev->slow, false);
+      slow_counts[i] = 0;
+    }
+  }
+}
+
 /* ============================================================================
  * Background Probe Thread
  * ============================================================================
@@ -25,6 +268,8 @@ static void *health_probe_thread(void *arg) {
 
   /* per-device recovery counters (local to this thread, no sharing needed) */
   uint32_t recovery_counts[KV_MAX_DEVICES] = {0};
+  uint32_t slow_counts[KV_MAX_DEVICES] = {0}; /* sweeps back under the
+                                                 slow factor */
 
   while (atomic_load(&probe->running)) {
     /* sleep for probe_interval_sec, but wake immediately if destroy() signals
@@ -41,15 +286,15 @@ static void *health_probe_thread(void *arg) {
       break;
     }
 
-    /* device recovery loop */
+    /* sample every device; for an unhealthy one the successful query also
+     * counts toward recovery */
     for (uint32_t i = 0; i < engine->num_devices; i++) {
       kv_device_ctx_t *dev = &engine->devices[i];
+      kvs_result res = kv_engine_sample_device(dev);
       if (atomic_load(&dev->healthy)) {
         continue;
       }
 
-      uint32_t utilization;
-      kvs_result res = kvs_get_device_utilization(dev->device, &utilization);
       if (res == KVS_SUCCESS) {
         recovery_counts[i]++;
         if (recovery_counts[i] >= probe->recovery_threshold) {
@@ -61,6 +306,16 @@ static void *health_probe_thread(void *arg) {
         recovery_counts[i] = 0;
       }
     }
+
+    if (engine->config.slow_device_factor) {
+      detect_slow_devices(engine, slow_counts, probe->recovery_threshold);
+    }
+
+    /* rebuild Bloom filters that deletes have made stale */
+    kv_engine_filter_maintain(engine);
+
+    /* close the hot-key / device load window */
+    kv_engine_hot_keys_rotate(engine);
   }
 
   return NULL;
@@ -120,6 +375,15 @@ void health_probe_destroy(health_probe_t *probe) {
   free(probe);
 }
 
+void health_probe_wake(health_probe_t *probe) {
+  if (!probe) {
+    return;
+  }
+  pthread_mutex_lock(&probe->mutex);
+  pthread_cond_signal(&probe->cond);
+  pthread_mutex_unlock(&probe->mutex);
+}
+
 /* ============================================================================
  * Public Health API
  * ============================================================================
@@ -143,33 +407,73 @@ kv_result_t kv_engine_get_device_health(kv_engine_t *engine,
   health->consecutive_errors = atomic_load(&dev->consecutive_errors);
   health->total_errors = atomic_load(&dev->total_errors);
   health->total_ops = atomic_load(&dev->total_ops);
+  health->slow = atomic_load(&dev->slow);
+  health->weight = engine->device_weights[device_index];
+  health->latency_ewma_us = atomic_load(&dev->latency_ewma_ns) / 1000.0;
+  health->latency_p99_us = atomic_load(&dev->latency_p99_ns) / 1000.0;
 
   if (dev->device_path) {
     snprintf(health->device_path, sizeof(health->device_path), "%s",
              dev->device_path);
   }
 
-  /* Query live capacity and utilization from the device. Failures leave
-   * the corresponding field at 0 (from the memset above); log so the caller
-   * can distinguish a real zero from a query failure. */
-  kvs_result cap_res =
-      kvs_get_device_capacity(dev->device, &health->capacity_bytes);
-  if (cap_res != KVS_SUCCESS) {
-    fprintf(stderr,
-            "[health] kvs_get_device_capacity failed for device %u: 0x%x\n",
-            device_index, cap_res);
+  /* Capacity and utilization come from the probe's latest sample; a stale
+   * sample (failed queries) shows up as a growing sample_age_ms */
+  kv_device_sample_t samples[KV_TELEMETRY_HISTORY];
+  uint32_t n = kv_engine_read_telemetry(dev, samples);
+  if (n == 0) {
+    health->sample_age_ms = UINT64_MAX;
+    return KV_SUCCESS;
   }
-  kvs_result util_res =
-      kvs_get_device_utilization(dev->device, &health->utilization_pct);
-  if (util_res != KVS_SUCCESS) {
-    fprintf(stderr,
-            "[health] kvs_get_device_utilization failed for device %u: 0x%x\n",
-            device_index, util_res);
+
+  const kv_device_sample_t *oldest = &samples[0];
+  const kv_device_sample_t *latest = &samples[n - 1];
+  health->capacity_bytes = latest->capacity_bytes;
+  health->utilization_pct = latest->utilization_pct;
+
+  uint64_t now_ms = wall_clock_ms();
+  health->sample_age_ms =
+      now_ms > latest->timestamp_ms ? now_ms - latest->timestamp_ms : 0;
+
+  if (latest->timestamp_ms > oldest->timestamp_ms) {
+    double used_then =
+        (double)oldest->capacity_bytes * oldest->utilization_pct / 10000.0;
+    double used_now =
+        (double)latest->capacity_bytes * latest->utilization_pct / 10000.0;
+    health->fill_rate_bytes_per_sec =
+        (used_now - used_then) * 1000.0 /
+        (double)(latest->timestamp_ms - oldest->timestamp_ms);
   }
 
   return KV_SUCCESS;
 }
 
+kv_result_t kv_engine_get_device_telemetry(kv_engine_t *engine,
+                                           uint32_t device_index,
+                                           kv_device_sample_t *samples,
+                                           uint32_t max_samples,
+                                           uint32_t *count) {
+  if (!engine || !engine->initialized || !count ||
+      (!samples && max_samples > 0)) {
+    return KV_ERR_INVALID_PARAM;
+  }
+  if (device_index >= engine->num_devices) {
+    return KV_ERR_INVALID_PARAM;
+  }
+
+  kv_device_sample_t history[KV_TELEMETRY_HISTORY];
+  uint32_t n = kv_engine_read_telemetry(&engine->devices[device_index],
+                                        history);
+
+  /* keep the newest samples if the caller's array is short */
+  uint32_t skip = n > max_samples ? n - max_samples : 0;
+  *count = n - skip;
+  if (*count > 0) {
+    memcpy(samples, history + skip, *count * sizeof(kv_device_sample_t));
+  }
+  return KV_SUCCESS;
+}
+
 uint32_t kv_engine_healthy_device_count(kv_engine_t *engine) {
   if (!engine || !engine->initialized) {
     return 0;
@@ -183,48 +487,3 @@ uint32_t kv_engine_healthy_device_count(kv_engine_t *engine) {
   }
   return count;
 }
-
-/* Contract: kv_engine_add_device is intended for init-time configuration
- * (after kv_engine_init returns, but before the first store/retrieve/delete/
- * exists call). The background health probe is running concurrently, so we
- * use atomic operations to publish the new device safely:
- *   1. kv_engine_open_device fully initializes devices[new_idx].
- *   2. atomic_store_explicit(..., release) publishes the new count.
- *   3. Probe / shard_for_key reads use the matching acquire load (or plain
- *      reads on _Atomic types, which the compiler treats as seq_cst).
- *
- * The write_ops guard rejects calls after any writes have completed; note
- * it is best-effort (TOCTOU window between releasing stats_lock and the
- * count store). Hot-add of a device into a running, hashed shard set would
- * also reroute ~(N-1)/N of existing keys and is therefore not supported. */
-kv_result_t kv_engine_add_device(kv_engine_t *engine, const char *device_path) {
-  if (!engine || !engine->initialized || !device_path) {
-    return KV_ERR_INVALID_PARAM;
-  }
-
-  uint32_t current =
-      atomic_load_explicit(&engine->num_devices, memory_order_acquire);
-  if (current >= KV_MAX_DEVICES) {
-    return KV_ERR_INVALID_PARAM;
-  }
-
-  pthread_mutex_lock(&engine->stats_lock);
-  uint64_t writes = engine->stats.write_ops;
-  pthread_mutex_unlock(&engine->stats_lock);
-
-  if (writes > 0) {
-    return KV_ERR_INVALID_PARAM;
-  }
-
-  kv_result_t res =
-      kv_engine_open_device(&engine->devices[current], device_path, current);
-  if (res != KV_SUCCESS) {
-    return res;
-  }
-
-  /* Publish the new device only after kv_engine_open_device has fully
-   * initialized the slot. Release pairs with the probe's acquire load. */
-  atomic_store_explicit(&engine->num_devices, current + 1,
-                        memory_order_release);
-  return KV_SUCCESS;
-}
@@ -0,0 +1,217 @@
+/**
+ * Hot-Key Detection
+ *
+ * Hash sharding sends every request for a key to the same device, so one
+ * hot key can saturate an SSD while the others idle. With
+ * hot_key_sample_interval = N, every Nth store/retrieve on each thread is
+ * counted in its device's hot key sketch (Count-Min plus heavy-hitter
+ * table, see hot_key_sketch.h).
+ *
+ * The health probe closes a window at each sweep (~5s): it drains the
+ * sketches into the "previous" tables and notes each device's command
+ * count. Reports merge the previous window with the current partial one,
+ * so they always cover 5-10 seconds of traffic and don't go blank right
+ * after a rotation.
+ */
+
+#include "kv_engine_internal.h"
+#include <stdlib.h>
+
+/* Width of each Count-Min row; with depth 4 a sketch is 16KB */
+#define HOT_KEY_SKETCH_WIDTH 1024
+
+/* Windows shorter than this are not closed (the probe can be woken early,
+ * e.g. for a filter rebuild) */
+#define HOT_KEY_MIN_WINDOW_NS 4000000000ULL
+
+/* Thread's countdown to its next sample */
+static _Thread_local uint32_t hot_key_countdown;
+
+kv_result_t kv_engine_hot_keys_init(kv_engine_t *engine) {
+  kv_hot_keys_t *hot = calloc(1, sizeof(kv_hot_keys_t) +
+                                     engine->device_slots *
+                                         sizeof(hot->previous[0]));
+  if (!hot) {
+    return KV_ERR_NO_MEMORY;
+  }
+  pthread_mutex_init(&hot->lock, NULL);
+  hot->window_start_ns = kv_now_ns();
+  engine->hot_keys = hot;
+
+  if (engine->config.hot_key_sample_interval == 0) {
+    return KV_SUCCESS;
+  }
+
+  /* every slot, so devices added later are covered too */
+  for (uint32_t i = 0; i < engine->device_slots; i++) {
+    hot->sketch[i] = hot_key_sketch_create(HOT_KEY_SKETCH_WIDTH);
+    if (!hot->sketch[i]) {
+      return KV_ERR_NO_MEMORY;
+    }
+  }
+  return KV_SUCCESS;
+}
+
+void kv_engine_hot_key_record(kv_engine_t *engine, uint32_t dev_idx,
+                              uint32_t key_hash, const void *key,
+                              size_t key_len) {
+  if (hot_key_countdown > 1) {
+    hot_key_countdown--;
+    return;
+  }
+  hot_key_countdown = engine->config.hot_key_sample_interval;
+
+  hot_key_sketch_record(engine->hot_keys->sketch[dev_idx],
+                        kv_engine_filter_hash(key_hash), key,
+                        (uint32_t)key_len);
+}
+
+void kv_engine_hot_keys_rotate(kv_engine_t *engine) {
+  kv_hot_keys_t *hot = engine->hot_keys;
+  uint64_t now = kv_now_ns();
+
+  pthread_mutex_lock(&hot->lock);
+  if (now - hot->window_start_ns < HOT_KEY_MIN_WINDOW_NS) {
+    pthread_mutex_unlock(&hot->lock);
+    return;
+  }
+
+  uint32_t num_devices = engine->num_devices;
+  for (uint32_t i = 0; i < num_devices; i++) {
+    if (hot->sketch[i]) {
+      hot->previous_count[i] =
+          hot_key_sketch_drain(hot->sketch[i], hot->previous[i]);
+    }
+    uint64_t ops = atomic_load(&engine->devices[i].total_ops);
+    hot->previous_ops[i] = ops - hot->window_start_ops[i];
+    hot->window_start_ops[i] = ops;
+  }
+  hot->previous_ns = now - hot->window_start_ns;
+  hot->window_start_ns = now;
+  pthread_mutex_unlock(&hot->lock);
+}
+
+/* Adds entry's count to the matching candidate, or appends it */
+static void merge_candidate(hot_key_entry_t *candidates, uint32_t *devices,
+                            uint32_t *count, const hot_key_entry_t *entry,
+                            uint32_t dev_idx) {
+  for (uint32_t i = 0; i < *count; i++) {
+    if (devices[i] == dev_idx && candidates[i].hash == entry->hash &&
+        candidates[i].key_len == entry->key_len &&
+        memcmp(candidates[i].key, entry->key, entry->key_len) == 0) {
+      candidates[i].count += entry->count;
+      return;
+    }
+  }
+  candidates[*count] = *entry;
+  devices[*count] = dev_idx;
+  (*count)++;
+}
+
+static int compare_hot_desc(const void *a, const void *b) {
+  double ra = ((const kv_hot_key_t *)a)->ops_per_sec;
+  double rb = ((const kv_hot_key_t *)b)->ops_per_sec;
+  return (ra < rb) - (ra > rb);
+}
+
+kv_result_t kv_engine_get_hot_keys(kv_engine_t *engine,
+                                   kv_hot_key_report_t *report) {
+  if (!engine || !engine->initialized || !report) {
+    return KV_ERR_INVALID_PARAM;
+  }
+
+  memset(report, 0, sizeof(*report));
+  kv_hot_keys_t *hot = engine->hot_keys;
+  uint32_t num_devices = engine->num_devices;
+  report->num_devices = num_devices;
+
+  /* up to two tables per device: previous window and current window */
+  hot_key_entry_t *candidates =
+      malloc(sizeof(hot_key_entry_t) * HOT_KEY_TABLE_SIZE * 2);
+  hot_key_entry_t *current = malloc(sizeof(hot_key_entry_t) *
+                                    HOT_KEY_TABLE_SIZE);
+  kv_hot_key_t *ranked =
+      malloc(sizeof(kv_hot_key_t) * HOT_KEY_TABLE_SIZE * 2 * num_devices);
+  if (!candidates || !current || !ranked) {
+    free(candidates);
+    free(current);
+    free(ranked);
+    return KV_ERR_NO_MEMORY;
+  }
+
+  pthread_mutex_lock(&hot->lock);
+  uint64_t now = kv_now_ns();
+  double span_sec = (double)(hot->previous_ns + (now - hot->window_start_ns)) /
+                    1e9;
+  report->window_sec = span_sec;
+
+  double total_rate = 0.0;
+  double max_rate = 0.0;
+  uint32_t num_ranked = 0;
+  uint32_t interval = engine->config.hot_key_sample_interval;
+
+  for (uint32_t i = 0; i < num_devices; i++) {
+    uint64_t ops = hot->previous_ops[i] +
+                   (atomic_load(&engine->devices[i].total_ops) -
+                    hot->window_start_ops[i]);
+    double rate = span_sec > 0.0 ? (double)ops / span_sec : 0.0;
+    report->device_ops_per_sec[i] = rate;
+    total_rate += rate;
+    if (rate > max_rate) {
+      max_rate = rate;
+    }
+
+    if (!hot->sketch[i]) {
+      continue;
+    }
+
+    uint32_t devices[HOT_KEY_TABLE_SIZE * 2];
+    uint32_t count = 0;
+    for (uint32_t k = 0; k < hot->previous_count[i]; k++) {
+      merge_candidate(candidates, devices, &count, &hot->previous[i][k], i);
+    }
+    uint32_t live = hot_key_sketch_snapshot(hot->sketch[i], current);
+    for (uint32_t k = 0; k < live; k++) {
+      merge_candidate(candidates, devices, &count, &current[k], i);
+    }
+
+    for (uint32_t k = 0; k < count; k++) {
+      kv_hot_key_t *out = &ranked[num_ranked++];
+      memcpy(out->key, candidates[k].key, candidates[k].key_len);
+      out->key_len = candidates[k].key_len;
+      out->device_index = i;
+      out->ops_per_sec =
+          span_sec > 0.0
+              ? (double)candidates[k].count * interval / span_sec
+              : 0.0;
+    }
+  }
+  pthread_mutex_unlock(&hot->lock);
+
+  if (num_devices > 0 && total_rate > 0.0) {
+    report->load_skew = max_rate / (total_rate / num_devices);
+  }
+
+  qsort(ranked, num_ranked, sizeof(kv_hot_key_t), compare_hot_desc);
+  report->num_keys =
+      num_ranked < KV_HOT_KEYS_MAX ? num_ranked : KV_HOT_KEYS_MAX;
+  memcpy(report->keys, ranked, report->num_keys * sizeof(kv_hot_key_t));
+
+  free(candidates);
+  free(current);
+  free(ranked);
+  return KV_SUCCESS;
+}
+
+void kv_engine_hot_keys_destroy(kv_engine_t *engine) {
+  kv_hot_keys_t *hot = engine->hot_keys;
+  if (!hot) {
+    return;
+  }
+  for (uint32_t i = 0; i < engine->device_slots; i++) {
+    hot_key_sketch_destroy(hot->sketch[i]);
+  }
+  pthread_mutex_destroy(&hot->lock);
+  free(hot);
+  engine->hot_keys = NULL;
+}
@@ -6,15 +6,44 @@
 #ifndef KV_ENGINE_INTERNAL_H
 #define KV_ENGINE_INTERNAL_H
 
+#include "../utils/bloom_filter.h"
+#include "../utils/buffer_registry.h"
 #include "../utils/dma_pool.h"
 #include "../utils/hashTable.h"
+#include "../utils/hot_key_sketch.h"
+#include "../utils/latency_histogram.h"
+#include "../utils/reed_solomon.h"
+#include "../utils/rendezvous_hash.h"
+#include "../utils/trace_ring.h"
 #include "kv_engine.h"
 #include <kvs_api.h>
 #include <pthread.h>
 #include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
 
 #define KV_ENGINE_RETRIEVE_SIZE 2 * 1024 * 1024 /* 2MB */
 
+/* Reads per device between recomputations of its hedge delay */
+#define KV_HEDGE_WINDOW 1024
+
+/* Slow-device detection: fewest commands in a probe sweep to update a
+ * device's latency average; the probe sends a slow device that many timed
+ * commands per sweep so it is measured while reads avoid it */
+#define KV_SLOW_MIN_SAMPLES 16
+
+/* Keys beginning with this prefix hold engine metadata (e.g. the index
+ * snapshot epoch marker). User stores with this prefix are rejected and
+ * index recovery skips them. */
+#define KV_INTERNAL_KEY_PREFIX "\xffKVE"
+#define KV_INTERNAL_KEY_PREFIX_LEN 4
+
+static inline bool kv_engine_is_internal_key(const void *key, size_t key_len) {
+  return key_len >= KV_INTERNAL_KEY_PREFIX_LEN &&
+         memcmp(key, KV_INTERNAL_KEY_PREFIX, KV_INTERNAL_KEY_PREFIX_LEN) == 0;
+}
+
 /* ============================================================================
  * Internal Structures
  * ============================================================================
@@ -53,6 +82,7 @@ typedef struct {
   work_item_t *queue_tail;
   uint32_t queue_size;
   uint32_t queue_capacity;
+  _Atomic uint32_t active; /* workers running an item */
 
   /* Synchronization */
   pthread_mutex_t queue_lock;
@@ -83,27 +113,79 @@ typedef struct {
   size_t value_len;
   bool overwrite;
   async_op_type_t op_type;
+  uint64_t submit_ns; /* submit timestamp, 0 when latency and phase timing
+                         are both off */
 } async_context_t;
 
 /**
  * Per-device context (device handle + keyspace handle pair)
+ *
+ * Entries are cache-line aligned and laid out for routing over many
+ * devices: what every op reads to pick and check a device shares the first
+ * line, the counters every command writes start the second, and the bulky
+ * state only the health probe and reports touch comes after.
  */
 typedef struct {
-  kvs_device_handle device;
+  _Alignas(64) kvs_device_handle device;
   kvs_key_space_handle keyspace;
-  char *device_path; /* owned copy for cleanup */
 
   /* Health tracking (updated atomically on every operation)
    *
    * Using _Atomic instead of a mutex because these fields will be
    * individually updated on every op and don't require multi-field
-   * consistency. */
+   * consistency. healthy and slow change rarely and are read by every op
+   * that routes to the device; the counters below change on every
+   * command. */
   _Atomic bool healthy;
+  /* Latency outlier flag (see cmd_latency below); reads prefer copies on
+   * devices that aren't slow */
+  _Atomic bool slow;
+  uint32_t
+      max_consecutive_errors; /* threshold for marking unhealthy; default 10 */
+
+  /* Negative lookup filter (see kv_engine_filter.c). filter is NULL when
+   * disabled; filter_next is non-NULL only while a rebuild is running. */
+  _Atomic(bloom_filter_t *) filter;
+  _Atomic(bloom_filter_t *) filter_next;
+
+  /* Hedge delay of the device's reads, see read_latency below */
+  _Atomic uint64_t hedge_after_ns;
+  char *device_path; /* owned copy for cleanup */
+
+  _Alignas(64) _Atomic uint32_t in_flight; /* commands issued and not yet
+                                              completed */
   _Atomic uint64_t consecutive_errors; /* resets to 0 on success */
   _Atomic uint64_t total_errors;
   _Atomic uint64_t total_ops;
-  uint32_t
-      max_consecutive_errors; /* threshold for marking unhealthy; default 10 */
+  _Atomic uint64_t read_samples;
+  _Atomic uint64_t filter_deletes; /* deletes since the last rebuild */
+
+  bloom_filter_t *filter_retired; /* freed by the next rebuild */
+  _Atomic bool filter_rebuild_requested;
+
+  /* Capacity/utilization samples (see kv_engine_health.c). Written only by
+   * the health probe, or before the device is published; readers copy them
+   * lock-free under telemetry_seq, which is odd while a write is underway. */
+  _Atomic uint64_t telemetry_seq;
+  uint64_t telemetry_count; /* samples taken so far */
+  kv_device_sample_t telemetry[KV_TELEMETRY_HISTORY];
+
+  /* Read latency for hedged reads (see kv_engine_health.c); read_latency
+   * is NULL unless config.hedge_percentile is set with replication.
+   * hedge_after_ns is that percentile over the last KV_HEDGE_WINDOW reads,
+   * 0 (no hedging) until the first window is complete. */
+  latency_histogram_t *read_latency;
+  uint64_t *read_window; /* bucket counts at the last window */
+  _Atomic bool read_window_busy; /* a thread is closing the window */
+
+  /* Command latency for slow-device detection (see kv_engine_health.c);
+   * cmd_latency is NULL unless config.slow_device_factor is set. The probe
+   * folds each sweep's mean into latency_ewma_ns and flags the device slow
+   * while that is slow_device_factor times its peers'. */
+  latency_histogram_t *cmd_latency;
+  uint64_t *cmd_window; /* bucket counts at the last sweep (probe only) */
+  _Atomic uint64_t latency_ewma_ns;
+  _Atomic uint64_t latency_p99_ns; /* p99 of the last sweep with samples */
 } kv_device_ctx_t;
 
 /**
@@ -121,43 +203,230 @@ typedef struct {
   kv_engine_t *engine;         /* back-pointer to iterate devices */
 } health_probe_t;
 
+/**
+ * Hot-key tracking (see kv_engine_hotkeys.c). The sketches exist only when
+ * hot_key_sample_interval > 0; the device load window is always kept.
+ */
+typedef struct {
+  hot_key_sketch_t *sketch[KV_MAX_DEVICES]; /* current window */
+
+  pthread_mutex_t lock; /* guards the window bookkeeping below */
+  uint32_t previous_count[KV_MAX_DEVICES];
+  uint64_t previous_ops[KV_MAX_DEVICES]; /* device commands last window */
+  uint64_t previous_ns;                  /* length of the last window */
+  uint64_t window_start_ns;
+  uint64_t window_start_ops[KV_MAX_DEVICES];
+  /* one row per device slot */
+  hot_key_entry_t previous[][HOT_KEY_TABLE_SIZE];
+} kv_hot_keys_t;
+
+/**
+ * Key migration after kv_engine_add_device (see kv_engine_migration.c).
+ * While active, a key whose replicas now include the added device is
+ * moving: ops on it hold its lock stripe shared and also look at the device
+ * it is leaving, the migrator holds the stripe exclusively to move it.
+ */
+#define KV_MIGRATION_LOCKS 256
+
+typedef struct {
+  _Atomic bool active;
+  uint32_t from_devices; /* device count before the add */
+  pthread_rwlock_t locks[KV_MIGRATION_LOCKS];
+
+  pthread_t thread;
+  bool thread_started;
+  bool stop;             /* guarded by mutex */
+  pthread_mutex_t mutex; /* cond wakes the migrator's sleeps on stop */
+  pthread_cond_t cond;
+
+  _Atomic uint32_t passes;
+  _Atomic uint64_t keys_scanned;
+  _Atomic uint64_t keys_to_move;
+  _Atomic uint64_t keys_moved;
+  _Atomic uint64_t bytes_moved;
+  _Atomic uint64_t errors;
+} kv_migration_t;
+
+/**
+ * Loopback HTTP listener serving OpenMetrics text (config.metrics_port)
+ */
+typedef struct {
+  pthread_t thread;
+  _Atomic bool running;
+  int listen_fd;
+  kv_engine_t *engine;
+} metrics_server_t;
+
+/**
+ * Per-thread statistics block. Each thread increments the slot it was
+ * assigned on first use, so counters on the hot path stay in a cache line
+ * owned by that thread; kv_engine_get_stats sums the slots. More threads
+ * than slots simply share, which is why the counters are still atomic
+ * (uncontended relaxed adds cost about the same as plain ones).
+ */
+#define KV_STATS_SLOTS 64
+
+typedef struct {
+  _Alignas(64) _Atomic uint64_t total_ops;
+  _Atomic uint64_t read_ops;
+  _Atomic uint64_t write_ops;
+  _Atomic uint64_t delete_ops;
+  _Atomic uint64_t failed_ops;
+  _Atomic uint64_t bytes_written;
+  _Atomic uint64_t bytes_read;
+  _Atomic uint64_t filter_negatives;
+  _Atomic uint64_t exists_from_index;
+  _Atomic uint64_t exists_verified;
+  _Atomic uint64_t index_mismatches;
+  _Atomic uint64_t hedged_reads;
+  _Atomic uint64_t hedge_wins;
+  _Atomic uint64_t chunked_stores;
+  _Atomic uint64_t chunked_retrieves;
+  _Atomic uint64_t reconstructed_retrieves;
+} kv_stats_slot_t;
+
+/**
+ * Latency histograms, indexed by kv_op_type_t. Allocated only when
+ * enable_stats is 1 (about 110KB plus 37KB per device slot).
+ */
+typedef struct {
+  latency_histogram_t op[KV_OP_TYPES];
+  latency_histogram_t queue_wait[KV_OP_TYPES];
+  latency_histogram_t async_total[KV_OP_TYPES];
+  /* one row per device slot */
+  latency_histogram_t device[][KV_OP_TYPES];
+} kv_latency_hists_t;
+
+/**
+ * Per-phase histograms, indexed by kv_op_type_t and kv_phase_t. Allocated
+ * only when enable_phase_timing is 1 (about 270KB).
+ */
+typedef struct {
+  latency_histogram_t phase[KV_OP_TYPES][KV_PHASES];
+} kv_phase_hists_t;
+
+/**
+ * Phase stopwatch carried through one store or retrieve call. Each
+ * kv_phase_mark charges the time since the previous mark to a phase;
+ * kv_phase_end records the totals. mark_ns stays 0 when phase timing is
+ * off, which turns every mark into a single branch.
+ */
+typedef struct {
+  uint64_t mark_ns;
+  uint32_t seen; /* bit per phase charged at least once */
+  uint64_t ns[KV_PHASES];
+} kv_phase_timer_t;
+
+/**
+ * Flight recorder and slow-op log. Calls are written to the ring of the
+ * caller's statistics slot, so each thread normally owns its ring; the
+ * rings hold kv_op_record_t with timestamp_ns still on the monotonic
+ * clock until they are read.
+ */
+typedef struct kv_flight_recorder {
+  trace_ring_t *threads[KV_STATS_SLOTS]; /* NULL unless flight_recorder_size */
+  trace_ring_t *slow_ops;                /* NULL unless slow_op_threshold_us */
+  uint64_t slow_threshold_ns;
+  int64_t realtime_offset_ns; /* CLOCK_REALTIME - CLOCK_MONOTONIC */
+  int dump_signal;
+  const char *dump_path; /* engine->config.dump_path */
+  struct kv_flight_recorder *next_dump; /* signal dump registry */
+} kv_flight_recorder_t;
+
 /**
  * Main engine structure (opaque in public API)
  */
 struct kv_engine {
-  /* Device array — one entry per SSD */
-  kv_device_ctx_t devices[KV_MAX_DEVICES];
+  /* Device table — one entry per SSD. device_slots entries are allocated
+   * at init (config.max_devices): the devices opened then plus room for
+   * kv_engine_add_device. Per-device stats and hot-key state are sized
+   * the same way. */
+  kv_device_ctx_t *devices;
+  uint32_t device_slots;
   /* num_devices is atomic to allow kv_engine_add_device to publish a new
-   * device while the background health probe is iterating. Writers must
-   * fully initialize devices[new_idx] before storing the new count with
-   * release ordering; readers must use acquire ordering. */
+   * device while ops and the background health probe are running. Writers
+   * must fully initialize devices[new_idx] and the migration state before
+   * storing the new count with release ordering; readers must use acquire
+   * ordering. */
   _Atomic uint32_t num_devices;
 
+  /* Placement weight of each device (see kv_engine_multi_device.c).
+   * weighted stays false while all weights are equal, so placement uses
+   * the plain scores. A device's weight is set before the count that
+   * publishes it, and never changes afterwards. */
+  uint32_t device_weights[KV_MAX_DEVICES];
+  _Atomic bool weighted;
+
   /* Configuration */
   kv_engine_config_t config;
 
   /* Memory management */
   memory_pool_t *mem_pool;
   dma_pool_t *buffer_pool;
+  dma_pool_t *stream_pool; /* stream segment buffers, NULL if not pooled */
+  buffer_registry_t *registered_buffers;
 
   /* Async I/O */
   thread_pool_t *workers;
 
-  /* Statistics */
-  kv_engine_stats_t stats;
-  pthread_mutex_t stats_lock;
+  /* Statistics: KV_STATS_SLOTS per-thread blocks, NULL when enable_stats
+   * is 0 */
+  kv_stats_slot_t *stats_slots;
+  kv_latency_hists_t *latency;
+  kv_phase_hists_t *phase_timing; /* NULL unless enable_phase_timing */
+  /* NULL unless flight_recorder_size or slow_op_threshold_us is set */
+  kv_flight_recorder_t *recorder;
+
+  /* Per-op dma_alloc calls made because the DMA pool was empty or too
+   * small for the value */
+  _Atomic uint64_t dma_fallback_allocs;
+
+  /* Asynchronous device commands (hedge reads, chunk I/O) that may still
+   * be running after their caller returned; cleanup waits for them before
+   * freeing buffers and closing devices */
+  _Atomic uint32_t async_cmds_outstanding;
+
+  /* Keys whose value is stored in chunks (see kv_engine_stripe.c), so an
+   * overwrite or delete also removes the chunks. striped_keys_present
+   * stays false until the first one, keeping the check off the hot path. */
+  hash_table_t striped_keys;
+  _Atomic bool striped_keys_present;
 
-  /* Hash table lock (uthash is not thread-safe) */
-  pthread_mutex_t hash_lock;
+  /* Chunk generations held by open write streams, which write their
+   * chunks without the key's lock stripe: no other store of the key
+   * writes under one until the stream closes. Guarded by
+   * generation_mutex. */
+  pthread_mutex_t generation_mutex;
+  struct generation_hold *generation_holds;
 
-  /* Hash table */
+  /* Keys moving after kv_engine_add_device */
+  kv_migration_t *migration;
+
+  /* Key index, striped by the same FNV-1a hash used for device sharding.
+   * Each stripe carries its own reader-writer lock. */
   hash_table_t key_table;
 
+  /* True once the index is known to hold every key on the devices (set by
+   * a successful recovery at init) */
+  bool index_complete;
+  kv_recovery_info_t recovery;
+  kv_init_timing_t init_timing;
+
+  /* Index-authoritative exists (config.index_authoritative with a complete
+   * index) */
+  bool index_authoritative;
+
   /* State */
   int initialized;
 
   /* Background health probe */
   health_probe_t *health_probe;
+
+  /* Hot-key sketches and per-device load window */
+  kv_hot_keys_t *hot_keys;
+
+  /* OpenMetrics listener, NULL unless config.metrics_port is set */
+  metrics_server_t *metrics_server;
 };
 
 /* ============================================================================
@@ -169,30 +438,536 @@ struct kv_engine {
 memory_pool_t *memory_pool_create(size_t size);
 void *memory_pool_alloc(memory_pool_t *pool, size_t size);
 void memory_pool_free(memory_pool_t *pool, void *ptr);
+size_t memory_pool_used(memory_pool_t *pool);
 void memory_pool_destroy(memory_pool_t *pool);
 
 /* Thread pool operations */
 thread_pool_t *thread_pool_create(uint32_t num_threads, uint32_t queue_depth);
 int thread_pool_submit(thread_pool_t *pool, void *(*func)(void *), void *arg,
                        void (*cleanup)(void *));
+uint32_t thread_pool_queue_size(thread_pool_t *pool);
+uint32_t thread_pool_active(thread_pool_t *pool);
 void thread_pool_destroy(thread_pool_t *pool);
 
 /* Statistics helpers */
 void update_stats(kv_engine_t *engine, int is_read, int is_write, int is_delete,
                   int success, size_t bytes);
 
+/* Device result handling shared with the chunk I/O of striped values */
+kv_result_t map_kvs_result(kvs_result kvs_res);
+bool is_device_error(kvs_result kvs_res);
+void device_record_result(kv_device_ctx_t *ctx, kvs_result kvs_res);
+
+/* Thread's statistics slot, assigned round-robin on first use */
+extern _Thread_local uint32_t kv_stats_thread_slot;
+uint32_t kv_engine_assign_stats_slot(void);
+
+static inline kv_stats_slot_t *kv_engine_stats_slot(kv_engine_t *engine) {
+  uint32_t slot = kv_stats_thread_slot;
+  if (slot == 0) {
+    slot = kv_engine_assign_stats_slot();
+  }
+  return &engine->stats_slots[(slot - 1) & (KV_STATS_SLOTS - 1)];
+}
+
+static inline uint64_t kv_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* Device command of the thread's current call, for the flight recorder.
+ * Cleared when the call is recorded; dev_slot is 0 until a command is
+ * issued. */
+typedef struct {
+  uint64_t device_ns;
+  uint32_t dev_slot; /* device index + 1 */
+} kv_op_trace_t;
+
+extern _Thread_local kv_op_trace_t kv_op_trace;
+
+/* Start timestamp for a latency sample; 0 when neither histograms nor the
+ * flight recorder are enabled, so the matching record call is a no-op and
+ * the clock is never read */
+static inline uint64_t kv_latency_start(kv_engine_t *engine) {
+  return engine && (engine->latency || engine->recorder) ? kv_now_ns() : 0;
+}
+
+void kv_engine_record_op(kv_engine_t *engine, kv_op_type_t op,
+                         uint64_t start_ns, uint64_t end_ns, const void *key,
+                         size_t key_len, kv_result_t result,
+                         size_t value_size);
+
+/* Ends a public call started with kv_latency_start: records the engine
+ * call sample and hands the call to the flight recorder */
+static inline void kv_op_finish(kv_engine_t *engine, kv_op_type_t op,
+                                uint64_t start_ns, const void *key,
+                                size_t key_len, kv_result_t result,
+                                size_t value_size) {
+  if (!start_ns) {
+    return;
+  }
+  uint64_t now = kv_now_ns();
+  if (engine->latency) {
+    latency_histogram_record(&engine->latency->op[op], now - start_ns);
+  }
+  if (engine->recorder) {
+    kv_engine_record_op(engine, op, start_ns, now, key, key_len, result,
+                        value_size);
+  }
+}
+
+/* Brackets a foreground device command: counts it as in flight on the
+ * device and returns the start timestamp for kv_device_cmd_end */
+static inline uint64_t kv_device_cmd_begin(kv_engine_t *engine,
+                                           uint32_t dev_idx) {
+  atomic_fetch_add_explicit(&engine->devices[dev_idx].in_flight, 1,
+                            memory_order_relaxed);
+  if (engine->devices[dev_idx].read_latency ||
+      engine->devices[dev_idx].cmd_latency) {
+    return kv_now_ns();
+  }
+  return kv_latency_start(engine);
+}
+
+void kv_engine_note_read_latency(kv_engine_t *engine, uint32_t dev_idx,
+                                 uint64_t elapsed_ns);
+
+/* Records the time since start_ns as a device command sample */
+static inline void kv_latency_record_device(kv_engine_t *engine,
+                                            uint32_t dev_idx, kv_op_type_t op,
+                                            uint64_t start_ns) {
+  if (start_ns) {
+    uint64_t elapsed = kv_now_ns() - start_ns;
+    if (engine->latency) {
+      latency_histogram_record(&engine->latency->device[dev_idx][op], elapsed);
+    }
+    if (engine->devices[dev_idx].cmd_latency) {
+      latency_histogram_record(engine->devices[dev_idx].cmd_latency, elapsed);
+    }
+    if (op == KV_OP_RETRIEVE && engine->devices[dev_idx].read_latency) {
+      kv_engine_note_read_latency(engine, dev_idx, elapsed);
+    }
+    kv_op_trace.device_ns = elapsed;
+    kv_op_trace.dev_slot = dev_idx + 1;
+  }
+}
+
+static inline void kv_device_cmd_end(kv_engine_t *engine, uint32_t dev_idx,
+                                     kv_op_type_t op, uint64_t start_ns) {
+  kv_latency_record_device(engine, dev_idx, op, start_ns);
+  atomic_fetch_sub_explicit(&engine->devices[dev_idx].in_flight, 1,
+                            memory_order_relaxed);
+}
+
+/* kv_device_cmd_end plus device_record_result for a command issued with
+ * an async kvs call, on the device's completion thread. The issuing
+ * thread's trace belongs to its own call, so it isn't touched. */
+void kv_device_async_cmd_end(kv_engine_t *engine, uint32_t dev_idx,
+                             kv_op_type_t op, uint64_t start_ns,
+                             kvs_result kvs_res);
+
+static inline void kv_phase_begin(kv_engine_t *engine, kv_phase_timer_t *t) {
+  t->mark_ns = 0;
+  if (engine && engine->phase_timing) {
+    t->seen = 0;
+    memset(t->ns, 0, sizeof(t->ns));
+    t->mark_ns = kv_now_ns();
+  }
+}
+
+/* Charges the time since the previous mark to phase */
+static inline void kv_phase_mark(kv_phase_timer_t *t, kv_phase_t phase) {
+  if (t->mark_ns) {
+    uint64_t now = kv_now_ns();
+    t->ns[phase] += now - t->mark_ns;
+    t->seen |= 1u << phase;
+    t->mark_ns = now;
+  }
+}
+
+static inline void kv_phase_end(kv_engine_t *engine, kv_phase_timer_t *t,
+                                kv_op_type_t op) {
+  if (!t->mark_ns) {
+    return;
+  }
+  for (int phase = 0; phase < KV_PHASES; phase++) {
+    if (t->seen & (1u << phase)) {
+      latency_histogram_record(&engine->phase_timing->phase[op][phase],
+                               t->ns[phase]);
+    }
+  }
+}
+
+/* Adds n to a statistics counter; no-op when enable_stats is 0 */
+#define KV_STAT_ADD(engine, field, n)                                          \
+  do {                                                                         \
+    if ((engine)->stats_slots) {                                               \
+      atomic_fetch_add_explicit(&kv_engine_stats_slot(engine)->field, (n),     \
+                                memory_order_relaxed);                         \
+    }                                                                          \
+  } while (0)
+
 /* Multi-device helpers */
 kv_result_t kv_engine_resolve_device_paths(const kv_engine_config_t *config,
                                            const char **effective_paths,
                                            uint32_t *effective_count);
+uint32_t kv_engine_key_hash(const void *key, size_t key_len);
 uint32_t kv_engine_shard_for_key(const void *key, size_t key_len,
                                  uint32_t num_devices);
+/* Sets the placement weight of a device joining the engine, before the
+ * count that publishes it; KV_ERR_IO if a derived weight can't be
+ * measured or recorded */
+kv_result_t kv_engine_weigh_device(kv_engine_t *engine, uint32_t dev_idx);
+/* Places by weight exactly when the first num_devices weights differ;
+ * called before the count that publishes the last of them */
+void kv_engine_update_weighted(kv_engine_t *engine, uint32_t num_devices);
+
+/* Weights for rendezvous placement, NULL while every device weighs the
+ * same */
+static inline const uint32_t *kv_engine_weights(kv_engine_t *engine) {
+  return atomic_load_explicit(&engine->weighted, memory_order_acquire)
+             ? engine->device_weights
+             : NULL;
+}
+
+#define KV_NO_DEVICE UINT32_MAX
+
+/* Device slots when config.max_devices is 0 and fewer devices are given:
+ * the old fixed table size, so engines keep room for online adds */
+#define KV_DEFAULT_DEVICE_SLOTS 8
+
+/**
+ * Devices holding a key. With config.replication_factor R the key lives on
+ * the R devices with the highest rendezvous scores: reads use any of them,
+ * writes and deletes all of them. While a device add is migrated, a key
+ * whose replicas include the added device is moving: the added device may
+ * not have its copy yet and the device it displaced (dropped) may still
+ * hold one.
+ */
+typedef struct {
+  uint32_t count;               /* replicas, best score first */
+  uint32_t dev[KV_MAX_DEVICES];
+  uint32_t dropped;             /* KV_NO_DEVICE if none */
+  bool moving;                  /* ops must hold the key's lock stripe */
+} kv_placement_t;
+
+/* Copies kept of each key on num_devices devices, for a configured
+ * replica count */
+static inline uint32_t kv_engine_copies(uint32_t replicas,
+                                        uint32_t num_devices) {
+  if (replicas <= 1) {
+    return 1;
+  }
+  return replicas < num_devices ? replicas : num_devices;
+}
+
+static inline uint32_t kv_engine_replica_count(const kv_engine_t *engine,
+                                               uint32_t num_devices) {
+  return kv_engine_copies(engine->config.replication_factor, num_devices);
+}
+
+void kv_engine_migration_place(kv_engine_t *engine, uint32_t key_hash,
+                               uint32_t replicas, kv_placement_t *placement);
+
+/* Places a key with the given replica count under the current device set.
+ * One rendezvous pick and loads of the weights and migration flags in the
+ * common case. */
+static inline void kv_engine_place_copies(kv_engine_t *engine,
+                                          uint32_t key_hash,
+                                          uint32_t replicas,
+                                          kv_placement_t *placement) {
+  uint32_t num_devices =
+      atomic_load_explicit(&engine->num_devices, memory_order_acquire);
+  const uint32_t *weights = kv_engine_weights(engine);
+  placement->count = kv_engine_copies(replicas, num_devices);
+  if (placement->count == 1) {
+    placement->dev[0] = rendezvous_pick(key_hash, weights, num_devices);
+  } else {
+    rendezvous_top(key_hash, weights, num_devices, placement->count,
+                   placement->dev);
+  }
+  placement->dropped = KV_NO_DEVICE;
+  placement->moving = false;
+  if (atomic_load_explicit(&engine->migration->active,
+                           memory_order_acquire)) {
+    kv_engine_migration_place(engine, key_hash, replicas, placement);
+  }
+}
+
+/* Places a key under the current device set */
+static inline void kv_engine_place(kv_engine_t *engine, uint32_t key_hash,
+                                   kv_placement_t *placement) {
+  kv_engine_place_copies(engine, key_hash, engine->config.replication_factor,
+                         placement);
+}
+
 kv_result_t kv_engine_open_device(kv_device_ctx_t *ctx, const char *path,
                                   uint32_t dev_index);
+/* Opens and weighs the devices of a new engine, all at once; on failure
+ * every device is closed again. *slowest_ns receives the longest open. */
+kv_result_t kv_engine_open_devices(kv_engine_t *engine, const char **paths,
+                                   uint32_t count, uint64_t *slowest_ns);
+/* Starts the latency tracking hedged reads and slow-device detection
+ * need on a device, when configured */
+kv_result_t kv_engine_track_latency(kv_engine_t *engine, uint32_t dev_idx);
 void kv_engine_close_device(kv_device_ctx_t *ctx);
 
+/* Key index recovery and snapshots */
+kv_result_t kv_engine_recover_index(kv_engine_t *engine);
+void kv_engine_save_index_snapshot(kv_engine_t *engine);
+
+/* Per-device negative lookup filters */
+uint64_t kv_engine_filter_hash(uint32_t key_hash);
+kv_result_t kv_engine_filter_init(kv_engine_t *engine);
+void kv_engine_filter_maintain(kv_engine_t *engine);
+void kv_engine_filter_rebuild_all(kv_engine_t *engine);
+void kv_engine_filter_add(kv_engine_t *engine, uint32_t dev_idx,
+                          uint32_t key_hash);
+void kv_engine_filter_note_delete(kv_engine_t *engine, uint32_t dev_idx);
+bool kv_engine_filter_may_contain(kv_engine_t *engine, uint32_t dev_idx,
+                                  uint32_t key_hash);
+uint64_t kv_engine_filter_memory_bytes(kv_engine_t *engine);
+void kv_engine_filter_destroy(kv_engine_t *engine);
+
+/* Hot-key detection */
+kv_result_t kv_engine_hot_keys_init(kv_engine_t *engine);
+void kv_engine_hot_key_record(kv_engine_t *engine, uint32_t dev_idx,
+                              uint32_t key_hash, const void *key,
+                              size_t key_len);
+void kv_engine_hot_keys_rotate(kv_engine_t *engine);
+void kv_engine_hot_keys_destroy(kv_engine_t *engine);
+
+/* Counts an op toward hot-key detection; a single test when it's off */
+static inline void kv_engine_hot_key_sample(kv_engine_t *engine,
+                                            uint32_t dev_idx,
+                                            uint32_t key_hash,
+                                            const void *key, size_t key_len) {
+  if (engine->config.hot_key_sample_interval) {
+    kv_engine_hot_key_record(engine, dev_idx, key_hash, key, key_len);
+  }
+}
+
+/* Flight recorder lifecycle (registers dump_signal) */
+kv_result_t kv_engine_recorder_init(kv_engine_t *engine);
+void kv_engine_recorder_destroy(kv_engine_t *engine);
+
+/* Online device add: migration state, resume at init, stop at cleanup */
+kv_result_t kv_engine_migration_init(kv_engine_t *engine);
+void kv_engine_migration_resume(kv_engine_t *engine);
+void kv_engine_migration_destroy(kv_engine_t *engine);
+
+/* Lock stripe serializing a moving key against the migrator */
+static inline pthread_rwlock_t *kv_migration_lock(kv_engine_t *engine,
+                                                  uint32_t key_hash) {
+  return &engine->migration->locks[kv_engine_filter_hash(key_hash) &
+                                   (KV_MIGRATION_LOCKS - 1)];
+}
+
+/* Takes the key's lock stripe shared or exclusively; NULL if it can't be
+ * taken (e.g. EDEADLK), which callers fail with KV_ERR_BUSY rather than
+ * go on unlocked. Never held across public API calls. */
+static inline pthread_rwlock_t *kv_key_lock(kv_engine_t *engine,
+                                            uint32_t key_hash,
+                                            bool exclusive) {
+  pthread_rwlock_t *lock = kv_migration_lock(engine, key_hash);
+  int rc = exclusive ? pthread_rwlock_wrlock(lock)
+                     : pthread_rwlock_rdlock(lock);
+  return rc == 0 ? lock : NULL;
+}
+
+/* Drops a lock stripe taken with kv_key_lock */
+static inline void kv_key_unlock(pthread_rwlock_t *lock) {
+  int rc = pthread_rwlock_unlock(lock);
+  if (rc != 0) {
+    fprintf(stderr, "[kv_engine] lock stripe release failed: %d\n", rc);
+  }
+}
+
+/**
+ * Striped values (see kv_engine_stripe.c). A value of at least
+ * config.erasure_min_value_size bytes is stored as data_chunks pieces plus
+ * parity_chunks Reed-Solomon pieces, and one of at least
+ * config.stripe_min_value_size, or of over 2MB, as data_chunks stripe units
+ * and no parity. Chunks form rows of data_chunks + parity_chunks, as many
+ * as the value needs, each chunk under an internal key derived from the
+ * value's key, generation and chunk number; chunk j of row r is on
+ * devices[(j + r) % (data_chunks + parity_chunks)]. The key itself holds this
+ * manifest, in host byte order, on kv_engine_manifest_replicas devices
+ * picked like any key's replicas (a superset of them). The generation
+ * changes on every overwrite so the new chunks never replace the ones a
+ * concurrent reader is fetching.
+ */
+#define KV_STRIPE_MAX_CHUNKS RS_MAX_SHARDS
+/* Chunk keys add 10 bytes to the key */
+#define KV_STRIPE_MAX_KEY_LEN 245
+/* stripe_unit_size when the config leaves it 0 */
+#define KV_STRIPE_DEFAULT_UNIT (256 * 1024)
+
+typedef struct {
+  uint8_t magic[8];
+  uint32_t version;
+  uint32_t generation;
+  uint64_t value_size;
+  uint32_t chunk_size; /* a multiple of DMA_ALIGNMENT */
+  uint16_t data_chunks;
+  uint16_t parity_chunks;
+  uint8_t devices[KV_STRIPE_MAX_CHUNKS];
+  uint64_t checksum; /* FNV-1a over the fields above */
+} kv_stripe_manifest_t;
+
+/* True for a value of the manifest's size and magic with a valid checksum;
+ * copies it to manifest */
+bool kv_stripe_parse_manifest(const void *value, size_t value_len,
+                              kv_stripe_manifest_t *manifest);
+/* Where kv_stripe_write gets the value: from data, or when that is NULL,
+ * from fill a row at a time */
+typedef struct {
+  const void *data;
+  kv_stream_fill_cb fill;
+  void *user_data;
+} kv_stripe_source_t;
+
+/* Writes the chunks of the value on healthy devices (distinct ones when
+ * erasure coded) and fills in manifest; on failure none are left behind.
+ * KV_ERR_ABORTED if fill asked to stop. */
+kv_result_t kv_stripe_write(kv_engine_t *engine, const void *key,
+                            size_t key_len, uint32_t key_hash,
+                            uint32_t generation,
+                            const kv_stripe_source_t *source, size_t value_len,
+                            kv_stripe_manifest_t *manifest);
+/* Reads the chunks in parallel and reassembles the value in a DMA buffer,
+ * rebuilding up to parity_chunks missing or slow ones.
+ * KV_ERR_KEY_NOT_FOUND means chunks are gone, e.g. to an overwrite. */
+kv_result_t kv_stripe_read(kv_engine_t *engine, const void *key,
+                           size_t key_len,
+                           const kv_stripe_manifest_t *manifest, void **value,
+                           size_t *value_len);
+/* Reads the value a row at a time, handing each to deliver in order;
+ * KV_ERR_ABORTED if deliver asked to stop */
+kv_result_t kv_stripe_read_stream(kv_engine_t *engine, const void *key,
+                                  size_t key_len,
+                                  const kv_stripe_manifest_t *manifest,
+                                  kv_stream_data_cb deliver, void *user_data);
+/* Deletes the chunks (best effort) */
+void kv_stripe_delete(kv_engine_t *engine, const void *key, size_t key_len,
+                      const kv_stripe_manifest_t *manifest);
+/* Write stream of a striped value: chunks are stored as they fill, a few
+ * at a time, so the value is never staged whole */
+typedef struct kv_stripe_writer kv_stripe_writer_t;
+
+/* Lays the value out and picks its devices like kv_stripe_write */
+kv_result_t kv_stripe_writer_open(kv_engine_t *engine, const void *key,
+                                  size_t key_len, uint32_t key_hash,
+                                  uint32_t generation, size_t value_len,
+                                  kv_stripe_writer_t **writer);
+/* Takes the next len bytes; a failed chunk store fails this and every
+ * later call */
+kv_result_t kv_stripe_writer_write(kv_stripe_writer_t *writer,
+                                   const void *data, size_t len);
+/* Waits for the chunk stores and frees the writer. With commit set and the
+ * whole value written fills in manifest; otherwise deletes the chunks
+ * (KV_ERR_ABORTED if nothing failed). */
+kv_result_t kv_stripe_writer_close(kv_stripe_writer_t *writer, bool commit,
+                                   kv_stripe_manifest_t *manifest);
+
+/* One ranged read of a read stream: len bytes at offset of a plain value
+ * on one device, or of a striped value within one of its data chunks. A
+ * data chunk that can't be read is rebuilt from the same range of the
+ * others. */
+typedef struct {
+  struct chunk_batch *batch; /* in flight, between start and finish */
+  const void *key;
+  size_t key_len;
+  const kv_stripe_manifest_t *manifest; /* NULL for a plain value */
+  uint64_t offset;                      /* into the value, 512-aligned */
+  size_t len;
+  uint8_t *buffer; /* room for len rounded up to 4 bytes */
+  bool rebuilt;    /* set by finish if parity was used */
+} kv_stripe_range_t;
+
+/* Bytes from offset to the end of its chunk */
+size_t kv_stripe_range_limit(const kv_stripe_manifest_t *manifest,
+                             uint64_t offset);
+/* Issues the read, from dev_idx for a plain value */
+kv_result_t kv_stripe_range_start(kv_engine_t *engine,
+                                  kv_stripe_range_t *range, uint32_t dev_idx);
+/* Waits for the read. KV_ERR_KEY_NOT_FOUND if the value was replaced by a
+ * shorter one or its chunks are gone. */
+kv_result_t kv_stripe_range_finish(kv_engine_t *engine,
+                                   kv_stripe_range_t *range);
+
+/* A DMA buffer for a stream, from the stream pool when size fits a
+ * segment; freed with kv_engine_free_buffer */
+void *kv_engine_stream_buffer(kv_engine_t *engine, size_t size);
+
+/* Finds the striped keys of earlier runs from their chunk keys */
+kv_result_t kv_engine_stripe_init(kv_engine_t *engine);
+
+/* True if the key's value is (or was, when last written) striped */
+static inline bool kv_engine_is_striped_key(kv_engine_t *engine,
+                                            const void *key, size_t key_len,
+                                            uint32_t key_hash) {
+  return atomic_load_explicit(&engine->striped_keys_present,
+                              memory_order_relaxed) &&
+         key_in_table(&engine->striped_keys, key, key_len, key_hash);
+}
+
+/* Copies kept of a striped value's manifest: at least as many lost
+ * devices as its chunks survive */
+static inline uint32_t kv_engine_manifest_replicas(const kv_engine_t *engine) {
+  uint32_t replicas = engine->config.replication_factor;
+  uint32_t needed = engine->config.erasure_parity_chunks + 1;
+  return replicas > needed ? replicas : needed;
+}
+
+/* Places a key, with the manifest's replica count if it is striped */
+static inline void kv_engine_place_key(kv_engine_t *engine, const void *key,
+                                       size_t key_len, uint32_t key_hash,
+                                       kv_placement_t *placement) {
+  uint32_t replicas = engine->config.replication_factor;
+  if (kv_engine_is_striped_key(engine, key, key_len, key_hash)) {
+    replicas = kv_engine_manifest_replicas(engine);
+  }
+  kv_engine_place_copies(engine, key_hash, replicas, placement);
+}
+
+/* True if a value of value_len bytes is erasure coded */
+static inline bool kv_engine_codes_value(const kv_engine_t *engine,
+                                         size_t value_len) {
+  uint32_t min = engine->config.erasure_min_value_size;
+  return min && value_len >= min;
+}
+
+/* True if a value of value_len bytes is stored in chunks, erasure coded or
+ * in stripe units (config.stripe_unit_size is set at init); values too
+ * large for one device value always are */
+static inline bool kv_engine_stripes_value(const kv_engine_t *engine,
+                                           size_t key_len, size_t value_len) {
+  if (key_len > KV_STRIPE_MAX_KEY_LEN) {
+    return false;
+  }
+  uint32_t min = engine->config.stripe_min_value_size;
+  return kv_engine_codes_value(engine, value_len) ||
+         value_len > KV_ENGINE_RETRIEVE_SIZE ||
+         (min && value_len >= min &&
+          value_len > engine->config.stripe_unit_size);
+}
+
+/* OpenMetrics rendering (malloc'd, NUL-terminated) and listener */
+char *kv_engine_render_metrics(kv_engine_t *engine, size_t *len);
+metrics_server_t *metrics_server_create(kv_engine_t *engine, uint16_t port);
+void metrics_server_destroy(metrics_server_t *server);
+
+/* Device telemetry: query the device and append a sample (probe thread or
+ * unpublished devices only); copy the history out, oldest first */
+kvs_result kv_engine_sample_device(kv_device_ctx_t *dev);
+uint32_t kv_engine_read_telemetry(kv_device_ctx_t *dev,
+                                  kv_device_sample_t *samples);
+
 /* Health probe lifecycle */
 health_probe_t *health_probe_create(kv_engine_t *engine);
 void health_probe_destroy(health_probe_t *probe);
+void health_probe_wake(health_probe_t *probe);
 
 #endif /* KV_ENGINE_INTERNAL_H */
@@ -0,0 +1,648 @@
+/**
+ * OpenMetrics Exporter
+ *
+ * Renders engine counters, latency histograms, pool and queue occupancy and
+ * per-device health as OpenMetrics text (the Prometheus exposition format),
+ * and optionally serves it over HTTP on a loopback port.
+ *
+ * Rendering only reads in-memory state: it never issues a device command,
+ * so scraping does not compete with I/O. Device capacity and utilization
+ * come from the health probe's telemetry samples. Latency histograms are exported
+ * with a fixed set of cumulative buckets derived from the engine's
+ * log-linear histograms.
+ *
+ * The listener is a single thread that accepts one connection at a time,
+ * answers GET /metrics and closes the connection. It binds to 127.0.0.1
+ * only; put a proper proxy in front of it to expose metrics remotely.
+ */
+
+#include "kv_engine_internal.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+/* Cumulative bucket bounds for exported latency histograms */
+static const uint64_t bucket_bounds_ns[] = {
+    5000,     10000,     25000,     50000,     100000,    250000,
+    500000,   1000000,   2500000,   5000000,   10000000,  25000000,
+    50000000, 100000000, 250000000, 1000000000,
+};
+#define NUM_BUCKET_BOUNDS (sizeof(bucket_bounds_ns) / sizeof(bucket_bounds_ns[0]))
+
+static const char *op_names[KV_OP_TYPES] = {"store", "retrieve", "delete",
+                                            "exists"};
+static const char *phase_names[KV_PHASES] = {
+    "validate", "route", "index", "buffer", "device", "stats", "queue_wait",
+};
+
+/* Listener poll timeout; bounds how long destroy waits for the thread */
+#define METRICS_POLL_MS 200
+#define METRICS_IO_TIMEOUT_SEC 2
+#define METRICS_REQUEST_MAX 2048
+
+/* ============================================================================
+ * Text Rendering
+ * ============================================================================
+ */
+
+typedef struct {
+  char *data;
+  size_t len;
+  size_t cap;
+  bool failed; /* an allocation failed; the output is incomplete */
+} text_buf_t;
+
+__attribute__((format(printf, 2, 3))) static void emit(text_buf_t *buf,
+                                                       const char *fmt, ...) {
+  if (buf->failed) {
+    return;
+  }
+
+  for (;;) {
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf->data + buf->len, buf->cap - buf->len, fmt, args);
+    va_end(args);
+    if (n < 0) {
+      buf->failed = true;
+      return;
+    }
+    if (buf->len + (size_t)n < buf->cap) {
+      buf->len += (size_t)n;
+      return;
+    }
+
+    size_t cap = buf->cap * 2;
+    while (cap <= buf->len + (size_t)n) {
+      cap *= 2;
+    }
+    char *data = realloc(buf->data, cap);
+    if (!data) {
+      buf->failed = true;
+      return;
+    }
+    buf->data = data;
+    buf->cap = cap;
+  }
+}
+
+static void emit_family(text_buf_t *buf, const char *name, const char *type,
+                        const char *unit, const char *help) {
+  emit(buf, "# TYPE %s %s\n", name, type);
+  if (unit) {
+    emit(buf, "# UNIT %s %s\n", name, unit);
+  }
+  emit(buf, "# HELP %s %s\n", name, help);
+}
+
+/* Writes a label value with OpenMetrics escaping (\\, \" and \n) */
+static void emit_escaped(text_buf_t *buf, const char *value) {
+  for (const char *c = value; *c; c++) {
+    if (*c == '\\' || *c == '"') {
+      emit(buf, "\\%c", *c);
+    } else if (*c == '\n') {
+      emit(buf, "\\n");
+    } else {
+      emit(buf, "%c", *c);
+    }
+  }
+}
+
+/* Emits the samples of one histogram series. labels is a comma-terminated
+ * label list ("op=\"store\",") or "" */
+static void emit_histogram(text_buf_t *buf, const char *name,
+                           const char *labels,
+                           const latency_histogram_t *hist) {
+  latency_summary_t summary;
+  latency_histogram_summarize(hist, &summary);
+
+  uint64_t counts[NUM_BUCKET_BOUNDS];
+  latency_histogram_cumulative(hist, bucket_bounds_ns, NUM_BUCKET_BOUNDS,
+                               counts);
+
+  for (size_t i = 0; i < NUM_BUCKET_BOUNDS; i++) {
+    emit(buf, "%s_bucket{%sle=\"%g\"} %lu\n", name, labels,
+         (double)bucket_bounds_ns[i] / 1e9, (unsigned long)counts[i]);
+  }
+  emit(buf, "%s_bucket{%sle=\"+Inf\"} %lu\n", name, labels,
+       (unsigned long)summary.count);
+
+  /* _count and _sum take the label set without the trailing comma */
+  char set[128] = "";
+  size_t label_len = strlen(labels);
+  if (label_len > 0) {
+    snprintf(set, sizeof(set), "{%.*s}", (int)label_len - 1, labels);
+  }
+  emit(buf, "%s_count%s %lu\n", name, set, (unsigned long)summary.count);
+  emit(buf, "%s_sum%s %.9f\n", name, set,
+       summary.mean_ns * (double)summary.count / 1e9);
+}
+
+static void emit_op_histograms(text_buf_t *buf, const char *name,
+                               const char *help,
+                               const latency_histogram_t *hists) {
+  emit_family(buf, name, "histogram", "seconds", help);
+  for (int op = 0; op < KV_OP_TYPES; op++) {
+    char labels[64];
+    snprintf(labels, sizeof(labels), "op=\"%s\",", op_names[op]);
+    emit_histogram(buf, name, labels, &hists[op]);
+  }
+}
+
+static void render_counters(text_buf_t *buf, kv_engine_t *engine) {
+  kv_engine_stats_t stats;
+  kv_engine_get_stats(engine, &stats);
+
+  emit_family(buf, "kv_engine_operations", "counter", NULL,
+              "Engine operations by type (enable_stats = 1)");
+  emit(buf, "kv_engine_operations_total{op=\"read\"} %lu\n",
+       (unsigned long)stats.read_ops);
+  emit(buf, "kv_engine_operations_total{op=\"write\"} %lu\n",
+       (unsigned long)stats.write_ops);
+  emit(buf, "kv_engine_operations_total{op=\"delete\"} %lu\n",
+       (unsigned long)stats.delete_ops);
+
+  emit_family(buf, "kv_engine_failed_operations", "counter", NULL,
+              "Operations that returned an error");
+  emit(buf, "kv_engine_failed_operations_total %lu\n",
+       (unsigned long)stats.failed_ops);
+
+  emit_family(buf, "kv_engine_read_bytes", "counter", "bytes",
+              "Value bytes returned by successful retrieves");
+  emit(buf, "kv_engine_read_bytes_total %lu\n",
+       (unsigned long)stats.bytes_read);
+
+  emit_family(buf, "kv_engine_written_bytes", "counter", "bytes",
+              "Value bytes accepted by successful stores");
+  emit(buf, "kv_engine_written_bytes_total %lu\n",
+       (unsigned long)stats.bytes_written);
+
+  emit_family(buf, "kv_engine_filter_negatives", "counter", NULL,
+              "Lookups answered absent by a Bloom filter");
+  emit(buf, "kv_engine_filter_negatives_total %lu\n",
+       (unsigned long)stats.filter_negatives);
+
+  emit_family(buf, "kv_engine_exists_from_index", "counter", NULL,
+              "Existence checks answered from the key index");
+  emit(buf, "kv_engine_exists_from_index_total %lu\n",
+       (unsigned long)stats.exists_from_index);
+
+  emit_family(buf, "kv_engine_exists_verified", "counter", NULL,
+              "Existence checks verified against the device");
+  emit(buf, "kv_engine_exists_verified_total %lu\n",
+       (unsigned long)stats.exists_verified);
+
+  emit_family(buf, "kv_engine_index_mismatches", "counter", NULL,
+              "Verified existence checks that disagreed with the index");
+  emit(buf, "kv_engine_index_mismatches_total %lu\n",
+       (unsigned long)stats.index_mismatches);
+
+  emit_family(buf, "kv_engine_hedged_reads", "counter", NULL,
+              "Reads that sent a second request to another copy");
+  emit(buf, "kv_engine_hedged_reads_total %lu\n",
+       (unsigned long)stats.hedged_reads);
+
+  emit_family(buf, "kv_engine_hedge_wins", "counter", NULL,
+              "Hedged reads answered by the second request");
+  emit(buf, "kv_engine_hedge_wins_total %lu\n",
+       (unsigned long)stats.hedge_wins);
+
+  emit_family(buf, "kv_engine_chunked_stores", "counter", NULL,
+              "Stores that wrote the value as erasure-coded chunks");
+  emit(buf, "kv_engine_chunked_stores_total %lu\n",
+       (unsigned long)stats.chunked_stores);
+
+  emit_family(buf, "kv_engine_chunked_retrieves", "counter", NULL,
+              "Retrieves that reassembled a value from chunks");
+  emit(buf, "kv_engine_chunked_retrieves_total %lu\n",
+       (unsigned long)stats.chunked_retrieves);
+
+  emit_family(buf, "kv_engine_reconstructed_retrieves", "counter", NULL,
+              "Chunked retrieves that rebuilt data chunks from parity");
+  emit(buf, "kv_engine_reconstructed_retrieves_total %lu\n",
+       (unsigned long)stats.reconstructed_retrieves);
+
+  emit_family(buf, "kv_engine_index_keys", "gauge", NULL,
+              "Keys tracked by the in-memory key index");
+  emit(buf, "kv_engine_index_keys %lu\n", (unsigned long)stats.index_keys);
+
+  emit_family(buf, "kv_engine_index_load_ratio", "gauge", "ratio",
+              "Occupied (live + deleted) share of key index slots");
+  uint64_t capacity = table_capacity(&engine->key_table);
+  emit(buf, "kv_engine_index_load_ratio %.4f\n",
+       capacity > 0 ? (double)(stats.index_keys +
+                               table_tombstone_count(&engine->key_table)) /
+                          (double)capacity
+                    : 0.0);
+
+  emit_family(buf, "kv_engine_index_memory_bytes", "gauge", "bytes",
+              "Heap bytes used by the key index");
+  emit(buf, "kv_engine_index_memory_bytes %lu\n",
+       (unsigned long)stats.index_bytes);
+
+  emit_family(buf, "kv_engine_filter_memory_bytes", "gauge", "bytes",
+              "Heap bytes used by the device Bloom filters");
+  emit(buf, "kv_engine_filter_memory_bytes %lu\n",
+       (unsigned long)stats.filter_bytes);
+}
+
+static void render_pools(text_buf_t *buf, kv_engine_t *engine) {
+  emit_family(buf, "kv_engine_memory_pool_used_bytes", "gauge", "bytes",
+              "Bytes allocated from the memory pool");
+  emit(buf, "kv_engine_memory_pool_used_bytes %lu\n",
+       (unsigned long)memory_pool_used(engine->mem_pool));
+  emit_family(buf, "kv_engine_memory_pool_size_bytes", "gauge", "bytes",
+              "Memory pool capacity");
+  emit(buf, "kv_engine_memory_pool_size_bytes %lu\n",
+       (unsigned long)engine->mem_pool->size);
+
+  if (engine->buffer_pool) {
+    emit_family(buf, "kv_engine_dma_pool_free_buffers", "gauge", NULL,
+                "DMA pool buffers currently available");
+    emit(buf, "kv_engine_dma_pool_free_buffers %lu\n",
+         (unsigned long)dma_pool_available(engine->buffer_pool));
+    emit_family(buf, "kv_engine_dma_pool_buffers", "gauge", NULL,
+                "DMA pool buffers in total");
+    emit(buf, "kv_engine_dma_pool_buffers %lu\n",
+         (unsigned long)engine->buffer_pool->count);
+    emit_family(buf, "kv_engine_dma_pool_exhausted", "counter", NULL,
+                "DMA pool acquires that found no free buffer");
+    emit(buf, "kv_engine_dma_pool_exhausted_total %lu\n",
+         (unsigned long)dma_pool_exhausted_count(engine->buffer_pool));
+  }
+  emit_family(buf, "kv_engine_dma_fallback_allocations", "counter", NULL,
+              "Per-op DMA allocations made outside the pool");
+  emit(buf, "kv_engine_dma_fallback_allocations_total %lu\n",
+       (unsigned long)atomic_load(&engine->dma_fallback_allocs));
+
+  if (engine->workers) {
+    emit_family(buf, "kv_engine_async_queue_depth", "gauge", NULL,
+                "Async ops waiting for a worker thread");
+    emit(buf, "kv_engine_async_queue_depth %u\n",
+         thread_pool_queue_size(engine->workers));
+    emit_family(buf, "kv_engine_async_queue_capacity", "gauge", NULL,
+                "Async queue bound; submitters block beyond it");
+    emit(buf, "kv_engine_async_queue_capacity %u\n",
+         engine->workers->queue_capacity);
+    emit_family(buf, "kv_engine_async_workers", "gauge", NULL,
+                "Async worker threads");
+    emit(buf, "kv_engine_async_workers %u\n", engine->workers->num_threads);
+    emit_family(buf, "kv_engine_async_active_workers", "gauge", NULL,
+                "Async worker threads executing an op");
+    emit(buf, "kv_engine_async_active_workers %u\n",
+         thread_pool_active(engine->workers));
+  }
+}
+
+static void render_devices(text_buf_t *buf, kv_engine_t *engine) {
+  uint32_t num_devices = engine->num_devices;
+
+  emit_family(buf, "kv_engine_device", "info", NULL, "Device paths");
+  for (uint32_t i = 0; i < num_devices; i++) {
+    emit(buf, "kv_engine_device_info{device=\"%u\",path=\"", i);
+    emit_escaped(buf, engine->devices[i].device_path
+                          ? engine->devices[i].device_path
+                          : "");
+    emit(buf, "\"} 1\n");
+  }
+
+  emit_family(buf, "kv_engine_device_healthy", "gauge", NULL,
+              "1 while the device accepts operations");
+  for (uint32_t i = 0; i < num_devices; i++) {
+    emit(buf, "kv_engine_device_healthy{device=\"%u\"} %d\n", i,
+         atomic_load(&engine->devices[i].healthy) ? 1 : 0);
+  }
+
+  emit_family(buf, "kv_engine_device_slow", "gauge", NULL,
+              "1 while reads avoid the device for its latency");
+  for (uint32_t i = 0; i < num_devices; i++) {
+    emit(buf, "kv_engine_device_slow{device=\"%u\"} %d\n", i,
+         atomic_load(&engine->devices[i].slow) ? 1 : 0);
+  }
+
+  emit_family(buf, "kv_engine_device_weight", "gauge", NULL,
+              "Placement weight; keys are shared in proportion to it");
+  for (uint32_t i = 0; i < num_devices; i++) {
+    emit(buf, "kv_engine_device_weight{device=\"%u\"} %u\n", i,
+         engine->device_weights[i]);
+  }
+
+  emit_family(buf, "kv_engine_device_operations", "counter", NULL,
+              "Device commands issued");
+  for (uint32_t i = 0; i < num_devices; i++) {
+    emit(buf, "kv_engine_device_operations_total{device=\"%u\"} %lu\n", i,
+         (unsigned long)atomic_load(&engine->devices[i].total_ops));
+  }
+
+  emit_family(buf, "kv_engine_device_in_flight", "gauge", NULL,
+              "Device commands issued and not yet completed");
+  for (uint32_t i = 0; i < num_devices; i++) {
+    emit(buf, "kv_engine_device_in_flight{device=\"%u\"} %u\n", i,
+         atomic_load(&engine->devices[i].in_flight));
+  }
+
+  emit_family(buf, "kv_engine_device_errors", "counter", NULL,
+              "Device-level command errors");
+  for (uint32_t i = 0; i < num_devices; i++) {
+    emit(buf, "kv_engine_device_errors_total{device=\"%u\"} %lu\n", i,
+         (unsigned long)atomic_load(&engine->devices[i].total_errors));
+  }
+
+  emit_family(buf, "kv_engine_device_consecutive_errors", "gauge", NULL,
+              "Device-level errors since the last success");
+  for (uint32_t i = 0; i < num_devices; i++) {
+    emit(buf, "kv_engine_device_consecutive_errors{device=\"%u\"} %lu\n", i,
+         (unsigned long)atomic_load(&engine->devices[i].consecutive_errors));
+  }
+
+  /* capacity and utilization from the health probe's telemetry cache */
+  kv_device_health_t *health = malloc(num_devices * sizeof(*health));
+  if (!health) {
+    return;
+  }
+  for (uint32_t i = 0; i < num_devices; i++) {
+    kv_engine_get_device_health(engine, i, &health[i]);
+  }
+
+  emit_family(buf, "kv_engine_device_capacity_bytes", "gauge", "bytes",
+              "Raw device capacity");
+  for (uint32_t i = 0; i < num_devices; i++) {
+    emit(buf, "kv_engine_device_capacity_bytes{device=\"%u\"} %lu\n", i,
+         (unsigned long)health[i].capacity_bytes);
+  }
+
+  emit_family(buf, "kv_engine_device_utilization_ratio", "gauge", "ratio",
+              "Fraction of device capacity in use");
+  for (uint32_t i = 0; i < num_devices; i++) {
+    emit(buf, "kv_engine_device_utilization_ratio{device=\"%u\"} %.4f\n", i,
+         health[i].utilization_pct / 10000.0);
+  }
+
+  emit_family(buf, "kv_engine_device_latency_average_seconds", "gauge",
+              "seconds",
+              "Moving average of device command latency (slow-device "
+              "detection)");
+  for (uint32_t i = 0; i < num_devices; i++) {
+    emit(buf,
+         "kv_engine_device_latency_average_seconds{device=\"%u\"} %.9f\n", i,
+         health[i].latency_ewma_us / 1e6);
+  }
+
+  emit_family(buf, "kv_engine_device_fill_rate_bytes_per_second", "gauge",
+              NULL, "Growth of used device bytes over the sample history");
+  for (uint32_t i = 0; i < num_devices; i++) {
+    emit(buf,
+         "kv_engine_device_fill_rate_bytes_per_second{device=\"%u\"} %.1f\n",
+         i, health[i].fill_rate_bytes_per_sec);
+  }
+  free(health);
+}
+
+static void render_latency(text_buf_t *buf, kv_engine_t *engine) {
+  kv_latency_hists_t *latency = engine->latency;
+  if (latency) {
+    emit_op_histograms(buf, "kv_engine_op_latency_seconds",
+                       "Time spent inside engine calls", latency->op);
+    emit_op_histograms(buf, "kv_engine_queue_wait_seconds",
+                       "Async ops: submit until a worker starts",
+                       latency->queue_wait);
+    emit_op_histograms(buf, "kv_engine_async_latency_seconds",
+                       "Async ops: submit until the completion callback",
+                       latency->async_total);
+
+    emit_family(buf, "kv_engine_device_latency_seconds", "histogram",
+                "seconds", "Device command service time");
+    for (uint32_t dev = 0; dev < engine->num_devices; dev++) {
+      for (int op = 0; op < KV_OP_TYPES; op++) {
+        char labels[64];
+        snprintf(labels, sizeof(labels), "device=\"%u\",op=\"%s\",", dev,
+                 op_names[op]);
+        emit_histogram(buf, "kv_engine_device_latency_seconds", labels,
+                       &latency->device[dev][op]);
+      }
+    }
+  }
+
+  /* phases an op type never passes through are left out */
+  kv_phase_hists_t *phases = engine->phase_timing;
+  if (phases) {
+    emit_family(buf, "kv_engine_phase_seconds", "histogram", "seconds",
+                "Time per hot-path phase (enable_phase_timing = 1)");
+    for (int op = 0; op < KV_OP_TYPES; op++) {
+      for (int phase = 0; phase < KV_PHASES; phase++) {
+        latency_summary_t summary;
+        latency_histogram_summarize(&phases->phase[op][phase], &summary);
+        if (summary.count == 0) {
+          continue;
+        }
+        char labels[64];
+        snprintf(labels, sizeof(labels), "op=\"%s\",phase=\"%s\",",
+                 op_names[op], phase_names[phase]);
+        emit_histogram(buf, "kv_engine_phase_seconds", labels,
+                       &phases->phase[op][phase]);
+      }
+    }
+  }
+}
+
+char *kv_engine_render_metrics(kv_engine_t *engine, size_t *len) {
+  text_buf_t buf = {.cap = 16384};
+  buf.data = malloc(buf.cap);
+  if (!buf.data) {
+    return NULL;
+  }
+
+  render_counters(&buf, engine);
+  render_pools(&buf, engine);
+  render_devices(&buf, engine);
+  render_latency(&buf, engine);
+  emit(&buf, "# EOF\n");
+
+  if (buf.failed) {
+    free(buf.data);
+    return NULL;
+  }
+  *len = buf.len;
+  return buf.data;
+}
+
+/* ============================================================================
+ * HTTP Listener
+ * ============================================================================
+ */
+
+static bool send_all(int fd, const char *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    len -= (size_t)n;
+  }
+  return true;
+}
+
+static void send_response(int fd, const char *status, const char *type,
+                          const char *body, size_t body_len) {
+  char header[256];
+  int n = snprintf(header, sizeof(header),
+                   "HTTP/1.1 %s\r\n"
+                   "Content-Type: %s\r\n"
+                   "Content-Length: %zu\r\n"
+                   "Connection: close\r\n\r\n",
+                   status, type, body_len);
+  if (send_all(fd, header, (size_t)n)) {
+    send_all(fd, body, body_len);
+  }
+}
+
+static void serve_client(metrics_server_t *server, int fd) {
+  struct timeval timeout = {.tv_sec = METRICS_IO_TIMEOUT_SEC};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+  /* only the request line matters; read until the end of the headers */
+  char request[METRICS_REQUEST_MAX];
+  size_t len = 0;
+  while (len < sizeof(request) - 1) {
+    ssize_t n = recv(fd, request + len, sizeof(request) - 1 - len, 0);
+    if (n <= 0) {
+      break;
+    }
+    len += (size_t)n;
+    request[len] = '\0';
+    if (strstr(request, "\r\n\r\n")) {
+      break;
+    }
+  }
+  request[len] = '\0';
+
+  static const char text_type[] = "text/plain; charset=utf-8";
+  if (strncmp(request, "GET ", 4) != 0) {
+    send_response(fd, "405 Method Not Allowed", text_type, "", 0);
+    return;
+  }
+
+  const char *path = request + 4;
+  size_t path_len = strcspn(path, " ?\r\n");
+  if (path_len != strlen("/metrics") ||
+      strncmp(path, "/metrics", path_len) != 0) {
+    static const char body[] = "try /metrics\n";
+    send_response(fd, "404 Not Found", text_type, body, sizeof(body) - 1);
+    return;
+  }
+
+  size_t body_len = 0;
+  char *body = kv_engine_render_metrics(server->engine, &body_len);
+  if (!body) {
+    send_response(fd, "500 Internal Server Error", text_type, "", 0);
+    return;
+  }
+  send_response(fd, "200 OK",
+                "application/openmetrics-text; version=1.0.0; charset=utf-8",
+                body, body_len);
+  free(body);
+}
+
+static void *metrics_server_thread(void *arg) {
+  metrics_server_t *server = (metrics_server_t *)arg;
+
+  while (atomic_load(&server->running)) {
+    struct pollfd pfd = {.fd = server->listen_fd, .events = POLLIN};
+    if (poll(&pfd, 1, METRICS_POLL_MS) <= 0) {
+      continue;
+    }
+    int client = accept(server->listen_fd, NULL, NULL);
+    if (client < 0) {
+      continue;
+    }
+    serve_client(server, client);
+    close(client);
+  }
+  return NULL;
+}
+
+metrics_server_t *metrics_server_create(kv_engine_t *engine, uint16_t port) {
+  metrics_server_t *server = calloc(1, sizeof(metrics_server_t));
+  if (!server) {
+    return NULL;
+  }
+  server->engine = engine;
+
+  server->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (server->listen_fd < 0) {
+    free(server);
+    return NULL;
+  }
+
+  int reuse = 1;
+  setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse,
+             sizeof(reuse));
+
+  struct sockaddr_in addr = {
+      .sin_family = AF_INET,
+      .sin_port = htons(port),
+      .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+  };
+  if (bind(server->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(server->listen_fd, 8) != 0) {
+    close(server->listen_fd);
+    free(server);
+    return NULL;
+  }
+
+  atomic_store(&server->running, true);
+  if (pthread_create(&server->thread, NULL, metrics_server_thread, server) !=
+      0) {
+    close(server->listen_fd);
+    free(server);
+    return NULL;
+  }
+  return server;
+}
+
+void metrics_server_destroy(metrics_server_t *server) {
+  if (!server) {
+    return;
+  }
+  atomic_store(&server->running, false);
+  pthread_join(server->thread, NULL);
+  close(server->listen_fd);
+  free(server);
+}
+
+/* ============================================================================
+ * Public API
+ * ============================================================================
+ */
+
+kv_result_t kv_engine_export_metrics(kv_engine_t *engine, char *buf,
+                                     size_t buf_size, size_t *out_len) {
+  if (!engine || !engine->initialized || !out_len ||
+      (!buf && buf_size > 0)) {
+    return KV_ERR_INVALID_PARAM;
+  }
+
+  size_t len = 0;
+  char *text = kv_engine_render_metrics(engine, &len);
+  if (!text) {
+    return KV_ERR_NO_MEMORY;
+  }
+
+  *out_len = len;
+  kv_result_t res = KV_SUCCESS;
+  if (len < buf_size) {
+    memcpy(buf, text, len + 1);
+  } else {
+    res = KV_ERR_NO_MEMORY;
+  }
+  free(text);
+  return res;
+}
@@ -0,0 +1,644 @@
+/**
+ * Online Device Add and Key Migration
+ *
+ * Keys are placed with rendezvous hashing (kv_engine_place), so adding a
+ * device to N others only moves the keys whose top replication_factor
+ * devices now include the new one, about R/(N+1) of them. Each such key
+ * moves one copy, from the device the new one displaces (the lowest of its
+ * old replicas) straight to the new one; while N < R the new device is
+ * simply one more replica and gets a copy from the key's best old device.
+ * kv_engine_add_device opens the device, records the old device count in a
+ * marker key on every device, marks the migration active and only then
+ * publishes the new count, so every op that places with the new count also
+ * sees the migration:
+ *
+ *   - ops on a moving key hold its lock stripe shared and also look at the
+ *     displaced device: stores write the new replicas and drop the
+ *     displaced copy, retrieves and exists fall back to it, deletes clear
+ *     it too
+ *   - a background thread walks each old device with the KVS iterator and
+ *     moves the copies that belong elsewhere one at a time, holding their
+ *     stripe exclusively, at up to migration_keys_per_sec
+ *
+ * Ops that loaded the old count just before the publish may still land on
+ * the old device, so the migrator waits a grace period before its first
+ * pass and keeps making passes until one finds nothing left to move. It
+ * then deletes the markers and asks for all filters to be rebuilt. An
+ * engine restarted mid-migration finds the markers at init and resumes.
+ */
+
+#include "../utils/dma_alloc.h"
+#include "kv_engine_internal.h"
+#include <kvs_api.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIGRATE_MARKER_KEY KV_INTERNAL_KEY_PREFIX "migrate_from"
+
+/* Time for ops that routed with the old device count to finish */
+#define MIGRATION_GRACE_NS (100 * 1000000ULL)
+
+/* Pause before retrying a pass that hit errors */
+#define MIGRATION_RETRY_NS (1000 * 1000000ULL)
+
+/* Keys found on an old device that owe the new device a copy, packed as
+ * [len:u8][key] */
+typedef struct {
+  uint8_t *data;
+  size_t used;
+  size_t capacity;
+  uint64_t count;
+} key_list_t;
+
+/* ============================================================================
+ * Migration Markers
+ * ============================================================================
+ */
+
+static kvs_result store_marker(kv_device_ctx_t *dev, uint32_t from_devices) {
+  uint32_t *buf = dma_alloc(DMA_ALIGNMENT);
+  if (!buf) {
+    return KVS_ERR_SYS_IO;
+  }
+  *buf = from_devices;
+
+  kvs_key key = {(void *)MIGRATE_MARKER_KEY, sizeof(MIGRATE_MARKER_KEY) - 1};
+  kvs_value value = {buf, sizeof(*buf), sizeof(*buf), 0};
+  kvs_option_store option = {KVS_STORE_POST, NULL};
+  kvs_result res = kvs_store_kvp(dev->keyspace, &key, &value, &option);
+
+  dma_free(buf);
+  return res;
+}
+
+/* Old device count recorded on the device, or 0 if it has no marker */
+static uint32_t read_marker(kv_device_ctx_t *dev) {
+  uint32_t *buf = dma_alloc(DMA_ALIGNMENT);
+  if (!buf) {
+    return 0;
+  }
+
+  kvs_key key = {(void *)MIGRATE_MARKER_KEY, sizeof(MIGRATE_MARKER_KEY) - 1};
+  kvs_value value = {buf, DMA_ALIGNMENT, 0, 0};
+  kvs_option_retrieve option = {false};
+  kvs_result res = kvs_retrieve_kvp(dev->keyspace, &key, &option, &value);
+
+  uint32_t from_devices =
+      res == KVS_SUCCESS && value.length == sizeof(*buf) ? *buf : 0;
+  dma_free(buf);
+  return from_devices;
+}
+
+static void delete_marker(kv_device_ctx_t *dev) {
+  kvs_key key = {(void *)MIGRATE_MARKER_KEY, sizeof(MIGRATE_MARKER_KEY) - 1};
+  kvs_option_delete option = {false};
+  kvs_delete_kvp(dev->keyspace, &key, &option);
+}
+
+/* ============================================================================
+ * Migrator Thread
+ * ============================================================================
+ */
+
+/* Sleeps until deadline_ns on the monotonic clock. Returns false if the
+ * migrator was asked to stop. */
+static bool migration_sleep_until(kv_migration_t *migration,
+                                  uint64_t deadline_ns) {
+  struct timespec deadline = {
+      .tv_sec = (time_t)(deadline_ns / 1000000000ULL),
+      .tv_nsec = (long)(deadline_ns % 1000000000ULL)};
+
+  pthread_mutex_lock(&migration->mutex);
+  while (!migration->stop && kv_now_ns() < deadline_ns) {
+    pthread_cond_timedwait(&migration->cond, &migration->mutex, &deadline);
+  }
+  bool stop = migration->stop;
+  pthread_mutex_unlock(&migration->mutex);
+  return !stop;
+}
+
+static bool migration_stopping(kv_migration_t *migration) {
+  pthread_mutex_lock(&migration->mutex);
+  bool stop = migration->stop;
+  pthread_mutex_unlock(&migration->mutex);
+  return stop;
+}
+
+static bool key_list_append(key_list_t *list, const uint8_t *key,
+                            uint32_t key_len) {
+  if (list->used + 1 + key_len > list->capacity) {
+    size_t capacity = list->capacity ? list->capacity * 2 : 64 * 1024;
+    uint8_t *data = realloc(list->data, capacity);
+    if (!data) {
+      return false;
+    }
+    list->data = data;
+    list->capacity = capacity;
+  }
+  list->data[list->used++] = (uint8_t)key_len;
+  memcpy(list->data + list->used, key, key_len);
+  list->used += key_len;
+  list->count++;
+  return true;
+}
+
+/* Whether the copy of a key on old device dev_idx is the one to move: the
+ * displaced copy, or while replicas grow, the copy on the key's best old
+ * device */
+static bool copy_moves(kv_engine_t *engine, uint32_t dev_idx,
+                       const uint8_t *key, uint32_t key_len,
+                       uint32_t key_hash) {
+  kv_placement_t placement;
+  kv_engine_place_key(engine, key, key_len, key_hash, &placement);
+  if (!placement.moving) {
+    return false;
+  }
+  if (placement.dropped != KV_NO_DEVICE) {
+    return placement.dropped == dev_idx;
+  }
+  return rendezvous_pick(key_hash, kv_engine_weights(engine),
+                         engine->migration->from_devices) == dev_idx;
+}
+
+/* Walks an old device and lists the user keys whose copy there has to
+ * move. Iterator entries are [len:u32][key] because keys are variable
+ * length. */
+static kv_result_t collect_misplaced(kv_engine_t *engine, uint32_t dev_idx,
+                                     key_list_t *list) {
+  kv_migration_t *migration = engine->migration;
+  kvs_key_space_handle keyspace = engine->devices[dev_idx].keyspace;
+
+  kvs_option_iterator option = {KVS_ITERATOR_KEY};
+  kvs_key_group_filter filter;
+  memset(&filter, 0, sizeof(filter)); /* empty bitmask matches every key */
+
+  kvs_iterator_handle handle;
+  if (kvs_create_iterator(keyspace, &option, &filter, &handle) !=
+      KVS_SUCCESS) {
+    return KV_ERR_IO;
+  }
+
+  uint8_t *buffer = dma_alloc(KVS_ITERATOR_BUFFER_SIZE);
+  if (!buffer) {
+    kvs_delete_iterator(keyspace, handle);
+    return KV_ERR_NO_MEMORY;
+  }
+
+  kv_result_t result = KV_SUCCESS;
+  kvs_iterator_list iter;
+  iter.it_list = buffer;
+  iter.end = false;
+
+  while (!iter.end && result == KV_SUCCESS) {
+    iter.size = KVS_ITERATOR_BUFFER_SIZE;
+    iter.num_entries = 0;
+    if (kvs_iterate_next(keyspace, handle, &iter) != KVS_SUCCESS) {
+      result = KV_ERR_IO;
+      break;
+    }
+
+    uint32_t pos = 0;
+    for (uint32_t i = 0; i < iter.num_entries; i++) {
+      uint32_t key_len;
+      if (pos + sizeof(key_len) > iter.size) {
+        break;
+      }
+      memcpy(&key_len, buffer + pos, sizeof(key_len));
+      pos += sizeof(key_len);
+      if (key_len == 0 || key_len > 255 || pos + key_len > iter.size) {
+        break;
+      }
+
+      const uint8_t *key = buffer + pos;
+      pos += key_len;
+      if (kv_engine_is_internal_key(key, key_len)) {
+        continue;
+      }
+      atomic_fetch_add_explicit(&migration->keys_scanned, 1,
+                                memory_order_relaxed);
+      uint32_t key_hash = kv_engine_key_hash(key, key_len);
+      if (copy_moves(engine, dev_idx, key, key_len, key_hash) &&
+          !key_list_append(list, key, key_len)) {
+        result = KV_ERR_NO_MEMORY;
+        break;
+      }
+    }
+  }
+
+  dma_free(buffer);
+  kvs_delete_iterator(keyspace, handle);
+  return result;
+}
+
+typedef enum {
+  MOVE_FAILED,  /* the copy stays where it is */
+  MOVE_SKIPPED, /* nothing to do: gone, or already copied */
+  MOVE_DONE,
+} move_result_t;
+
+/* Copies one key from old device from_idx to the added device, deleting
+ * it from from_idx if that is the device the key leaves. *buffer is a DMA
+ * buffer of *buffer_size bytes, grown when a value doesn't fit. */
+static move_result_t move_key(kv_engine_t *engine, uint32_t from_idx,
+                              const uint8_t *key_bytes, uint32_t key_len,
+                              void **buffer, size_t *buffer_size) {
+  kv_migration_t *migration = engine->migration;
+  uint32_t key_hash = kv_engine_key_hash(key_bytes, key_len);
+  uint32_t to_idx = migration->from_devices;
+  kvs_key key = {(void *)key_bytes, (uint16_t)key_len};
+
+  kv_placement_t placement;
+  kv_engine_place_key(engine, key_bytes, key_len, key_hash, &placement);
+  bool leaves = placement.dropped == from_idx;
+
+  pthread_rwlock_t *lock = kv_key_lock(engine, key_hash, true);
+  if (!lock) {
+    return MOVE_FAILED;
+  }
+
+  /* A copy that stays behind is only needed once; later passes find it on
+   * the added device */
+  if (!leaves) {
+    uint8_t found = 0;
+    kvs_exist_list exist_list = {1, &key, 1, &found};
+    kvs_result res = kvs_exist_kv_pairs(engine->devices[to_idx].keyspace, 1,
+                                        &key, &exist_list);
+    if (res != KVS_SUCCESS || found) {
+      kv_key_unlock(lock);
+      return res == KVS_SUCCESS ? MOVE_SKIPPED : MOVE_FAILED;
+    }
+  }
+
+  kvs_value value = {*buffer, (uint32_t)*buffer_size, 0, 0};
+  kvs_option_retrieve retrieve_option = {false};
+  kvs_result res = kvs_retrieve_kvp(engine->devices[from_idx].keyspace, &key,
+                                    &retrieve_option, &value);
+  if (res == KVS_ERR_BUFFER_SMALL) {
+    void *larger = dma_alloc(value.actual_value_size);
+    if (!larger) {
+      kv_key_unlock(lock);
+      return MOVE_FAILED;
+    }
+    dma_free(*buffer);
+    *buffer = larger;
+    *buffer_size = value.actual_value_size;
+    value.value = larger;
+    value.length = (uint32_t)*buffer_size;
+    value.offset = 0;
+    res = kvs_retrieve_kvp(engine->devices[from_idx].keyspace, &key,
+                           &retrieve_option, &value);
+  }
+  if (res == KVS_ERR_KEY_NOT_EXIST) {
+    /* deleted or rewritten since the scan */
+    kv_key_unlock(lock);
+    return MOVE_SKIPPED;
+  }
+  if (res != KVS_SUCCESS) {
+    kv_key_unlock(lock);
+    return MOVE_FAILED;
+  }
+
+  /* A copy already on the new device was written after the add and is
+   * newer; only the old one goes */
+  uint32_t value_len = value.length;
+  kv_engine_filter_add(engine, to_idx, key_hash);
+  kvs_option_store store_option = {KVS_STORE_NOOVERWRITE, NULL};
+  res = kvs_store_kvp(engine->devices[to_idx].keyspace, &key, &value,
+                      &store_option);
+  bool copied = res == KVS_SUCCESS;
+  if (!copied && res != KVS_ERR_VALUE_UPDATE_NOT_ALLOWED) {
+    kv_key_unlock(lock);
+    return MOVE_FAILED;
+  }
+
+  if (leaves) {
+    kvs_option_delete delete_option = {false};
+    res = kvs_delete_kvp(engine->devices[from_idx].keyspace, &key,
+                         &delete_option);
+    if (res != KVS_SUCCESS) {
+      kv_key_unlock(lock);
+      return MOVE_FAILED;
+    }
+    kv_engine_filter_note_delete(engine, from_idx);
+  }
+  kv_key_unlock(lock);
+
+  if (copied) {
+    atomic_fetch_add_explicit(&migration->keys_moved, 1,
+                              memory_order_relaxed);
+    atomic_fetch_add_explicit(&migration->bytes_moved, value_len,
+                              memory_order_relaxed);
+  }
+  return MOVE_DONE;
+}
+
+/* One sweep over the old devices. Returns the keys that needed moving, or
+ * UINT64_MAX if a device couldn't be fully walked or a key failed to
+ * move. */
+static uint64_t migration_pass(kv_engine_t *engine, void **buffer,
+                               size_t *buffer_size) {
+  kv_migration_t *migration = engine->migration;
+  uint32_t rate = engine->config.migration_keys_per_sec;
+  uint64_t pass_start = kv_now_ns();
+  uint64_t paced = 0;
+  uint64_t misplaced = 0;
+  bool failed = false;
+
+  for (uint32_t dev = 0; dev < migration->from_devices; dev++) {
+    key_list_t list = {0};
+    if (collect_misplaced(engine, dev, &list) != KV_SUCCESS) {
+      atomic_fetch_add_explicit(&migration->errors, 1, memory_order_relaxed);
+      failed = true;
+    }
+
+    size_t pos = 0;
+    while (pos < list.used) {
+      uint32_t key_len = list.data[pos++];
+      move_result_t moved = move_key(engine, dev, list.data + pos, key_len,
+                                     buffer, buffer_size);
+      if (moved != MOVE_SKIPPED) {
+        misplaced++;
+        atomic_fetch_add_explicit(&migration->keys_to_move, 1,
+                                  memory_order_relaxed);
+      }
+      if (moved == MOVE_FAILED) {
+        atomic_fetch_add_explicit(&migration->errors, 1,
+                                  memory_order_relaxed);
+        failed = true;
+      }
+      pos += key_len;
+
+      /* pace to migration_keys_per_sec from the start of the pass */
+      paced++;
+      if (rate > 0 &&
+          !migration_sleep_until(migration,
+                                 pass_start + paced * 1000000000ULL / rate)) {
+        break;
+      }
+      if (rate == 0 && migration_stopping(migration)) {
+        break;
+      }
+    }
+    free(list.data);
+
+    if (migration_stopping(migration)) {
+      return UINT64_MAX;
+    }
+  }
+  return failed ? UINT64_MAX : misplaced;
+}
+
+static void *migrator_thread(void *arg) {
+  kv_engine_t *engine = (kv_engine_t *)arg;
+  kv_migration_t *migration = engine->migration;
+
+  if (!migration_sleep_until(migration, kv_now_ns() + MIGRATION_GRACE_NS)) {
+    return NULL;
+  }
+
+  size_t buffer_size = KV_ENGINE_RETRIEVE_SIZE;
+  void *buffer = dma_alloc(buffer_size);
+
+  while (buffer) {
+    atomic_fetch_add(&migration->passes, 1);
+    uint64_t misplaced = migration_pass(engine, &buffer, &buffer_size);
+    if (misplaced == 0) {
+      /* Nothing left on an old device: ops stop looking there */
+      for (uint32_t i = 0; i < engine->num_devices; i++) {
+        delete_marker(&engine->devices[i]);
+      }
+      atomic_store_explicit(&migration->active, false, memory_order_release);
+      kv_engine_filter_rebuild_all(engine);
+      break;
+    }
+    uint64_t resume_at =
+        kv_now_ns() + (misplaced == UINT64_MAX ? MIGRATION_RETRY_NS : 0);
+    if (!migration_sleep_until(migration, resume_at)) {
+      break;
+    }
+  }
+
+  if (!buffer) {
+    fprintf(stderr, "[kv_engine] warning: migrator could not allocate a "
+                    "buffer; keys stay on their old devices\n");
+  }
+  dma_free(buffer);
+  return NULL;
+}
+
+/* Starts moving keys placed under from_devices. Best-effort: if the thread
+ * can't start, moving keys stay readable from their old devices and the
+ * markers resume the migration at the next init. */
+static void start_migrator(kv_engine_t *engine) {
+  kv_migration_t *migration = engine->migration;
+  migration->thread_started =
+      pthread_create(&migration->thread, NULL, migrator_thread, engine) == 0;
+  if (!migration->thread_started) {
+    fprintf(stderr, "[kv_engine] warning: migrator thread failed to start; "
+                    "keys move at the next init\n");
+  }
+}
+
+/* ============================================================================
+ * Lifecycle
+ * ============================================================================
+ */
+
+void kv_engine_migration_place(kv_engine_t *engine, uint32_t key_hash,
+                               uint32_t replicas, kv_placement_t *placement) {
+  uint32_t added = engine->migration->from_devices;
+  for (uint32_t i = 0; i < placement->count; i++) {
+    if (placement->dev[i] != added) {
+      continue;
+    }
+    placement->moving = true;
+
+    /* the added device displaced the lowest of the key's old replicas,
+     * unless the old device count was below the replica count */
+    uint32_t old_count = kv_engine_copies(replicas, added);
+    if (old_count == placement->count) {
+      uint32_t old[KV_MAX_DEVICES];
+      rendezvous_top(key_hash, kv_engine_weights(engine), added, old_count,
+                     old);
+      placement->dropped = old[old_count - 1];
+    }
+    return;
+  }
+}
+
+kv_result_t kv_engine_migration_init(kv_engine_t *engine) {
+  kv_migration_t *migration = calloc(1, sizeof(kv_migration_t));
+  if (!migration) {
+    return KV_ERR_NO_MEMORY;
+  }
+
+  for (uint32_t i = 0; i < KV_MIGRATION_LOCKS; i++) {
+    pthread_rwlock_init(&migration->locks[i], NULL);
+  }
+  pthread_mutex_init(&migration->mutex, NULL);
+
+  /* Monotonic to match kv_now_ns in migration_sleep_until */
+  pthread_condattr_t cattr;
+  pthread_condattr_init(&cattr);
+  pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+  pthread_cond_init(&migration->cond, &cattr);
+  pthread_condattr_destroy(&cattr);
+
+  engine->migration = migration;
+  return KV_SUCCESS;
+}
+
+void kv_engine_migration_resume(kv_engine_t *engine) {
+  uint32_t num_devices = engine->num_devices;
+  uint32_t from_devices = 0;
+  for (uint32_t i = 0; i < num_devices && from_devices == 0; i++) {
+    from_devices = read_marker(&engine->devices[i]);
+  }
+  if (from_devices == 0) {
+    return;
+  }
+  if (from_devices == num_devices) {
+    /* finished, but stopped before all markers were deleted */
+    for (uint32_t i = 0; i < num_devices; i++) {
+      delete_marker(&engine->devices[i]);
+    }
+    return;
+  }
+  if (from_devices > num_devices) {
+    fprintf(stderr,
+            "[kv_engine] warning: devices hold an unfinished migration from "
+            "%u devices but only %u are configured; keys on the missing "
+            "devices are not visible\n",
+            from_devices, num_devices);
+    return;
+  }
+
+  engine->migration->from_devices = from_devices;
+  atomic_store_explicit(&engine->migration->active, true,
+                        memory_order_release);
+  start_migrator(engine);
+}
+
+void kv_engine_migration_destroy(kv_engine_t *engine) {
+  kv_migration_t *migration = engine->migration;
+  if (!migration) {
+    return;
+  }
+
+  if (migration->thread_started) {
+    pthread_mutex_lock(&migration->mutex);
+    migration->stop = true;
+    pthread_cond_signal(&migration->cond);
+    pthread_mutex_unlock(&migration->mutex);
+    pthread_join(migration->thread, NULL);
+  }
+
+  for (uint32_t i = 0; i < KV_MIGRATION_LOCKS; i++) {
+    pthread_rwlock_destroy(&migration->locks[i]);
+  }
+  pthread_mutex_destroy(&migration->mutex);
+  pthread_cond_destroy(&migration->cond);
+  free(migration);
+  engine->migration = NULL;
+}
+
+/* ============================================================================
+ * Public API
+ * ============================================================================
+ */
+
+kv_result_t kv_engine_add_device(kv_engine_t *engine, const char *device_path) {
+  if (!engine || !engine->initialized || !device_path) {
+    return KV_ERR_INVALID_PARAM;
+  }
+
+  kv_migration_t *migration = engine->migration;
+
+  /* the mutex serializes adds; the migrator only takes it to sleep */
+  pthread_mutex_lock(&migration->mutex);
+  uint32_t current =
+      atomic_load_explicit(&engine->num_devices, memory_order_acquire);
+  if (current >= engine->device_slots) {
+    pthread_mutex_unlock(&migration->mutex);
+    return KV_ERR_INVALID_PARAM;
+  }
+  if (atomic_load(&migration->active)) {
+    pthread_mutex_unlock(&migration->mutex);
+    return KV_ERR_BUSY;
+  }
+
+  kv_result_t res =
+      kv_engine_open_device(&engine->devices[current], device_path, current);
+  if (res == KV_SUCCESS) {
+    res = kv_engine_track_latency(engine, current);
+    if (res == KV_SUCCESS) {
+      res = kv_engine_weigh_device(engine, current);
+    }
+    if (res != KV_SUCCESS) {
+      kv_engine_close_device(&engine->devices[current]);
+    }
+  }
+  if (res != KV_SUCCESS) {
+    pthread_mutex_unlock(&migration->mutex);
+    return res;
+  }
+
+  /* Markers first, so a restart at any later point resumes the move */
+  for (uint32_t i = 0; i <= current; i++) {
+    if (store_marker(&engine->devices[i], current) != KVS_SUCCESS) {
+      for (uint32_t j = 0; j < i; j++) {
+        delete_marker(&engine->devices[j]);
+      }
+      kv_engine_close_device(&engine->devices[current]);
+      pthread_mutex_unlock(&migration->mutex);
+      return KV_ERR_IO;
+    }
+  }
+
+  /* The device is going in: place by weight if its weight differs */
+  kv_engine_update_weighted(engine, current + 1);
+
+  /* Reap the previous migrator before reusing its slot */
+  if (migration->thread_started) {
+    pthread_join(migration->thread, NULL);
+    migration->thread_started = false;
+  }
+  atomic_store(&migration->passes, 0);
+  atomic_store(&migration->keys_scanned, 0);
+  atomic_store(&migration->keys_to_move, 0);
+  atomic_store(&migration->keys_moved, 0);
+  atomic_store(&migration->bytes_moved, 0);
+  atomic_store(&migration->errors, 0);
+
+  /* Ops that see the new count must see the migration: the release store
+   * of num_devices publishes both the device slot and this state */
+  migration->from_devices = current;
+  atomic_store_explicit(&migration->active, true, memory_order_relaxed);
+  atomic_store_explicit(&engine->num_devices, current + 1,
+                        memory_order_release);
+  pthread_mutex_unlock(&migration->mutex);
+
+  start_migrator(engine);
+  return KV_SUCCESS;
+}
+
+kv_result_t kv_engine_get_migration_status(kv_engine_t *engine,
+                                           kv_migration_status_t *status) {
+  if (!engine || !engine->initialized || !status) {
+    return KV_ERR_INVALID_PARAM;
+  }
+
+  kv_migration_t *migration = engine->migration;
+  memset(status, 0, sizeof(*status));
+  status->active = atomic_load(&migration->active);
+  status->from_devices = migration->from_devices;
+  status->to_devices = engine->num_devices;
+  status->passes = atomic_load(&migration->passes);
+  status->keys_scanned = atomic_load(&migration->keys_scanned);
+  status->keys_to_move = atomic_load(&migration->keys_to_move);
+  status->keys_moved = atomic_load(&migration->keys_moved);
+  status->bytes_moved = atomic_load(&migration->bytes_moved);
+  status->errors = atomic_load(&migration->errors);
+  return KV_SUCCESS;
+}
@@ -1,3 +1,4 @@
+#include "../utils/dma_alloc.h"
 #include "kv_engine_internal.h"
 
 #include <stdio.h>
@@ -33,15 +34,19 @@ kv_result_t kv_engine_resolve_device_paths(const kv_engine_config_t *config,
   return KV_SUCCESS;
 }
 
-uint32_t kv_engine_shard_for_key(const void *key, size_t key_len,
-                                 uint32_t num_devices) {
+uint32_t kv_engine_key_hash(const void *key, size_t key_len) {
   const uint8_t *data = (const uint8_t *)key;
   uint32_t hash = 2166136261u;
   for (size_t i = 0; i < key_len; i++) {
     hash ^= data[i];
     hash *= 16777619u;
   }
-  return hash % num_devices;
+  return hash;
+}
+
+uint32_t kv_engine_shard_for_key(const void *key, size_t key_len,
+                                 uint32_t num_devices) {
+  return rendezvous_pick(kv_engine_key_hash(key, key_len), NULL, num_devices);
 }
 
 kv_result_t kv_engine_open_device(kv_device_ctx_t *ctx, const char *path,
@@ -88,6 +93,12 @@ kv_result_t kv_engine_open_device(kv_device_ctx_t *ctx, const char *path,
   atomic_store(&ctx->total_ops, 0);
   ctx->max_consecutive_errors = 10;
 
+  /* First telemetry sample, so health reads have data before the probe's
+   * first sweep */
+  atomic_store(&ctx->telemetry_seq, 0);
+  ctx->telemetry_count = 0;
+  kv_engine_sample_device(ctx);
+
   return KV_SUCCESS;
 }
 
@@ -104,4 +115,182 @@ void kv_engine_close_device(kv_device_ctx_t *ctx) {
     free(ctx->device_path);
     ctx->device_path = NULL;
   }
+  free(ctx->read_latency);
+  free(ctx->read_window);
+  free(ctx->cmd_latency);
+  free(ctx->cmd_window);
+  ctx->read_latency = NULL;
+  ctx->read_window = NULL;
+  ctx->cmd_latency = NULL;
+  ctx->cmd_window = NULL;
+}
+
+/* ============================================================================
+ * Placement Weights
+ * ============================================================================
+ */
+
+#define WEIGHT_MARKER_KEY KV_INTERNAL_KEY_PREFIX "weight"
+
+/* Weight recorded on the device when it first joined, or 0 if none */
+static uint32_t read_weight(kv_device_ctx_t *dev) {
+  uint32_t *buf = dma_alloc(DMA_ALIGNMENT);
+  if (!buf) {
+    return 0;
+  }
+
+  kvs_key key = {(void *)WEIGHT_MARKER_KEY, sizeof(WEIGHT_MARKER_KEY) - 1};
+  kvs_value value = {buf, DMA_ALIGNMENT, 0, 0};
+  kvs_option_retrieve option = {false};
+  kvs_result res = kvs_retrieve_kvp(dev->keyspace, &key, &option, &value);
+
+  uint32_t weight =
+      res == KVS_SUCCESS && value.length == sizeof(*buf) ? *buf : 0;
+  dma_free(buf);
+  return weight;
+}
+
+static kvs_result record_weight(kv_device_ctx_t *dev, uint32_t weight) {
+  uint32_t *buf = dma_alloc(DMA_ALIGNMENT);
+  if (!buf) {
+    return KVS_ERR_SYS_IO;
+  }
+  *buf = weight;
+
+  kvs_key key = {(void *)WEIGHT_MARKER_KEY, sizeof(WEIGHT_MARKER_KEY) - 1};
+  kvs_value value = {buf, sizeof(*buf), sizeof(*buf), 0};
+  kvs_option_store option = {KVS_STORE_POST, NULL};
+  kvs_result res = kvs_store_kvp(dev->keyspace, &key, &value, &option);
+
+  dma_free(buf);
+  return res;
+}
+
+/* Free GiB of a device by the sample taken when it was opened (at least 1),
+ * or 0 if it couldn't be sampled */
+static uint32_t free_gib(const kv_device_ctx_t *dev) {
+  if (dev->telemetry_count == 0) {
+    return 0;
+  }
+  const kv_device_sample_t *sample =
+      &dev->telemetry[(dev->telemetry_count - 1) % KV_TELEMETRY_HISTORY];
+  uint32_t used = sample->utilization_pct < 10000 ? sample->utilization_pct
+                                                  : 10000;
+  uint64_t gib = sample->capacity_bytes / 10000 * (10000 - used) >> 30;
+  if (gib == 0) {
+    return 1;
+  }
+  return gib < UINT32_MAX ? (uint32_t)gib : UINT32_MAX;
+}
+
+/* The configured weight, else the one recorded on the device, else with
+ * weight_by_capacity its free space, recorded so later inits find it, else
+ * 1. Touches only the device's own weight, so devices can be weighed
+ * concurrently; kv_engine_update_weighted then applies them. */
+kv_result_t kv_engine_weigh_device(kv_engine_t *engine, uint32_t dev_idx) {
+  kv_device_ctx_t *dev = &engine->devices[dev_idx];
+  uint32_t weight = engine->config.device_weights[dev_idx];
+  if (weight == 0) {
+    weight = read_weight(dev);
+  }
+  if (weight == 0 && engine->config.weight_by_capacity) {
+    weight = free_gib(dev);
+    if (weight == 0 || record_weight(dev, weight) != KVS_SUCCESS) {
+      fprintf(stderr, "Failed to record the weight of %s\n",
+              dev->device_path);
+      return KV_ERR_IO;
+    }
+  }
+  if (weight == 0) {
+    weight = 1;
+  }
+
+  engine->device_weights[dev_idx] = weight;
+  return KV_SUCCESS;
+}
+
+void kv_engine_update_weighted(kv_engine_t *engine, uint32_t num_devices) {
+  bool weighted = false;
+  for (uint32_t i = 1; i < num_devices; i++) {
+    weighted |= engine->device_weights[i] != engine->device_weights[0];
+  }
+  atomic_store_explicit(&engine->weighted, weighted, memory_order_release);
+}
+
+/* ============================================================================
+ * Concurrent Device Open
+ * ============================================================================
+ */
+
+typedef struct {
+  kv_engine_t *engine;
+  const char **paths;
+  uint32_t count;
+  _Atomic uint32_t next; /* next device to open */
+  kv_result_t results[KV_MAX_DEVICES];
+  uint64_t duration_ns[KV_MAX_DEVICES];
+} open_queue_t;
+
+/* Opens and weighs devices until none are left. Most of an open is
+ * waiting on the device (keyspace create and open, the telemetry log page,
+ * the weight marker), so several openers overlap those waits. */
+static void *open_device_thread(void *arg) {
+  open_queue_t *queue = (open_queue_t *)arg;
+  uint32_t i;
+  while ((i = atomic_fetch_add(&queue->next, 1)) < queue->count) {
+    uint64_t start = kv_now_ns();
+    kv_result_t res = kv_engine_open_device(&queue->engine->devices[i],
+                                            queue->paths[i], i);
+    if (res == KV_SUCCESS) {
+      res = kv_engine_weigh_device(queue->engine, i);
+    }
+    queue->results[i] = res;
+    queue->duration_ns[i] = kv_now_ns() - start;
+  }
+  return NULL;
+}
+
+kv_result_t kv_engine_open_devices(kv_engine_t *engine, const char **paths,
+                                   uint32_t count, uint64_t *slowest_ns) {
+  open_queue_t queue = {.engine = engine, .paths = paths, .count = count};
+
+  uint32_t openers = engine->config.device_open_threads;
+  if (openers == 0 || openers > count) {
+    openers = count;
+  }
+  /* the caller is one of the openers */
+  pthread_t threads[KV_MAX_DEVICES];
+  uint32_t started = 0;
+  while (started + 1 < openers &&
+         pthread_create(&threads[started], NULL, open_device_thread,
+                        &queue) == 0) {
+    started++;
+  }
+  open_device_thread(&queue);
+  for (uint32_t t = 0; t < started; t++) {
+    pthread_join(threads[t], NULL);
+  }
+
+  kv_result_t result = KV_SUCCESS;
+  *slowest_ns = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    if (queue.duration_ns[i] > *slowest_ns) {
+      *slowest_ns = queue.duration_ns[i];
+    }
+    if (queue.results[i] != KV_SUCCESS && result == KV_SUCCESS) {
+      result = queue.results[i];
+    }
+  }
+
+  if (result != KV_SUCCESS) {
+    /* a failed open leaves its handles NULL, so closing it is a no-op */
+    for (uint32_t i = 0; i < count; i++) {
+      kv_engine_close_device(&engine->devices[i]);
+    }
+    return result;
+  }
+
+  kv_engine_update_weighted(engine, count);
+  atomic_store_explicit(&engine->num_devices, count, memory_order_release);
+  return KV_SUCCESS;
 }
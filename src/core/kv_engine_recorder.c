@@ -0,0 +1,471 @@
+/**
+ * Flight Recorder and Slow-Op Log
+ *
+ * Device health counters say that a device misbehaved, not which calls
+ * suffered. With flight_recorder_size = N every public store, retrieve,
+ * delete and exists call is written to a ring of the last N calls of its
+ * thread (one ring per statistics slot), and calls slower than
+ * slow_op_threshold_us are also kept in a shared slow-op log. Writing is a
+ * single atomic add and a ~50 byte copy; nothing is locked.
+ *
+ * Both logs can be read through the API or dumped as text. dump_signal
+ * installs a handler that only posts a semaphore; a process-wide dump
+ * thread does the formatting and I/O, so a dump is safe to request at any
+ * time, including while a device is stalled.
+ */
+
+#include "kv_engine_internal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+_Thread_local kv_op_trace_t kv_op_trace;
+
+/* ============================================================================
+ * Recording
+ * ============================================================================
+ */
+
+void kv_engine_record_op(kv_engine_t *engine, kv_op_type_t op,
+                         uint64_t start_ns, uint64_t end_ns, const void *key,
+                         size_t key_len, kv_result_t result,
+                         size_t value_size) {
+  kv_flight_recorder_t *rec = engine->recorder;
+  kv_op_record_t record = {
+      .timestamp_ns = start_ns,
+      .latency_ns = end_ns - start_ns,
+      .device_ns = kv_op_trace.device_ns,
+      .value_size = value_size,
+      .device_index = kv_op_trace.dev_slot ? kv_op_trace.dev_slot - 1
+                                           : UINT32_MAX,
+      .op = op,
+      .result = result,
+  };
+  kv_op_trace.device_ns = 0;
+  kv_op_trace.dev_slot = 0;
+
+  if (key && key_len >= 4 && key_len <= 255) {
+    record.key_hash = kv_engine_key_hash(key, key_len);
+  }
+
+  if (rec->threads[0]) {
+    uint32_t slot = kv_stats_thread_slot;
+    if (slot == 0) {
+      slot = kv_engine_assign_stats_slot();
+    }
+    trace_ring_push(rec->threads[(slot - 1) & (KV_STATS_SLOTS - 1)], &record);
+  }
+  if (rec->slow_ops && record.latency_ns >= rec->slow_threshold_ns) {
+    trace_ring_push(rec->slow_ops, &record);
+  }
+}
+
+/* ============================================================================
+ * Reading
+ * ============================================================================
+ */
+
+static int compare_timestamp(const void *a, const void *b) {
+  uint64_t ta = ((const kv_op_record_t *)a)->timestamp_ns;
+  uint64_t tb = ((const kv_op_record_t *)b)->timestamp_ns;
+  return (ta > tb) - (ta < tb);
+}
+
+/* Sorts records oldest first, keeps the newest max at the front and moves
+ * their timestamps onto the wall clock */
+static uint32_t finish_records(const kv_flight_recorder_t *rec,
+                               kv_op_record_t *all, uint32_t n,
+                               kv_op_record_t *records, uint32_t max) {
+  qsort(all, n, sizeof(kv_op_record_t), compare_timestamp);
+  uint32_t keep = n < max ? n : max;
+  for (uint32_t i = 0; i < keep; i++) {
+    records[i] = all[n - keep + i];
+    records[i].timestamp_ns += rec->realtime_offset_ns;
+  }
+  return keep;
+}
+
+/* Collects every thread ring; *out is malloc'd */
+static kv_result_t collect_recent(kv_flight_recorder_t *rec,
+                                  kv_op_record_t **out, uint32_t *n) {
+  *out = NULL;
+  *n = 0;
+  if (!rec->threads[0]) {
+    return KV_SUCCESS;
+  }
+
+  uint32_t per_ring = trace_ring_capacity(rec->threads[0]);
+  kv_op_record_t *all =
+      malloc(sizeof(kv_op_record_t) * per_ring * KV_STATS_SLOTS);
+  if (!all) {
+    return KV_ERR_NO_MEMORY;
+  }
+  for (uint32_t i = 0; i < KV_STATS_SLOTS; i++) {
+    *n += trace_ring_snapshot(rec->threads[i], all + *n);
+  }
+  *out = all;
+  return KV_SUCCESS;
+}
+
+kv_result_t kv_engine_get_recent_ops(kv_engine_t *engine,
+                                     kv_op_record_t *records, uint32_t max,
+                                     uint32_t *count) {
+  if (!engine || !engine->initialized || (!records && max) || !count) {
+    return KV_ERR_INVALID_PARAM;
+  }
+
+  *count = 0;
+  if (!engine->recorder) {
+    return KV_SUCCESS;
+  }
+
+  kv_op_record_t *all;
+  uint32_t n;
+  kv_result_t res = collect_recent(engine->recorder, &all, &n);
+  if (res != KV_SUCCESS) {
+    return res;
+  }
+  *count = finish_records(engine->recorder, all, n, records, max);
+  free(all);
+  return KV_SUCCESS;
+}
+
+kv_result_t kv_engine_get_slow_ops(kv_engine_t *engine,
+                                   kv_op_record_t *records, uint32_t max,
+                                   uint32_t *count) {
+  if (!engine || !engine->initialized || (!records && max) || !count) {
+    return KV_ERR_INVALID_PARAM;
+  }
+
+  *count = 0;
+  kv_flight_recorder_t *rec = engine->recorder;
+  if (!rec || !rec->slow_ops) {
+    return KV_SUCCESS;
+  }
+
+  kv_op_record_t all[KV_SLOW_OP_LOG_SIZE];
+  uint32_t n = trace_ring_snapshot(rec->slow_ops, all);
+  *count = finish_records(rec, all, n, records, max);
+  return KV_SUCCESS;
+}
+
+/* ============================================================================
+ * Text Dump
+ * ============================================================================
+ */
+
+static const char *op_names[KV_OP_TYPES] = {"store", "retrieve", "delete",
+                                            "exists"};
+
+static const char *result_name(kv_result_t result) {
+  switch (result) {
+  case KV_SUCCESS:
+    return "ok";
+  case KV_ERR_INVALID_PARAM:
+    return "invalid_param";
+  case KV_ERR_NO_MEMORY:
+    return "no_memory";
+  case KV_ERR_KEY_NOT_FOUND:
+    return "not_found";
+  case KV_ERR_KEY_EXISTS:
+  case KV_ERR_KEY_ALREADY_EXISTS:
+    return "key_exists";
+  case KV_ERR_VALUE_TOO_LARGE:
+    return "value_too_large";
+  case KV_ERR_TIMEOUT:
+    return "timeout";
+  case KV_ERR_IO:
+    return "io_error";
+  case KV_ERR_DEVICE_FULL:
+    return "device_full";
+  case KV_ERR_DEVICE_DEGRADED:
+    return "device_degraded";
+  case KV_ERR_ABORTED:
+    return "aborted";
+  default:
+    return "error";
+  }
+}
+
+static int dump_records(int fd, const char *title, const kv_op_record_t *r,
+                        uint32_t n) {
+  if (dprintf(fd, "%s: %u\n", title, n) < 0) {
+    return -1;
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    time_t secs = (time_t)(r[i].timestamp_ns / 1000000000ULL);
+    struct tm tm;
+    char when[32];
+    gmtime_r(&secs, &tm);
+    strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%S", &tm);
+
+    char device[16];
+    if (r[i].device_index == UINT32_MAX) {
+      snprintf(device, sizeof(device), "-");
+    } else {
+      snprintf(device, sizeof(device), "%u", r[i].device_index);
+    }
+
+    if (dprintf(fd,
+                "  %s.%06lluZ %-8s dev %-2s key %08x size %-8llu "
+                "%10.1f us  device %10.1f us  %s\n",
+                when,
+                (unsigned long long)(r[i].timestamp_ns % 1000000000ULL) / 1000,
+                op_names[r[i].op], device, r[i].key_hash,
+                (unsigned long long)r[i].value_size, r[i].latency_ns / 1e3,
+                r[i].device_ns / 1e3, result_name(r[i].result)) < 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static kv_result_t dump_recorder(kv_flight_recorder_t *rec, int fd) {
+  kv_op_record_t *recent;
+  uint32_t n;
+  kv_result_t res = collect_recent(rec, &recent, &n);
+  if (res != KV_SUCCESS) {
+    return res;
+  }
+  n = finish_records(rec, recent, n, recent, n);
+
+  kv_op_record_t slow[KV_SLOW_OP_LOG_SIZE];
+  uint32_t num_slow = 0;
+  if (rec->slow_ops) {
+    num_slow = trace_ring_snapshot(rec->slow_ops, slow);
+    num_slow = finish_records(rec, slow, num_slow, slow, num_slow);
+  }
+
+  char title[64];
+  snprintf(title, sizeof(title), "slow ops >= %llu us",
+           (unsigned long long)rec->slow_threshold_ns / 1000);
+
+  int failed =
+      dprintf(fd, "=== kv_engine flight recorder (pid %d) ===\n",
+              (int)getpid()) < 0 ||
+      dump_records(fd, "recent ops", recent, n) != 0 ||
+      (rec->slow_ops && dump_records(fd, title, slow, num_slow) != 0);
+  free(recent);
+  return failed ? KV_ERR_IO : KV_SUCCESS;
+}
+
+kv_result_t kv_engine_dump_ops(kv_engine_t *engine, int fd) {
+  if (!engine || !engine->initialized || fd < 0) {
+    return KV_ERR_INVALID_PARAM;
+  }
+  if (!engine->recorder) {
+    return dprintf(fd, "=== kv_engine flight recorder disabled ===\n") < 0
+               ? KV_ERR_IO
+               : KV_SUCCESS;
+  }
+  return dump_recorder(engine->recorder, fd);
+}
+
+/* ============================================================================
+ * Dump on Signal
+ * ============================================================================
+ */
+
+/* Recorders with a dump_signal, served by one dump thread. registry_lock
+ * serializes (un)registration including thread start/stop; list_lock
+ * guards the list against the dump thread. */
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t list_lock = PTHREAD_MUTEX_INITIALIZER;
+static kv_flight_recorder_t *dump_list;
+static uint32_t signal_users[64];
+static struct sigaction saved_actions[64];
+
+static sem_t dump_sem;
+static pthread_t dump_thread;
+static bool dump_thread_running;
+static _Atomic bool dump_thread_stop;
+static _Atomic uint64_t dump_pending; /* bit per signal number */
+
+/* Async-signal-safe: an atomic or and sem_post */
+static void dump_signal_handler(int sig) {
+  atomic_fetch_or_explicit(&dump_pending, 1ULL << sig, memory_order_relaxed);
+  sem_post(&dump_sem);
+}
+
+static void dump_to_target(kv_flight_recorder_t *rec) {
+  int fd = STDERR_FILENO;
+  if (rec->dump_path) {
+    fd = open(rec->dump_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+              0644);
+    if (fd < 0) {
+      fprintf(stderr, "[kv_engine] warning: cannot open dump_path %s: %s\n",
+              rec->dump_path, strerror(errno));
+      return;
+    }
+  }
+  dump_recorder(rec, fd);
+  if (fd != STDERR_FILENO) {
+    close(fd);
+  }
+}
+
+static void *dump_thread_main(void *arg) {
+  (void)arg;
+  for (;;) {
+    while (sem_wait(&dump_sem) != 0 && errno == EINTR) {
+    }
+    if (atomic_load(&dump_thread_stop)) {
+      break;
+    }
+
+    uint64_t pending = atomic_exchange(&dump_pending, 0);
+    pthread_mutex_lock(&list_lock);
+    for (kv_flight_recorder_t *rec = dump_list; rec; rec = rec->next_dump) {
+      if (pending & (1ULL << rec->dump_signal)) {
+        dump_to_target(rec);
+      }
+    }
+    pthread_mutex_unlock(&list_lock);
+  }
+  return NULL;
+}
+
+static kv_result_t register_dump_signal(kv_flight_recorder_t *rec) {
+  int sig = rec->dump_signal;
+  if (sig <= 0 || sig >= 64 || sig == SIGKILL || sig == SIGSTOP) {
+    return KV_ERR_INVALID_PARAM;
+  }
+
+  pthread_mutex_lock(&registry_lock);
+  if (!dump_thread_running) {
+    atomic_store(&dump_thread_stop, false);
+    if (sem_init(&dump_sem, 0, 0) != 0) {
+      pthread_mutex_unlock(&registry_lock);
+      return KV_ERR_NO_MEMORY;
+    }
+    if (pthread_create(&dump_thread, NULL, dump_thread_main, NULL) != 0) {
+      sem_destroy(&dump_sem);
+      pthread_mutex_unlock(&registry_lock);
+      return KV_ERR_NO_MEMORY;
+    }
+    dump_thread_running = true;
+  }
+
+  if (signal_users[sig]++ == 0) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = dump_signal_handler;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(sig, &action, &saved_actions[sig]);
+  }
+
+  pthread_mutex_lock(&list_lock);
+  rec->next_dump = dump_list;
+  dump_list = rec;
+  pthread_mutex_unlock(&list_lock);
+  pthread_mutex_unlock(&registry_lock);
+  return KV_SUCCESS;
+}
+
+static void unregister_dump_signal(kv_flight_recorder_t *rec) {
+  pthread_mutex_lock(&registry_lock);
+
+  pthread_mutex_lock(&list_lock);
+  kv_flight_recorder_t **link = &dump_list;
+  while (*link && *link != rec) {
+    link = &(*link)->next_dump;
+  }
+  bool found = *link != NULL;
+  if (found) {
+    *link = rec->next_dump;
+  }
+  pthread_mutex_unlock(&list_lock);
+
+  if (found && --signal_users[rec->dump_signal] == 0) {
+    sigaction(rec->dump_signal, &saved_actions[rec->dump_signal], NULL);
+  }
+
+  if (!dump_list && dump_thread_running) {
+    atomic_store(&dump_thread_stop, true);
+    sem_post(&dump_sem);
+    pthread_join(dump_thread, NULL);
+    sem_destroy(&dump_sem);
+    dump_thread_running = false;
+  }
+  pthread_mutex_unlock(&registry_lock);
+}
+
+/* ============================================================================
+ * Lifecycle
+ * ============================================================================
+ */
+
+kv_result_t kv_engine_recorder_init(kv_engine_t *engine) {
+  const kv_engine_config_t *config = &engine->config;
+  if (config->flight_recorder_size == 0 && config->slow_op_threshold_us == 0) {
+    if (config->dump_signal) {
+      fprintf(stderr, "[kv_engine] warning: dump_signal needs "
+                      "flight_recorder_size or slow_op_threshold_us\n");
+    }
+    return KV_SUCCESS;
+  }
+
+  kv_flight_recorder_t *rec = calloc(1, sizeof(kv_flight_recorder_t));
+  if (!rec) {
+    return KV_ERR_NO_MEMORY;
+  }
+  engine->recorder = rec;
+
+  struct timespec mono, real;
+  clock_gettime(CLOCK_MONOTONIC, &mono);
+  clock_gettime(CLOCK_REALTIME, &real);
+  rec->realtime_offset_ns =
+      ((int64_t)real.tv_sec - mono.tv_sec) * 1000000000LL +
+      (real.tv_nsec - mono.tv_nsec);
+  rec->slow_threshold_ns = (uint64_t)config->slow_op_threshold_us * 1000;
+  rec->dump_path = config->dump_path;
+
+  if (config->flight_recorder_size > 0) {
+    for (uint32_t i = 0; i < KV_STATS_SLOTS; i++) {
+      rec->threads[i] = trace_ring_create(config->flight_recorder_size,
+                                          sizeof(kv_op_record_t));
+      if (!rec->threads[i]) {
+        return KV_ERR_NO_MEMORY;
+      }
+    }
+  }
+  if (config->slow_op_threshold_us > 0) {
+    rec->slow_ops =
+        trace_ring_create(KV_SLOW_OP_LOG_SIZE, sizeof(kv_op_record_t));
+    if (!rec->slow_ops) {
+      return KV_ERR_NO_MEMORY;
+    }
+  }
+
+  /* Non-fatal: the logs are still readable through the API */
+  if (config->dump_signal) {
+    rec->dump_signal = config->dump_signal;
+    if (register_dump_signal(rec) != KV_SUCCESS) {
+      fprintf(stderr, "[kv_engine] warning: cannot dump on signal %d\n",
+              config->dump_signal);
+      rec->dump_signal = 0;
+    }
+  }
+  return KV_SUCCESS;
+}
+
+void kv_engine_recorder_destroy(kv_engine_t *engine) {
+  kv_flight_recorder_t *rec = engine->recorder;
+  if (!rec) {
+    return;
+  }
+  if (rec->dump_signal) {
+    unregister_dump_signal(rec);
+  }
+  for (uint32_t i = 0; i < KV_STATS_SLOTS; i++) {
+    trace_ring_destroy(rec->threads[i]);
+  }
+  trace_ring_destroy(rec->slow_ops);
+  free(rec);
+  engine->recorder = NULL;
+}
@@ -0,0 +1,459 @@
+/**
+ * Key Index Recovery
+ *
+ * Rebuilds the in-memory key index at startup so that keys stored by a
+ * previous run are visible again. Two sources are supported:
+ *
+ *   - Device scan: one thread per device walks its keyspace with the KVS
+ *     iterator API and bulk-loads every key into the index.
+ *   - Snapshot: kv_engine_cleanup writes the index to index_snapshot_path and
+ *     stores a random epoch under an internal marker key on every device.
+ *     The next init trusts the snapshot only if every device still holds the
+ *     same epoch. Every init, whether or not it recovers the index, takes
+ *     the markers off the devices before anything is stored, so a run that
+ *     writes and then doesn't save a snapshot can't leave an old one
+ *     looking valid.
+ */
+
+#include "../utils/dma_alloc.h"
+#include "kv_engine_internal.h"
+#include <kvs_api.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SNAPSHOT_MAGIC "KVEIDX01"
+#define EPOCH_MARKER_KEY KV_INTERNAL_KEY_PREFIX "index_epoch"
+
+/* On-disk snapshot header, followed by [len:u8][key] entries and a trailing
+ * FNV-1a 64 checksum of the entries. Written in host byte order. */
+typedef struct {
+  char magic[8];
+  uint64_t epoch;
+  uint64_t key_count;
+  uint32_t num_devices;
+  uint32_t reserved;
+} snapshot_header_t;
+
+typedef struct {
+  kv_engine_t *engine;
+  kv_device_ctx_t *dev;
+  uint32_t dev_index;
+  uint64_t keys;
+  kv_result_t result;
+} scan_arg_t;
+
+static uint64_t now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static void fnv1a64_update(uint64_t *hash, const void *data, size_t len) {
+  const uint8_t *bytes = (const uint8_t *)data;
+  for (size_t i = 0; i < len; i++) {
+    *hash ^= bytes[i];
+    *hash *= 1099511628211ULL;
+  }
+}
+
+/* ============================================================================
+ * Device Scan
+ * ============================================================================
+ */
+
+/* Walks one device's keyspace and loads every user key into the index.
+ * Iterator entries are [len:u32][key] because keys are variable length. */
+static void *scan_device_thread(void *arg) {
+  scan_arg_t *scan = (scan_arg_t *)arg;
+  kvs_key_space_handle keyspace = scan->dev->keyspace;
+
+  kvs_option_iterator option = {KVS_ITERATOR_KEY};
+  kvs_key_group_filter filter;
+  memset(&filter, 0, sizeof(filter)); /* empty bitmask matches every key */
+
+  kvs_iterator_handle handle;
+  kvs_result kvs_res = kvs_create_iterator(keyspace, &option, &filter, &handle);
+  if (kvs_res != KVS_SUCCESS) {
+    fprintf(stderr, "[recovery] iterator open failed on device %u: 0x%x\n",
+            scan->dev_index, kvs_res);
+    scan->result = KV_ERR_IO;
+    return NULL;
+  }
+
+  uint8_t *buffer = dma_alloc(KVS_ITERATOR_BUFFER_SIZE);
+  if (!buffer) {
+    kvs_delete_iterator(keyspace, handle);
+    scan->result = KV_ERR_NO_MEMORY;
+    return NULL;
+  }
+
+  kvs_iterator_list list;
+  list.it_list = buffer;
+  list.end = false;
+
+  while (!list.end) {
+    list.size = KVS_ITERATOR_BUFFER_SIZE;
+    list.num_entries = 0;
+    kvs_res = kvs_iterate_next(keyspace, handle, &list);
+    if (kvs_res != KVS_SUCCESS) {
+      fprintf(stderr, "[recovery] iterate failed on device %u: 0x%x\n",
+              scan->dev_index, kvs_res);
+      scan->result = KV_ERR_IO;
+      break;
+    }
+
+    uint32_t pos = 0;
+    for (uint32_t i = 0; i < list.num_entries; i++) {
+      uint32_t key_len;
+      if (pos + sizeof(key_len) > list.size) {
+        break;
+      }
+      memcpy(&key_len, buffer + pos, sizeof(key_len));
+      pos += sizeof(key_len);
+      if (key_len == 0 || key_len > 255 || pos + key_len > list.size) {
+        break;
+      }
+
+      const uint8_t *key = buffer + pos;
+      pos += key_len;
+      if (kv_engine_is_internal_key(key, key_len)) {
+        continue;
+      }
+      if (add_key(&scan->engine->key_table, key, key_len,
+                  kv_engine_key_hash(key, key_len)) < 0) {
+        scan->result = KV_ERR_NO_MEMORY;
+        list.end = true;
+        break;
+      }
+      scan->keys++;
+    }
+  }
+
+  dma_free(buffer);
+  kvs_delete_iterator(keyspace, handle);
+  return NULL;
+}
+
+static kv_result_t scan_devices(kv_engine_t *engine, uint64_t *keys) {
+  uint32_t num_devices = engine->num_devices;
+  scan_arg_t args[KV_MAX_DEVICES];
+  pthread_t threads[KV_MAX_DEVICES];
+  bool started[KV_MAX_DEVICES] = {false};
+
+  for (uint32_t i = 0; i < num_devices; i++) {
+    args[i].engine = engine;
+    args[i].dev = &engine->devices[i];
+    args[i].dev_index = i;
+    args[i].keys = 0;
+    args[i].result = KV_SUCCESS;
+    started[i] =
+        pthread_create(&threads[i], NULL, scan_device_thread, &args[i]) == 0;
+    if (!started[i]) {
+      /* fall back to scanning this device on the calling thread */
+      scan_device_thread(&args[i]);
+    }
+  }
+
+  kv_result_t result = KV_SUCCESS;
+  *keys = 0;
+  for (uint32_t i = 0; i < num_devices; i++) {
+    if (started[i]) {
+      pthread_join(threads[i], NULL);
+    }
+    *keys += args[i].keys;
+    if (args[i].result != KV_SUCCESS) {
+      result = args[i].result;
+    }
+  }
+  return result;
+}
+
+/* ============================================================================
+ * Snapshot Epoch Markers
+ * ============================================================================
+ */
+
+static kvs_result store_epoch_marker(kv_device_ctx_t *dev, uint64_t epoch) {
+  uint64_t *buf = dma_alloc(DMA_ALIGNMENT);
+  if (!buf) {
+    return KVS_ERR_SYS_IO;
+  }
+  *buf = epoch;
+
+  kvs_key key = {(void *)EPOCH_MARKER_KEY, sizeof(EPOCH_MARKER_KEY) - 1};
+  kvs_value value = {buf, sizeof(epoch), sizeof(epoch), 0};
+  kvs_option_store option = {KVS_STORE_POST, NULL};
+  kvs_result res = kvs_store_kvp(dev->keyspace, &key, &value, &option);
+
+  dma_free(buf);
+  return res;
+}
+
+/* Reads the device's marker into *epoch; false if it has none */
+static bool read_epoch_marker(kv_device_ctx_t *dev, uint64_t *epoch) {
+  uint64_t *buf = dma_alloc(DMA_ALIGNMENT);
+  if (!buf) {
+    return false;
+  }
+
+  kvs_key key = {(void *)EPOCH_MARKER_KEY, sizeof(EPOCH_MARKER_KEY) - 1};
+  kvs_value value = {buf, DMA_ALIGNMENT, 0, 0};
+  kvs_option_retrieve option = {false};
+  kvs_result res = kvs_retrieve_kvp(dev->keyspace, &key, &option, &value);
+
+  bool found = res == KVS_SUCCESS && value.length == sizeof(*epoch);
+  if (found) {
+    *epoch = *buf;
+  }
+  dma_free(buf);
+  return found;
+}
+
+static kvs_result delete_epoch_marker(kv_device_ctx_t *dev) {
+  kvs_key key = {(void *)EPOCH_MARKER_KEY, sizeof(EPOCH_MARKER_KEY) - 1};
+  kvs_option_delete option = {false};
+  return kvs_delete_kvp(dev->keyspace, &key, &option);
+}
+
+/* Removes every device's marker, first reading them into epochs (0 where
+ * a device has none) if want_epochs is set. Only a snapshot saved at
+ * cleanup marks the devices again. */
+static void take_epoch_markers(kv_engine_t *engine, bool want_epochs,
+                               uint64_t *epochs) {
+  for (uint32_t i = 0; i < engine->num_devices; i++) {
+    kv_device_ctx_t *dev = &engine->devices[i];
+    if (want_epochs && !read_epoch_marker(dev, &epochs[i])) {
+      epochs[i] = 0;
+    }
+    kvs_result res = delete_epoch_marker(dev);
+    if (res != KVS_SUCCESS && res != KVS_ERR_KEY_NOT_EXIST) {
+      fprintf(stderr,
+              "[recovery] failed to clear snapshot marker on device %u: "
+              "0x%x\n",
+              i, res);
+    }
+  }
+}
+
+/* ============================================================================
+ * Snapshot Load / Save
+ * ============================================================================
+ */
+
+/* Loads the snapshot into the index. Returns KV_SUCCESS only if the file is
+ * intact and every device carried its epoch (epochs, as read at init); on
+ * failure the index is left empty. */
+static kv_result_t load_snapshot(kv_engine_t *engine, const char *path,
+                                 const uint64_t *epochs, uint64_t *keys) {
+  FILE *fp = fopen(path, "rb");
+  if (!fp) {
+    return KV_ERR_IO;
+  }
+
+  snapshot_header_t header;
+  if (fread(&header, sizeof(header), 1, fp) != 1 ||
+      memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 ||
+      header.num_devices != engine->num_devices) {
+    fclose(fp);
+    return KV_ERR_IO;
+  }
+
+  for (uint32_t i = 0; i < engine->num_devices; i++) {
+    if (header.epoch == 0 || epochs[i] != header.epoch) {
+      fclose(fp);
+      return KV_ERR_IO;
+    }
+  }
+
+  uint64_t checksum = 14695981039346656037ULL;
+  kv_result_t result = KV_SUCCESS;
+  uint8_t key[256];
+  uint64_t loaded = 0;
+
+  for (uint64_t i = 0; i < header.key_count; i++) {
+    int len = fgetc(fp);
+    if (len == EOF || len == 0 ||
+        fread(key, 1, (size_t)len, fp) != (size_t)len) {
+      result = KV_ERR_IO;
+      break;
+    }
+    uint8_t len_byte = (uint8_t)len;
+    fnv1a64_update(&checksum, &len_byte, 1);
+    fnv1a64_update(&checksum, key, len_byte);
+    if (add_key(&engine->key_table, key, len_byte,
+                kv_engine_key_hash(key, len_byte)) < 0) {
+      result = KV_ERR_NO_MEMORY;
+      break;
+    }
+    loaded++;
+  }
+
+  uint64_t stored_checksum;
+  if (result == KV_SUCCESS &&
+      (fread(&stored_checksum, sizeof(stored_checksum), 1, fp) != 1 ||
+       stored_checksum != checksum)) {
+    result = KV_ERR_IO;
+  }
+  fclose(fp);
+
+  if (result != KV_SUCCESS) {
+    /* discard the partial load; the caller falls back to a device scan */
+    free_table(&engine->key_table);
+    create_table(&engine->key_table);
+    return result;
+  }
+
+  *keys = loaded;
+  return KV_SUCCESS;
+}
+
+typedef struct {
+  FILE *fp;
+  uint64_t checksum;
+  uint64_t count;
+  int failed;
+} snapshot_writer_t;
+
+static int write_snapshot_entry(const void *key, uint32_t key_len, void *arg) {
+  snapshot_writer_t *writer = (snapshot_writer_t *)arg;
+  uint8_t len_byte = (uint8_t)key_len;
+  if (fwrite(&len_byte, 1, 1, writer->fp) != 1 ||
+      fwrite(key, 1, key_len, writer->fp) != key_len) {
+    writer->failed = 1;
+    return 1;
+  }
+  fnv1a64_update(&writer->checksum, &len_byte, 1);
+  fnv1a64_update(&writer->checksum, key, key_len);
+  writer->count++;
+  return 0;
+}
+
+void kv_engine_save_index_snapshot(kv_engine_t *engine) {
+  const char *path = engine->config.index_snapshot_path;
+  if (!path || !engine->index_complete) {
+    return;
+  }
+
+  size_t tmp_len = strlen(path) + 5;
+  char *tmp_path = malloc(tmp_len);
+  if (!tmp_path) {
+    return;
+  }
+  snprintf(tmp_path, tmp_len, "%s.tmp", path);
+
+  FILE *fp = fopen(tmp_path, "wb");
+  if (!fp) {
+    fprintf(stderr, "[recovery] cannot write index snapshot %s\n", tmp_path);
+    free(tmp_path);
+    return;
+  }
+
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  snapshot_header_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.epoch = ((uint64_t)ts.tv_sec << 32) ^ (uint64_t)ts.tv_nsec ^
+                 ((uint64_t)getpid() << 16);
+  if (header.epoch == 0) {
+    header.epoch = 1; /* 0 stands for a device without a marker */
+  }
+  header.num_devices = engine->num_devices;
+
+  /* header is rewritten with the final key count once the walk is done */
+  snapshot_writer_t writer = {fp, 14695981039346656037ULL, 0, 0};
+  if (fwrite(&header, sizeof(header), 1, fp) != 1) {
+    writer.failed = 1;
+  }
+  if (!writer.failed) {
+    table_for_each(&engine->key_table, write_snapshot_entry, &writer);
+  }
+  header.key_count = writer.count;
+  if (!writer.failed &&
+      (fwrite(&writer.checksum, sizeof(writer.checksum), 1, fp) != 1 ||
+       fseek(fp, 0, SEEK_SET) != 0 ||
+       fwrite(&header, sizeof(header), 1, fp) != 1)) {
+    writer.failed = 1;
+  }
+  if (fclose(fp) != 0) {
+    writer.failed = 1;
+  }
+
+  if (writer.failed || rename(tmp_path, path) != 0) {
+    fprintf(stderr, "[recovery] failed to save index snapshot %s\n", path);
+    unlink(tmp_path);
+    free(tmp_path);
+    return;
+  }
+  free(tmp_path);
+
+  /* Markers go last: a snapshot is only trusted once all of them exist */
+  for (uint32_t i = 0; i < engine->num_devices; i++) {
+    if (store_epoch_marker(&engine->devices[i], header.epoch) != KVS_SUCCESS) {
+      fprintf(stderr,
+              "[recovery] failed to mark device %u; snapshot will be "
+              "ignored on next start\n",
+              i);
+      return;
+    }
+  }
+}
+
+/* ============================================================================
+ * Entry Point
+ * ============================================================================
+ */
+
+kv_result_t kv_engine_recover_index(kv_engine_t *engine) {
+  kv_recovery_info_t *info = &engine->recovery;
+  memset(info, 0, sizeof(*info));
+  engine->index_complete = false;
+
+  /* Runs before anything is stored: whatever this run does from here on,
+   * an earlier snapshot stops matching the devices */
+  const char *path = engine->config.index_snapshot_path;
+  bool load = engine->config.recover_index && path;
+  uint64_t epochs[KV_MAX_DEVICES];
+  take_epoch_markers(engine, load, epochs);
+
+  if (!engine->config.recover_index) {
+    return KV_SUCCESS;
+  }
+
+  uint64_t start = now_us();
+  uint64_t keys = 0;
+  kv_result_t result = KV_ERR_IO;
+
+  if (load) {
+    result = load_snapshot(engine, path, epochs, &keys);
+    if (result == KV_SUCCESS) {
+      info->source = KV_RECOVERY_SNAPSHOT;
+    }
+  }
+
+  if (result != KV_SUCCESS) {
+    info->source = KV_RECOVERY_DEVICE_SCAN;
+    result = scan_devices(engine, &keys);
+  }
+
+  info->keys_recovered = keys;
+  info->duration_us = now_us() - start;
+  info->keys_per_sec = info->duration_us > 0
+                           ? (double)keys * 1e6 / (double)info->duration_us
+                           : 0.0;
+  info->complete = (result == KV_SUCCESS);
+  engine->index_complete = info->complete;
+  return result;
+}
+
+kv_result_t kv_engine_get_recovery_info(kv_engine_t *engine,
+                                        kv_recovery_info_t *info) {
+  if (!engine || !engine->initialized || !info) {
+    return KV_ERR_INVALID_PARAM;
+  }
+  *info = engine->recovery;
+  return KV_SUCCESS;
+}
@@ -0,0 +1,1415 @@
+/**
+ * Striped Values
+ *
+ * Values of at least config.erasure_min_value_size bytes are split into k
+ * data chunks plus m Reed-Solomon parity chunks, each stored on a
+ * different device. Values of at least config.stripe_min_value_size, and
+ * any value over the 2MB one device value holds, are cut into stripe units
+ * with no parity, spread over all devices. Every chunk goes under an
+ * internal key:
+ *
+ *   KV_INTERNAL_KEY_PREFIX 'C' <generation:u8> <chunk:u32 BE> <key>
+ *
+ * and the key itself holds a kv_stripe_manifest_t naming the devices.
+ * Chunks form rows of k + m. A value longer than one row (k chunks of at
+ * most 2MB) takes several, chunk j of row r being chunk r * (k + m) + j on
+ * devices[(j + r) % (k + m)], and rows are moved PIPELINE_ROWS at a time,
+ * so a value of any size needs only a few rows' worth of buffers.
+ *
+ * A row read fetches all k + m chunks at once with the async kvs calls and
+ * completes as soon as the data chunks are in. A data chunk that failed,
+ * or is still outstanding well after k chunks have arrived, is rebuilt
+ * from parity, so up to m failed or slow devices cost neither the read nor
+ * its latency. Reading the parity alongside costs m/k extra device
+ * bandwidth.
+ *
+ * Streams move a value through a few chunk or segment buffers: a write
+ * stream stores each chunk as soon as it is full, folding it into the
+ * row's parity, and a read stream reads ranges of chunks (kvs_value.offset)
+ * into segment buffers, rebuilding the range of a lost data chunk from the
+ * same range of the others.
+ *
+ * Overwrites write chunks of the next generation, then the manifest, then
+ * delete the previous generation's chunks; the key's migration lock stripe
+ * is held exclusively throughout and readers of a striped key hold it
+ * shared. A write stream writes its chunks without the lock, under a
+ * generation no other store of the key takes while it is open, and holds
+ * the lock only to swap the manifest in at close. A reader that raced the
+ * key's first store and loses its chunks to an overwrite sees
+ * KV_ERR_KEY_NOT_FOUND and re-reads the manifest.
+ */
+
+#include "../utils/dma_alloc.h"
+#include "kv_engine_internal.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define STRIPE_MAGIC "\xffKVEobj1"
+#define STRIPE_VERSION 1
+#define CHUNK_KEY_TAG 'C'
+#define CHUNK_KEY_HEADER (KV_INTERNAL_KEY_PREFIX_LEN + 6)
+
+/* A data chunk still outstanding once k chunks have arrived is rebuilt
+ * from parity after this multiple of the time the k-th one took */
+#define STRAGGLER_GRACE 2
+
+/* Rows of a value being written, read or deleted at once */
+#define PIPELINE_ROWS 4
+
+/* Data chunks of a write stream being filled or stored at once */
+#define WRITER_CHUNKS 4
+
+/* ============================================================================
+ * Manifest
+ * ============================================================================
+ */
+
+static uint64_t manifest_checksum(const kv_stripe_manifest_t *manifest) {
+  const uint8_t *p = (const uint8_t *)manifest;
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < offsetof(kv_stripe_manifest_t, checksum); i++) {
+    hash ^= p[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+bool kv_stripe_parse_manifest(const void *value, size_t value_len,
+                              kv_stripe_manifest_t *manifest) {
+  if (!value || value_len != sizeof(kv_stripe_manifest_t) ||
+      memcmp(value, STRIPE_MAGIC, sizeof(manifest->magic)) != 0) {
+    return false;
+  }
+  memcpy(manifest, value, sizeof(*manifest));
+  uint32_t width = manifest->data_chunks + manifest->parity_chunks;
+  return manifest->checksum == manifest_checksum(manifest) &&
+         manifest->version == STRIPE_VERSION && manifest->data_chunks > 0 &&
+         width <= KV_STRIPE_MAX_CHUNKS && manifest->chunk_size > 0;
+}
+
+static size_t chunk_key(uint8_t *out, uint32_t generation, uint32_t chunk,
+                        const void *key, size_t key_len) {
+  memcpy(out, KV_INTERNAL_KEY_PREFIX, KV_INTERNAL_KEY_PREFIX_LEN);
+  uint8_t *p = out + KV_INTERNAL_KEY_PREFIX_LEN;
+  p[0] = CHUNK_KEY_TAG;
+  p[1] = (uint8_t)generation;
+  p[2] = (uint8_t)(chunk >> 24);
+  p[3] = (uint8_t)(chunk >> 16);
+  p[4] = (uint8_t)(chunk >> 8);
+  p[5] = (uint8_t)chunk;
+  memcpy(out + CHUNK_KEY_HEADER, key, key_len);
+  return CHUNK_KEY_HEADER + key_len;
+}
+
+static uint32_t manifest_width(const kv_stripe_manifest_t *manifest) {
+  return manifest->data_chunks + manifest->parity_chunks;
+}
+
+/* Value bytes in a full row */
+static uint64_t row_bytes(const kv_stripe_manifest_t *manifest) {
+  return (uint64_t)manifest->data_chunks * manifest->chunk_size;
+}
+
+static uint64_t manifest_rows(const kv_stripe_manifest_t *manifest) {
+  uint64_t bytes = row_bytes(manifest);
+  return (manifest->value_size + bytes - 1) / bytes;
+}
+
+/* Device of chunk j of a row; rows rotate over the devices so parity and
+ * the short end of a value don't always land on the same ones */
+static uint32_t chunk_device(const kv_stripe_manifest_t *manifest,
+                             uint64_t row, uint32_t j) {
+  return manifest->devices[(j + row) % manifest_width(manifest)];
+}
+
+/* Bytes of chunk j of a row: chunk_size, except that without parity the
+ * last stripe unit is unpadded and none follow it */
+static size_t chunk_length(const kv_stripe_manifest_t *manifest, uint64_t row,
+                           uint32_t j) {
+  if (manifest->parity_chunks > 0) {
+    return manifest->chunk_size;
+  }
+  uint64_t offset =
+      row * row_bytes(manifest) + (uint64_t)j * manifest->chunk_size;
+  if (offset >= manifest->value_size) {
+    return 0;
+  }
+  uint64_t left = manifest->value_size - offset;
+  return left < manifest->chunk_size ? (size_t)left : manifest->chunk_size;
+}
+
+/* Chunk keys number the chunks of all rows in order */
+static uint32_t chunk_index(const kv_stripe_manifest_t *manifest,
+                            uint64_t row, uint32_t j) {
+  return (uint32_t)(row * manifest_width(manifest) + j);
+}
+
+/* A DMA buffer of size bytes, pooled when it fits a pool buffer; freed
+ * with kv_engine_free_buffer */
+static void *stripe_buffer(kv_engine_t *engine, size_t size) {
+  if (engine->buffer_pool && size <= engine->buffer_pool->buffer_size) {
+    void *buffer = dma_pool_acquire(engine->buffer_pool);
+    if (buffer) {
+      return buffer;
+    }
+    atomic_fetch_add_explicit(&engine->dma_fallback_allocs, 1,
+                              memory_order_relaxed);
+  }
+  return dma_alloc(size);
+}
+
+/* ============================================================================
+ * Chunk Batches
+ * ============================================================================
+ */
+
+typedef struct chunk_batch chunk_batch_t;
+
+/* One chunk command of a batch */
+typedef struct {
+  chunk_batch_t *batch;
+  uint32_t dev_idx;
+  kv_op_type_t op;
+  uint64_t start_ns;
+  kvs_key key;
+  uint8_t key_bytes[255];
+  kvs_value value;
+  kvs_result result;
+  bool done;
+} chunk_cmd_t;
+
+/* Shared by the caller and the completions of its commands; the last of
+ * them to finish frees it along with the buffers it owns, so a read the
+ * caller stopped waiting for completes into valid memory */
+struct chunk_batch {
+  kv_engine_t *engine;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  uint32_t refs; /* caller plus commands not yet completed */
+  uint32_t issued;
+  uint32_t completed;
+  uint32_t succeeded;
+  uint32_t quorum;    /* successes that set quorum_ns */
+  uint64_t quorum_ns; /* when the quorum-th success arrived */
+  void *buffers[2];   /* freed with the batch */
+  kvs_option_store store_option;
+  kvs_option_retrieve retrieve_option;
+  kvs_option_delete delete_option;
+  chunk_cmd_t cmd[];
+};
+
+static chunk_batch_t *batch_create(kv_engine_t *engine, uint32_t count) {
+  chunk_batch_t *batch =
+      calloc(1, sizeof(chunk_batch_t) + count * sizeof(chunk_cmd_t));
+  if (!batch) {
+    return NULL;
+  }
+  batch->engine = engine;
+  batch->refs = 1;
+  pthread_mutex_init(&batch->mutex, NULL);
+  pthread_condattr_t cattr;
+  pthread_condattr_init(&cattr);
+  pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+  pthread_cond_init(&batch->cond, &cattr);
+  pthread_condattr_destroy(&cattr);
+  batch->store_option.st_type = KVS_STORE_POST;
+  batch->retrieve_option.kvs_retrieve_delete = false;
+  batch->delete_option.kvs_delete_error = false;
+  return batch;
+}
+
+static void batch_free(chunk_batch_t *batch) {
+  kv_engine_free_buffer(batch->engine, batch->buffers[0]);
+  kv_engine_free_buffer(batch->engine, batch->buffers[1]);
+  pthread_mutex_destroy(&batch->mutex);
+  pthread_cond_destroy(&batch->cond);
+  free(batch);
+}
+
+/* Drops the caller's reference */
+static void batch_release(chunk_batch_t *batch) {
+  pthread_mutex_lock(&batch->mutex);
+  uint32_t refs = --batch->refs;
+  pthread_mutex_unlock(&batch->mutex);
+  if (refs == 0) {
+    batch_free(batch);
+  }
+}
+
+static void batch_complete(chunk_batch_t *batch, chunk_cmd_t *cmd,
+                           kvs_result result) {
+  pthread_mutex_lock(&batch->mutex);
+  cmd->result = result;
+  cmd->done = true;
+  batch->completed++;
+  if (result == KVS_SUCCESS && ++batch->succeeded == batch->quorum) {
+    batch->quorum_ns = kv_now_ns();
+  }
+  uint32_t refs = --batch->refs;
+  pthread_cond_broadcast(&batch->cond);
+  pthread_mutex_unlock(&batch->mutex);
+  if (refs == 0) {
+    batch_free(batch);
+  }
+}
+
+/* Completion of a chunk command, on the device's completion thread */
+static void chunk_done(kvs_postprocess_context *ctx) {
+  chunk_cmd_t *cmd = (chunk_cmd_t *)ctx->private2;
+  kv_engine_t *engine = cmd->batch->engine;
+  kv_device_async_cmd_end(engine, cmd->dev_idx, cmd->op, cmd->start_ns,
+                          ctx->result);
+  batch_complete(cmd->batch, cmd, ctx->result);
+  atomic_fetch_sub_explicit(&engine->async_cmds_outstanding, 1,
+                            memory_order_release);
+}
+
+/* Issues command i (key and, for stores and reads, value set up by the
+ * caller); a command the device refuses completes immediately */
+static void batch_submit(chunk_batch_t *batch, uint32_t i, kvs_context op) {
+  kv_engine_t *engine = batch->engine;
+  chunk_cmd_t *cmd = &batch->cmd[i];
+  cmd->batch = batch;
+  kvs_key_space_handle keyspace = engine->devices[cmd->dev_idx].keyspace;
+
+  pthread_mutex_lock(&batch->mutex);
+  batch->refs++;
+  batch->issued++;
+  pthread_mutex_unlock(&batch->mutex);
+  atomic_fetch_add_explicit(&engine->async_cmds_outstanding, 1,
+                            memory_order_relaxed);
+  cmd->start_ns = kv_device_cmd_begin(engine, cmd->dev_idx);
+
+  kvs_result res;
+  switch (op) {
+  case KVS_CMD_STORE:
+    cmd->op = KV_OP_STORE;
+    res = kvs_store_kvp_async(keyspace, &cmd->key, &cmd->value,
+                              &batch->store_option, batch, cmd, chunk_done);
+    break;
+  case KVS_CMD_DELETE:
+    cmd->op = KV_OP_DELETE;
+    res = kvs_delete_kvp_async(keyspace, &cmd->key, &batch->delete_option,
+                               batch, cmd, chunk_done);
+    break;
+  default:
+    cmd->op = KV_OP_RETRIEVE;
+    res = kvs_retrieve_kvp_async(keyspace, &cmd->key, &batch->retrieve_option,
+                                 batch, cmd, &cmd->value, chunk_done);
+    break;
+  }
+  if (res == KVS_SUCCESS) {
+    return;
+  }
+
+  atomic_fetch_sub_explicit(&engine->devices[cmd->dev_idx].in_flight, 1,
+                            memory_order_relaxed);
+  device_record_result(&engine->devices[cmd->dev_idx], res);
+  batch_complete(batch, cmd, res);
+  atomic_fetch_sub_explicit(&engine->async_cmds_outstanding, 1,
+                            memory_order_relaxed);
+}
+
+/* Waits for every issued command */
+static void batch_wait_all(chunk_batch_t *batch) {
+  pthread_mutex_lock(&batch->mutex);
+  while (batch->completed < batch->issued) {
+    pthread_cond_wait(&batch->cond, &batch->mutex);
+  }
+  pthread_mutex_unlock(&batch->mutex);
+}
+
+/* First failure among commands [0, count), KVS_SUCCESS if none */
+static kvs_result batch_first_error(const chunk_batch_t *batch,
+                                    uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    if (batch->cmd[i].done && batch->cmd[i].result != KVS_SUCCESS) {
+      return batch->cmd[i].result;
+    }
+  }
+  return KVS_SUCCESS;
+}
+
+/* Deletes the chunks of rows [0, rows), PIPELINE_ROWS rows at a time */
+static void delete_rows(kv_engine_t *engine, const void *key, size_t key_len,
+                        const kv_stripe_manifest_t *manifest, uint64_t rows) {
+  uint32_t width = manifest_width(manifest);
+  uint32_t num_devices =
+      atomic_load_explicit(&engine->num_devices, memory_order_acquire);
+  chunk_batch_t *window[PIPELINE_ROWS] = {NULL};
+  for (uint64_t row = 0; row < rows + PIPELINE_ROWS; row++) {
+    chunk_batch_t **slot = &window[row % PIPELINE_ROWS];
+    if (*slot) {
+      batch_wait_all(*slot);
+      batch_release(*slot);
+      *slot = NULL;
+    }
+    if (row >= rows || !(*slot = batch_create(engine, width))) {
+      continue;
+    }
+    for (uint32_t j = 0; j < width; j++) {
+      chunk_cmd_t *cmd = &(*slot)->cmd[j];
+      cmd->dev_idx = chunk_device(manifest, row, j);
+      if (chunk_length(manifest, row, j) == 0 || cmd->dev_idx >= num_devices) {
+        continue;
+      }
+      cmd->key.key = cmd->key_bytes;
+      cmd->key.length = (uint16_t)chunk_key(
+          cmd->key_bytes, manifest->generation,
+          chunk_index(manifest, row, j), key, key_len);
+      batch_submit(*slot, j, KVS_CMD_DELETE);
+    }
+  }
+}
+
+/* ============================================================================
+ * Write, Read, Delete
+ * ============================================================================
+ */
+
+/* Up to width distinct devices in the key's rendezvous order, preferring
+ * those neither unhealthy nor slow; returns how many healthy ones there
+ * were */
+static uint32_t choose_devices(kv_engine_t *engine, uint32_t key_hash,
+                               uint32_t width, uint8_t *devices) {
+  uint32_t num_devices =
+      atomic_load_explicit(&engine->num_devices, memory_order_acquire);
+  uint32_t ranked[KV_MAX_DEVICES];
+  rendezvous_top(key_hash, kv_engine_weights(engine), num_devices,
+                 num_devices, ranked);
+
+  uint32_t chosen = 0;
+  for (int pass = 0; pass < 2 && chosen < width; pass++) {
+    for (uint32_t i = 0; i < num_devices && chosen < width; i++) {
+      kv_device_ctx_t *dev = &engine->devices[ranked[i]];
+      bool slow = atomic_load_explicit(&dev->slow, memory_order_relaxed);
+      if (atomic_load(&dev->healthy) && slow == (pass == 1)) {
+        devices[chosen++] = (uint8_t)ranked[i];
+      }
+    }
+  }
+  return chosen;
+}
+
+/* Chunk size and counts per row for a value: the configured k + m with
+ * chunks of up to 2MB when erasure coded, else stripe units, at most one
+ * per device in a row */
+static void chunk_layout(const kv_engine_t *engine, size_t value_len,
+                         uint32_t *k, uint32_t *m, size_t *chunk_size) {
+  size_t size;
+  if (kv_engine_codes_value(engine, value_len)) {
+    *k = engine->config.erasure_data_chunks;
+    *m = engine->config.erasure_parity_chunks;
+    size = (value_len + *k - 1) / *k;
+    size = (size + DMA_ALIGNMENT - 1) & ~(size_t)(DMA_ALIGNMENT - 1);
+    if (size > KV_ENGINE_RETRIEVE_SIZE) {
+      size = KV_ENGINE_RETRIEVE_SIZE;
+    }
+  } else {
+    *m = 0;
+    size = engine->config.stripe_unit_size;
+    size_t units = (value_len + size - 1) / size;
+    *k = units < KV_STRIPE_MAX_CHUNKS ? (uint32_t)units : KV_STRIPE_MAX_CHUNKS;
+  }
+  *chunk_size = size;
+}
+
+/* Computes the m parity chunks of a staged row from its k data chunks,
+ * zero-padding the data past the row's len bytes */
+static void encode_row(uint8_t *row, size_t len, uint32_t k, uint32_t m,
+                       size_t chunk_size) {
+  memset(row + len, 0, k * chunk_size - len);
+  const uint8_t *data[KV_STRIPE_MAX_CHUNKS];
+  uint8_t *parity[KV_STRIPE_MAX_CHUNKS];
+  for (uint32_t i = 0; i < k + m; i++) {
+    if (i < k) {
+      data[i] = row + i * chunk_size;
+    } else {
+      parity[i - k] = row + i * chunk_size;
+    }
+  }
+  rs_encode(k, m, chunk_size, data, parity);
+}
+
+/* Issues command i of a batch: the store of chunk j of a row from chunk,
+ * unless the chunk is past the end of the value */
+static void chunk_store(chunk_batch_t *batch, uint32_t i, const void *key,
+                        size_t key_len, const kv_stripe_manifest_t *manifest,
+                        uint64_t row, uint32_t j, const uint8_t *chunk) {
+  chunk_cmd_t *cmd = &batch->cmd[i];
+  size_t length = chunk_length(manifest, row, j);
+  if (length == 0) {
+    return;
+  }
+  cmd->dev_idx = chunk_device(manifest, row, j);
+  cmd->key.key = cmd->key_bytes;
+  cmd->key.length =
+      (uint16_t)chunk_key(cmd->key_bytes, manifest->generation,
+                          chunk_index(manifest, row, j), key, key_len);
+  cmd->value.value = (void *)chunk;
+  cmd->value.length = (uint32_t)length;
+  cmd->value.actual_value_size = (uint32_t)length;
+  cmd->value.offset = 0;
+  batch_submit(batch, i, KVS_CMD_STORE);
+}
+
+/* Issues the stores of one row's chunks, laid out chunk_size apart at
+ * chunks */
+static chunk_batch_t *row_store(kv_engine_t *engine, const void *key,
+                                size_t key_len,
+                                const kv_stripe_manifest_t *manifest,
+                                uint64_t row, const uint8_t *chunks) {
+  uint32_t width = manifest_width(manifest);
+  chunk_batch_t *batch = batch_create(engine, width);
+  if (!batch) {
+    return NULL;
+  }
+  for (uint32_t j = 0; j < width; j++) {
+    chunk_store(batch, j, key, key_len, manifest, row, j,
+                chunks + j * manifest->chunk_size);
+  }
+  return batch;
+}
+
+/* Waits for a row's stores and releases them */
+static kv_result_t row_store_finish(chunk_batch_t *batch, uint32_t width) {
+  batch_wait_all(batch);
+  kvs_result kvs_res = batch_first_error(batch, width);
+  batch_release(batch);
+  return map_kvs_result(kvs_res);
+}
+
+/* Lays out a value about to be written and picks its devices, filling in
+ * all of manifest but the checksum */
+static kv_result_t plan_manifest(kv_engine_t *engine, uint32_t key_hash,
+                                 uint32_t generation, size_t value_len,
+                                 kv_stripe_manifest_t *manifest) {
+  uint32_t k, m;
+  size_t chunk_size;
+  chunk_layout(engine, value_len, &k, &m, &chunk_size);
+
+  memset(manifest, 0, sizeof(*manifest));
+  memcpy(manifest->magic, STRIPE_MAGIC, sizeof(manifest->magic));
+  manifest->version = STRIPE_VERSION;
+  manifest->generation = generation;
+  manifest->value_size = value_len;
+  manifest->chunk_size = (uint32_t)chunk_size;
+  manifest->parity_chunks = (uint16_t)m;
+
+  /* parity needs distinct devices; stripe units take as many healthy ones
+   * as there are units, up to one each per row */
+  uint32_t chosen = choose_devices(engine, key_hash, k + m, manifest->devices);
+  if (chosen == 0 || (m > 0 && chosen < k + m)) {
+    return KV_ERR_DEVICE_DEGRADED;
+  }
+  if (m == 0) {
+    k = chosen;
+  }
+  manifest->data_chunks = (uint16_t)k;
+  if (manifest_rows(manifest) * (k + m) > UINT32_MAX) {
+    return KV_ERR_VALUE_TOO_LARGE;
+  }
+  return KV_SUCCESS;
+}
+
+kv_result_t kv_stripe_write(kv_engine_t *engine, const void *key,
+                            size_t key_len, uint32_t key_hash,
+                            uint32_t generation,
+                            const kv_stripe_source_t *source, size_t value_len,
+                            kv_stripe_manifest_t *manifest) {
+  kv_result_t res =
+      plan_manifest(engine, key_hash, generation, value_len, manifest);
+  if (res != KV_SUCCESS) {
+    return res;
+  }
+  uint32_t k = manifest->data_chunks;
+  uint32_t m = manifest->parity_chunks;
+  uint32_t width = k + m;
+  size_t chunk_size = manifest->chunk_size;
+  uint64_t rows = manifest_rows(manifest);
+
+  /* stripe units of an aligned value go to the devices straight from it;
+   * anything else is staged a row at a time as data chunks, zero-padded,
+   * then parity, in one buffer per row in flight. Staging and encoding a
+   * row overlap the I/O of the rows before it. */
+  const uint8_t *data = source->data;
+  bool zero_copy = m == 0 && data && IS_DMA_ALIGNED(data);
+  chunk_batch_t *window[PIPELINE_ROWS] = {NULL};
+  uint8_t *staging[PIPELINE_ROWS] = {NULL};
+  uint64_t row = 0;
+  for (; row < rows; row++) {
+    chunk_batch_t **slot = &window[row % PIPELINE_ROWS];
+    if (*slot) {
+      res = row_store_finish(*slot, width);
+      *slot = NULL;
+      if (res != KV_SUCCESS) {
+        break;
+      }
+    }
+    uint64_t offset = row * row_bytes(manifest);
+    size_t len = (size_t)(value_len - offset < row_bytes(manifest)
+                              ? value_len - offset
+                              : row_bytes(manifest));
+    const uint8_t *chunks = zero_copy ? data + offset : NULL;
+    if (!zero_copy) {
+      uint8_t **buffer = &staging[row % PIPELINE_ROWS];
+      if (!*buffer && !(*buffer = stripe_buffer(engine, width * chunk_size))) {
+        res = KV_ERR_NO_MEMORY;
+        break;
+      }
+      if (data) {
+        memcpy(*buffer, data + offset, len);
+      } else if (source->fill(*buffer, len, source->user_data) != 0) {
+        res = KV_ERR_ABORTED;
+        break;
+      }
+      if (m > 0) {
+        encode_row(*buffer, len, k, m, chunk_size);
+      }
+      chunks = *buffer;
+    }
+    *slot = row_store(engine, key, key_len, manifest, row, chunks);
+    if (!*slot) {
+      res = KV_ERR_NO_MEMORY;
+      break;
+    }
+  }
+  for (uint32_t i = 0; i < PIPELINE_ROWS; i++) {
+    if (window[i]) {
+      kv_result_t row_res = row_store_finish(window[i], width);
+      if (res == KV_SUCCESS) {
+        res = row_res;
+      }
+    }
+    kv_engine_free_buffer(engine, staging[i]);
+  }
+
+  /* rows [0, row) were started */
+  if (res != KV_SUCCESS) {
+    delete_rows(engine, key, key_len, manifest, row);
+  }
+  manifest->checksum = manifest_checksum(manifest);
+  return res;
+}
+
+/* A row read in flight. The buffers belong to the slot of the read
+ * window and are reused from row to row. */
+typedef struct {
+  chunk_batch_t *batch;
+  uint64_t row;
+  uint64_t start_ns;
+  uint8_t *data;   /* the row's data chunks, chunk_size apart */
+  uint8_t *buffer; /* data, unless the caller gave a target */
+  uint8_t *parity;
+} row_read_t;
+
+/* Issues the reads of all chunks of a row: the data chunks into target if
+ * given (stripe units only), else into read->buffer */
+static kv_result_t row_read_start(kv_engine_t *engine, const void *key,
+                                  size_t key_len,
+                                  const kv_stripe_manifest_t *manifest,
+                                  uint64_t row, uint8_t *target,
+                                  row_read_t *read) {
+  uint32_t k = manifest->data_chunks;
+  uint32_t m = manifest->parity_chunks;
+  size_t chunk_size = manifest->chunk_size;
+
+  read->batch = NULL;
+  if (!target && !read->buffer) {
+    read->buffer = stripe_buffer(engine, k * chunk_size);
+  }
+  if (m && !read->parity) {
+    read->parity = stripe_buffer(engine, m * chunk_size);
+  }
+  chunk_batch_t *batch = batch_create(engine, k + m);
+  if (!batch || (!target && !read->buffer) || (m && !read->parity)) {
+    if (batch) {
+      batch_release(batch);
+    }
+    return KV_ERR_NO_MEMORY;
+  }
+  batch->quorum = k;
+  read->batch = batch;
+  read->row = row;
+  read->start_ns = kv_now_ns();
+  read->data = target ? target : read->buffer;
+
+  uint32_t num_devices =
+      atomic_load_explicit(&engine->num_devices, memory_order_acquire);
+  for (uint32_t i = 0; i < k + m; i++) {
+    chunk_cmd_t *cmd = &batch->cmd[i];
+    cmd->dev_idx = chunk_device(manifest, row, i);
+    if (chunk_length(manifest, row, i) == 0) {
+      cmd->result = KVS_SUCCESS;
+      cmd->done = true;
+      continue;
+    }
+    if (cmd->dev_idx >= num_devices ||
+        !atomic_load(&engine->devices[cmd->dev_idx].healthy)) {
+      cmd->result = KVS_ERR_DEV_NOT_EXIST;
+      cmd->done = true;
+      continue;
+    }
+    cmd->key.key = cmd->key_bytes;
+    cmd->key.length =
+        (uint16_t)chunk_key(cmd->key_bytes, manifest->generation,
+                            chunk_index(manifest, row, i), key, key_len);
+    cmd->value.value = i < k ? read->data + i * chunk_size
+                             : read->parity + (i - k) * chunk_size;
+    cmd->value.length = (uint32_t)chunk_size;
+    cmd->value.actual_value_size = 0;
+    cmd->value.offset = 0;
+    batch_submit(batch, i, KVS_CMD_RETRIEVE);
+  }
+  return KV_SUCCESS;
+}
+
+/* Drops a row read's batch. Reads into a target are waited for; reads
+ * still running into the slot's buffers take those buffers with them, to
+ * be freed with the batch. */
+static void row_read_release(const kv_stripe_manifest_t *manifest,
+                             row_read_t *read) {
+  uint32_t k = manifest->data_chunks;
+  chunk_batch_t *batch = read->batch;
+  if (read->data != read->buffer) {
+    batch_wait_all(batch);
+  }
+  bool data_out = false;
+  bool parity_out = false;
+  pthread_mutex_lock(&batch->mutex);
+  for (uint32_t i = 0; i < manifest_width(manifest); i++) {
+    if (!batch->cmd[i].done) {
+      *(i < k ? &data_out : &parity_out) = true;
+    }
+  }
+  pthread_mutex_unlock(&batch->mutex);
+  if (data_out) {
+    batch->buffers[0] = read->buffer;
+    read->buffer = NULL;
+  }
+  if (parity_out) {
+    batch->buffers[1] = read->parity;
+    read->parity = NULL;
+  }
+  batch_release(batch);
+  read->batch = NULL;
+}
+
+/* Completes a row read, rebuilding missing data chunks from parity. On
+ * success read->data holds the row; *rebuilt is set if it took parity. */
+static kv_result_t row_read_finish(kv_engine_t *engine,
+                                   const kv_stripe_manifest_t *manifest,
+                                   row_read_t *read, bool *rebuilt) {
+  uint32_t k = manifest->data_chunks;
+  uint32_t m = manifest->parity_chunks;
+  uint32_t width = k + m;
+  size_t chunk_size = manifest->chunk_size;
+  chunk_batch_t *batch = read->batch;
+
+  /* stripe units all have to arrive; otherwise wait for the data chunks,
+   * or for k chunks and then a grace period for the data chunks still
+   * out */
+  if (m == 0) {
+    batch_wait_all(batch);
+  }
+  bool present[KV_STRIPE_MAX_CHUNKS];
+  bool pending_data = false;
+  pthread_mutex_lock(&batch->mutex);
+  while (batch->completed < batch->issued) {
+    uint32_t data_ok = 0;
+    bool data_out = false;
+    for (uint32_t i = 0; i < k; i++) {
+      data_ok += batch->cmd[i].done && batch->cmd[i].result == KVS_SUCCESS;
+      data_out |= !batch->cmd[i].done;
+    }
+    if (data_ok == k || (batch->succeeded >= k && !data_out)) {
+      break;
+    }
+    if (batch->succeeded < k) {
+      pthread_cond_wait(&batch->cond, &batch->mutex);
+      continue;
+    }
+    uint64_t deadline_ns =
+        batch->quorum_ns +
+        STRAGGLER_GRACE * (batch->quorum_ns - read->start_ns);
+    struct timespec deadline = {
+        .tv_sec = (time_t)(deadline_ns / 1000000000ULL),
+        .tv_nsec = (long)(deadline_ns % 1000000000ULL)};
+    if (pthread_cond_timedwait(&batch->cond, &batch->mutex, &deadline) ==
+        ETIMEDOUT) {
+      break;
+    }
+  }
+  uint32_t available = 0;
+  bool degraded = false;
+  for (uint32_t i = 0; i < width; i++) {
+    chunk_cmd_t *cmd = &batch->cmd[i];
+    present[i] = cmd->done && cmd->result == KVS_SUCCESS &&
+                 cmd->value.length == chunk_length(manifest, read->row, i);
+    available += present[i];
+    if (i < k && !present[i]) {
+      degraded = true;
+      pending_data |= !cmd->done;
+    }
+  }
+  kvs_result kvs_res = batch_first_error(batch, width);
+  pthread_mutex_unlock(&batch->mutex);
+
+  if (available < k) {
+    row_read_release(manifest, read);
+    if (kvs_res == KVS_SUCCESS || is_device_error(kvs_res)) {
+      return KV_ERR_DEVICE_DEGRADED;
+    }
+    return map_kvs_result(kvs_res);
+  }
+
+  *rebuilt = degraded;
+  uint8_t *fresh = NULL;
+  if (degraded) {
+    /* reads still running own their chunk's memory: rebuild into a fresh
+     * buffer, which the slot keeps once the batch takes the old one */
+    uint8_t *data = read->data;
+    if (pending_data) {
+      fresh = stripe_buffer(engine, k * chunk_size);
+      if (!fresh) {
+        row_read_release(manifest, read);
+        return KV_ERR_NO_MEMORY;
+      }
+      for (uint32_t i = 0; i < k; i++) {
+        if (present[i]) {
+          memcpy(fresh + i * chunk_size, data + i * chunk_size, chunk_size);
+        }
+      }
+      data = fresh;
+    }
+    uint8_t *shards[KV_STRIPE_MAX_CHUNKS];
+    for (uint32_t i = 0; i < width; i++) {
+      shards[i] = i < k ? data + i * chunk_size
+                        : read->parity + (i - k) * chunk_size;
+    }
+    rs_reconstruct(k, m, chunk_size, shards, present);
+  }
+  row_read_release(manifest, read);
+  if (fresh) {
+    read->buffer = fresh;
+    read->data = fresh;
+  }
+  return KV_SUCCESS;
+}
+
+/* Frees the buffers of a read window slot */
+static void row_read_free(kv_engine_t *engine, row_read_t *read) {
+  kv_engine_free_buffer(engine, read->buffer);
+  kv_engine_free_buffer(engine, read->parity);
+}
+
+/* Reads the rows of a value PIPELINE_ROWS at a time, in order, into out
+ * (stripe units straight off the devices, coded rows copied out) and/or
+ * to deliver */
+static kv_result_t read_rows(kv_engine_t *engine, const void *key,
+                             size_t key_len,
+                             const kv_stripe_manifest_t *manifest,
+                             uint8_t *out, kv_stream_data_cb deliver,
+                             void *user_data) {
+  uint64_t rows = manifest_rows(manifest);
+  uint64_t bytes = row_bytes(manifest);
+  bool in_place = out && manifest->parity_chunks == 0;
+  row_read_t window[PIPELINE_ROWS];
+  memset(window, 0, sizeof(window));
+  uint64_t started = 0;
+  bool rebuilt = false;
+  kv_result_t res = KV_SUCCESS;
+
+  for (uint64_t row = 0; row < rows && res == KV_SUCCESS; row++) {
+    for (; started < rows && started < row + PIPELINE_ROWS &&
+           res == KV_SUCCESS;
+         started++) {
+      res = row_read_start(engine, key, key_len, manifest, started,
+                           in_place ? out + started * bytes : NULL,
+                           &window[started % PIPELINE_ROWS]);
+    }
+    if (res != KV_SUCCESS) {
+      break;
+    }
+
+    row_read_t *read = &window[row % PIPELINE_ROWS];
+    bool row_rebuilt = false;
+    res = row_read_finish(engine, manifest, read, &row_rebuilt);
+    if (res != KV_SUCCESS) {
+      break;
+    }
+    rebuilt |= row_rebuilt;
+    uint64_t offset = row * bytes;
+    size_t len = (size_t)(manifest->value_size - offset < bytes
+                              ? manifest->value_size - offset
+                              : bytes);
+    if (out && !in_place) {
+      memcpy(out + offset, read->data, len);
+    }
+    if (deliver && deliver(read->data, len, user_data) != 0) {
+      res = KV_ERR_ABORTED;
+    }
+  }
+
+  /* after a failure, rows still in flight are abandoned */
+  for (uint32_t i = 0; i < PIPELINE_ROWS; i++) {
+    if (window[i].batch) {
+      row_read_release(manifest, &window[i]);
+    }
+    row_read_free(engine, &window[i]);
+  }
+  if (res == KV_SUCCESS && rebuilt) {
+    KV_STAT_ADD(engine, reconstructed_retrieves, 1);
+  }
+  return res;
+}
+
+kv_result_t kv_stripe_read(kv_engine_t *engine, const void *key,
+                           size_t key_len,
+                           const kv_stripe_manifest_t *manifest, void **value,
+                           size_t *value_len) {
+  /* one row is returned in its own buffer */
+  if (manifest_rows(manifest) == 1) {
+    row_read_t read;
+    memset(&read, 0, sizeof(read));
+    bool rebuilt = false;
+    kv_result_t res =
+        row_read_start(engine, key, key_len, manifest, 0, NULL, &read);
+    if (res == KV_SUCCESS) {
+      res = row_read_finish(engine, manifest, &read, &rebuilt);
+    }
+    kv_engine_free_buffer(engine, read.parity);
+    if (res != KV_SUCCESS) {
+      kv_engine_free_buffer(engine, read.buffer);
+      return res;
+    }
+    if (rebuilt) {
+      KV_STAT_ADD(engine, reconstructed_retrieves, 1);
+    }
+    *value = read.buffer;
+    *value_len = manifest->value_size;
+    return KV_SUCCESS;
+  }
+
+  /* stripe units are read in place, so the buffer runs to the end of the
+   * last one */
+  size_t size = manifest->value_size;
+  if (manifest->parity_chunks == 0) {
+    size = (size + manifest->chunk_size - 1) / manifest->chunk_size *
+           manifest->chunk_size;
+  }
+  uint8_t *out = dma_alloc(size);
+  if (!out) {
+    return KV_ERR_NO_MEMORY;
+  }
+  kv_result_t res =
+      read_rows(engine, key, key_len, manifest, out, NULL, NULL);
+  if (res != KV_SUCCESS) {
+    dma_free(out);
+    return res;
+  }
+  *value = out;
+  *value_len = manifest->value_size;
+  return KV_SUCCESS;
+}
+
+kv_result_t kv_stripe_read_stream(kv_engine_t *engine, const void *key,
+                                  size_t key_len,
+                                  const kv_stripe_manifest_t *manifest,
+                                  kv_stream_data_cb deliver,
+                                  void *user_data) {
+  return read_rows(engine, key, key_len, manifest, NULL, deliver, user_data);
+}
+
+void kv_stripe_delete(kv_engine_t *engine, const void *key, size_t key_len,
+                      const kv_stripe_manifest_t *manifest) {
+  delete_rows(engine, key, key_len, manifest, manifest_rows(manifest));
+}
+
+/* ============================================================================
+ * Write Streams
+ * ============================================================================
+ */
+
+/* A value taken in pieces: data chunks are filled in turn, each stored as
+ * soon as it is full from one of WRITER_CHUNKS buffers, and a row's parity
+ * is summed up as its data chunks go by, in one of two buffers so the next
+ * row can start while this one's parity is stored */
+struct kv_stripe_writer {
+  kv_engine_t *engine;
+  uint8_t key[255];
+  size_t key_len;
+  kv_stripe_manifest_t manifest;
+  uint64_t written; /* value bytes taken */
+  size_t filled;    /* of them, in the data chunk being filled */
+  chunk_batch_t *stores[WRITER_CHUNKS];
+  uint8_t *chunks[WRITER_CHUNKS];
+  chunk_batch_t *parity_stores[2];
+  uint8_t *parity[2];
+  kv_result_t res; /* first failure, which ends the stream */
+};
+
+/* Value bytes in data chunk d, counting the data chunks of all rows */
+static size_t data_length(const kv_stripe_manifest_t *manifest, uint64_t d) {
+  uint64_t left = manifest->value_size - d * manifest->chunk_size;
+  return left < manifest->chunk_size ? (size_t)left : manifest->chunk_size;
+}
+
+/* Waits for one of the writer's batches of count stores, if any */
+static void writer_settle(kv_stripe_writer_t *writer, chunk_batch_t **batch,
+                          uint32_t count) {
+  if (!*batch) {
+    return;
+  }
+  kv_result_t res = row_store_finish(*batch, count);
+  *batch = NULL;
+  if (writer->res == KV_SUCCESS) {
+    writer->res = res;
+  }
+}
+
+/* Stores data chunk d, which is full, and after the last data chunk of a
+ * row, the row's parity */
+static kv_result_t writer_store_chunk(kv_stripe_writer_t *writer, uint64_t d) {
+  kv_engine_t *engine = writer->engine;
+  const kv_stripe_manifest_t *manifest = &writer->manifest;
+  uint32_t k = manifest->data_chunks;
+  uint32_t m = manifest->parity_chunks;
+  size_t chunk_size = manifest->chunk_size;
+  uint64_t row = d / k;
+  uint32_t j = (uint32_t)(d % k);
+  uint8_t *chunk = writer->chunks[d % WRITER_CHUNKS];
+  uint8_t **parity = &writer->parity[row % 2];
+
+  if (m > 0) {
+    memset(chunk + data_length(manifest, d), 0,
+           chunk_size - data_length(manifest, d));
+    if (j == 0) {
+      writer_settle(writer, &writer->parity_stores[row % 2], m);
+      if (!*parity && !(*parity = kv_engine_stream_buffer(
+                            engine, (size_t)m * chunk_size))) {
+        return KV_ERR_NO_MEMORY;
+      }
+      memset(*parity, 0, (size_t)m * chunk_size);
+    }
+    uint8_t *shards[KV_STRIPE_MAX_CHUNKS];
+    for (uint32_t i = 0; i < m; i++) {
+      shards[i] = *parity + i * chunk_size;
+    }
+    rs_encode_shard(k, m, j, chunk_size, chunk, shards);
+  }
+  chunk_batch_t *batch = batch_create(engine, 1);
+  if (!batch) {
+    return KV_ERR_NO_MEMORY;
+  }
+  chunk_store(batch, 0, writer->key, writer->key_len, manifest, row, j,
+              chunk);
+  writer->stores[d % WRITER_CHUNKS] = batch;
+
+  bool last = (d + 1) * chunk_size >= manifest->value_size;
+  if (m == 0 || (j + 1 < k && !last)) {
+    return KV_SUCCESS;
+  }
+
+  /* the row is complete: data chunks past the end of the value are zeros,
+   * which add nothing to the parity */
+  if (j + 1 < k) {
+    uint8_t *zeros = kv_engine_stream_buffer(engine, chunk_size);
+    batch = zeros ? batch_create(engine, k) : NULL;
+    if (!batch) {
+      kv_engine_free_buffer(engine, zeros);
+      return KV_ERR_NO_MEMORY;
+    }
+    memset(zeros, 0, chunk_size);
+    batch->buffers[0] = zeros;
+    for (uint32_t i = j + 1; i < k; i++) {
+      chunk_store(batch, i, writer->key, writer->key_len, manifest, row, i,
+                  zeros);
+    }
+    kv_result_t res = row_store_finish(batch, k);
+    if (res != KV_SUCCESS) {
+      return res;
+    }
+  }
+  batch = batch_create(engine, m);
+  if (!batch) {
+    return KV_ERR_NO_MEMORY;
+  }
+  for (uint32_t i = 0; i < m; i++) {
+    chunk_store(batch, i, writer->key, writer->key_len, manifest, row, k + i,
+                *parity + i * chunk_size);
+  }
+  writer->parity_stores[row % 2] = batch;
+  return KV_SUCCESS;
+}
+
+kv_result_t kv_stripe_writer_open(kv_engine_t *engine, const void *key,
+                                  size_t key_len, uint32_t key_hash,
+                                  uint32_t generation, size_t value_len,
+                                  kv_stripe_writer_t **writer) {
+  kv_stripe_writer_t *w = calloc(1, sizeof(*w));
+  if (!w) {
+    return KV_ERR_NO_MEMORY;
+  }
+  kv_result_t res =
+      plan_manifest(engine, key_hash, generation, value_len, &w->manifest);
+  if (res != KV_SUCCESS) {
+    free(w);
+    return res;
+  }
+  w->engine = engine;
+  memcpy(w->key, key, key_len);
+  w->key_len = key_len;
+  *writer = w;
+  return KV_SUCCESS;
+}
+
+kv_result_t kv_stripe_writer_write(kv_stripe_writer_t *writer,
+                                   const void *data, size_t len) {
+  const kv_stripe_manifest_t *manifest = &writer->manifest;
+  size_t chunk_size = manifest->chunk_size;
+  const uint8_t *bytes = (const uint8_t *)data;
+  if (len > manifest->value_size - writer->written) {
+    return KV_ERR_INVALID_PARAM;
+  }
+
+  while (len > 0 && writer->res == KV_SUCCESS) {
+    uint64_t d = writer->written / chunk_size;
+    uint8_t **chunk = &writer->chunks[d % WRITER_CHUNKS];
+    if (writer->filled == 0) {
+      writer_settle(writer, &writer->stores[d % WRITER_CHUNKS], 1);
+      if (writer->res == KV_SUCCESS && !*chunk &&
+          !(*chunk = kv_engine_stream_buffer(writer->engine, chunk_size))) {
+        writer->res = KV_ERR_NO_MEMORY;
+      }
+      if (writer->res != KV_SUCCESS) {
+        break;
+      }
+    }
+    size_t full = data_length(manifest, d);
+    size_t n = full - writer->filled < len ? full - writer->filled : len;
+    memcpy(*chunk + writer->filled, bytes, n);
+    writer->filled += n;
+    writer->written += n;
+    bytes += n;
+    len -= n;
+    if (writer->filled == full) {
+      writer->filled = 0;
+      kv_result_t res = writer_store_chunk(writer, d);
+      if (writer->res == KV_SUCCESS) {
+        writer->res = res;
+      }
+    }
+  }
+  return writer->res;
+}
+
+kv_result_t kv_stripe_writer_close(kv_stripe_writer_t *writer, bool commit,
+                                   kv_stripe_manifest_t *manifest) {
+  kv_engine_t *engine = writer->engine;
+  uint32_t m = writer->manifest.parity_chunks;
+  for (uint32_t i = 0; i < WRITER_CHUNKS; i++) {
+    writer_settle(writer, &writer->stores[i], 1);
+    kv_engine_free_buffer(engine, writer->chunks[i]);
+  }
+  for (uint32_t i = 0; i < 2; i++) {
+    writer_settle(writer, &writer->parity_stores[i], m);
+    kv_engine_free_buffer(engine, writer->parity[i]);
+  }
+
+  kv_result_t res = writer->res;
+  if (res == KV_SUCCESS &&
+      (!commit || writer->written < writer->manifest.value_size)) {
+    res = KV_ERR_ABORTED;
+  }
+  /* chunks were stored for rows [0, ceil(written / row bytes)) */
+  if (res != KV_SUCCESS) {
+    uint64_t bytes = row_bytes(&writer->manifest);
+    delete_rows(engine, writer->key, writer->key_len, &writer->manifest,
+                (writer->written + bytes - 1) / bytes);
+  }
+  writer->manifest.checksum = manifest_checksum(&writer->manifest);
+  *manifest = writer->manifest;
+  free(writer);
+  return res;
+}
+
+/* ============================================================================
+ * Ranged Reads
+ * ============================================================================
+ */
+
+size_t kv_stripe_range_limit(const kv_stripe_manifest_t *manifest,
+                             uint64_t offset) {
+  return manifest->chunk_size - (size_t)(offset % manifest->chunk_size);
+}
+
+/* Ranged reads ask for a multiple of 4 bytes, running past the end of a
+ * value that isn't one */
+static uint32_t range_request(size_t len) {
+  return (uint32_t)((len + 3) & ~(size_t)3);
+}
+
+/* True if a ranged read brought at least len bytes; one that stops short
+ * of the end of the value reports KVS_ERR_BUFFER_SMALL */
+static bool range_arrived(const chunk_cmd_t *cmd, size_t len) {
+  return cmd->done &&
+         (cmd->result == KVS_SUCCESS ||
+          cmd->result == KVS_ERR_BUFFER_SMALL) &&
+         cmd->value.length >= len;
+}
+
+/* Sets up cmd to read len bytes at offset of the chunk j of a row */
+static void range_chunk_cmd(chunk_cmd_t *cmd, const kv_stripe_range_t *range,
+                            uint64_t row, uint32_t j, uint8_t *buffer,
+                            uint32_t len, uint64_t offset) {
+  const kv_stripe_manifest_t *manifest = range->manifest;
+  cmd->dev_idx = chunk_device(manifest, row, j);
+  cmd->key.key = cmd->key_bytes;
+  cmd->key.length = (uint16_t)chunk_key(cmd->key_bytes, manifest->generation,
+                                        chunk_index(manifest, row, j),
+                                        range->key, range->key_len);
+  cmd->value.value = buffer;
+  cmd->value.length = len;
+  cmd->value.actual_value_size = 0;
+  cmd->value.offset = (uint32_t)offset;
+}
+
+static bool device_readable(kv_engine_t *engine, uint32_t dev_idx) {
+  return dev_idx < atomic_load_explicit(&engine->num_devices,
+                                        memory_order_acquire) &&
+         atomic_load(&engine->devices[dev_idx].healthy);
+}
+
+kv_result_t kv_stripe_range_start(kv_engine_t *engine,
+                                  kv_stripe_range_t *range, uint32_t dev_idx) {
+  const kv_stripe_manifest_t *manifest = range->manifest;
+  chunk_batch_t *batch = batch_create(engine, 1);
+  if (!batch) {
+    return KV_ERR_NO_MEMORY;
+  }
+  range->batch = batch;
+  range->rebuilt = false;
+
+  chunk_cmd_t *cmd = &batch->cmd[0];
+  uint32_t len = range_request(range->len);
+  if (manifest) {
+    uint64_t d = range->offset / manifest->chunk_size;
+    range_chunk_cmd(cmd, range, d / manifest->data_chunks,
+                    (uint32_t)(d % manifest->data_chunks), range->buffer, len,
+                    range->offset % manifest->chunk_size);
+  } else {
+    cmd->dev_idx = dev_idx;
+    memcpy(cmd->key_bytes, range->key, range->key_len);
+    cmd->key.key = cmd->key_bytes;
+    cmd->key.length = (uint16_t)range->key_len;
+    cmd->value.value = range->buffer;
+    cmd->value.length = len;
+    cmd->value.actual_value_size = 0;
+    cmd->value.offset = (uint32_t)range->offset;
+  }
+  if (!device_readable(engine, cmd->dev_idx)) {
+    cmd->result = KVS_ERR_DEV_NOT_EXIST;
+    cmd->done = true;
+    return KV_SUCCESS;
+  }
+  batch_submit(batch, 0, KVS_CMD_RETRIEVE);
+  return KV_SUCCESS;
+}
+
+/* Rebuilds a range of a lost data chunk from the same range of the row's
+ * other chunks, all read at once */
+static kv_result_t range_rebuild(kv_engine_t *engine,
+                                 kv_stripe_range_t *range) {
+  const kv_stripe_manifest_t *manifest = range->manifest;
+  uint32_t k = manifest->data_chunks;
+  uint32_t m = manifest->parity_chunks;
+  uint32_t width = k + m;
+  uint64_t d = range->offset / manifest->chunk_size;
+  uint64_t row = d / k;
+  uint32_t lost = (uint32_t)(d % k);
+  uint32_t len = range_request(range->len);
+
+  uint8_t *buffer = stripe_buffer(engine, (size_t)width * len);
+  chunk_batch_t *batch = buffer ? batch_create(engine, width) : NULL;
+  if (!batch) {
+    kv_engine_free_buffer(engine, buffer);
+    return KV_ERR_NO_MEMORY;
+  }
+  batch->buffers[0] = buffer;
+  for (uint32_t i = 0; i < width; i++) {
+    chunk_cmd_t *cmd = &batch->cmd[i];
+    if (i == lost) {
+      continue;
+    }
+    range_chunk_cmd(cmd, range, row, i, buffer + (size_t)i * len, len,
+                    range->offset % manifest->chunk_size);
+    if (!device_readable(engine, cmd->dev_idx)) {
+      cmd->result = KVS_ERR_DEV_NOT_EXIST;
+      cmd->done = true;
+      continue;
+    }
+    batch_submit(batch, i, KVS_CMD_RETRIEVE);
+  }
+  batch_wait_all(batch);
+
+  bool present[KV_STRIPE_MAX_CHUNKS];
+  uint8_t *shards[KV_STRIPE_MAX_CHUNKS];
+  uint32_t available = 0;
+  for (uint32_t i = 0; i < width; i++) {
+    present[i] = i != lost && range_arrived(&batch->cmd[i], len);
+    shards[i] = i == lost ? range->buffer : buffer + (size_t)i * len;
+    available += present[i];
+  }
+  kvs_result kvs_res = batch_first_error(batch, width);
+  if (available >= k) {
+    rs_reconstruct(k, m, len, shards, present);
+  }
+  batch_release(batch);
+  if (available < k) {
+    if (kvs_res == KVS_SUCCESS || is_device_error(kvs_res)) {
+      return KV_ERR_DEVICE_DEGRADED;
+    }
+    return map_kvs_result(kvs_res);
+  }
+  range->rebuilt = true;
+  return KV_SUCCESS;
+}
+
+kv_result_t kv_stripe_range_finish(kv_engine_t *engine,
+                                   kv_stripe_range_t *range) {
+  chunk_batch_t *batch = range->batch;
+  batch_wait_all(batch);
+  bool arrived = range_arrived(&batch->cmd[0], range->len);
+  kvs_result kvs_res = batch->cmd[0].result;
+  batch_release(batch);
+  range->batch = NULL;
+  if (arrived) {
+    return KV_SUCCESS;
+  }
+  if (range->manifest && range->manifest->parity_chunks > 0) {
+    return range_rebuild(engine, range);
+  }
+  /* the value is shorter than when the stream opened: it was replaced */
+  if (kvs_res == KVS_SUCCESS || kvs_res == KVS_ERR_BUFFER_SMALL ||
+      kvs_res == KVS_ERR_VALUE_OFFSET_INVALID) {
+    return KV_ERR_KEY_NOT_FOUND;
+  }
+  return map_kvs_result(kvs_res);
+}
+
+/* ============================================================================
+ * Striped Keys of Earlier Runs
+ * ============================================================================
+ */
+
+/* Adds the key of every chunk on one device to engine->striped_keys; the
+ * iterator filter limits the walk to internal keys */
+static kv_result_t scan_chunk_keys(kv_engine_t *engine, uint32_t dev_idx) {
+  kvs_key_space_handle keyspace = engine->devices[dev_idx].keyspace;
+  kvs_option_iterator option = {KVS_ITERATOR_KEY};
+  kvs_key_group_filter filter;
+  memset(&filter, 0, sizeof(filter));
+  memset(filter.bitmask, 0xff, KV_INTERNAL_KEY_PREFIX_LEN);
+  memcpy(filter.bit_pattern, KV_INTERNAL_KEY_PREFIX,
+         KV_INTERNAL_KEY_PREFIX_LEN);
+
+  kvs_iterator_handle handle;
+  if (kvs_create_iterator(keyspace, &option, &filter, &handle) !=
+      KVS_SUCCESS) {
+    return KV_ERR_IO;
+  }
+  uint8_t *buffer = dma_alloc(KVS_ITERATOR_BUFFER_SIZE);
+  if (!buffer) {
+    kvs_delete_iterator(keyspace, handle);
+    return KV_ERR_NO_MEMORY;
+  }
+
+  kv_result_t result = KV_SUCCESS;
+  kvs_iterator_list list;
+  list.it_list = buffer;
+  list.end = false;
+  while (!list.end && result == KV_SUCCESS) {
+    list.size = KVS_ITERATOR_BUFFER_SIZE;
+    list.num_entries = 0;
+    if (kvs_iterate_next(keyspace, handle, &list) != KVS_SUCCESS) {
+      result = KV_ERR_IO;
+      break;
+    }
+    uint32_t pos = 0;
+    for (uint32_t i = 0; i < list.num_entries; i++) {
+      uint32_t key_len;
+      if (pos + sizeof(key_len) > list.size) {
+        break;
+      }
+      memcpy(&key_len, buffer + pos, sizeof(key_len));
+      pos += sizeof(key_len);
+      if (key_len == 0 || key_len > 255 || pos + key_len > list.size) {
+        break;
+      }
+      const uint8_t *key = buffer + pos;
+      pos += key_len;
+      if (key_len <= CHUNK_KEY_HEADER || !kv_engine_is_internal_key(key,
+                                                                    key_len) ||
+          key[KV_INTERNAL_KEY_PREFIX_LEN] != CHUNK_KEY_TAG) {
+        continue;
+      }
+      const uint8_t *user_key = key + CHUNK_KEY_HEADER;
+      uint32_t user_len = key_len - CHUNK_KEY_HEADER;
+      if (add_key(&engine->striped_keys, user_key, user_len,
+                  kv_engine_key_hash(user_key, user_len)) < 0) {
+        result = KV_ERR_NO_MEMORY;
+        break;
+      }
+      atomic_store(&engine->striped_keys_present, true);
+    }
+  }
+
+  dma_free(buffer);
+  kvs_delete_iterator(keyspace, handle);
+  return result;
+}
+
+typedef struct {
+  kv_engine_t *engine;
+  uint32_t dev_idx;
+  kv_result_t result;
+} chunk_scan_t;
+
+static void *scan_chunk_keys_thread(void *arg) {
+  chunk_scan_t *scan = (chunk_scan_t *)arg;
+  scan->result = scan_chunk_keys(scan->engine, scan->dev_idx);
+  return NULL;
+}
+
+/* One thread per device, like index recovery: startup waits for the
+ * longest walk rather than the sum of them */
+kv_result_t kv_engine_stripe_init(kv_engine_t *engine) {
+  uint32_t num_devices = engine->num_devices;
+  chunk_scan_t scans[KV_MAX_DEVICES];
+  pthread_t threads[KV_MAX_DEVICES];
+  bool started[KV_MAX_DEVICES] = {false};
+
+  for (uint32_t i = 0; i < num_devices; i++) {
+    scans[i] = (chunk_scan_t){.engine = engine, .dev_idx = i};
+    started[i] = num_devices > 1 &&
+                 pthread_create(&threads[i], NULL, scan_chunk_keys_thread,
+                                &scans[i]) == 0;
+    if (!started[i]) {
+      scan_chunk_keys_thread(&scans[i]);
+    }
+  }
+
+  kv_result_t result = KV_SUCCESS;
+  for (uint32_t i = 0; i < num_devices; i++) {
+    if (started[i]) {
+      pthread_join(threads[i], NULL);
+    }
+    if (scans[i].result != KV_SUCCESS) {
+      fprintf(stderr, "[stripe] chunk key scan failed on device %u\n", i);
+      result = scans[i].result;
+    }
+  }
+  return result;
+}
@@ -0,0 +1,104 @@
+/**
+ * Blocked Bloom Filter Implementation
+ */
+
+#include "bloom_filter.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define BLOCK_BYTES 64
+#define BLOCK_BITS (BLOCK_BYTES * 8)
+#define WORDS_PER_BLOCK (BLOCK_BYTES / sizeof(uint64_t))
+#define MAX_HASHES 16
+
+bloom_filter_t *bloom_filter_create(uint64_t expected_keys,
+                                    uint32_t bits_per_key) {
+  if (expected_keys == 0 || bits_per_key == 0) {
+    return NULL;
+  }
+
+  bloom_filter_t *filter = malloc(sizeof(bloom_filter_t));
+  if (!filter) {
+    return NULL;
+  }
+
+  // round the block count up to a power of two so the block index is a shift
+  uint64_t wanted_blocks =
+      (expected_keys * bits_per_key + BLOCK_BITS - 1) / BLOCK_BITS;
+  uint32_t shift = 0;
+  while ((1ULL << shift) < wanted_blocks) {
+    shift++;
+  }
+
+  filter->num_blocks = 1ULL << shift;
+  filter->block_shift = shift;
+  filter->capacity = expected_keys;
+  atomic_store(&filter->count, 0);
+
+  // k = bits_per_key * ln 2 minimizes the false positive rate
+  uint32_t k = (bits_per_key * 693 + 500) / 1000;
+  filter->num_hashes = k < 1 ? 1 : (k > MAX_HASHES ? MAX_HASHES : k);
+
+  size_t bytes = filter->num_blocks * BLOCK_BYTES;
+  filter->words = aligned_alloc(BLOCK_BYTES, bytes);
+  if (!filter->words) {
+    free(filter);
+    return NULL;
+  }
+  memset((void *)filter->words, 0, bytes);
+
+  return filter;
+}
+
+// first word of the block selected by hash
+static inline uint64_t block_base(const bloom_filter_t *filter,
+                                  uint64_t hash) {
+  if (filter->block_shift == 0) {
+    return 0;
+  }
+  // multiplicative hashing takes the block from the high bits, leaving the
+  // low bits of hash free for the in-block probes
+  uint64_t mixed = hash * 0x9E3779B97F4A7C15ULL;
+  return (mixed >> (64 - filter->block_shift)) * WORDS_PER_BLOCK;
+}
+
+void bloom_filter_add(bloom_filter_t *filter, uint64_t hash) {
+  _Atomic uint64_t *block = filter->words + block_base(filter, hash);
+  uint32_t h1 = (uint32_t)hash;
+  uint32_t h2 = (uint32_t)(hash >> 32) | 1;
+
+  for (uint32_t i = 0; i < filter->num_hashes; i++) {
+    uint32_t bit = (h1 + i * h2) & (BLOCK_BITS - 1);
+    atomic_fetch_or_explicit(&block[bit >> 6], 1ULL << (bit & 63),
+                             memory_order_relaxed);
+  }
+  atomic_fetch_add_explicit(&filter->count, 1, memory_order_relaxed);
+}
+
+bool bloom_filter_may_contain(const bloom_filter_t *filter, uint64_t hash) {
+  _Atomic uint64_t *block = filter->words + block_base(filter, hash);
+  uint32_t h1 = (uint32_t)hash;
+  uint32_t h2 = (uint32_t)(hash >> 32) | 1;
+
+  for (uint32_t i = 0; i < filter->num_hashes; i++) {
+    uint32_t bit = (h1 + i * h2) & (BLOCK_BITS - 1);
+    uint64_t word =
+        atomic_load_explicit(&block[bit >> 6], memory_order_relaxed);
+    if (!(word & (1ULL << (bit & 63)))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t bloom_filter_memory_bytes(const bloom_filter_t *filter) {
+  return filter ? filter->num_blocks * BLOCK_BYTES : 0;
+}
+
+void bloom_filter_destroy(bloom_filter_t *filter) {
+  if (!filter) {
+    return;
+  }
+  free((void *)filter->words);
+  free(filter);
+}
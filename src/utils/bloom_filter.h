@@ -0,0 +1,76 @@
+/**
+ * Blocked Bloom Filter
+ *
+ * Fixed-size Bloom filter used to answer "definitely not stored" without a
+ * device round-trip. Bits are grouped into 64-byte blocks and every probe for
+ * a key lands in the same block, so a lookup touches one cache line.
+ *
+ * Inserts and lookups are lock-free (atomic OR / relaxed loads) and may run
+ * concurrently. Bloom filters cannot remove keys, so callers rebuild a fresh
+ * filter once enough deletes have accumulated.
+ */
+
+#ifndef BLOOM_FILTER_H
+#define BLOOM_FILTER_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * bloom filter sized for a target number of keys.
+ */
+typedef struct {
+  _Atomic uint64_t *words;
+  uint64_t num_blocks; // power of two, 512 bits each
+  uint32_t block_shift;
+  uint32_t num_hashes;
+  uint64_t capacity;       // keys the filter was sized for
+  _Atomic uint64_t count;  // insertions so far (duplicates included)
+} bloom_filter_t;
+
+/**
+ * Create an empty filter.
+ *
+ * @param expected_keys Number of keys to size the filter for
+ * @param bits_per_key  Bits of filter per key (10 gives roughly 1% false
+ *                      positives)
+ * @return Pointer to filter, or NULL on failure
+ */
+bloom_filter_t *bloom_filter_create(uint64_t expected_keys,
+                                    uint32_t bits_per_key);
+
+/**
+ * Add a key by its 64-bit hash. Safe to call concurrently with lookups.
+ *
+ * @param filter The filter
+ * @param hash   Well-mixed 64-bit hash of the key
+ */
+void bloom_filter_add(bloom_filter_t *filter, uint64_t hash);
+
+/**
+ * Check whether a key may be present.
+ *
+ * @param filter The filter
+ * @param hash   Hash passed to bloom_filter_add
+ * @return false if the key was never added, true if it may have been
+ */
+bool bloom_filter_may_contain(const bloom_filter_t *filter, uint64_t hash);
+
+/**
+ * Heap bytes used by the filter's bit array.
+ *
+ * @param filter The filter
+ * @return Size in bytes
+ */
+size_t bloom_filter_memory_bytes(const bloom_filter_t *filter);
+
+/**
+ * Destroy the filter.
+ *
+ * @param filter The filter to destroy (NULL is ignored)
+ */
+void bloom_filter_destroy(bloom_filter_t *filter);
+
+#endif /* BLOOM_FILTER_H */
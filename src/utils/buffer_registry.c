@@ -0,0 +1,120 @@
+/**
+ * Registered Buffer Registry Implementation
+ */
+
+#include "buffer_registry.h"
+#include <stdlib.h>
+#include <string.h>
+
+buffer_registry_t *buffer_registry_create(void) {
+  buffer_registry_t *registry = malloc(sizeof(buffer_registry_t));
+  if (!registry) {
+    return NULL;
+  }
+
+  registry->regions =
+      malloc(sizeof(buffer_region_t) * BUFFER_REGISTRY_MAX_REGIONS);
+  if (!registry->regions) {
+    free(registry);
+    return NULL;
+  }
+
+  atomic_store(&registry->count, 0);
+  pthread_rwlock_init(&registry->lock, NULL);
+  return registry;
+}
+
+/* index of the first region whose start is > addr */
+static size_t upper_bound(const buffer_region_t *regions, size_t count,
+                          uintptr_t addr) {
+  size_t lo = 0;
+  size_t hi = count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (regions[mid].start <= addr) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+int buffer_registry_add(buffer_registry_t *registry, const void *base,
+                        size_t len) {
+  if (!registry || !base || len == 0) {
+    return -1;
+  }
+
+  uintptr_t start = (uintptr_t)base;
+  uintptr_t end = start + len;
+  if (end < start) {
+    return -1; // wraps the address space
+  }
+
+  pthread_rwlock_wrlock(&registry->lock);
+
+  size_t count = atomic_load(&registry->count);
+  if (count >= BUFFER_REGISTRY_MAX_REGIONS) {
+    pthread_rwlock_unlock(&registry->lock);
+    return -1;
+  }
+
+  // reject overlap with the neighbours on either side of the insert point
+  size_t pos = upper_bound(registry->regions, count, start);
+  if ((pos > 0 && registry->regions[pos - 1].end > start) ||
+      (pos < count && registry->regions[pos].start < end)) {
+    pthread_rwlock_unlock(&registry->lock);
+    return -1;
+  }
+
+  memmove(&registry->regions[pos + 1], &registry->regions[pos],
+          sizeof(buffer_region_t) * (count - pos));
+  registry->regions[pos].start = start;
+  registry->regions[pos].end = end;
+  atomic_store(&registry->count, count + 1);
+
+  pthread_rwlock_unlock(&registry->lock);
+  return 0;
+}
+
+int buffer_registry_contains(buffer_registry_t *registry, const void *ptr,
+                             size_t len) {
+  if (!registry || !ptr) {
+    return 0;
+  }
+
+  // fast path: nothing registered, skip the lock
+  if (atomic_load_explicit(&registry->count, memory_order_relaxed) == 0) {
+    return 0;
+  }
+
+  uintptr_t start = (uintptr_t)ptr;
+  uintptr_t end = start + len;
+
+  pthread_rwlock_rdlock(&registry->lock);
+  size_t count = atomic_load(&registry->count);
+  size_t pos = upper_bound(registry->regions, count, start);
+  int found = pos > 0 && end >= start && registry->regions[pos - 1].end >= end;
+  pthread_rwlock_unlock(&registry->lock);
+
+  return found;
+}
+
+void buffer_registry_clear(buffer_registry_t *registry) {
+  if (!registry) {
+    return;
+  }
+  pthread_rwlock_wrlock(&registry->lock);
+  atomic_store(&registry->count, 0);
+  pthread_rwlock_unlock(&registry->lock);
+}
+
+void buffer_registry_destroy(buffer_registry_t *registry) {
+  if (!registry) {
+    return;
+  }
+  pthread_rwlock_destroy(&registry->lock);
+  free(registry->regions);
+  free(registry);
+}
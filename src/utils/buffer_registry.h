@@ -0,0 +1,83 @@
+/**
+ * Registered Buffer Registry
+ *
+ * Tracks long-lived application buffers that the caller has registered with
+ * the engine (similar to io_uring fixed buffers). A value that lies entirely
+ * inside a registered region is handed to the device as-is, skipping the
+ * alignment bounce copy in kv_engine_store().
+ *
+ * Regions are kept sorted by start address so lookups are a binary search.
+ * Registration is rare and lookups are frequent, so the table is guarded by
+ * a reader-writer lock and lookups skip the lock entirely while the registry
+ * is empty.
+ */
+
+#ifndef BUFFER_REGISTRY_H
+#define BUFFER_REGISTRY_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* maximum number of regions that can be registered at once */
+#define BUFFER_REGISTRY_MAX_REGIONS 1024
+
+typedef struct {
+  uintptr_t start; // first byte of the region
+  uintptr_t end;   // one past the last byte of the region
+} buffer_region_t;
+
+/**
+ * sorted table of registered regions.
+ */
+typedef struct {
+  buffer_region_t *regions;
+  _Atomic size_t count;
+  pthread_rwlock_t lock;
+} buffer_registry_t;
+
+/**
+ * Create an empty registry.
+ *
+ * @return Pointer to registry, or NULL on failure
+ */
+buffer_registry_t *buffer_registry_create(void);
+
+/**
+ * Register a region. Overlapping or duplicate regions are rejected.
+ *
+ * @param registry The registry
+ * @param base     Start of the region
+ * @param len      Length of the region in bytes (must be > 0)
+ * @return 0 on success, -1 if invalid, overlapping, or the table is full
+ */
+int buffer_registry_add(buffer_registry_t *registry, const void *base,
+                        size_t len);
+
+/**
+ * Check whether [ptr, ptr + len) lies entirely inside one registered region.
+ *
+ * @param registry The registry
+ * @param ptr      Start of the range
+ * @param len      Length of the range in bytes
+ * @return 1 if the range is registered, 0 otherwise
+ */
+int buffer_registry_contains(buffer_registry_t *registry, const void *ptr,
+                             size_t len);
+
+/**
+ * Remove all registered regions.
+ *
+ * @param registry The registry
+ */
+void buffer_registry_clear(buffer_registry_t *registry);
+
+/**
+ * Destroy the registry. Does not touch the registered memory itself.
+ *
+ * @param registry The registry to destroy (NULL is safe)
+ */
+void buffer_registry_destroy(buffer_registry_t *registry);
+
+#endif /* BUFFER_REGISTRY_H */
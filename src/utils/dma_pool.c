@@ -6,7 +6,9 @@
 #include "dma_alloc.h"
 #include <stdlib.h>
 
-dma_pool_t *dma_pool_create(size_t buffer_size, size_t count) {
+// pool with no buffers yet; all_buffers is zeroed so ownership checks
+// skip the slots a lazy pool hasn't filled
+static dma_pool_t *pool_alloc(size_t buffer_size, size_t count) {
   dma_pool_t *pool = malloc(sizeof(dma_pool_t));
   if (!pool) {
     return NULL;
@@ -18,7 +20,7 @@ dma_pool_t *dma_pool_create(size_t buffer_size, size_t count) {
     return NULL;
   }
 
-  pool->all_buffers = malloc(sizeof(void *) * count);
+  pool->all_buffers = calloc(count, sizeof(void *));
   if (!pool->all_buffers) {
     free(pool->free_list);
     free(pool);
@@ -27,7 +29,18 @@ dma_pool_t *dma_pool_create(size_t buffer_size, size_t count) {
 
   pool->buffer_size = buffer_size;
   pool->count = count;
+  pool->allocated = 0;
+  pool->exhausted = 0;
   pool->top = -1;
+  pthread_mutex_init(&pool->lock, NULL);
+  return pool;
+}
+
+dma_pool_t *dma_pool_create(size_t buffer_size, size_t count) {
+  dma_pool_t *pool = pool_alloc(buffer_size, count);
+  if (!pool) {
+    return NULL;
+  }
 
   // pre-allocate all buffers and push onto both free-list and all_buffers
   for (size_t i = 0; i < count; i++) {
@@ -39,18 +52,33 @@ dma_pool_t *dma_pool_create(size_t buffer_size, size_t count) {
     pool->top++;
     pool->free_list[pool->top] = buf;
     pool->all_buffers[i] = buf;
+    pool->allocated++;
   }
 
-  pthread_mutex_init(&pool->lock, NULL);
   return pool;
 }
 
+dma_pool_t *dma_pool_create_lazy(size_t buffer_size, size_t count) {
+  return pool_alloc(buffer_size, count);
+}
+
 void *dma_pool_acquire(dma_pool_t *pool) {
 
   pthread_mutex_lock(&pool->lock);
 
+  // none free: a lazy pool grows while it is under count
+  if (pool->top < 0 && pool->allocated < pool->count) {
+    void *buf = dma_alloc(pool->buffer_size);
+    if (buf) {
+      pool->all_buffers[pool->allocated++] = buf;
+      pthread_mutex_unlock(&pool->lock);
+      return buf;
+    }
+  }
+
   // check if pool is exhausted
   if (pool->top < 0) {
+    pool->exhausted++;
     pthread_mutex_unlock(&pool->lock);
     return NULL;
   }
@@ -82,6 +110,8 @@ int dma_pool_owns(dma_pool_t *pool, void *buffer) {
   if (!pool || !buffer) {
     return 0;
   }
+  // slots a lazy pool has yet to fill are NULL, and the one it may be
+  // filling now can't hold a buffer already handed out
   for (size_t i = 0; i < pool->count; i++) {
     if (pool->all_buffers[i] == buffer) {
       return 1;
@@ -90,6 +120,20 @@ int dma_pool_owns(dma_pool_t *pool, void *buffer) {
   return 0;
 }
 
+size_t dma_pool_available(dma_pool_t *pool) {
+  pthread_mutex_lock(&pool->lock);
+  size_t available = (size_t)(pool->top + 1) + pool->count - pool->allocated;
+  pthread_mutex_unlock(&pool->lock);
+  return available;
+}
+
+uint64_t dma_pool_exhausted_count(dma_pool_t *pool) {
+  pthread_mutex_lock(&pool->lock);
+  uint64_t exhausted = pool->exhausted;
+  pthread_mutex_unlock(&pool->lock);
+  return exhausted;
+}
+
 void dma_pool_destroy(dma_pool_t *pool) {
   if (!pool) {
     return;
@@ -97,7 +141,7 @@ void dma_pool_destroy(dma_pool_t *pool) {
 
   /* free all buffers via all_buffers (free_list only tracks available ones) */
   if (pool->all_buffers) {
-    for (size_t i = 0; i < pool->count; i++) {
+    for (size_t i = 0; i < pool->allocated; i++) {
       dma_free(pool->all_buffers[i]);
     }
     free(pool->all_buffers);
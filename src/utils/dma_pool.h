@@ -14,6 +14,7 @@
 
 #include <pthread.h>
 #include <stddef.h>
+#include <stdint.h>
 
 /**
  * pool of fixed size DMA aligned buffers backed by a stack free-list.
@@ -24,6 +25,8 @@ typedef struct {
   int top;            // idx of next available buffer (-1 if empty)
   size_t buffer_size;
   size_t count;
+  size_t allocated;   // buffers allocated so far (count unless lazy)
+  uint64_t exhausted; // acquires that found no free buffer
   pthread_mutex_t lock;
 } dma_pool_t;
 
@@ -37,6 +40,17 @@ typedef struct {
  */
 dma_pool_t *dma_pool_create(size_t buffer_size, size_t count);
 
+/**
+ * Create a DMA buffer pool that allocates its buffers on demand.
+ * Acquires allocate a new buffer while fewer than count exist and none is
+ * free, so startup doesn't pay for buffers until they are used.
+ *
+ * @param buffer_size Size of each buffer in bytes
+ * @param count       Most buffers the pool will hold
+ * @return Pointer to pool, or NULL on failure
+ */
+dma_pool_t *dma_pool_create_lazy(size_t buffer_size, size_t count);
+
 /**
  * Acquire a buffer from the pool.
  * Returns NULL if the pool is exhausted — caller should fall back to dma_alloc.
@@ -65,6 +79,23 @@ void dma_pool_release(dma_pool_t *pool, void *buffer);
  */
 int dma_pool_owns(dma_pool_t *pool, void *buffer);
 
+/**
+ * Number of buffers currently free in the pool, counting those a lazy
+ * pool has yet to allocate.
+ *
+ * @param pool The buffer pool
+ * @return Free buffers (0 to count)
+ */
+size_t dma_pool_available(dma_pool_t *pool);
+
+/**
+ * Number of acquires that found the pool empty since it was created.
+ *
+ * @param pool The buffer pool
+ * @return Failed acquires
+ */
+uint64_t dma_pool_exhausted_count(dma_pool_t *pool);
+
 /**
  * Destroy the pool and free all buffers.
  *
@@ -0,0 +1,437 @@
+/**
+ * Compact Key Index Implementation
+ */
+
+#include "hashTable.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define GROUP_WIDTH 16
+#define CTRL_EMPTY 0x80
+#define CTRL_DELETED 0xFE
+#define INITIAL_CAPACITY 16
+#define INITIAL_ARENA 1024
+
+/* arena entry layout: [hash:u32][len:u8][key bytes]. The caller's hash is
+ * kept so the stripe can be rehashed without knowing the hash function. */
+#define ENTRY_HEADER (sizeof(uint32_t) + 1)
+
+/* Spread the caller's 32-bit hash over 64 bits (murmur3 finalizer). The low
+ * bits of the input already chose the stripe, so they can't be reused. */
+static inline uint64_t mix_hash(uint32_t hash) {
+  uint64_t h = hash;
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+static inline uint8_t hash_tag(uint64_t h) { return (uint8_t)(h & 0x7F); }
+
+/* bitmask of slots in the 16-byte group whose control byte equals byte */
+static inline uint32_t group_match(const uint8_t *ctrl, uint8_t byte) {
+#if defined(__SSE2__)
+  __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+  __m128i match = _mm_cmpeq_epi8(group, _mm_set1_epi8((char)byte));
+  return (uint32_t)_mm_movemask_epi8(match);
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < GROUP_WIDTH; i++) {
+    if (ctrl[i] == byte) {
+      mask |= 1u << i;
+    }
+  }
+  return mask;
+#endif
+}
+
+/* bitmask of empty or deleted slots (both have the high bit set) */
+static inline uint32_t group_available(const uint8_t *ctrl) {
+#if defined(__SSE2__)
+  __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+  return (uint32_t)_mm_movemask_epi8(group);
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < GROUP_WIDTH; i++) {
+    if (ctrl[i] & 0x80) {
+      mask |= 1u << i;
+    }
+  }
+  return mask;
+#endif
+}
+
+static inline uint32_t entry_hash(const char *entry) {
+  uint32_t hash;
+  memcpy(&hash, entry, sizeof(hash));
+  return hash;
+}
+
+/* Returns the slot holding key, or -1. Probes whole groups with triangular
+ * steps, which visits every group when the group count is a power of two. */
+static int64_t stripe_find(const struct hash_stripe *stripe, const void *key,
+                           uint32_t key_len, uint32_t hash, uint64_t h) {
+  if (stripe->capacity == 0) {
+    return -1;
+  }
+
+  uint32_t num_groups = stripe->capacity / GROUP_WIDTH;
+  uint32_t group = (uint32_t)(h >> 7) & (num_groups - 1);
+  uint8_t tag = hash_tag(h);
+
+  for (uint32_t probe = 0; probe < num_groups; probe++) {
+    const uint8_t *ctrl = stripe->ctrl + (size_t)group * GROUP_WIDTH;
+    uint32_t match = group_match(ctrl, tag);
+    while (match) {
+      uint32_t slot = group * GROUP_WIDTH + (uint32_t)__builtin_ctz(match);
+      const char *entry = stripe->arena + stripe->offsets[slot];
+      if (entry_hash(entry) == hash &&
+          (uint8_t)entry[sizeof(uint32_t)] == key_len &&
+          memcmp(entry + ENTRY_HEADER, key, key_len) == 0) {
+        return slot;
+      }
+      match &= match - 1;
+    }
+    if (group_match(ctrl, CTRL_EMPTY)) {
+      return -1;
+    }
+    group = (group + probe + 1) & (num_groups - 1);
+  }
+  return -1;
+}
+
+/* Places an arena offset in the first available slot of the probe sequence.
+ * The caller guarantees the table has room. */
+static void stripe_place(struct hash_stripe *stripe, uint64_t h,
+                         uint32_t offset) {
+  uint32_t num_groups = stripe->capacity / GROUP_WIDTH;
+  uint32_t group = (uint32_t)(h >> 7) & (num_groups - 1);
+
+  for (uint32_t probe = 0; probe < num_groups; probe++) {
+    uint8_t *ctrl = stripe->ctrl + (size_t)group * GROUP_WIDTH;
+    uint32_t available = group_available(ctrl);
+    if (available) {
+      uint32_t slot = group * GROUP_WIDTH + (uint32_t)__builtin_ctz(available);
+      if (stripe->ctrl[slot] == CTRL_DELETED) {
+        stripe->tombstones--;
+      }
+      stripe->ctrl[slot] = hash_tag(h);
+      stripe->offsets[slot] = offset;
+      stripe->count++;
+      return;
+    }
+    group = (group + probe + 1) & (num_groups - 1);
+  }
+}
+
+/* Rebuilds the stripe at new_capacity, dropping tombstones and compacting
+ * the arena so deleted keys stop taking space. */
+static int stripe_rehash(struct hash_stripe *stripe, uint32_t new_capacity) {
+  uint32_t live_bytes = stripe->arena_used - stripe->arena_dead;
+  uint32_t arena_cap = live_bytes > INITIAL_ARENA ? live_bytes : INITIAL_ARENA;
+
+  uint8_t *ctrl = malloc(new_capacity);
+  uint32_t *offsets = malloc(sizeof(uint32_t) * new_capacity);
+  char *arena = malloc(arena_cap);
+  if (!ctrl || !offsets || !arena) {
+    free(ctrl);
+    free(offsets);
+    free(arena);
+    return -1;
+  }
+  memset(ctrl, CTRL_EMPTY, new_capacity);
+
+  struct hash_stripe old = *stripe;
+  stripe->ctrl = ctrl;
+  stripe->offsets = offsets;
+  stripe->capacity = new_capacity;
+  stripe->count = 0;
+  stripe->tombstones = 0;
+  stripe->arena = arena;
+  stripe->arena_used = 0;
+  stripe->arena_cap = arena_cap;
+  stripe->arena_dead = 0;
+
+  for (uint32_t slot = 0; slot < old.capacity; slot++) {
+    if (old.ctrl[slot] & 0x80) {
+      continue;
+    }
+    const char *entry = old.arena + old.offsets[slot];
+    uint32_t len = ENTRY_HEADER + (uint8_t)entry[sizeof(uint32_t)];
+    memcpy(arena + stripe->arena_used, entry, len);
+    stripe_place(stripe, mix_hash(entry_hash(entry)), stripe->arena_used);
+    stripe->arena_used += len;
+  }
+
+  free(old.ctrl);
+  free(old.offsets);
+  free(old.arena);
+  return 0;
+}
+
+/* Appends a key to the arena, growing it if needed. Returns the offset or
+ * -1 if the arena can't grow. */
+static int64_t arena_append(struct hash_stripe *stripe, const void *key,
+                            uint32_t key_len, uint32_t hash) {
+  uint64_t need = (uint64_t)stripe->arena_used + ENTRY_HEADER + key_len;
+  if (need > UINT32_MAX) {
+    return -1;
+  }
+  if (need > stripe->arena_cap) {
+    uint64_t new_cap = stripe->arena_cap ? stripe->arena_cap : INITIAL_ARENA;
+    // grow by 1.5x rather than 2x to bound slack in large arenas
+    while (new_cap < need) {
+      new_cap += new_cap / 2;
+    }
+    if (new_cap > UINT32_MAX) {
+      new_cap = UINT32_MAX;
+    }
+    char *arena = realloc(stripe->arena, new_cap);
+    if (!arena) {
+      return -1;
+    }
+    stripe->arena = arena;
+    stripe->arena_cap = (uint32_t)new_cap;
+  }
+
+  uint32_t offset = stripe->arena_used;
+  char *entry = stripe->arena + offset;
+  memcpy(entry, &hash, sizeof(hash));
+  entry[sizeof(uint32_t)] = (char)key_len;
+  memcpy(entry + ENTRY_HEADER, key, key_len);
+  stripe->arena_used = (uint32_t)need;
+  return offset;
+}
+
+int create_table(hash_table_t *table) {
+  if (!table) {
+    return -1;
+  }
+  for (int i = 0; i < HASH_TABLE_STRIPES; i++) {
+    struct hash_stripe *stripe = &table->stripes[i];
+    memset(stripe, 0, sizeof(*stripe));
+    if (pthread_rwlock_init(&stripe->lock, NULL) != 0) {
+      for (int j = 0; j < i; j++) {
+        pthread_rwlock_destroy(&table->stripes[j].lock);
+      }
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int add_key(hash_table_t *table, const void *key, uint32_t key_len,
+            uint32_t hash) {
+  if (!table || !key || key_len == 0 || key_len > 255) {
+    return -1;
+  }
+
+  struct hash_stripe *stripe =
+      &table->stripes[hash & (HASH_TABLE_STRIPES - 1)];
+  uint64_t h = mix_hash(hash);
+
+  // overwrites of an existing key only need the shared lock
+  pthread_rwlock_rdlock(&stripe->lock);
+  int64_t slot = stripe_find(stripe, key, key_len, hash, h);
+  pthread_rwlock_unlock(&stripe->lock);
+  if (slot >= 0) {
+    return 0;
+  }
+
+  pthread_rwlock_wrlock(&stripe->lock);
+
+  // re-check: another writer may have inserted between the two locks
+  if (stripe_find(stripe, key, key_len, hash, h) >= 0) {
+    pthread_rwlock_unlock(&stripe->lock);
+    return 0;
+  }
+
+  // keep (live + tombstones) under 7/8 of the slots
+  uint64_t used = (uint64_t)stripe->count + stripe->tombstones + 1;
+  if (used * 8 > (uint64_t)stripe->capacity * 7) {
+    uint32_t new_capacity = stripe->capacity ? stripe->capacity
+                                             : INITIAL_CAPACITY;
+    if (((uint64_t)stripe->count + 1) * 8 > (uint64_t)new_capacity * 7 / 2) {
+      new_capacity *= 2; // mostly live keys: grow, otherwise just purge
+    }
+    if (stripe_rehash(stripe, new_capacity) != 0) {
+      pthread_rwlock_unlock(&stripe->lock);
+      return -1;
+    }
+  }
+
+  int64_t offset = arena_append(stripe, key, key_len, hash);
+  if (offset < 0) {
+    pthread_rwlock_unlock(&stripe->lock);
+    return -1;
+  }
+  stripe_place(stripe, h, (uint32_t)offset);
+
+  pthread_rwlock_unlock(&stripe->lock);
+  return 1;
+}
+
+uint8_t key_in_table(hash_table_t *table, const void *key, uint32_t key_len,
+                     uint32_t hash) {
+  if (!table || !key || key_len == 0 || key_len > 255) {
+    return 0;
+  }
+
+  struct hash_stripe *stripe =
+      &table->stripes[hash & (HASH_TABLE_STRIPES - 1)];
+
+  pthread_rwlock_rdlock(&stripe->lock);
+  int64_t slot = stripe_find(stripe, key, key_len, hash, mix_hash(hash));
+  pthread_rwlock_unlock(&stripe->lock);
+
+  return slot >= 0 ? 1 : 0;
+}
+
+void delete_key(hash_table_t *table, const void *key, uint32_t key_len,
+                uint32_t hash) {
+  if (!table || !key || key_len == 0 || key_len > 255) {
+    return;
+  }
+
+  struct hash_stripe *stripe =
+      &table->stripes[hash & (HASH_TABLE_STRIPES - 1)];
+
+  pthread_rwlock_wrlock(&stripe->lock);
+
+  int64_t slot = stripe_find(stripe, key, key_len, hash, mix_hash(hash));
+  if (slot < 0) {
+    pthread_rwlock_unlock(&stripe->lock);
+    return;
+  }
+
+  /* A slot may go straight back to EMPTY only if its group already has an
+   * empty slot: lookups stop at such a group, so nothing probed past it. */
+  uint8_t *group_ctrl = stripe->ctrl + (slot & ~(int64_t)(GROUP_WIDTH - 1));
+  if (group_match(group_ctrl, CTRL_EMPTY)) {
+    stripe->ctrl[slot] = CTRL_EMPTY;
+  } else {
+    stripe->ctrl[slot] = CTRL_DELETED;
+    stripe->tombstones++;
+  }
+  stripe->count--;
+  stripe->arena_dead += ENTRY_HEADER + key_len;
+
+  // reclaim the arena once more than half of it belongs to deleted keys
+  if (stripe->arena_dead > INITIAL_ARENA &&
+      stripe->arena_dead > stripe->arena_used / 2) {
+    stripe_rehash(stripe, stripe->capacity); // best-effort on failure
+  }
+
+  pthread_rwlock_unlock(&stripe->lock);
+}
+
+void table_for_each(hash_table_t *table, table_visit_fn visit, void *arg) {
+  if (!table || !visit) {
+    return;
+  }
+
+  for (int i = 0; i < HASH_TABLE_STRIPES; i++) {
+    struct hash_stripe *stripe = &table->stripes[i];
+    int stop = 0;
+
+    pthread_rwlock_rdlock(&stripe->lock);
+    for (uint32_t slot = 0; slot < stripe->capacity && !stop; slot++) {
+      if (stripe->ctrl[slot] & 0x80) {
+        continue;
+      }
+      const char *entry = stripe->arena + stripe->offsets[slot];
+      stop = visit(entry + ENTRY_HEADER, (uint8_t)entry[sizeof(uint32_t)], arg);
+    }
+    pthread_rwlock_unlock(&stripe->lock);
+
+    if (stop) {
+      return;
+    }
+  }
+}
+
+uint64_t table_key_count(hash_table_t *table) {
+  uint64_t count = 0;
+  for (int i = 0; i < HASH_TABLE_STRIPES; i++) {
+    pthread_rwlock_rdlock(&table->stripes[i].lock);
+    count += table->stripes[i].count;
+    pthread_rwlock_unlock(&table->stripes[i].lock);
+  }
+  return count;
+}
+
+uint64_t table_capacity(hash_table_t *table) {
+  uint64_t capacity = 0;
+  for (int i = 0; i < HASH_TABLE_STRIPES; i++) {
+    pthread_rwlock_rdlock(&table->stripes[i].lock);
+    capacity += table->stripes[i].capacity;
+    pthread_rwlock_unlock(&table->stripes[i].lock);
+  }
+  return capacity;
+}
+
+uint64_t table_tombstone_count(hash_table_t *table) {
+  uint64_t tombstones = 0;
+  for (int i = 0; i < HASH_TABLE_STRIPES; i++) {
+    pthread_rwlock_rdlock(&table->stripes[i].lock);
+    tombstones += table->stripes[i].tombstones;
+    pthread_rwlock_unlock(&table->stripes[i].lock);
+  }
+  return tombstones;
+}
+
+double table_max_stripe_load(hash_table_t *table) {
+  double max_load = 0.0;
+  for (int i = 0; i < HASH_TABLE_STRIPES; i++) {
+    struct hash_stripe *stripe = &table->stripes[i];
+    pthread_rwlock_rdlock(&stripe->lock);
+    if (stripe->capacity) {
+      double load = (double)(stripe->count + stripe->tombstones) /
+                    stripe->capacity;
+      if (load > max_load) {
+        max_load = load;
+      }
+    }
+    pthread_rwlock_unlock(&stripe->lock);
+  }
+  return max_load;
+}
+
+uint64_t table_memory_bytes(hash_table_t *table) {
+  uint64_t bytes = sizeof(hash_table_t);
+  for (int i = 0; i < HASH_TABLE_STRIPES; i++) {
+    struct hash_stripe *stripe = &table->stripes[i];
+    pthread_rwlock_rdlock(&stripe->lock);
+    bytes += (uint64_t)stripe->capacity * (1 + sizeof(uint32_t));
+    bytes += stripe->arena_cap;
+    pthread_rwlock_unlock(&stripe->lock);
+  }
+  return bytes;
+}
+
+void free_table(hash_table_t *table) {
+  if (!table) {
+    return;
+  }
+
+  for (int i = 0; i < HASH_TABLE_STRIPES; i++) {
+    struct hash_stripe *stripe = &table->stripes[i];
+    pthread_rwlock_wrlock(&stripe->lock);
+    free(stripe->ctrl);
+    free(stripe->offsets);
+    free(stripe->arena);
+    stripe->ctrl = NULL;
+    stripe->offsets = NULL;
+    stripe->arena = NULL;
+    stripe->capacity = 0;
+    stripe->count = 0;
+    pthread_rwlock_unlock(&stripe->lock);
+    pthread_rwlock_destroy(&stripe->lock);
+  }
+}
@@ -1,115 +1,90 @@
+/**
+ * Compact Key Index
+ *
+ * Set of keys kept in DRAM alongside the devices. The table is split into
+ * independently locked stripes; callers pick the stripe with the same key
+ * hash used for device sharding.
+ *
+ * Each stripe is an open-addressing table in the style of SwissTable: one
+ * control byte per slot holding a 7-bit fingerprint of the hash, scanned
+ * 16 slots at a time (with SSE2 where available), plus a 4-byte offset per
+ * slot into a per-stripe arena that stores the variable-length keys back to
+ * back. There is no per-entry allocation; a 16-byte key costs roughly
+ * 30-40 bytes of index memory (depending on where the table and arena are in
+ * their growth cycle) instead of a fixed 256-byte buffer plus a uthash
+ * handle.
+ */
+
 #ifndef HASH_TABLE_H
 #define HASH_TABLE_H
 
-#include "../../lib/uthash.h"
 #include <pthread.h>
+#include <stddef.h>
 #include <stdint.h>
-#include <stdlib.h>
-#include <string.h>
 
-struct hash_entry {
-  char key[256];     // key data (255 bytes + null terminator)
-  uint32_t key_len;  // actual key length
-  UT_hash_handle hh; // makes structure hashable
+// Number of independently locked stripes (power of two)
+#define HASH_TABLE_STRIPES 64
+
+// One stripe of the table, aligned to a cache line so neighbouring stripes
+// don't false-share.
+struct hash_stripe {
+  _Alignas(64) pthread_rwlock_t lock;
+  uint8_t *ctrl;       // control byte per slot: empty, deleted or fingerprint
+  uint32_t *offsets;   // arena offset of the key stored in each slot
+  uint32_t capacity;   // number of slots (power of two, multiple of 16)
+  uint32_t count;      // live keys
+  uint32_t tombstones; // deleted slots not yet reclaimed
+  char *arena;         // keys stored as [len:u8][bytes]
+  uint32_t arena_used;
+  uint32_t arena_cap;
+  uint32_t arena_dead; // bytes belonging to deleted keys
 };
 
 typedef struct {
-  struct hash_entry *head;
-  pthread_mutex_t lock;
+  struct hash_stripe stripes[HASH_TABLE_STRIPES];
 } hash_table_t;
 
-// Creates an empty hash table with a mutex.
-static inline int create_table(hash_table_t *table) {
-  if (!table) {
-    return -1;
-  }
-  table->head = NULL;
-  return pthread_mutex_init(&table->lock, NULL);
-}
-
-// Adds a key to the hash table if missing.
-static inline void add_key(hash_table_t *table, const void *key,
-                           uint32_t key_len) {
-  if (!table || !key || key_len == 0 || key_len > 255) {
-    return;
-  }
-
-  pthread_mutex_lock(&table->lock);
-
-  struct hash_entry *entry = NULL;
-  HASH_FIND(hh, table->head, key, key_len, entry);
-  if (entry) {
-    pthread_mutex_unlock(&table->lock);
-    return;
-  }
-
-  entry = (struct hash_entry *)malloc(sizeof(struct hash_entry));
-  if (!entry) {
-    pthread_mutex_unlock(&table->lock);
-    return;
-  }
-
-  memcpy(entry->key, key, key_len);
-  entry->key_len = key_len;
-  HASH_ADD_KEYPTR(hh, table->head, entry->key, key_len, entry);
-
-  pthread_mutex_unlock(&table->lock);
-}
-
-// Checks if a key exists in the table
-static inline uint8_t key_in_table(hash_table_t *table, const void *key,
-                                   uint32_t key_len) {
-  if (!table || !key || key_len == 0 || key_len > 255) {
-    return 0;
-  }
+// Callback for table_for_each(); return non-zero to stop the walk early.
+typedef int (*table_visit_fn)(const void *key, uint32_t key_len, void *arg);
 
-  pthread_mutex_lock(&table->lock);
+// Creates an empty hash table with one lock per stripe.
+int create_table(hash_table_t *table);
 
-  struct hash_entry *entry = NULL;
-  HASH_FIND(hh, table->head, key, key_len, entry);
+// Adds a key to the hash table if missing. hash selects the stripe.
+// Returns 1 if the key was inserted, 0 if it was already present, -1 on
+// allocation failure.
+int add_key(hash_table_t *table, const void *key, uint32_t key_len,
+            uint32_t hash);
 
-  uint8_t found = (entry != NULL) ? 1 : 0;
-  pthread_mutex_unlock(&table->lock);
-  return found;
-}
+// Checks if a key exists in the table
+uint8_t key_in_table(hash_table_t *table, const void *key, uint32_t key_len,
+                     uint32_t hash);
 
 // Deletes a key from the hash table
-static inline void delete_key(hash_table_t *table, const void *key,
-                              uint32_t key_len) {
-  if (!table || !key || key_len == 0 || key_len > 255) {
-    return;
-  }
+void delete_key(hash_table_t *table, const void *key, uint32_t key_len,
+                uint32_t hash);
 
-  pthread_mutex_lock(&table->lock);
+// Calls visit for every key, one stripe at a time under its shared lock.
+// visit must not modify the table.
+void table_for_each(hash_table_t *table, table_visit_fn visit, void *arg);
 
-  struct hash_entry *entry = NULL;
-  HASH_FIND(hh, table->head, key, key_len, entry);
-  if (entry) {
-    HASH_DEL(table->head, entry);
-    free(entry);
-  }
+// Number of keys currently in the table
+uint64_t table_key_count(hash_table_t *table);
 
-  pthread_mutex_unlock(&table->lock);
-}
+// Slots allocated across all stripes (used + free)
+uint64_t table_capacity(hash_table_t *table);
 
-// Frees all entries in the hash table
-static inline void free_table(hash_table_t *table) {
-  if (!table) {
-    return;
-  }
-
-  pthread_mutex_lock(&table->lock);
+// Deleted slots not yet reclaimed by a rehash
+uint64_t table_tombstone_count(hash_table_t *table);
 
-  struct hash_entry *current;
-  struct hash_entry *tmp;
+// Highest (live + deleted) / capacity over the stripes; a stripe rehashes
+// when an insert would take it past 7/8
+double table_max_stripe_load(hash_table_t *table);
 
-  HASH_ITER(hh, table->head, current, tmp) {
-    HASH_DEL(table->head, current);
-    free(current);
-  }
+// Heap bytes used by the index (control bytes, offsets and key arenas)
+uint64_t table_memory_bytes(hash_table_t *table);
 
-  pthread_mutex_unlock(&table->lock);
-  pthread_mutex_destroy(&table->lock);
-}
+// Frees all entries in the hash table
+void free_table(hash_table_t *table);
 
 #endif // HASH_TABLE_H
@@ -0,0 +1,146 @@
+/**
+ * Hot Key Sketch Implementation
+ */
+
+#include "hot_key_sketch.h"
+#include <stdlib.h>
+#include <string.h>
+
+hot_key_sketch_t *hot_key_sketch_create(uint32_t width) {
+  if (width == 0) {
+    return NULL;
+  }
+
+  hot_key_sketch_t *sketch = calloc(1, sizeof(hot_key_sketch_t));
+  if (!sketch) {
+    return NULL;
+  }
+
+  uint32_t rounded = 1;
+  while (rounded < width) {
+    rounded <<= 1;
+  }
+  sketch->width_mask = rounded - 1;
+
+  sketch->counters =
+      calloc((size_t)HOT_KEY_SKETCH_DEPTH * rounded, sizeof(uint32_t));
+  if (!sketch->counters) {
+    free(sketch);
+    return NULL;
+  }
+
+  pthread_mutex_init(&sketch->lock, NULL);
+  return sketch;
+}
+
+// smallest count in the table, or 0 while it still has free slots
+static uint64_t table_floor(const hot_key_sketch_t *sketch) {
+  if (sketch->num_entries < HOT_KEY_TABLE_SIZE) {
+    return 0;
+  }
+  uint64_t floor = sketch->entries[0].count;
+  for (uint32_t i = 1; i < sketch->num_entries; i++) {
+    if (sketch->entries[i].count < floor) {
+      floor = sketch->entries[i].count;
+    }
+  }
+  return floor;
+}
+
+void hot_key_sketch_record(hot_key_sketch_t *sketch, uint64_t hash,
+                           const void *key, uint32_t key_len) {
+  // one counter per row, picked by double hashing
+  uint32_t h1 = (uint32_t)hash;
+  uint32_t h2 = (uint32_t)(hash >> 32) | 1;
+  uint64_t estimate = UINT64_MAX;
+
+  for (uint32_t d = 0; d < HOT_KEY_SKETCH_DEPTH; d++) {
+    uint32_t col = (h1 + d * h2) & sketch->width_mask;
+    _Atomic uint32_t *counter =
+        &sketch->counters[(size_t)d * (sketch->width_mask + 1) + col];
+    uint64_t value =
+        atomic_fetch_add_explicit(counter, 1, memory_order_relaxed) + 1;
+    if (value < estimate) {
+      estimate = value;
+    }
+  }
+
+  if (estimate <= atomic_load_explicit(&sketch->admit_min,
+                                       memory_order_relaxed)) {
+    return;
+  }
+  if (key_len > HOT_KEY_MAX_LEN) {
+    key_len = HOT_KEY_MAX_LEN;
+  }
+
+  pthread_mutex_lock(&sketch->lock);
+
+  hot_key_entry_t *slot = NULL;
+  for (uint32_t i = 0; i < sketch->num_entries; i++) {
+    hot_key_entry_t *entry = &sketch->entries[i];
+    if (entry->hash == hash && entry->key_len == key_len &&
+        memcmp(entry->key, key, key_len) == 0) {
+      slot = entry;
+      break;
+    }
+  }
+
+  if (!slot) {
+    if (sketch->num_entries < HOT_KEY_TABLE_SIZE) {
+      slot = &sketch->entries[sketch->num_entries++];
+    } else {
+      // evict the coldest entry, if this key now beats it
+      slot = &sketch->entries[0];
+      for (uint32_t i = 1; i < sketch->num_entries; i++) {
+        if (sketch->entries[i].count < slot->count) {
+          slot = &sketch->entries[i];
+        }
+      }
+      if (slot->count >= estimate) {
+        pthread_mutex_unlock(&sketch->lock);
+        return;
+      }
+    }
+    slot->hash = hash;
+    slot->key_len = key_len;
+    memcpy(slot->key, key, key_len);
+  }
+  slot->count = estimate;
+
+  atomic_store_explicit(&sketch->admit_min, table_floor(sketch),
+                        memory_order_relaxed);
+  pthread_mutex_unlock(&sketch->lock);
+}
+
+uint32_t hot_key_sketch_snapshot(hot_key_sketch_t *sketch,
+                                 hot_key_entry_t *out) {
+  pthread_mutex_lock(&sketch->lock);
+  uint32_t n = sketch->num_entries;
+  memcpy(out, sketch->entries, n * sizeof(hot_key_entry_t));
+  pthread_mutex_unlock(&sketch->lock);
+  return n;
+}
+
+uint32_t hot_key_sketch_drain(hot_key_sketch_t *sketch, hot_key_entry_t *out) {
+  pthread_mutex_lock(&sketch->lock);
+  uint32_t n = sketch->num_entries;
+  memcpy(out, sketch->entries, n * sizeof(hot_key_entry_t));
+  sketch->num_entries = 0;
+  atomic_store_explicit(&sketch->admit_min, 0, memory_order_relaxed);
+
+  size_t counters = (size_t)HOT_KEY_SKETCH_DEPTH * (sketch->width_mask + 1);
+  for (size_t i = 0; i < counters; i++) {
+    atomic_store_explicit(&sketch->counters[i], 0, memory_order_relaxed);
+  }
+  pthread_mutex_unlock(&sketch->lock);
+  return n;
+}
+
+void hot_key_sketch_destroy(hot_key_sketch_t *sketch) {
+  if (!sketch) {
+    return;
+  }
+  pthread_mutex_destroy(&sketch->lock);
+  free((void *)sketch->counters);
+  free(sketch);
+}
@@ -0,0 +1,92 @@
+/**
+ * Hot Key Sketch
+ *
+ * Streaming heavy-hitter detector: a Count-Min sketch estimates how often
+ * each key was seen, and a small table keeps the keys with the largest
+ * estimates (with their bytes, so they can be reported). Memory is fixed
+ * regardless of how many distinct keys pass through.
+ *
+ * Count-Min increments are lock-free. The table is guarded by a mutex, but
+ * a key only takes it once its estimate beats the smallest count in a full
+ * table, so cold keys never contend. Estimates can only overcount; with
+ * probability 1 - e^-DEPTH the excess is below e/width of all samples.
+ */
+
+#ifndef HOT_KEY_SKETCH_H
+#define HOT_KEY_SKETCH_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define HOT_KEY_SKETCH_DEPTH 4
+#define HOT_KEY_TABLE_SIZE 32
+#define HOT_KEY_MAX_LEN 255
+
+/**
+ * A tracked key and its estimated count.
+ */
+typedef struct {
+  uint64_t hash;
+  uint64_t count;
+  uint32_t key_len;
+  unsigned char key[HOT_KEY_MAX_LEN];
+} hot_key_entry_t;
+
+typedef struct {
+  _Atomic uint32_t *counters; // DEPTH rows of width counters
+  uint32_t width_mask;        // width - 1, width a power of two
+
+  pthread_mutex_t lock;       // guards entries / num_entries
+  hot_key_entry_t entries[HOT_KEY_TABLE_SIZE];
+  uint32_t num_entries;
+  _Atomic uint64_t admit_min; // smallest table count once full, else 0
+} hot_key_sketch_t;
+
+/**
+ * Create an empty sketch.
+ *
+ * @param width Counters per row (rounded up to a power of two)
+ * @return Pointer to sketch, or NULL on failure
+ */
+hot_key_sketch_t *hot_key_sketch_create(uint32_t width);
+
+/**
+ * Count one occurrence of a key.
+ *
+ * @param sketch  The sketch
+ * @param hash    Well-mixed 64-bit hash of the key
+ * @param key     Key bytes (copied if the key enters the table)
+ * @param key_len Key length (at most HOT_KEY_MAX_LEN)
+ */
+void hot_key_sketch_record(hot_key_sketch_t *sketch, uint64_t hash,
+                           const void *key, uint32_t key_len);
+
+/**
+ * Copy out the tracked keys, in no particular order.
+ *
+ * @param sketch The sketch
+ * @param out    Receives up to HOT_KEY_TABLE_SIZE entries
+ * @return Number of entries copied
+ */
+uint32_t hot_key_sketch_snapshot(hot_key_sketch_t *sketch,
+                                 hot_key_entry_t *out);
+
+/**
+ * Copy out the tracked keys and start over with an empty sketch. Samples
+ * recorded concurrently may land on either side of the reset.
+ *
+ * @param sketch The sketch
+ * @param out    Receives up to HOT_KEY_TABLE_SIZE entries
+ * @return Number of entries copied
+ */
+uint32_t hot_key_sketch_drain(hot_key_sketch_t *sketch, hot_key_entry_t *out);
+
+/**
+ * Destroy the sketch.
+ *
+ * @param sketch The sketch to destroy (NULL is ignored)
+ */
+void hot_key_sketch_destroy(hot_key_sketch_t *sketch);
+
+#endif /* HOT_KEY_SKETCH_H */
@@ -0,0 +1,187 @@
+/**
+ * Log-Linear Latency Histogram Implementation
+ */
+
+#include "latency_histogram.h"
+
+/* Bucket layout: values below 2 * LATENCY_SUB_BUCKETS map to themselves.
+ * Above that, a value whose highest set bit is msb is shifted right until
+ * it lies in [SUB_BUCKETS, 2 * SUB_BUCKETS), and each msb gets its own run
+ * of SUB_BUCKETS buckets. */
+static inline uint32_t bucket_index(uint64_t value) {
+  if (value < 2 * LATENCY_SUB_BUCKETS) {
+    return (uint32_t)value;
+  }
+  uint32_t msb = 63 - (uint32_t)__builtin_clzll(value);
+  if (msb > LATENCY_MAX_MSB) {
+    return LATENCY_BUCKETS - 1;
+  }
+  uint32_t shift = msb - LATENCY_SUB_BUCKET_BITS;
+  return shift * LATENCY_SUB_BUCKETS + (uint32_t)(value >> shift);
+}
+
+/* Lowest and highest value that map to bucket index */
+static inline uint64_t bucket_low(uint32_t index) {
+  if (index < 2 * LATENCY_SUB_BUCKETS) {
+    return index;
+  }
+  uint32_t shift = index / LATENCY_SUB_BUCKETS - 1;
+  uint64_t sub = index % LATENCY_SUB_BUCKETS + LATENCY_SUB_BUCKETS;
+  return sub << shift;
+}
+
+static inline uint64_t bucket_high(uint32_t index) {
+  if (index < 2 * LATENCY_SUB_BUCKETS) {
+    return index;
+  }
+  uint32_t shift = index / LATENCY_SUB_BUCKETS - 1;
+  return bucket_low(index) + (1ULL << shift) - 1;
+}
+
+void latency_histogram_record(latency_histogram_t *hist, uint64_t value_ns) {
+  atomic_fetch_add_explicit(&hist->buckets[bucket_index(value_ns)], 1,
+                            memory_order_relaxed);
+
+  // the maximum rarely changes, so read before attempting the CAS
+  uint64_t max = atomic_load_explicit(&hist->max_ns, memory_order_relaxed);
+  while (value_ns > max &&
+         !atomic_compare_exchange_weak_explicit(&hist->max_ns, &max, value_ns,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed)) {
+  }
+}
+
+/* Summary of bucket counts whose largest sample is max_ns */
+static void summarize_counts(const uint64_t *counts, uint64_t max_ns,
+                             latency_summary_t *summary) {
+  uint64_t total = 0;
+  double weighted = 0.0;
+
+  for (uint32_t i = 0; i < LATENCY_BUCKETS; i++) {
+    total += counts[i];
+    weighted += (double)counts[i] * (double)(bucket_low(i) + bucket_high(i)) /
+                2.0;
+  }
+
+  summary->count = total;
+  summary->max_ns = max_ns;
+  summary->mean_ns = total > 0 ? weighted / (double)total : 0.0;
+
+  const double fractions[] = {0.50, 0.90, 0.99, 0.999};
+  uint64_t *targets[] = {&summary->p50_ns, &summary->p90_ns, &summary->p99_ns,
+                         &summary->p999_ns};
+  uint64_t seen = 0;
+  uint32_t bucket = 0;
+
+  for (int p = 0; p < 4; p++) {
+    if (total == 0) {
+      *targets[p] = 0;
+      continue;
+    }
+    // rank of the sample at this percentile (1-based, rounded up)
+    uint64_t rank = (uint64_t)(fractions[p] * (double)total);
+    if ((double)rank < fractions[p] * (double)total) {
+      rank++;
+    }
+    if (rank == 0) {
+      rank = 1;
+    }
+    while (bucket < LATENCY_BUCKETS && seen + counts[bucket] < rank) {
+      seen += counts[bucket];
+      bucket++;
+    }
+    uint64_t value =
+        bucket < LATENCY_BUCKETS ? bucket_high(bucket) : summary->max_ns;
+    *targets[p] = value < summary->max_ns ? value : summary->max_ns;
+  }
+}
+
+void latency_histogram_summarize(const latency_histogram_t *hist,
+                                 latency_summary_t *summary) {
+  uint64_t counts[LATENCY_BUCKETS];
+  for (uint32_t i = 0; i < LATENCY_BUCKETS; i++) {
+    counts[i] = atomic_load_explicit(&hist->buckets[i], memory_order_relaxed);
+  }
+  summarize_counts(counts,
+                   atomic_load_explicit(&hist->max_ns, memory_order_relaxed),
+                   summary);
+}
+
+void latency_histogram_cumulative(const latency_histogram_t *hist,
+                                  const uint64_t *bounds_ns,
+                                  uint32_t num_bounds, uint64_t *counts) {
+  uint64_t seen = 0;
+  uint32_t bucket = 0;
+
+  for (uint32_t b = 0; b < num_bounds; b++) {
+    while (bucket < LATENCY_BUCKETS && bucket_high(bucket) <= bounds_ns[b]) {
+      seen += atomic_load_explicit(&hist->buckets[bucket], memory_order_relaxed);
+      bucket++;
+    }
+    counts[b] = seen;
+  }
+}
+
+/* Bucket counts since the snapshot, which is advanced to now. Returns the
+ * number of samples. */
+static uint64_t window_counts(const latency_histogram_t *hist,
+                              uint64_t *snapshot, uint64_t *counts) {
+  uint64_t total = 0;
+  for (uint32_t i = 0; i < LATENCY_BUCKETS; i++) {
+    uint64_t now = atomic_load_explicit(&hist->buckets[i], memory_order_relaxed);
+    counts[i] = now - snapshot[i];
+    snapshot[i] = now;
+    total += counts[i];
+  }
+  return total;
+}
+
+uint64_t latency_histogram_window_percentile(const latency_histogram_t *hist,
+                                             uint64_t *snapshot,
+                                             double fraction) {
+  uint64_t counts[LATENCY_BUCKETS];
+  uint64_t total = window_counts(hist, snapshot, counts);
+  if (total == 0) {
+    return 0;
+  }
+
+  uint64_t rank = (uint64_t)(fraction * (double)total);
+  if ((double)rank < fraction * (double)total) {
+    rank++;
+  }
+  if (rank == 0) {
+    rank = 1;
+  }
+  uint64_t seen = 0;
+  for (uint32_t i = 0; i < LATENCY_BUCKETS; i++) {
+    seen += counts[i];
+    if (seen >= rank) {
+      return bucket_high(i);
+    }
+  }
+  return bucket_high(LATENCY_BUCKETS - 1);
+}
+
+void latency_histogram_window_summarize(const latency_histogram_t *hist,
+                                        uint64_t *snapshot,
+                                        latency_summary_t *summary) {
+  uint64_t counts[LATENCY_BUCKETS];
+  window_counts(hist, snapshot, counts);
+
+  // the exact maximum covers all time, so use the highest bucket instead
+  uint64_t max_ns = 0;
+  for (uint32_t i = LATENCY_BUCKETS; i-- > 0;) {
+    if (counts[i]) {
+      max_ns = bucket_high(i);
+      break;
+    }
+  }
+  summarize_counts(counts, max_ns, summary);
+}
+
+void latency_histogram_reset(latency_histogram_t *hist) {
+  for (uint32_t i = 0; i < LATENCY_BUCKETS; i++) {
+    atomic_store_explicit(&hist->buckets[i], 0, memory_order_relaxed);
+  }
+  atomic_store_explicit(&hist->max_ns, 0, memory_order_relaxed);
+}
@@ -0,0 +1,115 @@
+/**
+ * Log-Linear Latency Histogram
+ *
+ * HDR-style histogram of nanosecond latencies. Values below 64 ns get one
+ * bucket each; above that every power-of-two range is split into 32 linear
+ * sub-buckets, so any recorded value is reported within about 3% of its
+ * true value up to 2^41 ns (~36 minutes; larger values land in the top
+ * bucket).
+ *
+ * Recording is a single relaxed atomic increment (plus a compare-and-swap
+ * only when a new maximum is seen), so histograms can be shared by all
+ * threads. Counts and means are derived from the buckets when summarizing.
+ */
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define LATENCY_SUB_BUCKET_BITS 5
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BUCKET_BITS) // 32 per octave
+#define LATENCY_MAX_MSB 40 // values >= 2^41 ns are clamped into the top bucket
+#define LATENCY_BUCKETS                                                        \
+  ((LATENCY_MAX_MSB - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKETS +     \
+   LATENCY_SUB_BUCKETS)
+
+typedef struct {
+  _Atomic uint64_t buckets[LATENCY_BUCKETS];
+  _Atomic uint64_t max_ns;
+} latency_histogram_t;
+
+/**
+ * Percentile summary of a histogram. Percentiles report the upper bound of
+ * the bucket they fall in, capped at the exact maximum.
+ */
+typedef struct {
+  uint64_t count;
+  double mean_ns;
+  uint64_t p50_ns;
+  uint64_t p90_ns;
+  uint64_t p99_ns;
+  uint64_t p999_ns;
+  uint64_t max_ns;
+} latency_summary_t;
+
+/**
+ * Record one latency sample.
+ *
+ * @param hist     The histogram
+ * @param value_ns Latency in nanoseconds
+ */
+void latency_histogram_record(latency_histogram_t *hist, uint64_t value_ns);
+
+/**
+ * Compute count, mean and percentiles in one pass over the buckets.
+ * Concurrent recording may make the result off by the samples in flight.
+ *
+ * @param hist    The histogram
+ * @param summary Receives the summary (all zero if the histogram is empty)
+ */
+void latency_histogram_summarize(const latency_histogram_t *hist,
+                                 latency_summary_t *summary);
+
+/**
+ * Count samples at or below each of a list of bounds, e.g. for exporting
+ * cumulative buckets. A sample counts toward a bound if its whole bucket
+ * lies at or below it, so counts may fall short by the ~3% bucket width.
+ * @param hist       The histogram
+ * @param bounds_ns  Ascending upper bounds in nanoseconds
+ * @param num_bounds Number of bounds
+ * @param counts     Receives num_bounds cumulative counts
+ */
+void latency_histogram_cumulative(const latency_histogram_t *hist,
+                                  const uint64_t *bounds_ns,
+                                  uint32_t num_bounds, uint64_t *counts);
+
+/**
+ * Percentile of the samples recorded since a snapshot of the buckets, e.g.
+ * for a threshold that follows recent behaviour. The snapshot is then
+ * advanced to the current counts. Not safe to call concurrently on the
+ * same snapshot.
+ *
+ * @param hist     The histogram
+ * @param snapshot LATENCY_BUCKETS counts from the previous call (zeroed
+ *                 before the first)
+ * @param fraction Percentile as a fraction, e.g. 0.95
+ * @return Upper bound of the bucket holding the percentile, 0 if no samples
+ *         were recorded since the snapshot
+ */
+uint64_t latency_histogram_window_percentile(const latency_histogram_t *hist,
+                                             uint64_t *snapshot,
+                                             double fraction);
+
+/**
+ * Summary of the samples recorded since a snapshot of the buckets, which
+ * is then advanced like in latency_histogram_window_percentile. The
+ * maximum is the upper bound of the highest bucket used in the window.
+ *
+ * @param hist     The histogram
+ * @param snapshot LATENCY_BUCKETS counts from the previous call
+ * @param summary  Receives the summary (all zero if no samples)
+ */
+void latency_histogram_window_summarize(const latency_histogram_t *hist,
+                                        uint64_t *snapshot,
+                                        latency_summary_t *summary);
+
+/**
+ * Clear all samples.
+ *
+ * @param hist The histogram
+ */
+void latency_histogram_reset(latency_histogram_t *hist);
+
+#endif /* LATENCY_HISTOGRAM_H */
@@ -60,6 +60,13 @@ void memory_pool_free(memory_pool_t *pool, void *ptr) {
   (void)ptr;
 }
 
+size_t memory_pool_used(memory_pool_t *pool) {
+  pthread_mutex_lock(&pool->lock);
+  size_t used = pool->used;
+  pthread_mutex_unlock(&pool->lock);
+  return used;
+}
+
 void memory_pool_destroy(memory_pool_t *pool) {
   if (!pool) {
     return;
@@ -38,6 +38,13 @@ void *memory_pool_alloc(memory_pool_t *pool, size_t size);
  */
 void memory_pool_free(memory_pool_t *pool, void *ptr);
 
+/**
+ * Bytes handed out so far
+ * @param pool The memory pool
+ * @return Allocated bytes (0 to size)
+ */
+size_t memory_pool_used(memory_pool_t *pool);
+
 /**
  * Destroy the entire pool
  * @param pool The memory pool to destroy
@@ -0,0 +1,179 @@
+/**
+ * Reed-Solomon Erasure Code Implementation
+ */
+
+#include "reed_solomon.h"
+#include <pthread.h>
+#include <string.h>
+
+// GF(2^8) with the polynomial x^8 + x^4 + x^3 + x^2 + 1
+static uint8_t gf_exp[512];
+static uint8_t gf_log[256];
+static uint8_t gf_mul_table[256][256];
+static pthread_once_t gf_once = PTHREAD_ONCE_INIT;
+
+static void gf_init(void) {
+  uint32_t x = 1;
+  for (uint32_t i = 0; i < 255; i++) {
+    gf_exp[i] = (uint8_t)x;
+    gf_log[x] = (uint8_t)i;
+    x <<= 1;
+    if (x & 0x100) {
+      x ^= 0x11d;
+    }
+  }
+  // doubled so a product never needs a modulo
+  for (uint32_t i = 255; i < 512; i++) {
+    gf_exp[i] = gf_exp[i - 255];
+  }
+  for (uint32_t a = 1; a < 256; a++) {
+    for (uint32_t b = 1; b < 256; b++) {
+      gf_mul_table[a][b] = gf_exp[gf_log[a] + gf_log[b]];
+    }
+  }
+}
+
+static uint8_t gf_inv(uint8_t a) { return gf_exp[255 - gf_log[a]]; }
+
+// Generator row r: the unit row for a data shard, a Cauchy row for parity
+// shard r - k (1 / (x_i + y_j) with x_i = k + i and y_j = j, all distinct)
+static void generator_row(uint32_t k, uint32_t r, uint8_t *row) {
+  for (uint32_t j = 0; j < k; j++) {
+    if (r < k) {
+      row[j] = r == j;
+    } else {
+      row[j] = gf_inv((uint8_t)(r ^ j));
+    }
+  }
+}
+
+// dst ^= c * src
+static void mul_add(uint8_t *dst, const uint8_t *src, uint8_t c, size_t len) {
+  if (c == 0) {
+    return;
+  }
+  if (c == 1) {
+    for (size_t b = 0; b < len; b++) {
+      dst[b] ^= src[b];
+    }
+    return;
+  }
+  const uint8_t *mul = gf_mul_table[c];
+  for (size_t b = 0; b < len; b++) {
+    dst[b] ^= mul[src[b]];
+  }
+}
+
+void rs_encode(uint32_t k, uint32_t m, size_t len, const uint8_t *const *data,
+               uint8_t *const *parity) {
+  pthread_once(&gf_once, gf_init);
+  uint8_t row[RS_MAX_SHARDS];
+  for (uint32_t i = 0; i < m; i++) {
+    generator_row(k, k + i, row);
+    memset(parity[i], 0, len);
+    for (uint32_t j = 0; j < k; j++) {
+      mul_add(parity[i], data[j], row[j], len);
+    }
+  }
+}
+
+void rs_encode_shard(uint32_t k, uint32_t m, uint32_t j, size_t len,
+                     const uint8_t *data, uint8_t *const *parity) {
+  pthread_once(&gf_once, gf_init);
+  uint8_t row[RS_MAX_SHARDS];
+  for (uint32_t i = 0; i < m; i++) {
+    generator_row(k, k + i, row);
+    mul_add(parity[i], data, row[j], len);
+  }
+}
+
+// Gauss-Jordan inversion of the k x k matrix a into inv; a is destroyed.
+// Returns -1 if a is singular (never for rows of the generator).
+static int invert(uint32_t k, uint8_t a[][RS_MAX_SHARDS],
+                  uint8_t inv[][RS_MAX_SHARDS]) {
+  for (uint32_t r = 0; r < k; r++) {
+    memset(inv[r], 0, k);
+    inv[r][r] = 1;
+  }
+  for (uint32_t col = 0; col < k; col++) {
+    uint32_t pivot = col;
+    while (pivot < k && a[pivot][col] == 0) {
+      pivot++;
+    }
+    if (pivot == k) {
+      return -1;
+    }
+    if (pivot != col) {
+      uint8_t tmp[RS_MAX_SHARDS];
+      memcpy(tmp, a[col], k);
+      memcpy(a[col], a[pivot], k);
+      memcpy(a[pivot], tmp, k);
+      memcpy(tmp, inv[col], k);
+      memcpy(inv[col], inv[pivot], k);
+      memcpy(inv[pivot], tmp, k);
+    }
+    uint8_t scale = gf_inv(a[col][col]);
+    for (uint32_t j = 0; j < k; j++) {
+      a[col][j] = a[col][j] ? gf_mul_table[scale][a[col][j]] : 0;
+      inv[col][j] = inv[col][j] ? gf_mul_table[scale][inv[col][j]] : 0;
+    }
+    for (uint32_t r = 0; r < k; r++) {
+      uint8_t factor = a[r][col];
+      if (r == col || factor == 0) {
+        continue;
+      }
+      for (uint32_t j = 0; j < k; j++) {
+        a[r][j] ^= gf_mul_table[factor][a[col][j]];
+        inv[r][j] ^= gf_mul_table[factor][inv[col][j]];
+      }
+    }
+  }
+  return 0;
+}
+
+int rs_reconstruct(uint32_t k, uint32_t m, size_t len, uint8_t *const *shards,
+                   const bool *present) {
+  pthread_once(&gf_once, gf_init);
+
+  // the first k present shards, preferring data shards since their rows
+  // are unit rows
+  uint32_t rows[RS_MAX_SHARDS];
+  uint32_t found = 0;
+  for (uint32_t r = 0; r < k + m && found < k; r++) {
+    if (present[r]) {
+      rows[found++] = r;
+    }
+  }
+  if (found < k) {
+    return -1;
+  }
+
+  bool missing = false;
+  for (uint32_t j = 0; j < k; j++) {
+    missing |= !present[j];
+  }
+  if (!missing) {
+    return 0;
+  }
+
+  uint8_t a[RS_MAX_SHARDS][RS_MAX_SHARDS];
+  uint8_t inv[RS_MAX_SHARDS][RS_MAX_SHARDS];
+  for (uint32_t t = 0; t < k; t++) {
+    generator_row(k, rows[t], a[t]);
+  }
+  if (invert(k, a, inv) != 0) {
+    return -1;
+  }
+
+  // data shard j = sum over t of inv[j][t] * shard rows[t]
+  for (uint32_t j = 0; j < k; j++) {
+    if (present[j]) {
+      continue;
+    }
+    memset(shards[j], 0, len);
+    for (uint32_t t = 0; t < k; t++) {
+      mul_add(shards[j], shards[rows[t]], inv[j][t], len);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,66 @@
+/**
+ * Reed-Solomon Erasure Code
+ *
+ * Systematic code over GF(2^8): k data shards are stored as they are and m
+ * parity shards are linear combinations of them, with coefficients from a
+ * Cauchy matrix. Every k x k submatrix of the resulting generator is
+ * invertible, so any k of the k + m shards recover the data, i.e. up to m
+ * shards may be lost.
+ *
+ * Encoding costs one table lookup and XOR per data byte per parity shard;
+ * reconstruction inverts a k x k matrix once and then costs the same per
+ * missing shard.
+ */
+
+#ifndef REED_SOLOMON_H
+#define REED_SOLOMON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Most shards (data plus parity) a code may have */
+#define RS_MAX_SHARDS 32
+
+/**
+ * Computes parity shards.
+ *
+ * @param k      Data shards (at least 1)
+ * @param m      Parity shards; k + m at most RS_MAX_SHARDS
+ * @param len    Bytes per shard
+ * @param data   k data shards of len bytes
+ * @param parity m buffers of len bytes, overwritten with the parity
+ */
+void rs_encode(uint32_t k, uint32_t m, size_t len, const uint8_t *const *data,
+               uint8_t *const *parity);
+
+/**
+ * Adds data shard j to parity shards being built a shard at a time. Once
+ * all k data shards have been added to zeroed parity buffers they hold
+ * what rs_encode computes.
+ *
+ * @param k      Data shards
+ * @param m      Parity shards
+ * @param j      Which data shard, below k
+ * @param len    Bytes per shard
+ * @param data   Data shard j, len bytes
+ * @param parity m buffers of len bytes, updated in place
+ */
+void rs_encode_shard(uint32_t k, uint32_t m, uint32_t j, size_t len,
+                     const uint8_t *data, uint8_t *const *parity);
+
+/**
+ * Rebuilds the missing data shards from any k present shards.
+ *
+ * @param k       Data shards
+ * @param m       Parity shards
+ * @param len     Bytes per shard
+ * @param shards  k + m shard buffers, data shards first; the buffers of
+ *                missing data shards receive their contents
+ * @param present Which shards hold valid contents
+ * @return 0 on success, -1 if fewer than k shards are present
+ */
+int rs_reconstruct(uint32_t k, uint32_t m, size_t len, uint8_t *const *shards,
+                   const bool *present);
+
+#endif /* REED_SOLOMON_H */
@@ -0,0 +1,92 @@
+/**
+ * Rendezvous Hashing Implementation
+ */
+
+#include "rendezvous_hash.h"
+#include <math.h>
+#include <stdbool.h>
+
+/* A node's standing for a key: its weighted score (0 for all nodes when
+ * unweighted), ties broken by the raw score */
+typedef struct {
+  double weighted;
+  uint64_t score;
+} rank_t;
+
+uint64_t rendezvous_score(uint32_t key_hash, uint32_t node) {
+  // splitmix64 finalizer over (node, key) so scores of different nodes
+  // for the same key are independent
+  uint64_t h = ((uint64_t)(node + 1) << 32 | key_hash) *
+               0x9e3779b97f4a7c15ULL;
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ULL;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebULL;
+  h ^= h >> 31;
+  return h;
+}
+
+static rank_t node_rank(uint32_t key_hash, const uint32_t *weights,
+                        uint32_t node) {
+  rank_t rank = {0.0, rendezvous_score(key_hash, node)};
+  if (weights) {
+    // u in (0, 1) from the top 53 bits, so -log(u) is positive and finite
+    double u = ((double)(rank.score >> 11) + 0.5) * 0x1p-53;
+    rank.weighted = (double)weights[node] / -log(u);
+  }
+  return rank;
+}
+
+static bool outranks(rank_t a, rank_t b) {
+  return a.weighted > b.weighted ||
+         (a.weighted == b.weighted && a.score > b.score);
+}
+
+uint32_t rendezvous_pick(uint32_t key_hash, const uint32_t *weights,
+                         uint32_t num_nodes) {
+  if (!weights) {
+    // raw scores alone, selected without branches: a mispredicted best
+    // costs more than the mix at a hundred nodes
+    uint32_t best = 0;
+    uint64_t best_score = 0;
+    for (uint32_t node = 0; node < num_nodes; node++) {
+      uint64_t score = rendezvous_score(key_hash, node);
+      bool higher = score > best_score;
+      best_score = higher ? score : best_score;
+      best = higher ? node : best;
+    }
+    return best;
+  }
+  uint32_t best = 0;
+  rank_t best_rank = node_rank(key_hash, weights, 0);
+  for (uint32_t node = 1; node < num_nodes; node++) {
+    rank_t rank = node_rank(key_hash, weights, node);
+    if (outranks(rank, best_rank)) {
+      best = node;
+      best_rank = rank;
+    }
+  }
+  return best;
+}
+
+void rendezvous_top(uint32_t key_hash, const uint32_t *weights,
+                    uint32_t num_nodes, uint32_t count, uint32_t *out) {
+  // insertion into a descending list; count and num_nodes are small
+  rank_t ranks[count > 0 ? count : 1];
+  uint32_t filled = 0;
+  for (uint32_t node = 0; node < num_nodes; node++) {
+    rank_t rank = node_rank(key_hash, weights, node);
+    uint32_t pos = filled < count ? filled++ : count;
+    while (pos > 0 && outranks(rank, ranks[pos - 1])) {
+      if (pos < count) {
+        ranks[pos] = ranks[pos - 1];
+        out[pos] = out[pos - 1];
+      }
+      pos--;
+    }
+    if (pos < count) {
+      ranks[pos] = rank;
+      out[pos] = node;
+    }
+  }
+}
@@ -0,0 +1,60 @@
+/**
+ * Rendezvous Hashing
+ *
+ * Highest-random-weight placement: every node gets a pseudo-random score
+ * for a key and the key lives on the highest-scoring node. Adding node N
+ * only moves the keys for which N now scores highest (about 1/(N+1) of
+ * them), and every other key keeps its node, so a device can be added to
+ * a populated engine without reshuffling it. Scores are independent per
+ * node, which also gives a stable preference order when a key needs more
+ * than one node.
+ *
+ * Nodes may carry weights: a node's score becomes weight / -ln(u) for its
+ * uniform score u in (0, 1), so it wins a share of the keys proportional to
+ * its weight and adding a node still only moves keys to it. With equal
+ * weights (or none) the order is exactly that of the unweighted scores.
+ *
+ * A pick is one 64-bit mix per node, plus a logarithm when weighted:
+ * about 3ns per node unweighted, so a few hundred ns at KV_MAX_DEVICES.
+ */
+
+#ifndef RENDEZVOUS_HASH_H
+#define RENDEZVOUS_HASH_H
+
+#include <stdint.h>
+
+/**
+ * Score of a node for a key.
+ *
+ * @param key_hash 32-bit hash of the key
+ * @param node     Node number
+ * @return Uniformly distributed 64-bit score
+ */
+uint64_t rendezvous_score(uint32_t key_hash, uint32_t node);
+
+/**
+ * Node with the highest score for a key among nodes 0..num_nodes-1.
+ *
+ * @param key_hash  32-bit hash of the key
+ * @param weights   Weight of each node, at least 1 (NULL = all equal)
+ * @param num_nodes Number of nodes (at least 1)
+ * @return Chosen node
+ */
+uint32_t rendezvous_pick(uint32_t key_hash, const uint32_t *weights,
+                         uint32_t num_nodes);
+
+/**
+ * The count highest-scoring nodes for a key, best first. Growing num_nodes
+ * by one changes the list only if the new node scores among the top count,
+ * in which case it displaces the lowest entry.
+ *
+ * @param key_hash  32-bit hash of the key
+ * @param weights   Weight of each node, at least 1 (NULL = all equal)
+ * @param num_nodes Number of nodes
+ * @param count     Nodes wanted (at most num_nodes)
+ * @param out       Receives count node numbers
+ */
+void rendezvous_top(uint32_t key_hash, const uint32_t *weights,
+                    uint32_t num_nodes, uint32_t count, uint32_t *out);
+
+#endif /* RENDEZVOUS_HASH_H */
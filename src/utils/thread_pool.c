@@ -42,7 +42,9 @@ static void *thread_pool_worker(void *arg) {
     pthread_mutex_unlock(&pool->queue_lock);
 
     /* Execute work outside the lock */
+    atomic_fetch_add_explicit(&pool->active, 1, memory_order_relaxed);
     item->func(item->arg);
+    atomic_fetch_sub_explicit(&pool->active, 1, memory_order_relaxed);
     free(item);
   }
 
@@ -70,6 +72,7 @@ thread_pool_t *thread_pool_create(uint32_t num_threads, uint32_t queue_depth) {
   pool->queue_head = NULL;
   pool->queue_tail = NULL;
   pool->queue_size = 0;
+  atomic_init(&pool->active, 0);
   pool->queue_capacity = (queue_depth > 0) ? queue_depth : 128;
 
   pthread_mutex_init(&pool->queue_lock, NULL);
@@ -151,6 +154,17 @@ int thread_pool_submit(thread_pool_t *pool, void *(*func)(void *), void *arg,
   return 0;
 }
 
+uint32_t thread_pool_queue_size(thread_pool_t *pool) {
+  pthread_mutex_lock(&pool->queue_lock);
+  uint32_t size = pool->queue_size;
+  pthread_mutex_unlock(&pool->queue_lock);
+  return size;
+}
+
+uint32_t thread_pool_active(thread_pool_t *pool) {
+  return atomic_load_explicit(&pool->active, memory_order_relaxed);
+}
+
 void thread_pool_destroy(thread_pool_t *pool) {
   if (!pool) {
     return;
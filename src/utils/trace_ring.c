@@ -0,0 +1,82 @@
+/**
+ * Trace Ring Implementation
+ */
+
+#include "trace_ring.h"
+#include <stdlib.h>
+#include <string.h>
+
+trace_ring_t *trace_ring_create(uint32_t capacity, uint32_t record_size) {
+  if (capacity == 0 || record_size == 0) {
+    return NULL;
+  }
+
+  trace_ring_t *ring = calloc(1, sizeof(trace_ring_t));
+  if (!ring) {
+    return NULL;
+  }
+
+  uint32_t rounded = 1;
+  while (rounded < capacity) {
+    rounded <<= 1;
+  }
+  ring->capacity_mask = rounded - 1;
+  ring->record_size = record_size;
+  // keep every sequence word 8-byte aligned
+  ring->stride = (sizeof(uint64_t) + record_size + 7) & ~(size_t)7;
+
+  ring->slots = calloc(rounded, ring->stride);
+  if (!ring->slots) {
+    free(ring);
+    return NULL;
+  }
+  return ring;
+}
+
+static inline _Atomic uint64_t *slot_seq(trace_ring_t *ring, uint64_t pos) {
+  return (_Atomic uint64_t *)(ring->slots +
+                              (pos & ring->capacity_mask) * ring->stride);
+}
+
+void trace_ring_push(trace_ring_t *ring, const void *record) {
+  uint64_t pos =
+      atomic_fetch_add_explicit(&ring->head, 1, memory_order_relaxed);
+  _Atomic uint64_t *seq = slot_seq(ring, pos);
+
+  // odd while the record is being written, 2 * (pos + 1) once published
+  atomic_store_explicit(seq, 2 * pos + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  memcpy((unsigned char *)seq + sizeof(uint64_t), record, ring->record_size);
+  atomic_store_explicit(seq, 2 * pos + 2, memory_order_release);
+}
+
+uint32_t trace_ring_snapshot(trace_ring_t *ring, void *out) {
+  uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  uint64_t capacity = (uint64_t)ring->capacity_mask + 1;
+  uint64_t first = head > capacity ? head - capacity : 0;
+  unsigned char *dst = out;
+  uint32_t n = 0;
+
+  for (uint64_t pos = first; pos < head; pos++) {
+    _Atomic uint64_t *seq = slot_seq(ring, pos);
+    uint64_t before = atomic_load_explicit(seq, memory_order_acquire);
+    if (before != 2 * pos + 2) {
+      continue; // still being written, or already overwritten
+    }
+    memcpy(dst + (size_t)n * ring->record_size,
+           (unsigned char *)seq + sizeof(uint64_t), ring->record_size);
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(seq, memory_order_relaxed) == before) {
+      n++;
+    }
+  }
+  return n;
+}
+
+void trace_ring_destroy(trace_ring_t *ring) {
+  if (!ring) {
+    return;
+  }
+  free(ring->slots);
+  free(ring);
+}
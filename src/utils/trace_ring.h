@@ -0,0 +1,69 @@
+/**
+ * Trace Ring
+ *
+ * Fixed-size, lock-free ring of fixed-size records that overwrites the
+ * oldest entry when full. Writers claim a position with one atomic add and
+ * publish the record under a per-slot sequence number, so readers can copy
+ * the ring at any time without stopping writers; a slot that is being
+ * rewritten while it is copied is simply left out of the snapshot.
+ *
+ * Intended for one writer per ring (per-thread rings) but safe with
+ * several: concurrent writers only contend on the head counter.
+ */
+
+#ifndef TRACE_RING_H
+#define TRACE_RING_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+  _Atomic uint64_t head; // positions claimed so far
+  uint32_t capacity_mask; // capacity - 1, capacity a power of two
+  uint32_t record_size;
+  size_t stride;          // bytes per slot: sequence word + record
+  unsigned char *slots;
+} trace_ring_t;
+
+/**
+ * Create an empty ring.
+ *
+ * @param capacity    Records kept (rounded up to a power of two)
+ * @param record_size Size of one record in bytes
+ * @return Pointer to ring, or NULL on failure
+ */
+trace_ring_t *trace_ring_create(uint32_t capacity, uint32_t record_size);
+
+/**
+ * Append a record, overwriting the oldest one once the ring is full.
+ *
+ * @param ring   The ring
+ * @param record record_size bytes to copy in
+ */
+void trace_ring_push(trace_ring_t *ring, const void *record);
+
+/**
+ * Copy out the records currently in the ring, oldest first.
+ *
+ * @param ring The ring
+ * @param out  Receives up to capacity records
+ * @return Number of records copied
+ */
+uint32_t trace_ring_snapshot(trace_ring_t *ring, void *out);
+
+/**
+ * Capacity of the ring (after rounding).
+ */
+static inline uint32_t trace_ring_capacity(const trace_ring_t *ring) {
+  return ring->capacity_mask + 1;
+}
+
+/**
+ * Destroy the ring.
+ *
+ * @param ring The ring to destroy (NULL is ignored)
+ */
+void trace_ring_destroy(trace_ring_t *ring);
+
+#endif /* TRACE_RING_H */